@@ -114,7 +114,7 @@ fn parse_args() -> App<'static, 'static> {
             SubCommand::with_name("filesystem").subcommands(vec![
                 SubCommand::with_name("create")
                     .arg(Arg::with_name("pool_name").required(true))
-                    .arg(Arg::with_name("fs_name").required(true)),
+                    .arg(Arg::with_name("fs_name").required(true).multiple(true)),
                 SubCommand::with_name("destroy")
                     .arg(Arg::with_name("pool_name").required(true))
                     .arg(Arg::with_name("fs_name").required(true)),
@@ -122,6 +122,9 @@ fn parse_args() -> App<'static, 'static> {
                     .arg(Arg::with_name("pool_name").required(true))
                     .arg(Arg::with_name("fs_name").required(true))
                     .arg(Arg::with_name("new_fs_name").required(true)),
+                SubCommand::with_name("snapshot")
+                    .arg(Arg::with_name("pool_name").required(true))
+                    .arg(Arg::with_name("snapshots").required(true).multiple(true)),
             ]),
             SubCommand::with_name("report"),
         ])
@@ -265,7 +268,10 @@ fn main() -> Result<(), Box<dyn Error>> {
         if let Some(args) = subcommand.subcommand_matches("create") {
             filesystem::filesystem_create(
                 args.value_of("pool_name").expect("required").to_string(),
-                args.value_of("fs_name").expect("required").to_string(),
+                args.values_of("fs_name")
+                    .expect("required")
+                    .map(|s| s.to_string())
+                    .collect(),
             )?;
             Ok(())
         } else if let Some(args) = subcommand.subcommand_matches("destroy") {
@@ -281,6 +287,26 @@ fn main() -> Result<(), Box<dyn Error>> {
                 args.value_of("new_fs_name").expect("required").to_string(),
             )?;
             Ok(())
+        } else if let Some(args) = subcommand.subcommand_matches("snapshot") {
+            let names = args
+                .values_of("snapshots")
+                .expect("required")
+                .map(|s| s.to_string())
+                .collect::<Vec<_>>();
+            if names.len() % 2 != 0 {
+                return Err(Box::new(StratisError::Msg(
+                    "Each origin filesystem must be followed by the name of its snapshot"
+                        .to_string(),
+                )));
+            }
+            filesystem::filesystem_snapshot(
+                args.value_of("pool_name").expect("required").to_string(),
+                names
+                    .chunks(2)
+                    .map(|pair| (pair[0].clone(), pair[1].clone()))
+                    .collect(),
+            )?;
+            Ok(())
         } else {
             filesystem::filesystem_list()?;
             Ok(())
@@ -19,7 +19,10 @@ use nix::{
     unistd::getpid,
 };
 
-use stratisd::stratis::{run, StratisError, StratisResult, VERSION};
+use stratisd::{
+    engine::{PoolMetadataFormat, ThinCheckPolicy, DEFAULT_PARALLELISM},
+    stratis::{run, StratisError, StratisResult, DEFAULT_USAGE_REFRESH_INTERVAL, VERSION},
+};
 
 const STRATISD_PID_PATH: &str = "/run/stratisd.pid";
 const STRATISD_MIN_PID_PATH: &str = "/run/stratisd-min.pid";
@@ -145,7 +148,13 @@ fn main() -> Result<(), Box<dyn Error>> {
         println!("{}", help);
         Ok(())
     } else {
-        run(args.is_present("sim"))?;
+        run(
+            args.is_present("sim"),
+            Some(DEFAULT_USAGE_REFRESH_INTERVAL),
+            ThinCheckPolicy::default(),
+            PoolMetadataFormat::default(),
+            DEFAULT_PARALLELISM,
+        )?;
         Ok(())
     }
 }
@@ -17,7 +17,7 @@ use pretty_hex::pretty_hex;
 
 use serde_json::Value;
 
-use stratisd::engine::{StaticHeader, StaticHeaderResult, BDA};
+use stratisd::engine::{pool_metadata_to_json, StaticHeader, StaticHeaderResult, BDA};
 
 /// Format metadata on a given device
 /// Returns StaticHeader fields
@@ -116,8 +116,8 @@ fn run(devpath: &str, print_bytes: bool) -> Result<(), String> {
 
     println!("\nPool metadata:");
     if let Some(loaded_state) = loaded_state {
-        let state_json: Value = serde_json::from_slice(&loaded_state)
-            .map_err(|extract_err| format!("Error during state JSON extract: {}", extract_err))?;
+        let state_json: Value = pool_metadata_to_json(&loaded_state)
+            .map_err(|extract_err| format!("Error during state extract: {}", extract_err))?;
         let state_json_pretty: String = serde_json::to_string_pretty(&state_json)
             .map_err(|parse_err| format!("Error during state JSON parse: {}", parse_err))?;
         println!("{}", state_json_pretty);
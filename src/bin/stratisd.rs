@@ -3,12 +3,14 @@
 // file, You can obtain one at http://mozilla.org/MPL/2.0/.
 
 use std::{
+    convert::TryFrom,
     env,
     fs::{File, OpenOptions},
     io::{Read, Write},
     os::unix::io::AsRawFd,
     process::exit,
     str::FromStr,
+    time::Duration,
 };
 
 use clap::{App, Arg};
@@ -19,7 +21,10 @@ use nix::{
     unistd::getpid,
 };
 
-use stratisd::stratis::{run, StratisError, StratisResult, VERSION};
+use stratisd::{
+    engine::{PoolMetadataFormat, ThinCheckPolicy, DEFAULT_PARALLELISM},
+    stratis::{run, StratisError, StratisResult, DEFAULT_USAGE_REFRESH_INTERVAL, VERSION},
+};
 
 const STRATISD_PID_PATH: &str = "/run/stratisd.pid";
 const STRATISD_MIN_PID_PATH: &str = "/run/stratisd-min.pid";
@@ -130,8 +135,75 @@ fn main() {
                 .possible_values(&["trace", "debug", "info", "warn", "error"])
                 .help("Sets level for generation of log messages."),
         )
+        .arg(
+            Arg::with_name("usage-refresh-interval")
+                .empty_values(false)
+                .long("usage-refresh-interval")
+                .validator(|s| {
+                    s.parse::<u64>()
+                        .map(|_| ())
+                        .map_err(|e| format!("{}: {}", s, e))
+                })
+                .help(
+                    "Sets the interval in seconds at which pool and filesystem usage is \
+                     refreshed; 0 disables periodic refresh.",
+                ),
+        )
+        .arg(
+            Arg::with_name("thin-check")
+                .empty_values(false)
+                .long("thin-check")
+                .possible_values(&["full", "superblock", "skip"])
+                .help(
+                    "Sets how thoroughly thin pool metadata that has changed only by \
+                     error-free kernel transactions since it was last verified is checked \
+                     when a pool is set up; a full check is still run at every tenth setup. \
+                     The default is full.",
+                ),
+        )
+        .arg(
+            Arg::with_name("pool-metadata-format")
+                .empty_values(false)
+                .long("pool-metadata-format")
+                .possible_values(&["json", "binary"])
+                .help("Sets the format in which the metadata of newly created pools is written."),
+        )
+        .arg(
+            Arg::with_name("unlock-parallelism")
+                .empty_values(false)
+                .long("unlock-parallelism")
+                .validator(|s| match s.parse::<usize>() {
+                    Ok(0) => Err("must be at least 1".to_string()),
+                    Ok(_) => Ok(()),
+                    Err(e) => Err(format!("{}: {}", s, e)),
+                })
+                .help("Sets the largest number of devices of an encrypted pool unlocked at once."),
+        )
         .get_matches();
 
+    let usage_refresh_interval = match matches.value_of("usage-refresh-interval") {
+        Some(secs) => match secs.parse::<u64>().expect("validated by argument parser") {
+            0 => None,
+            secs => Some(Duration::from_secs(secs)),
+        },
+        None => Some(DEFAULT_USAGE_REFRESH_INTERVAL),
+    };
+
+    let thin_check_policy = matches
+        .value_of("thin-check")
+        .map(|policy| ThinCheckPolicy::try_from(policy).expect("validated by argument parser"))
+        .unwrap_or_default();
+
+    let metadata_format = matches
+        .value_of("pool-metadata-format")
+        .map(|format| PoolMetadataFormat::try_from(format).expect("validated by argument parser"))
+        .unwrap_or_default();
+
+    let unlock_parallelism = matches
+        .value_of("unlock-parallelism")
+        .map(|n| n.parse::<usize>().expect("validated by argument parser"))
+        .unwrap_or(DEFAULT_PARALLELISM);
+
     // Using a let-expression here so that the scope of the lock file
     // is the rest of the block.
     let lock_file = trylock_pid_file();
@@ -141,7 +213,13 @@ fn main() {
             Err(err) => Err(err),
             Ok(_) => {
                 initialize_log(matches.value_of("log-level"));
-                run(matches.is_present("sim"))
+                run(
+                    matches.is_present("sim"),
+                    usage_refresh_interval,
+                    thin_check_policy,
+                    metadata_format,
+                    unlock_parallelism,
+                )
             }
         }
     };
@@ -32,7 +32,7 @@ pub fn locked_pools_with_devs(
 ) -> Result<LockedPoolsWithDevs, String> {
     let dbus_context = info.tree.get_data();
 
-    let engine = dbus_context.engine.blocking_lock();
+    let engine = dbus_context.engine.blocking_read();
     Ok(engine
         .locked_pools()
         .into_iter()
@@ -54,7 +54,7 @@ pub fn destroy_pool(m: &MethodInfo<MTSync<TData>, TData>) -> MethodResult {
         }
     };
 
-    let msg = match log_action!(dbus_context.engine.blocking_lock().destroy_pool(pool_uuid)) {
+    let msg = match log_action!(dbus_context.engine.blocking_write().destroy_pool(pool_uuid)) {
         Ok(DeleteAction::Deleted(uuid)) => {
             dbus_context.push_remove(&pool_path, consts::pool_interface_list());
             return_message.append3(
@@ -88,7 +88,7 @@ pub fn unset_key(m: &MethodInfo<MTSync<TData>, TData>) -> MethodResult {
 
     let msg = match log_action!(dbus_context
         .engine
-        .blocking_lock()
+        .blocking_write()
         .get_key_handler_mut()
         .unset(&match KeyDescription::try_from(key_desc_str) {
             Ok(kd) => kd,
@@ -126,7 +126,7 @@ pub fn set_key(m: &MethodInfo<MTSync<TData>, TData>) -> MethodResult {
 
     let msg = match log_action!(dbus_context
         .engine
-        .blocking_lock()
+        .blocking_write()
         .get_key_handler_mut()
         .set(
             &match KeyDescription::try_from(key_desc_str) {
@@ -192,7 +192,7 @@ pub fn unlock_pool(m: &MethodInfo<MTSync<TData>, TData>) -> MethodResult {
 
     let msg = match log_action!(dbus_context
         .engine
-        .blocking_lock()
+        .blocking_write()
         .unlock_pool(pool_uuid, unlock_method))
     {
         Ok(unlock_action) => match unlock_action.changed() {
@@ -225,14 +225,19 @@ pub fn engine_state_report(m: &MethodInfo<MTSync<TData>, TData>) -> MethodResult
     let default_return = String::new();
 
     let dbus_context = m.tree.get_data();
-    let lock = dbus_context.engine.blocking_lock();
+    // The engine is locked only while the report is written out; the reply
+    // is constructed after the lock has been released.
+    let report = dbus_context
+        .engine
+        .blocking_read()
+        .engine_state_report_json();
 
-    let msg = match serde_json::to_string(&lock.engine_state_report()) {
+    let msg = match report {
         Ok(string) => {
             return_message.append3(string, DbusErrorEnum::OK as u16, OK_STRING.to_string())
         }
         Err(e) => {
-            let (rc, rs) = engine_to_dbus_err_tuple(&e.into());
+            let (rc, rs) = engine_to_dbus_err_tuple(&e);
             return_message.append3(default_return, rc, rs)
         }
     };
@@ -281,8 +286,8 @@ pub fn create_pool(m: &MethodInfo<MTSync<TData>, TData>) -> MethodResult {
 
     let object_path = m.path.get_name();
     let dbus_context = m.tree.get_data();
-    let mut mutex_lock = dbus_context.engine.blocking_lock();
-    let result = log_action!(mutex_lock.create_pool(
+    let mut write_lock = dbus_context.engine.blocking_write();
+    let result = log_action!(write_lock.create_pool(
         name,
         &devs.map(|x| Path::new(x)).collect::<Vec<&Path>>(),
         tuple_to_option(redundancy_tuple),
@@ -296,14 +301,14 @@ pub fn create_pool(m: &MethodInfo<MTSync<TData>, TData>) -> MethodResult {
         Ok(pool_uuid_action) => {
             let results = match pool_uuid_action {
                 CreateAction::Created(uuid) => {
-                    let (_, pool) = get_pool!(mutex_lock; uuid; default_return; return_message);
+                    let (_, pool) = get_pool!(write_lock; uuid; default_return; return_message);
 
                     let pool_object_path: dbus::Path = create_dbus_pool(
                         dbus_context,
                         object_path.clone(),
                         &Name::new(name.to_string()),
                         uuid,
-                        pool,
+                        &*pool,
                     );
 
                     let bd_paths = pool
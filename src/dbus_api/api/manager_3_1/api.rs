@@ -0,0 +1,53 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+use dbus_tree::{Factory, MTSync, Method};
+
+use crate::dbus_api::{
+    api::manager_3_1::methods::{fetch_object_properties, get_managed_objects_page},
+    types::TData,
+};
+
+pub fn fetch_object_properties_method(
+    f: &Factory<MTSync<TData>, TData>,
+) -> Method<MTSync<TData>, TData> {
+    f.method("FetchObjectProperties", (), fetch_object_properties)
+        // a(oas): Array of object paths, each with the names of the
+        // properties to fetch from the object's FetchProperties interface.
+        // An empty array of names requests all the properties.
+        .in_arg(("objects", "a(oas)"))
+        // a{oa{s(bv)}}: Dictionary of object paths to the results of
+        // fetching their properties, as returned by GetProperties.
+        // Object paths which do not refer to a pool, filesystem, or
+        // blockdev are omitted.
+        //
+        // Rust representation: HashMap<dbus::Path, HashMap<String, (bool, Variant)>>
+        .out_arg(("results", "a{oa{s(bv)}}"))
+        .out_arg(("return_code", "q"))
+        .out_arg(("return_string", "s"))
+}
+
+pub fn get_managed_objects_page_method(
+    f: &Factory<MTSync<TData>, TData>,
+) -> Method<MTSync<TData>, TData> {
+    f.method("GetManagedObjectsPage", (), get_managed_objects_page)
+        // s: UUID of a pool; if not empty, only the pool and its
+        //    filesystems and blockdevs are listed.
+        .in_arg(("pool_uuid", "s"))
+        // s: Only objects with paths that sort after this one are listed;
+        //    empty to start from the beginning.
+        .in_arg(("start_after", "s"))
+        // u: Maximum number of objects to list; 0 for the largest number
+        //    that stratisd allows.
+        .in_arg(("limit", "u"))
+        // In order from left to right:
+        // a{oa{sa{sv}}}: The objects, as returned by GetManagedObjects
+        // s: The value of start_after for the next page; empty if this is
+        //    the last page
+        //
+        // Rust representation: (GetManagedObjects, String)
+        .out_arg(("result", "(a{oa{sa{sv}}}s)"))
+        .out_arg(("return_code", "q"))
+        .out_arg(("return_string", "s"))
+}
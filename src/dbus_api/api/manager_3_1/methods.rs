@@ -0,0 +1,174 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+use std::{collections::HashMap, convert::TryFrom};
+
+use dbus::{
+    arg::{RefArg, Variant},
+    Message,
+};
+use dbus_tree::{MTSync, MethodInfo, MethodResult};
+
+use crate::{
+    dbus_api::{
+        api::shared::object_properties,
+        blockdev::{fetch_blockdev_properties, ALL_BLOCKDEV_PROPERTIES},
+        filesystem::{fetch_fs_properties, ALL_FS_PROPERTIES},
+        pool::{fetch_pool_properties, ALL_POOL_PROPERTIES},
+        types::{DbusErrorEnum, GetManagedObjects, TData, OK_STRING},
+        util::{engine_to_dbus_err_tuple, get_next_arg},
+    },
+    engine::{PoolUuid, StratisUuid},
+    stratis::StratisError,
+};
+
+type FetchedProperties = HashMap<String, (bool, Variant<Box<dyn RefArg>>)>;
+
+/// The maximum number of objects whose properties may be fetched, or which
+/// may be listed, in a single method call.
+pub const MAX_OBJECTS_PER_CALL: usize = 1000;
+
+pub fn fetch_object_properties(m: &MethodInfo<MTSync<TData>, TData>) -> MethodResult {
+    let message: &Message = m.msg;
+    let mut iter = message.iter_init();
+
+    let requests: Vec<(dbus::Path<'static>, Vec<String>)> = get_next_arg(&mut iter, 0)?;
+
+    let default_return: HashMap<dbus::Path<'static>, FetchedProperties> = HashMap::new();
+    let return_message = message.method_return();
+
+    if requests.len() > MAX_OBJECTS_PER_CALL {
+        let e = StratisError::Msg(format!(
+            "The properties of at most {} objects may be fetched at once",
+            MAX_OBJECTS_PER_CALL
+        ));
+        let (rc, rs) = engine_to_dbus_err_tuple(&e);
+        return Ok(vec![return_message.append3(default_return, rc, rs)]);
+    }
+
+    // Objects which are not in the tree, or which have no FetchProperties
+    // interface of their own, are omitted. An empty list of properties
+    // requests all the properties of the object.
+    let results = requests
+        .into_iter()
+        .filter_map(|(path, properties)| {
+            let data = m.tree.get(&path)?.get_data().as_ref()?;
+            let properties = &mut properties.into_iter();
+            let fetched = match (&data.uuid, properties.len()) {
+                (StratisUuid::Pool(_), 0) => fetch_pool_properties(
+                    m.tree,
+                    &path,
+                    &mut ALL_POOL_PROPERTIES.iter().map(|&s| s.to_string()),
+                ),
+                (StratisUuid::Pool(_), _) => fetch_pool_properties(m.tree, &path, properties),
+                (StratisUuid::Fs(_), 0) => fetch_fs_properties(
+                    m.tree,
+                    &path,
+                    &mut ALL_FS_PROPERTIES.iter().map(|&s| s.to_string()),
+                ),
+                (StratisUuid::Fs(_), _) => fetch_fs_properties(m.tree, &path, properties),
+                (StratisUuid::Dev(_), 0) => fetch_blockdev_properties(
+                    m.tree,
+                    &path,
+                    &mut ALL_BLOCKDEV_PROPERTIES.iter().map(|&s| s.to_string()),
+                ),
+                (StratisUuid::Dev(_), _) => fetch_blockdev_properties(m.tree, &path, properties),
+            };
+            Some((path, fetched))
+        })
+        .collect::<HashMap<_, _>>();
+
+    Ok(vec![return_message.append3(
+        results,
+        DbusErrorEnum::OK as u16,
+        OK_STRING.to_string(),
+    )])
+}
+
+pub fn get_managed_objects_page(m: &MethodInfo<MTSync<TData>, TData>) -> MethodResult {
+    let message: &Message = m.msg;
+    let mut iter = message.iter_init();
+
+    let pool_uuid_str: &str = get_next_arg(&mut iter, 0)?;
+    let start_after: &str = get_next_arg(&mut iter, 1)?;
+    let limit: u32 = get_next_arg(&mut iter, 2)?;
+
+    let default_return: (GetManagedObjects, String) = (HashMap::new(), String::new());
+    let return_message = message.method_return();
+
+    let pool_uuid = if pool_uuid_str.is_empty() {
+        None
+    } else {
+        match PoolUuid::parse_str(pool_uuid_str) {
+            Ok(uuid) => Some(uuid),
+            Err(e) => {
+                let e = StratisError::Chained(
+                    "Malformed UUID passed to GetManagedObjectsPage".to_string(),
+                    Box::new(e),
+                );
+                let (rc, rs) = engine_to_dbus_err_tuple(&e);
+                return Ok(vec![return_message.append3(default_return, rc, rs)]);
+            }
+        }
+    };
+    let limit = match usize::try_from(limit) {
+        Ok(0) | Err(_) => MAX_OBJECTS_PER_CALL,
+        Ok(limit) => std::cmp::min(limit, MAX_OBJECTS_PER_CALL),
+    };
+
+    // The object path of the pool to which the listing is restricted; if
+    // that pool does not exist, no object belongs to it.
+    let pool_path = pool_uuid.map(|pool_uuid| {
+        m.tree
+            .iter()
+            .find(|op| {
+                op.get_data().as_ref().map_or(
+                    false,
+                    |data| matches!(data.uuid, StratisUuid::Pool(uuid) if uuid == pool_uuid),
+                )
+            })
+            .map(|op| op.get_name().clone())
+    });
+
+    let mut candidates = m
+        .tree
+        .iter()
+        .filter(|op| &**op.get_name() > start_after)
+        .filter(|op| match (&pool_path, op.get_data()) {
+            (_, None) => false,
+            (None, Some(_)) => true,
+            (Some(None), Some(_)) => false,
+            (Some(Some(pool_path)), Some(data)) => {
+                op.get_name() == pool_path || &data.parent == pool_path
+            }
+        })
+        .collect::<Vec<_>>();
+    candidates.sort_by(|a, b| (**a.get_name()).cmp(&**b.get_name()));
+
+    let dbus_context = m.tree.get_data();
+    let engine = dbus_context.engine.blocking_read();
+
+    let next = if candidates.len() > limit {
+        candidates.truncate(limit);
+        candidates
+            .last()
+            .map(|op| op.get_name().to_string())
+            .unwrap_or_else(String::new)
+    } else {
+        String::new()
+    };
+    let objects: GetManagedObjects = candidates
+        .into_iter()
+        .filter_map(|op| object_properties(m.tree, &*engine, op))
+        .fold(HashMap::new(), |mut objects, object| {
+            objects.extend(object.into_iter());
+            objects
+        });
+
+    Ok(vec![return_message.append3(
+        (objects, next),
+        DbusErrorEnum::OK as u16,
+        OK_STRING.to_string(),
+    )])
+}
@@ -0,0 +1,4 @@
+mod api;
+mod methods;
+
+pub use api::{fetch_object_properties_method, get_managed_objects_page_method};
@@ -0,0 +1,17 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+use dbus_tree::{Factory, MTSync, Method};
+
+use crate::dbus_api::{api::metrics_3_0::methods::get_metrics, types::TData};
+
+pub fn get_metrics_method(f: &Factory<MTSync<TData>, TData>) -> Method<MTSync<TData>, TData> {
+    f.method("GetMetrics", (), get_metrics)
+        // The metrics are in the Prometheus text exposition format.
+        //
+        // s: the text of the metrics
+        .out_arg(("result", "s"))
+        .out_arg(("return_code", "q"))
+        .out_arg(("return_string", "s"))
+}
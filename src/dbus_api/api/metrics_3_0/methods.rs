@@ -0,0 +1,29 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+use dbus_tree::{MTSync, MethodInfo, MethodResult};
+
+use crate::{
+    dbus_api::types::{DbusErrorEnum, TData, OK_STRING},
+    engine::render_metrics,
+};
+
+/// Metrics of the engine together with those of D-Bus method dispatch.
+/// Neither requires the engine lock.
+pub fn get_metrics(m: &MethodInfo<MTSync<TData>, TData>) -> MethodResult {
+    let return_message = m.msg.method_return();
+
+    let mut metrics = render_metrics();
+    m.tree
+        .get_data()
+        .dispatch_stats
+        .write_prometheus(&mut metrics)
+        .expect("writing to a String can not fail");
+
+    Ok(vec![return_message.append3(
+        metrics,
+        DbusErrorEnum::OK as u16,
+        OK_STRING.to_string(),
+    )])
+}
@@ -0,0 +1,4 @@
+mod api;
+mod methods;
+
+pub use api::get_metrics_method;
@@ -11,6 +11,8 @@ use crate::dbus_api::{
 
 mod fetch_properties_3_0;
 mod manager_3_0;
+mod manager_3_1;
+mod metrics_3_0;
 mod report_3_0;
 mod shared;
 
@@ -47,6 +49,18 @@ pub fn get_base_tree<'a>(
                 .add_m(manager_3_0::engine_state_report_method(&f))
                 .add_p(manager_3_0::version_property(&f)),
         )
+        .add(
+            f.interface(consts::MANAGER_INTERFACE_NAME_3_1, ())
+                .add_m(manager_3_0::create_pool_method(&f))
+                .add_m(manager_3_0::set_key_method(&f))
+                .add_m(manager_3_0::unset_key_method(&f))
+                .add_m(manager_3_0::unlock_pool_method(&f))
+                .add_m(manager_3_0::destroy_pool_method(&f))
+                .add_m(manager_3_0::engine_state_report_method(&f))
+                .add_m(manager_3_1::fetch_object_properties_method(&f))
+                .add_m(manager_3_1::get_managed_objects_page_method(&f))
+                .add_p(manager_3_0::version_property(&f)),
+        )
         .add(
             f.interface(consts::PROPERTY_FETCH_INTERFACE_NAME_3_0, ())
                 .add_m(fetch_properties_3_0::get_all_properties_method(&f))
@@ -55,6 +69,10 @@ pub fn get_base_tree<'a>(
         .add(
             f.interface(consts::REPORT_INTERFACE_NAME_3_0, ())
                 .add_m(report_3_0::get_report_method(&f)),
+        )
+        .add(
+            f.interface(consts::METRICS_INTERFACE_NAME_3_0, ())
+                .add_m(metrics_3_0::get_metrics_method(&f)),
         );
 
     let path = obj_path.get_name().to_owned();
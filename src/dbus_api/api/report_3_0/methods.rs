@@ -9,6 +9,7 @@ use dbus_tree::{MTSync, MethodInfo, MethodResult};
 
 use crate::{
     dbus_api::{
+        consts,
         types::{DbusErrorEnum, TData, OK_STRING},
         util::{engine_to_dbus_err_tuple, get_next_arg},
     },
@@ -23,6 +24,17 @@ pub fn get_report(m: &MethodInfo<MTSync<TData>, TData>) -> MethodResult {
     let return_message = message.method_return();
     let default_return = String::new();
 
+    let dbus_context = m.tree.get_data();
+
+    if report_name == consts::DBUS_DISPATCH_REPORT {
+        let report: serde_json::Value = (&*dbus_context.dispatch_stats).into();
+        return Ok(vec![return_message.append3(
+            report.to_string(),
+            DbusErrorEnum::OK as u16,
+            OK_STRING.to_string(),
+        )]);
+    }
+
     let report_type = match ReportType::try_from(report_name) {
         Ok(rt) => rt,
         Err(e) => {
@@ -31,10 +43,9 @@ pub fn get_report(m: &MethodInfo<MTSync<TData>, TData>) -> MethodResult {
         }
     };
 
-    let dbus_context = m.tree.get_data();
-    let mutex_lock = dbus_context.engine.blocking_lock();
+    let read_lock = dbus_context.engine.blocking_read();
 
-    let msg = match serde_json::to_string(&mutex_lock.get_report(report_type)) {
+    let msg = match serde_json::to_string(&read_lock.get_report(report_type)) {
         Ok(string) => {
             return_message.append3(string, DbusErrorEnum::OK as u16, OK_STRING.to_string())
         }
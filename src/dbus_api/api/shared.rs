@@ -4,7 +4,7 @@
 
 use std::{collections::HashMap, vec::Vec};
 
-use dbus_tree::{Factory, MTSync, Method, MethodInfo, MethodResult, ObjectPath};
+use dbus_tree::{Factory, MTSync, Method, MethodInfo, MethodResult, ObjectPath, Tree};
 
 use crate::{
     dbus_api::{
@@ -20,8 +20,8 @@ use crate::{
 pub fn list_keys(info: &MethodInfo<MTSync<TData>, TData>) -> Result<Vec<String>, String> {
     let dbus_context = info.tree.get_data();
 
-    let mutex_lock = dbus_context.engine.blocking_lock();
-    mutex_lock
+    let read_lock = dbus_context.engine.blocking_read();
+    read_lock
         .get_key_handler()
         .list()
         .map(|v| {
@@ -35,8 +35,8 @@ pub fn list_keys(info: &MethodInfo<MTSync<TData>, TData>) -> Result<Vec<String>,
 pub fn locked_pool_uuids(info: &MethodInfo<MTSync<TData>, TData>) -> Result<Vec<String>, String> {
     let dbus_context = info.tree.get_data();
 
-    let mutex_lock = dbus_context.engine.blocking_lock();
-    Ok(mutex_lock
+    let read_lock = dbus_context.engine.blocking_read();
+    Ok(read_lock
         .locked_pools()
         .into_iter()
         .map(|(u, _)| uuid_to_string!(u))
@@ -48,7 +48,7 @@ pub fn locked_pools(
 ) -> Result<HashMap<String, String>, String> {
     let dbus_context = info.tree.get_data();
 
-    let engine = dbus_context.engine.blocking_lock();
+    let engine = dbus_context.engine.blocking_read();
     Ok(engine
         .locked_pools()
         .into_iter()
@@ -64,100 +64,108 @@ pub fn locked_pools(
         .collect())
 }
 
-pub fn get_managed_objects_method(
-    f: &Factory<MTSync<TData>, TData>,
-) -> Method<MTSync<TData>, TData> {
-    fn properties_to_get_managed_objects(
-        path: dbus::Path<'static>,
-        ia: InterfacesAddedThreadSafe,
-    ) -> GetManagedObjects {
-        let mut gmo = HashMap::new();
-        gmo.insert(path, thread_safe_to_dbus_sendable(ia));
-        gmo
-    }
+fn properties_to_get_managed_objects(
+    path: dbus::Path<'static>,
+    ia: InterfacesAddedThreadSafe,
+) -> GetManagedObjects {
+    let mut gmo = HashMap::new();
+    gmo.insert(path, thread_safe_to_dbus_sendable(ia));
+    gmo
+}
 
-    fn pool_properties(
-        path: &dbus::Path<'static>,
-        engine: &dyn Engine,
-        pool_uuid: PoolUuid,
-    ) -> Option<GetManagedObjects> {
-        engine.get_pool(pool_uuid).map(|(ref n, p)| {
-            properties_to_get_managed_objects(path.clone(), get_pool_properties(n, pool_uuid, p))
-        })
-    }
+fn pool_properties(
+    path: &dbus::Path<'static>,
+    engine: &dyn Engine,
+    pool_uuid: PoolUuid,
+) -> Option<GetManagedObjects> {
+    engine.get_pool(pool_uuid).map(|(ref n, p)| {
+        properties_to_get_managed_objects(path.clone(), get_pool_properties(n, pool_uuid, &*p))
+    })
+}
 
-    fn fs_properties(
-        parent_path: &dbus::Path<'static>,
-        path: &dbus::Path<'static>,
-        engine: &dyn Engine,
-        pool_uuid: PoolUuid,
-        fs_uuid: FilesystemUuid,
-    ) -> Option<GetManagedObjects> {
-        engine.get_pool(pool_uuid).and_then(|(ref p_n, p)| {
-            p.get_filesystem(fs_uuid).map(|(ref fs_n, f)| {
-                properties_to_get_managed_objects(
-                    path.clone(),
-                    get_fs_properties(parent_path.clone(), p_n, fs_n, fs_uuid, f),
-                )
-            })
+fn fs_properties(
+    parent_path: &dbus::Path<'static>,
+    path: &dbus::Path<'static>,
+    engine: &dyn Engine,
+    pool_uuid: PoolUuid,
+    fs_uuid: FilesystemUuid,
+) -> Option<GetManagedObjects> {
+    engine.get_pool(pool_uuid).and_then(|(ref p_n, p)| {
+        p.get_filesystem(fs_uuid).map(|(ref fs_n, f)| {
+            properties_to_get_managed_objects(
+                path.clone(),
+                get_fs_properties(parent_path.clone(), p_n, fs_n, fs_uuid, f),
+            )
         })
-    }
+    })
+}
 
-    fn blockdev_properties(
-        parent_path: &dbus::Path<'static>,
-        path: &dbus::Path<'static>,
-        engine: &dyn Engine,
-        pool_uuid: PoolUuid,
-        uuid: DevUuid,
-    ) -> Option<GetManagedObjects> {
-        engine.get_pool(pool_uuid).and_then(|(_, p)| {
-            p.get_blockdev(uuid).map(|(bd_tier, bd)| {
-                properties_to_get_managed_objects(
-                    path.clone(),
-                    get_blockdev_properties(parent_path.clone(), uuid, bd_tier, bd),
-                )
-            })
+fn blockdev_properties(
+    parent_path: &dbus::Path<'static>,
+    path: &dbus::Path<'static>,
+    engine: &dyn Engine,
+    pool_uuid: PoolUuid,
+    uuid: DevUuid,
+) -> Option<GetManagedObjects> {
+    engine.get_pool(pool_uuid).and_then(|(_, p)| {
+        p.get_blockdev(uuid).map(|(bd_tier, bd)| {
+            properties_to_get_managed_objects(
+                path.clone(),
+                get_blockdev_properties(parent_path.clone(), uuid, bd_tier, bd),
+            )
         })
-    }
+    })
+}
 
-    fn parent_pool_uuid(op: Option<&ObjectPath<MTSync<TData>, TData>>) -> Option<PoolUuid> {
-        op.and_then(|o| {
-            o.get_data().as_ref().and_then(|data| match data.uuid {
-                StratisUuid::Pool(p) => Some(p),
-                _ => None,
-            })
+fn parent_pool_uuid(op: Option<&ObjectPath<MTSync<TData>, TData>>) -> Option<PoolUuid> {
+    op.and_then(|o| {
+        o.get_data().as_ref().and_then(|data| match data.uuid {
+            StratisUuid::Pool(p) => Some(p),
+            _ => None,
         })
-    }
+    })
+}
 
+/// The interfaces and properties of the object at op, as GetManagedObjects
+/// reports them, or None if op is not a pool, filesystem, or blockdev.
+pub fn object_properties(
+    tree: &Tree<MTSync<TData>, TData>,
+    engine: &dyn Engine,
+    op: &ObjectPath<MTSync<TData>, TData>,
+) -> Option<GetManagedObjects> {
+    op.get_data().as_ref().and_then(|data| match data.uuid {
+        StratisUuid::Pool(uuid) => pool_properties(op.get_name(), engine, uuid),
+        StratisUuid::Fs(uuid) => fs_properties(
+            &data.parent,
+            op.get_name(),
+            engine,
+            parent_pool_uuid(tree.get(&data.parent).map(|p| &**p))
+                .expect("Parent must be present and be pool"),
+            uuid,
+        ),
+        StratisUuid::Dev(uuid) => blockdev_properties(
+            &data.parent,
+            op.get_name(),
+            engine,
+            parent_pool_uuid(tree.get(&data.parent).map(|p| &**p))
+                .expect("Parent must be present and be pool"),
+            uuid,
+        ),
+    })
+}
+
+pub fn get_managed_objects_method(
+    f: &Factory<MTSync<TData>, TData>,
+) -> Method<MTSync<TData>, TData> {
     #[allow(clippy::unnecessary_wraps)]
     fn get_managed_objects(m: &MethodInfo<MTSync<TData>, TData>) -> MethodResult {
         let dbus_context = m.tree.get_data();
-        let engine = dbus_context.engine.blocking_lock();
+        let engine = dbus_context.engine.blocking_read();
 
         let properties: GetManagedObjects = m
             .tree
             .iter()
-            .filter_map(|op| {
-                op.get_data().as_ref().and_then(|data| match data.uuid {
-                    StratisUuid::Pool(uuid) => pool_properties(op.get_name(), &*engine, uuid),
-                    StratisUuid::Fs(uuid) => fs_properties(
-                        &data.parent,
-                        op.get_name(),
-                        &*engine,
-                        parent_pool_uuid(m.tree.get(&data.parent).map(|p| &**p))
-                            .expect("Parent must be present and be pool"),
-                        uuid,
-                    ),
-                    StratisUuid::Dev(uuid) => blockdev_properties(
-                        &data.parent,
-                        op.get_name(),
-                        &*engine,
-                        parent_pool_uuid(m.tree.get(&data.parent).map(|p| &**p))
-                            .expect("Parent must be present and be pool"),
-                        uuid,
-                    ),
-                })
-            })
+            .filter_map(|op| object_properties(m.tree, &*engine, op))
             .fold(HashMap::new(), |mut props, prop| {
                 props.extend(prop.into_iter());
                 props
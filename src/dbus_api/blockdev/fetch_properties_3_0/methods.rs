@@ -8,14 +8,35 @@ use dbus::{
     arg::{RefArg, Variant},
     Message,
 };
-use dbus_tree::{MTSync, MethodInfo, MethodResult};
+use dbus_tree::{MTSync, MethodInfo, MethodResult, Tree};
 use itertools::Itertools;
 
 use crate::dbus_api::{
     blockdev::shared::blockdev_operation, consts, types::TData, util::result_to_tuple,
 };
 
-const ALL_PROPERTIES: [&str; 1] = [consts::BLOCKDEV_TOTAL_SIZE_PROP];
+pub const ALL_PROPERTIES: [&str; 1] = [consts::BLOCKDEV_TOTAL_SIZE_PROP];
+
+/// Fetch the given properties of the blockdev with object path object_path.
+/// Properties that the blockdev does not have are omitted.
+pub fn fetch_properties(
+    tree: &Tree<MTSync<TData>, TData>,
+    object_path: &dbus::Path<'static>,
+    properties: &mut dyn Iterator<Item = String>,
+) -> HashMap<String, (bool, Variant<Box<dyn RefArg>>)> {
+    properties
+        .unique()
+        .filter_map(|prop| match prop.as_str() {
+            consts::BLOCKDEV_TOTAL_SIZE_PROP => Some((
+                prop,
+                result_to_tuple(blockdev_operation(tree, object_path, |_, bd| {
+                    Ok((*bd.size().bytes()).to_string())
+                })),
+            )),
+            _ => None,
+        })
+        .collect()
+}
 
 #[allow(clippy::unnecessary_wraps)]
 fn get_properties_shared(
@@ -23,24 +44,10 @@ fn get_properties_shared(
     properties: &mut dyn Iterator<Item = String>,
 ) -> MethodResult {
     let message: &Message = m.msg;
-    let object_path = &m.path;
 
     let return_message = message.method_return();
 
-    let return_value: HashMap<String, (bool, Variant<Box<dyn RefArg>>)> = properties
-        .unique()
-        .filter_map(|prop| match prop.as_str() {
-            consts::BLOCKDEV_TOTAL_SIZE_PROP => Some((
-                prop,
-                result_to_tuple(blockdev_operation(
-                    m.tree,
-                    object_path.get_name(),
-                    |_, bd| Ok((*bd.size().bytes()).to_string()),
-                )),
-            )),
-            _ => None,
-        })
-        .collect();
+    let return_value = fetch_properties(m.tree, m.path.get_name(), properties);
 
     Ok(vec![return_message.append1(return_value)])
 }
@@ -18,6 +18,10 @@ mod blockdev_3_0;
 mod fetch_properties_3_0;
 mod shared;
 
+pub use fetch_properties_3_0::{
+    fetch_properties as fetch_blockdev_properties, ALL_PROPERTIES as ALL_BLOCKDEV_PROPERTIES,
+};
+
 pub fn create_dbus_blockdev<'a>(
     dbus_context: &DbusContext,
     parent: dbus::Path<'static>,
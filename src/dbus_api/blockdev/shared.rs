@@ -46,8 +46,8 @@ where
         Pool
     );
 
-    let mutex_lock = dbus_context.engine.blocking_lock();
-    let (_, pool) = mutex_lock
+    let read_lock = dbus_context.engine.blocking_read();
+    let (_, pool) = read_lock
         .get_pool(pool_uuid)
         .ok_or_else(|| format!("no pool corresponding to uuid {}", &pool_uuid))?;
     let (tier, blockdev) = pool
@@ -2,7 +2,12 @@
 // License, v. 2.0. If a copy of the MPL was not distributed with this
 // file, You can obtain one at http://mozilla.org/MPL/2.0/.
 
-use std::{collections::HashMap, sync::Arc, time::Duration};
+use std::{
+    collections::{HashMap, HashSet},
+    mem, slice,
+    sync::Arc,
+    time::{Duration, Instant},
+};
 
 use dbus::{
     arg::{RefArg, Variant},
@@ -13,15 +18,15 @@ use dbus::{
         },
         SyncConnection,
     },
-    channel::{default_reply, MatchingReceiver, Sender},
+    channel::{MatchingReceiver, Sender},
     message::{MatchRule, SignalArgs},
     Path,
 };
-use dbus_tree::{MTSync, Tree};
+use dbus_tree::{Factory, MTSync, Tree};
 use futures::{
     executor::block_on,
     future::{select, Either},
-    pin_mut,
+    pin_mut, FutureExt,
 };
 use tokio::{
     sync::{
@@ -29,12 +34,13 @@ use tokio::{
         mpsc::UnboundedReceiver,
         RwLockWriteGuard,
     },
-    task::spawn_blocking,
+    time::timeout,
 };
 
 use crate::{
     dbus_api::{
         consts,
+        dispatch::{DispatchPool, DispatchStats},
         types::{DbusAction, InterfacesAddedThreadSafe, InterfacesRemoved, LockableTree, TData},
         util::thread_safe_to_dbus_sendable,
     },
@@ -42,6 +48,117 @@ use crate::{
     stratis::{StratisError, StratisResult},
 };
 
+/// The longest time for which a property change is held so that it can be
+/// merged with later changes.
+const BATCH_WINDOW: Duration = Duration::from_millis(10);
+/// The maximum number of actions handled in a single batch.
+const MAX_BATCH_SIZE: usize = 512;
+
+/// The changes to the properties of a single interface of a D-Bus object.
+#[derive(Default)]
+struct InterfaceChanges {
+    changed: HashMap<String, Variant<Box<dyn RefArg>>>,
+    invalidated: HashSet<String>,
+}
+
+/// Property changes on D-Bus objects, merged so that a single
+/// PropertiesChanged signal is sent for each interface of each object.
+/// A property which is changed more than once is sent with its most
+/// recent value.
+#[derive(Default)]
+struct PropertyChanges {
+    objects: HashMap<Path<'static>, HashMap<String, InterfaceChanges>>,
+}
+
+impl PropertyChanges {
+    fn interface_changes<'a>(
+        &'a mut self,
+        object: &Path<'static>,
+        interface: &str,
+    ) -> &'a mut InterfaceChanges {
+        self.objects
+            .entry(object.clone())
+            .or_insert_with(HashMap::new)
+            .entry(interface.to_string())
+            .or_insert_with(InterfaceChanges::default)
+    }
+
+    /// Record that the value of property on interfaces of object is value.
+    fn change(
+        &mut self,
+        object: &Path<'static>,
+        interfaces: &[String],
+        property: &str,
+        value: &dyn RefArg,
+    ) {
+        for interface in interfaces {
+            let changes = self.interface_changes(object, interface);
+            changes.invalidated.remove(property);
+            changes
+                .changed
+                .insert(property.to_string(), Variant(value.box_clone()));
+        }
+    }
+
+    /// Record that the value of property on interfaces of object is no
+    /// longer valid.
+    fn invalidate(&mut self, object: &Path<'static>, interfaces: &[String], property: &str) {
+        for interface in interfaces {
+            let changes = self.interface_changes(object, interface);
+            changes.changed.remove(property);
+            changes.invalidated.insert(property.to_string());
+        }
+    }
+
+    fn is_empty(&self) -> bool {
+        self.objects.is_empty()
+    }
+
+    /// Discard the changes to object, which has been removed.
+    fn forget(&mut self, object: &Path<'static>) {
+        self.objects.remove(object);
+    }
+
+    /// The object, interface, changed properties and invalidated properties
+    /// of each signal to be sent.
+    fn into_signals(
+        self,
+    ) -> Vec<(
+        Path<'static>,
+        String,
+        HashMap<String, Variant<Box<dyn RefArg>>>,
+        Vec<String>,
+    )> {
+        self.objects
+            .into_iter()
+            .flat_map(|(object, interfaces)| {
+                interfaces.into_iter().map(move |(interface, changes)| {
+                    (
+                        object.clone(),
+                        interface,
+                        changes.changed,
+                        changes.invalidated.into_iter().collect(),
+                    )
+                })
+            })
+            .collect()
+    }
+}
+
+/// Get the tree for modification. If a method call is still being served
+/// from the current tree, the tree is copied and the copy replaces it; the
+/// method call keeps the tree with which it started.
+fn tree_mut(tree: &mut Arc<Tree<MTSync<TData>, TData>>) -> &mut Tree<MTSync<TData>, TData> {
+    if Arc::get_mut(tree).is_none() {
+        let mut copy = Factory::new_sync().tree(tree.get_data().clone());
+        for opath in tree.iter() {
+            copy.insert(Arc::clone(opath));
+        }
+        *tree = Arc::new(copy);
+    }
+    Arc::get_mut(tree).expect("the tree was just replaced by a copy with no other references")
+}
+
 /// Handler for a D-Bus tree.
 /// Proceses messages specifying tree mutations.
 pub struct DbusTreeHandler {
@@ -66,168 +183,188 @@ impl DbusTreeHandler {
         }
     }
 
-    /// Process a D-Bus action (add/remove) request.
+    /// Process D-Bus action (add/remove) requests.
+    ///
+    /// Every action that is already waiting when an action is received is
+    /// handled with it, under a single acquisition of the tree write lock.
+    /// Objects are added and removed at once, but property changes are
+    /// held for up to BATCH_WINDOW after the first of them, and merged into
+    /// one signal per object and interface.
     pub fn process_dbus_actions(&mut self) -> StratisResult<()> {
+        let mut changes = PropertyChanges::default();
+        let mut send_at: Option<Instant> = None;
         loop {
-            let (action, write_lock) = {
-                let recv_fut = self.receiver.recv();
+            let received = {
+                let receiver = &mut self.receiver;
+                let wait = send_at.map(|at| at.saturating_duration_since(Instant::now()));
+                let recv_fut = async move {
+                    match wait {
+                        Some(wait) => timeout(wait, receiver.recv()).await.ok(),
+                        None => Some(receiver.recv().await),
+                    }
+                };
                 let should_exit_fut = self.should_exit.recv();
 
                 pin_mut!(recv_fut);
                 pin_mut!(should_exit_fut);
 
-                let (action, should_exit_fut) = match block_on(select(recv_fut, should_exit_fut)) {
-                    Either::Left((a, se)) => {
-                        (
-                            a.ok_or_else(|| {
-                                StratisError::Msg(
-                                    "The channel from the D-Bus request handler to the D-Bus object handler was closed".to_string()
-                                )
-                            })?,
-                            se
+                match block_on(select(recv_fut, should_exit_fut)) {
+                    Either::Left((Some(a), _)) => Some(a.ok_or_else(|| {
+                        StratisError::Msg(
+                            "The channel from the D-Bus request handler to the D-Bus object handler was closed".to_string()
                         )
-                    },
+                    })?),
+                    Either::Left((None, _)) => None,
                     Either::Right((Ok(()), _)) => {
                         info!("D-Bus tree handler was notified to exit");
                         break;
-                    },
+                    }
                     Either::Right((Err(_), _)) => {
                         return Err(StratisError::Msg(
                             "D-Bus tree handler can no longer be notified to exit; shutting down...".to_string()
                         ));
-                    },
-                };
+                    }
+                }
+            };
 
-                let write_fut = self.tree.write();
+            if let Some(action) = received {
+                let mut actions = vec![action];
+                // If the channel has been closed, that is discovered when
+                // the next action is received.
+                while actions.len() < MAX_BATCH_SIZE {
+                    match self.receiver.recv().now_or_never() {
+                        Some(Some(action)) => actions.push(action),
+                        _ => break,
+                    }
+                }
 
-                pin_mut!(write_fut);
+                let write_lock = {
+                    let write_fut = self.tree.write();
+                    let should_exit_fut = self.should_exit.recv();
 
-                let write_lock = match block_on(select(write_fut, should_exit_fut)) {
-                    Either::Left((wl, _)) => wl,
-                    Either::Right((Ok(()), _)) => {
-                        info!("D-Bus tree handler was notified to exit");
-                        break;
-                    }
-                    Either::Right((Err(_), _)) => {
-                        return Err(StratisError::Msg(
-                            "D-Bus tree handler can no longer be notified to exit; shutting down...".to_string()
-                        ));
+                    pin_mut!(write_fut);
+                    pin_mut!(should_exit_fut);
+
+                    match block_on(select(write_fut, should_exit_fut)) {
+                        Either::Left((wl, _)) => wl,
+                        Either::Right((Ok(()), _)) => {
+                            info!("D-Bus tree handler was notified to exit");
+                            break;
+                        }
+                        Either::Right((Err(_), _)) => {
+                            return Err(StratisError::Msg(
+                                "D-Bus tree handler can no longer be notified to exit; shutting down...".to_string()
+                            ));
+                        }
                     }
                 };
 
-                (action, write_lock)
-            };
+                self.handle_dbus_actions(actions, write_lock, &mut changes);
+                if send_at.is_none() && !changes.is_empty() {
+                    send_at = Some(Instant::now() + BATCH_WINDOW);
+                }
+            }
 
-            self.handle_dbus_action(action, write_lock);
+            if send_at.map_or(false, |at| at <= Instant::now()) {
+                self.send_property_changes(mem::take(&mut changes));
+                send_at = None;
+            }
         }
+        self.send_property_changes(changes);
         Ok(())
     }
 
-    /// Handle a D-Bus action that has been generated by the connection processing
-    /// handle.
-    fn handle_dbus_action(
+    /// Handle a batch of D-Bus actions that have been generated by the
+    /// connection processing handle. Objects are added and removed in the
+    /// order of the actions, and their signals sent immediately. Property
+    /// changes are merged into changes, from which any changes to objects
+    /// that have been removed are dropped.
+    fn handle_dbus_actions(
         &self,
-        action: DbusAction,
-        mut write_lock: ExclusiveGuard<RwLockWriteGuard<Tree<MTSync<TData>, TData>>>,
+        actions: Vec<DbusAction>,
+        mut write_lock: ExclusiveGuard<RwLockWriteGuard<Arc<Tree<MTSync<TData>, TData>>>>,
+        changes: &mut PropertyChanges,
     ) {
-        match action {
-            DbusAction::Add(path, interfaces) => {
-                let path_name = path.get_name().clone();
-                write_lock.insert(path);
-                if self.added_object_signal(path_name, interfaces).is_err() {
-                    warn!("Signal on object add was not sent to the D-Bus client");
+        for action in actions {
+            match action {
+                DbusAction::Add(path, interfaces) => {
+                    let path_name = path.get_name().clone();
+                    tree_mut(&mut write_lock).insert(path);
+                    if self.added_object_signal(path_name, interfaces).is_err() {
+                        warn!("Signal on object add was not sent to the D-Bus client");
+                    }
                 }
-            }
-            DbusAction::Remove(path, interfaces) => {
-                let paths = write_lock
-                    .iter()
-                    .filter_map(|opath| {
-                        opath.get_data().as_ref().and_then(|op_cxt| {
-                            if op_cxt.parent == path {
-                                Some((
-                                    opath.get_name().clone(),
-                                    match op_cxt.uuid {
-                                        StratisUuid::Pool(_) => consts::pool_interface_list(),
-                                        StratisUuid::Fs(_) => consts::filesystem_interface_list(),
-                                        StratisUuid::Dev(_) => consts::blockdev_interface_list(),
-                                    },
-                                ))
-                            } else {
-                                None
-                            }
+                DbusAction::Remove(path, interfaces) => {
+                    let tree = tree_mut(&mut write_lock);
+                    let paths = tree
+                        .iter()
+                        .filter_map(|opath| {
+                            opath.get_data().as_ref().and_then(|op_cxt| {
+                                if op_cxt.parent == path {
+                                    Some((
+                                        opath.get_name().clone(),
+                                        match op_cxt.uuid {
+                                            StratisUuid::Pool(_) => consts::pool_interface_list(),
+                                            StratisUuid::Fs(_) => {
+                                                consts::filesystem_interface_list()
+                                            }
+                                            StratisUuid::Dev(_) => {
+                                                consts::blockdev_interface_list()
+                                            }
+                                        },
+                                    ))
+                                } else {
+                                    None
+                                }
+                            })
                         })
-                    })
-                    .collect::<Vec<_>>();
-                for (path, interfaces) in paths {
-                    write_lock.remove(&path);
-                    if self.removed_object_signal(path, interfaces).is_err() {
+                        .collect::<Vec<_>>();
+                    for (path, interfaces) in paths {
+                        tree.remove(&path);
+                        changes.forget(&path);
+                        if self.removed_object_signal(path, interfaces).is_err() {
+                            warn!("Signal on object removal was not sent to the D-Bus client");
+                        };
+                    }
+                    tree.remove(&path);
+                    changes.forget(&path);
+                    if self
+                        .removed_object_signal(path.clone(), interfaces)
+                        .is_err()
+                    {
                         warn!("Signal on object removal was not sent to the D-Bus client");
                     };
                 }
-                write_lock.remove(&path);
-                if self
-                    .removed_object_signal(path.clone(), interfaces)
-                    .is_err()
-                {
-                    warn!("Signal on object removal was not sent to the D-Bus client");
-                };
-            }
-            DbusAction::FsNameChange(item, new_name) => {
-                let mut changed = HashMap::new();
-                changed.insert(
-                    consts::FILESYSTEM_NAME_PROP.into(),
-                    Variant(new_name.box_clone()),
-                );
-                if self
-                    .property_changed_invalidated_signal(
-                        &item,
-                        changed,
-                        vec![consts::FILESYSTEM_DEVNODE_PROP.into()],
-                        &consts::standard_filesystem_interfaces(),
-                    )
-                    .is_err()
-                {
-                    warn!("Signal on filesystem name change was not sent to the D-Bus client");
+                DbusAction::FsNameChange(item, new_name) => {
+                    let interfaces = consts::standard_filesystem_interfaces();
+                    changes.change(&item, &interfaces, consts::FILESYSTEM_NAME_PROP, &new_name);
+                    changes.invalidate(&item, &interfaces, consts::FILESYSTEM_DEVNODE_PROP);
                 }
-            }
-            DbusAction::PoolNameChange(item, new_name) => {
-                let mut changed = HashMap::new();
-                changed.insert(consts::POOL_NAME_PROP.into(), Variant(new_name.box_clone()));
-
-                if self
-                    .property_changed_invalidated_signal(
+                DbusAction::PoolNameChange(item, new_name) => {
+                    changes.change(
                         &item,
-                        changed,
-                        vec![],
                         &consts::standard_pool_interfaces(),
-                    )
-                    .is_err()
-                {
-                    warn!("Signal on pool name change was not sent to the D-Bus client");
-                }
+                        consts::POOL_NAME_PROP,
+                        &new_name,
+                    );
 
-                for opath in write_lock.iter().filter(|opath| {
-                    opath
-                        .get_data()
-                        .as_ref()
-                        .map_or(false, |op_cxt| op_cxt.parent == item)
-                }) {
-                    if let StratisUuid::Fs(_) = opath
-                        .get_data()
-                        .as_ref()
-                        .expect("all objects with parents have data")
-                        .uuid
-                    {
-                        if self
-                            .property_changed_invalidated_signal(
-                                &opath.get_name().clone(),
-                                HashMap::new(),
-                                vec![consts::FILESYSTEM_DEVNODE_PROP.into()],
-                                &consts::standard_filesystem_interfaces(),
-                            )
-                            .is_err()
+                    for opath in write_lock.iter().filter(|opath| {
+                        opath
+                            .get_data()
+                            .as_ref()
+                            .map_or(false, |op_cxt| op_cxt.parent == item)
+                    }) {
+                        if let StratisUuid::Fs(_) = opath
+                            .get_data()
+                            .as_ref()
+                            .expect("all objects with parents have data")
+                            .uuid
                         {
-                            warn!("Signal on filesystem devnode change was not sent to the D-Bus client");
+                            changes.invalidate(
+                                opath.get_name(),
+                                &consts::standard_filesystem_interfaces(),
+                                consts::FILESYSTEM_DEVNODE_PROP,
+                            );
                         }
                     }
                 }
@@ -235,6 +372,27 @@ impl DbusTreeHandler {
         }
     }
 
+    /// Send a PropertiesChanged signal for each object and interface in
+    /// changes.
+    fn send_property_changes(&self, changes: PropertyChanges) {
+        for (object, interface, changed, invalidated) in changes.into_signals() {
+            if self
+                .property_changed_invalidated_signal(
+                    &object,
+                    changed,
+                    invalidated,
+                    slice::from_ref(&interface),
+                )
+                .is_err()
+            {
+                warn!(
+                    "Signal on change of properties of D-Bus object with path {} was not sent to the D-Bus client",
+                    object
+                );
+            }
+        }
+    }
+
     /// Send an InterfacesAdded signal on the D-Bus
     fn added_object_signal(
         &self,
@@ -298,12 +456,13 @@ impl DbusTreeHandler {
 }
 
 /// Handler for a D-Bus receiving connection.
-/// stratisd has exactly one connection handler, but this handler spawns
-/// a thread for every D-Bus method.
+/// stratisd has exactly one connection handler, which passes every D-Bus
+/// method call to a fixed pool of worker threads.
 pub struct DbusConnectionHandler {
     connection: Arc<SyncConnection>,
     tree: LockableTree,
     should_exit: Receiver<()>,
+    dispatch_stats: Arc<DispatchStats>,
 }
 
 impl DbusConnectionHandler {
@@ -311,42 +470,30 @@ impl DbusConnectionHandler {
         connection: Arc<SyncConnection>,
         tree: LockableTree,
         should_exit: Receiver<()>,
+        dispatch_stats: Arc<DispatchStats>,
     ) -> DbusConnectionHandler {
         DbusConnectionHandler {
             connection,
             tree,
             should_exit,
+            dispatch_stats,
         }
     }
 
     /// Handle a D-Bus action passed from a D-Bus connection.
-    /// Spawn a new thread for every D-Bus method call.
-    /// Every method call requires a read lock on the D-Bus tree.
+    /// Queue every D-Bus method call to be served by the worker threads.
+    /// Every method call is served from the D-Bus tree as it was when the
+    /// call was taken from the queue.
     pub fn process_dbus_requests(&mut self) -> StratisResult<()> {
-        let tree = self.tree.clone();
-        let connection = Arc::clone(&self.connection);
+        let pool = DispatchPool::new(
+            self.tree.clone(),
+            Arc::clone(&self.connection),
+            Arc::clone(&self.dispatch_stats),
+        )?;
         let _ = self.connection.start_receive(
             MatchRule::new_method_call(),
-            Box::new(move |msg, _| {
-                let cloned_tree = tree.clone();
-                let cloned_connection = Arc::clone(&connection);
-                spawn_blocking(move || {
-                    let lock = cloned_tree.blocking_read();
-                    if let Some(msgs) = lock.handle(&msg) {
-                        for msg in msgs {
-                            if cloned_connection.send(msg).is_err() {
-                                warn!("Failed to send reply to D-Bus client");
-                            }
-                        }
-                    } else {
-                        let reply = default_reply(&msg);
-                        if let Some(r) = reply {
-                            if cloned_connection.send(r).is_err() {
-                                warn!("Failed to send reply to D-Bus client");
-                            }
-                        }
-                    }
-                });
+            Box::new(move |msg, connection| {
+                pool.dispatch(msg, connection);
                 true
             }),
         );
@@ -372,3 +519,47 @@ impl DbusConnectionHandler {
         Ok(())
     }
 }
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    /// Verify that repeated changes to the properties of an object are
+    /// merged, and that changes to removed objects are discarded.
+    fn test_property_changes() {
+        let fs = Path::from("/org/storage/stratis3/1");
+        let removed = Path::from("/org/storage/stratis3/2");
+        let interfaces = consts::standard_filesystem_interfaces();
+
+        let mut changes = PropertyChanges::default();
+        changes.change(
+            &fs,
+            &interfaces,
+            consts::FILESYSTEM_NAME_PROP,
+            &"a".to_string(),
+        );
+        changes.invalidate(&fs, &interfaces, consts::FILESYSTEM_DEVNODE_PROP);
+        changes.change(
+            &fs,
+            &interfaces,
+            consts::FILESYSTEM_NAME_PROP,
+            &"b".to_string(),
+        );
+        changes.invalidate(&fs, &interfaces, consts::FILESYSTEM_DEVNODE_PROP);
+        changes.invalidate(&removed, &interfaces, consts::FILESYSTEM_DEVNODE_PROP);
+        changes.forget(&removed);
+
+        let signals = changes.into_signals();
+        assert_eq!(signals.len(), interfaces.len());
+        for (object, _, changed, invalidated) in signals {
+            assert_eq!(object, fs);
+            assert_eq!(changed.len(), 1);
+            assert_eq!(changed[consts::FILESYSTEM_NAME_PROP].0.as_str(), Some("b"));
+            assert_eq!(
+                invalidated,
+                vec![consts::FILESYSTEM_DEVNODE_PROP.to_string()]
+            );
+        }
+    }
+}
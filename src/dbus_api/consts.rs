@@ -8,9 +8,16 @@ pub const STRATIS_BASE_PATH: &str = "/org/storage/stratis3";
 pub const STRATIS_BASE_SERVICE: &str = "org.storage.stratis3";
 
 pub const MANAGER_INTERFACE_NAME_3_0: &str = "org.storage.stratis3.Manager.r0";
+pub const MANAGER_INTERFACE_NAME_3_1: &str = "org.storage.stratis3.Manager.r1";
 pub const REPORT_INTERFACE_NAME_3_0: &str = "org.storage.stratis3.Report.r0";
+pub const METRICS_INTERFACE_NAME_3_0: &str = "org.storage.stratis3.Metrics.r0";
 
 pub const PROPERTY_FETCH_INTERFACE_NAME_3_0: &str = "org.storage.stratis3.FetchProperties.r0";
+pub const PROPERTY_FETCH_INTERFACE_NAME_3_1: &str = "org.storage.stratis3.FetchProperties.r1";
+
+/// The name of the report on D-Bus method dispatch, which is kept by the
+/// D-Bus layer rather than by the engine.
+pub const DBUS_DISPATCH_REPORT: &str = "dbus_dispatch_report";
 
 pub const KEY_LIST_PROP: &str = "KeyList";
 
@@ -19,6 +26,7 @@ pub const LOCKED_POOLS: &str = "LockedPools";
 pub const LOCKED_POOL_DEVS: &str = "LockedPoolsWithDevs";
 
 pub const POOL_INTERFACE_NAME_3_0: &str = "org.storage.stratis3.pool.r0";
+pub const POOL_INTERFACE_NAME_3_1: &str = "org.storage.stratis3.pool.r1";
 pub const POOL_NAME_PROP: &str = "Name";
 pub const POOL_UUID_PROP: &str = "Uuid";
 pub const POOL_HAS_CACHE_PROP: &str = "HasCache";
@@ -26,12 +34,20 @@ pub const POOL_ENCRYPTED_PROP: &str = "Encrypted";
 pub const POOL_ENCRYPTION_KEY_DESC: &str = "KeyDescription";
 pub const POOL_TOTAL_SIZE_PROP: &str = "TotalPhysicalSize";
 pub const POOL_TOTAL_USED_PROP: &str = "TotalPhysicalUsed";
+pub const POOL_TOTAL_USED_AGE_PROP: &str = "TotalPhysicalUsedAge";
 pub const POOL_CLEVIS_INFO: &str = "ClevisInfo";
+pub const POOL_CACHE_BLOCK_SIZE_PROP: &str = "CacheBlockSize";
+pub const POOL_CACHE_MIGRATION_THRESHOLD_PROP: &str = "CacheMigrationThreshold";
+pub const POOL_CACHE_STATS_PROP: &str = "CacheStats";
+pub const POOL_ALLOC_POLICY_PROP: &str = "AllocationPolicy";
 
 pub const FILESYSTEM_INTERFACE_NAME_3_0: &str = "org.storage.stratis3.filesystem.r0";
+pub const FILESYSTEM_INTERFACE_NAME_3_1: &str = "org.storage.stratis3.filesystem.r1";
 pub const FILESYSTEM_NAME_PROP: &str = "Name";
 pub const FILESYSTEM_UUID_PROP: &str = "Uuid";
 pub const FILESYSTEM_USED_PROP: &str = "Used";
+pub const FILESYSTEM_USED_AGE_PROP: &str = "UsedAge";
+pub const FILESYSTEM_GROWTH_POLICY_PROP: &str = "GrowthPolicy";
 pub const FILESYSTEM_DEVNODE_PROP: &str = "Devnode";
 pub const FILESYSTEM_POOL_PROP: &str = "Pool";
 pub const FILESYSTEM_CREATED_PROP: &str = "Created";
@@ -59,7 +75,7 @@ pub fn fetch_properties_interfaces() -> Vec<String> {
 /// Get a list of all the standard pool interfaces; i.e., all the revisions of
 /// org.storage.stratis2.pool.
 pub fn standard_pool_interfaces() -> Vec<String> {
-    [POOL_INTERFACE_NAME_3_0]
+    [POOL_INTERFACE_NAME_3_0, POOL_INTERFACE_NAME_3_1]
         .iter()
         .map(|s| (*s).to_string())
         .collect()
@@ -68,7 +84,7 @@ pub fn standard_pool_interfaces() -> Vec<String> {
 /// Get a list of all the standard filesystem interfaces; i.e., all the
 /// revisions of org.storage.stratis2.filesystem.
 pub fn standard_filesystem_interfaces() -> Vec<String> {
-    [FILESYSTEM_INTERFACE_NAME_3_0]
+    [FILESYSTEM_INTERFACE_NAME_3_0, FILESYSTEM_INTERFACE_NAME_3_1]
         .iter()
         .map(|s| (*s).to_string())
         .collect()
@@ -87,6 +103,7 @@ pub fn standard_blockdev_interfaces() -> Vec<String> {
 pub fn pool_interface_list() -> InterfacesRemoved {
     let mut interfaces = standard_pool_interfaces();
     interfaces.extend(fetch_properties_interfaces());
+    interfaces.push(PROPERTY_FETCH_INTERFACE_NAME_3_1.to_string());
     interfaces
 }
 
@@ -94,6 +111,7 @@ pub fn pool_interface_list() -> InterfacesRemoved {
 pub fn filesystem_interface_list() -> InterfacesRemoved {
     let mut interfaces = standard_filesystem_interfaces();
     interfaces.extend(fetch_properties_interfaces());
+    interfaces.push(PROPERTY_FETCH_INTERFACE_NAME_3_1.to_string());
     interfaces
 }
 
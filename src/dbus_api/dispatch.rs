@@ -0,0 +1,443 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+//! Dispatch of D-Bus method calls to a fixed set of worker threads.
+//!
+//! Method calls are divided between two lanes, each with its own bounded
+//! queue and its own workers. Calls that only read state, e.g., property
+//! fetches and GetManagedObjects, are served by the read lane, so that they
+//! are not stuck behind calls that modify pools, which may wait for the
+//! engine lock for a long time. If a lane's queue is full, the call is
+//! rejected with an error reply rather than queued without limit.
+
+use std::{
+    collections::HashMap,
+    fmt::{self, Write},
+    sync::{
+        atomic::{AtomicU64, AtomicUsize, Ordering},
+        mpsc::{sync_channel, Receiver, SyncSender, TrySendError},
+        Arc, Mutex,
+    },
+    thread,
+    time::{Duration, Instant},
+};
+
+use dbus::{
+    blocking::SyncConnection,
+    channel::{default_reply, Sender},
+    Message,
+};
+use dbus_tree::MethodErr;
+use serde_json::{Map, Value};
+
+use crate::{
+    dbus_api::{consts, types::LockableTree},
+    engine::{prometheus_labels, write_prometheus_header, LatencyHistogram},
+    stratis::StratisResult,
+};
+
+/// The number of workers serving read-only method calls.
+pub const READ_WORKERS: usize = 4;
+/// The number of workers serving all other method calls. Most of these
+/// calls require exclusive access to the engine, so additional workers
+/// would only wait.
+pub const MUTATE_WORKERS: usize = 2;
+/// The number of method calls that may wait in the queue of a single lane.
+pub const QUEUE_CAPACITY: usize = 128;
+
+// Latencies are recorded separately for no more than this many distinct
+// methods; further methods, which can only be the result of calls to
+// methods that do not exist, are recorded together.
+const MAX_TRACKED_METHODS: usize = 256;
+const UNTRACKED_METHOD: &str = "<other>";
+
+/// The lane by which a method call is served.
+#[derive(Clone, Copy, Debug, Eq, PartialEq)]
+pub enum Lane {
+    Read,
+    Mutate,
+}
+
+impl Lane {
+    fn name(self) -> &'static str {
+        match self {
+            Lane::Read => "read",
+            Lane::Mutate => "mutate",
+        }
+    }
+
+    fn index(self) -> usize {
+        match self {
+            Lane::Read => 0,
+            Lane::Mutate => 1,
+        }
+    }
+}
+
+/// Determine the lane of the method call identified by interface and
+/// member. Any method that is not known to be read-only is served by the
+/// mutate lane.
+pub fn classify(interface: Option<&str>, member: Option<&str>) -> Lane {
+    match (interface, member) {
+        (Some("org.freedesktop.DBus.Properties"), Some("Get"))
+        | (Some("org.freedesktop.DBus.Properties"), Some("GetAll"))
+        | (Some("org.freedesktop.DBus.ObjectManager"), Some("GetManagedObjects"))
+        | (Some("org.freedesktop.DBus.Introspectable"), _)
+        | (Some("org.freedesktop.DBus.Peer"), _)
+        | (Some(consts::MANAGER_INTERFACE_NAME_3_1), Some("FetchObjectProperties"))
+        | (Some(consts::MANAGER_INTERFACE_NAME_3_1), Some("GetManagedObjectsPage")) => Lane::Read,
+        (Some(interface), _)
+            if consts::fetch_properties_interfaces()
+                .iter()
+                .any(|i| i == interface)
+                || interface == consts::PROPERTY_FETCH_INTERFACE_NAME_3_1
+                || interface == consts::REPORT_INTERFACE_NAME_3_0
+                || interface == consts::METRICS_INTERFACE_NAME_3_0 =>
+        {
+            Lane::Read
+        }
+        _ => Lane::Mutate,
+    }
+}
+
+/// Counters for a single lane.
+#[derive(Debug, Default)]
+struct LaneStats {
+    depth: AtomicUsize,
+    max_depth: AtomicUsize,
+    dispatched: AtomicU64,
+    rejected: AtomicU64,
+}
+
+/// Queue depths and per-method latencies of the method calls dispatched to
+/// the worker threads. The latency of a call is measured from its receipt
+/// to the sending of its reply, and so includes the time spent in the queue.
+#[derive(Debug, Default)]
+pub struct DispatchStats {
+    lanes: [LaneStats; 2],
+    methods: Mutex<HashMap<String, LatencyHistogram>>,
+}
+
+impl DispatchStats {
+    fn enqueued(&self, lane: Lane) {
+        let stats = &self.lanes[lane.index()];
+        let depth = stats.depth.fetch_add(1, Ordering::SeqCst) + 1;
+        stats.max_depth.fetch_max(depth, Ordering::SeqCst);
+        stats.dispatched.fetch_add(1, Ordering::SeqCst);
+    }
+
+    fn dequeued(&self, lane: Lane) {
+        self.lanes[lane.index()]
+            .depth
+            .fetch_sub(1, Ordering::SeqCst);
+    }
+
+    fn rejected(&self, lane: Lane) {
+        self.lanes[lane.index()]
+            .rejected
+            .fetch_add(1, Ordering::SeqCst);
+    }
+
+    fn record_latency(&self, method: String, latency: Duration) {
+        let mut methods = self
+            .methods
+            .lock()
+            .expect("no thread panics while holding the lock");
+        let key = if methods.len() < MAX_TRACKED_METHODS || methods.contains_key(&method) {
+            method
+        } else {
+            UNTRACKED_METHOD.to_string()
+        };
+        methods.entry(key).or_default().record(latency);
+    }
+
+    /// Write the statistics in the Prometheus text exposition format.
+    pub fn write_prometheus(&self, out: &mut String) -> fmt::Result {
+        let lanes = [Lane::Read, Lane::Mutate];
+        let mut write_lanes = |name: &str,
+                               help: &str,
+                               metric_type: &str,
+                               value: &dyn Fn(&LaneStats) -> String|
+         -> fmt::Result {
+            write_prometheus_header(out, name, help, metric_type)?;
+            for lane in lanes.iter() {
+                writeln!(
+                    out,
+                    "{}{{{}}} {}",
+                    name,
+                    prometheus_labels(&[("lane", lane.name())]),
+                    value(&self.lanes[lane.index()])
+                )?;
+            }
+            Ok(())
+        };
+        write_lanes(
+            "stratisd_dbus_queue_depth",
+            "Method calls waiting in the queue of a lane.",
+            "gauge",
+            &|stats| stats.depth.load(Ordering::SeqCst).to_string(),
+        )?;
+        write_lanes(
+            "stratisd_dbus_dispatched_total",
+            "Method calls queued to a lane.",
+            "counter",
+            &|stats| stats.dispatched.load(Ordering::SeqCst).to_string(),
+        )?;
+        write_lanes(
+            "stratisd_dbus_rejected_total",
+            "Method calls rejected because the queue of a lane was full.",
+            "counter",
+            &|stats| stats.rejected.load(Ordering::SeqCst).to_string(),
+        )?;
+
+        let name = "stratisd_dbus_method_duration_seconds";
+        write_prometheus_header(
+            out,
+            name,
+            "Time from the receipt of a method call to the sending of its reply.",
+            "histogram",
+        )?;
+        let methods = self
+            .methods
+            .lock()
+            .expect("no thread panics while holding the lock");
+        let mut methods = methods.iter().collect::<Vec<_>>();
+        methods.sort_unstable_by_key(|(method, _)| *method);
+        for (method, histogram) in methods {
+            histogram.write_prometheus(out, name, &prometheus_labels(&[("method", method)]))?;
+        }
+        Ok(())
+    }
+}
+
+impl<'a> Into<Value> for &'a DispatchStats {
+    fn into(self) -> Value {
+        let lanes = [Lane::Read, Lane::Mutate]
+            .iter()
+            .map(|lane| {
+                let stats = &self.lanes[lane.index()];
+                (
+                    lane.name().to_string(),
+                    json!({
+                        "queue_depth": Value::from(stats.depth.load(Ordering::SeqCst)),
+                        "max_queue_depth": Value::from(stats.max_depth.load(Ordering::SeqCst)),
+                        "dispatched": Value::from(stats.dispatched.load(Ordering::SeqCst)),
+                        "rejected": Value::from(stats.rejected.load(Ordering::SeqCst)),
+                    }),
+                )
+            })
+            .collect::<Map<String, Value>>();
+        let methods = self
+            .methods
+            .lock()
+            .expect("no thread panics while holding the lock")
+            .iter()
+            .map(|(method, histogram)| (method.to_owned(), histogram.into()))
+            .collect::<Map<String, Value>>();
+        json!({
+            "lanes": Value::Object(lanes),
+            "methods": Value::Object(methods),
+        })
+    }
+}
+
+/// A method call waiting to be served.
+struct Job {
+    msg: Message,
+    received: Instant,
+}
+
+/// The queues of the two lanes. The worker threads exit when this is
+/// dropped.
+pub struct DispatchPool {
+    read: SyncSender<Job>,
+    mutate: SyncSender<Job>,
+    stats: Arc<DispatchStats>,
+}
+
+impl DispatchPool {
+    /// Start the worker threads, which serve method calls from tree and
+    /// send their replies on connection.
+    pub fn new(
+        tree: LockableTree,
+        connection: Arc<SyncConnection>,
+        stats: Arc<DispatchStats>,
+    ) -> StratisResult<DispatchPool> {
+        let read = start_lane(Lane::Read, READ_WORKERS, &tree, &connection, &stats)?;
+        let mutate = start_lane(Lane::Mutate, MUTATE_WORKERS, &tree, &connection, &stats)?;
+        Ok(DispatchPool {
+            read,
+            mutate,
+            stats,
+        })
+    }
+
+    /// Queue msg to be served by the lane appropriate to it. If that lane's
+    /// queue is full, send an error reply instead.
+    pub fn dispatch(&self, msg: Message, connection: &SyncConnection) {
+        let lane = classify(
+            msg.interface().as_ref().map(|i| &**i),
+            msg.member().as_ref().map(|m| &**m),
+        );
+        let sender = match lane {
+            Lane::Read => &self.read,
+            Lane::Mutate => &self.mutate,
+        };
+        self.stats.enqueued(lane);
+        match sender.try_send(Job {
+            msg,
+            received: Instant::now(),
+        }) {
+            Ok(()) => (),
+            Err(TrySendError::Full(job)) | Err(TrySendError::Disconnected(job)) => {
+                self.stats.dequeued(lane);
+                self.stats.rejected(lane);
+                warn!(
+                    "The queue of D-Bus {} method calls is full; rejecting method call",
+                    lane.name()
+                );
+                let reply = MethodErr::failed(&format!(
+                    "stratisd is busy; more than {} {} method calls are waiting",
+                    QUEUE_CAPACITY,
+                    lane.name()
+                ))
+                .to_message(&job.msg);
+                if connection.send(reply).is_err() {
+                    warn!("Failed to send reply to D-Bus client");
+                }
+            }
+        }
+    }
+}
+
+/// Start worker threads, all serving calls from a single queue for lane.
+fn start_lane(
+    lane: Lane,
+    workers: usize,
+    tree: &LockableTree,
+    connection: &Arc<SyncConnection>,
+    stats: &Arc<DispatchStats>,
+) -> StratisResult<SyncSender<Job>> {
+    let (sender, receiver) = sync_channel(QUEUE_CAPACITY);
+    let receiver = Arc::new(Mutex::new(receiver));
+    for i in 0..workers {
+        let receiver = Arc::clone(&receiver);
+        let tree = tree.clone();
+        let connection = Arc::clone(connection);
+        let stats = Arc::clone(stats);
+        thread::Builder::new()
+            .name(format!("stratis-dbus-{}-{}", lane.name(), i))
+            .spawn(move || serve(lane, &receiver, &tree, &connection, &stats))?;
+    }
+    Ok(sender)
+}
+
+/// Serve method calls from receiver until all senders have been dropped.
+fn serve(
+    lane: Lane,
+    receiver: &Mutex<Receiver<Job>>,
+    tree: &LockableTree,
+    connection: &SyncConnection,
+    stats: &DispatchStats,
+) {
+    loop {
+        let job = {
+            let receiver = receiver
+                .lock()
+                .expect("no thread panics while holding the lock");
+            receiver.recv()
+        };
+        let Job { msg, received } = match job {
+            Ok(job) => job,
+            Err(_) => return,
+        };
+        stats.dequeued(lane);
+
+        let method = match (msg.interface(), msg.member()) {
+            (Some(interface), Some(member)) => format!("{}.{}", &*interface, &*member),
+            (None, Some(member)) => String::from(&*member),
+            (_, None) => UNTRACKED_METHOD.to_string(),
+        };
+
+        // The tree lock is held only while the current tree is cloned, so
+        // that a long running method holds up neither changes to the tree
+        // nor the method calls waiting behind such a change.
+        let current = Arc::clone(&*tree.blocking_read());
+        let replies = current
+            .handle(&msg)
+            .unwrap_or_else(|| default_reply(&msg).into_iter().collect());
+        for reply in replies {
+            if connection.send(reply).is_err() {
+                warn!("Failed to send reply to D-Bus client");
+            }
+        }
+
+        stats.record_latency(method, received.elapsed());
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    /// Verify that only read-only methods are served by the read lane.
+    fn test_classify() {
+        assert_eq!(
+            classify(Some("org.freedesktop.DBus.Properties"), Some("Get")),
+            Lane::Read
+        );
+        assert_eq!(
+            classify(Some("org.freedesktop.DBus.Properties"), Some("Set")),
+            Lane::Mutate
+        );
+        assert_eq!(
+            classify(
+                Some("org.freedesktop.DBus.ObjectManager"),
+                Some("GetManagedObjects")
+            ),
+            Lane::Read
+        );
+        assert_eq!(
+            classify(
+                Some(consts::PROPERTY_FETCH_INTERFACE_NAME_3_0),
+                Some("GetAllProperties")
+            ),
+            Lane::Read
+        );
+        assert_eq!(
+            classify(
+                Some(consts::PROPERTY_FETCH_INTERFACE_NAME_3_1),
+                Some("GetProperties")
+            ),
+            Lane::Read
+        );
+        assert_eq!(
+            classify(
+                Some(consts::MANAGER_INTERFACE_NAME_3_1),
+                Some("GetManagedObjectsPage")
+            ),
+            Lane::Read
+        );
+        assert_eq!(
+            classify(Some(consts::MANAGER_INTERFACE_NAME_3_0), Some("CreatePool")),
+            Lane::Mutate
+        );
+        assert_eq!(classify(None, Some("Get")), Lane::Mutate);
+    }
+
+    #[test]
+    /// Verify that the number of methods tracked separately is bounded.
+    fn test_tracked_methods() {
+        let stats = DispatchStats::default();
+        for i in 0..MAX_TRACKED_METHODS + 10 {
+            stats.record_latency(format!("method{}", i), Duration::from_micros(1));
+        }
+        stats.record_latency("method0".to_string(), Duration::from_micros(1));
+        let methods = stats.methods.lock().unwrap();
+        assert_eq!(methods.len(), MAX_TRACKED_METHODS + 1);
+        assert_eq!(methods["method0"].count(), 2);
+        assert_eq!(methods[UNTRACKED_METHOD].count(), 10);
+    }
+}
@@ -8,14 +8,37 @@ use dbus::{
     arg::{RefArg, Variant},
     Message,
 };
-use dbus_tree::{MTSync, MethodInfo, MethodResult};
+use dbus_tree::{MTSync, MethodInfo, MethodResult, Tree};
 use itertools::Itertools;
 
 use crate::dbus_api::{
     consts, filesystem::shared::filesystem_operation, types::TData, util::result_to_tuple,
 };
 
-const ALL_PROPERTIES: [&str; 1] = [consts::FILESYSTEM_USED_PROP];
+pub const ALL_PROPERTIES: [&str; 1] = [consts::FILESYSTEM_USED_PROP];
+
+/// Fetch the given properties of the filesystem with object path object_path.
+/// Properties that the filesystem does not have are omitted.
+pub fn fetch_properties(
+    tree: &Tree<MTSync<TData>, TData>,
+    object_path: &dbus::Path<'static>,
+    properties: &mut dyn Iterator<Item = String>,
+) -> HashMap<String, (bool, Variant<Box<dyn RefArg>>)> {
+    properties
+        .unique()
+        .filter_map(|prop| match prop.as_str() {
+            consts::FILESYSTEM_USED_PROP => Some((
+                prop,
+                result_to_tuple(filesystem_operation(tree, object_path, |(_, _, fs)| {
+                    fs.used()
+                        .map(|u| (*u).to_string())
+                        .map_err(|e| e.to_string())
+                })),
+            )),
+            _ => None,
+        })
+        .collect()
+}
 
 #[allow(clippy::unnecessary_wraps)]
 fn get_properties_shared(
@@ -23,28 +46,10 @@ fn get_properties_shared(
     properties: &mut dyn Iterator<Item = String>,
 ) -> MethodResult {
     let message: &Message = m.msg;
-    let object_path = &m.path;
 
     let return_message = message.method_return();
 
-    let return_value: HashMap<String, (bool, Variant<Box<dyn RefArg>>)> = properties
-        .unique()
-        .filter_map(|prop| match prop.as_str() {
-            consts::FILESYSTEM_USED_PROP => Some((
-                prop,
-                result_to_tuple(filesystem_operation(
-                    m.tree,
-                    object_path.get_name(),
-                    |(_, _, fs)| {
-                        fs.used()
-                            .map(|u| (*u).to_string())
-                            .map_err(|e| e.to_string())
-                    },
-                )),
-            )),
-            _ => None,
-        })
-        .collect();
+    let return_value = fetch_properties(m.tree, m.path.get_name(), properties);
 
     Ok(vec![return_message.append1(return_value)])
 }
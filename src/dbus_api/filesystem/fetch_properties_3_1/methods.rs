@@ -0,0 +1,82 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+use std::collections::HashMap;
+
+use dbus::{
+    arg::{RefArg, Variant},
+    Message,
+};
+use dbus_tree::{MTSync, MethodInfo, MethodResult, Tree};
+use itertools::Itertools;
+
+use crate::dbus_api::{
+    consts,
+    filesystem::{fetch_properties_3_0, shared::filesystem_operation},
+    types::TData,
+    util::{option_to_tuple, result_to_tuple},
+};
+
+pub const ALL_PROPERTIES: [&str; 3] = [
+    consts::FILESYSTEM_USED_PROP,
+    consts::FILESYSTEM_GROWTH_POLICY_PROP,
+    consts::FILESYSTEM_USED_AGE_PROP,
+];
+
+/// Fetch the given properties of the filesystem with object path object_path.
+/// Properties that the filesystem does not have are omitted. Properties
+/// which revision 0 of the interface also offers are fetched by it.
+pub fn fetch_properties(
+    tree: &Tree<MTSync<TData>, TData>,
+    object_path: &dbus::Path<'static>,
+    properties: &mut dyn Iterator<Item = String>,
+) -> HashMap<String, (bool, Variant<Box<dyn RefArg>>)> {
+    let (inherited, properties): (Vec<_>, Vec<_>) = properties
+        .unique()
+        .partition(|prop| fetch_properties_3_0::ALL_PROPERTIES.contains(&prop.as_str()));
+
+    let mut return_value = properties
+        .into_iter()
+        .filter_map(|prop| match prop.as_str() {
+            consts::FILESYSTEM_USED_AGE_PROP => Some((
+                prop,
+                result_to_tuple(filesystem_operation(tree, object_path, |(_, _, fs)| {
+                    Ok(option_to_tuple(
+                        fs.used_age().map(|age| age.as_secs().to_string()),
+                        String::new(),
+                    ))
+                })),
+            )),
+            consts::FILESYSTEM_GROWTH_POLICY_PROP => Some((
+                prop,
+                result_to_tuple(filesystem_operation(tree, object_path, |(_, _, fs)| {
+                    Ok(fs.growth_policy().to_string())
+                })),
+            )),
+            _ => None,
+        })
+        .collect::<HashMap<_, _>>();
+    return_value.extend(fetch_properties_3_0::fetch_properties(
+        tree,
+        object_path,
+        &mut inherited.into_iter(),
+    ));
+    return_value
+}
+
+#[allow(clippy::unnecessary_wraps)]
+fn get_properties_shared(
+    m: &MethodInfo<MTSync<TData>, TData>,
+    properties: &mut dyn Iterator<Item = String>,
+) -> MethodResult {
+    let message: &Message = m.msg;
+
+    let return_message = message.method_return();
+
+    let return_value = fetch_properties(m.tree, m.path.get_name(), properties);
+
+    Ok(vec![return_message.append1(return_value)])
+}
+
+properties_footer!();
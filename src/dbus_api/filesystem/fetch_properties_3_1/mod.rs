@@ -0,0 +1,5 @@
+mod api;
+mod methods;
+
+pub use api::{get_all_properties_method, get_properties_method};
+pub use methods::{fetch_properties, ALL_PROPERTIES};
@@ -38,8 +38,8 @@ pub fn rename_filesystem(m: &MethodInfo<MTSync<TData>, TData>) -> MethodResult {
         return_message
     );
 
-    let mut mutex_lock = dbus_context.engine.blocking_lock();
-    let (pool_name, pool) = get_mut_pool!(mutex_lock; pool_uuid; default_return; return_message);
+    let read_lock = dbus_context.engine.blocking_read();
+    let (pool_name, mut pool) = lock_pool!(read_lock; pool_uuid; default_return; return_message);
 
     let uuid = typed_uuid!(filesystem_data.uuid; Fs; default_return; return_message);
     let msg = match log_action!(pool.rename_filesystem(&pool_name, uuid, new_name)) {
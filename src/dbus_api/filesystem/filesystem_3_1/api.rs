@@ -0,0 +1,20 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+use dbus_tree::{Factory, MTSync, Method};
+
+use crate::dbus_api::{filesystem::filesystem_3_1::methods::set_growth_policy, types::TData};
+
+pub fn set_growth_policy_method(f: &Factory<MTSync<TData>, TData>) -> Method<MTSync<TData>, TData> {
+    f.method("SetGrowthPolicy", (), set_growth_policy)
+        // s: double, fixed:<bytes>, percent:<percent> or predictive:<seconds>
+        .in_arg(("policy", "s"))
+        // b: true if the policy was changed
+        // s: the new policy
+        //
+        // Rust representation: (bool, String)
+        .out_arg(("result", "(bs)"))
+        .out_arg(("return_code", "q"))
+        .out_arg(("return_string", "s"))
+}
@@ -0,0 +1,73 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+use dbus::Message;
+use dbus_tree::{MTSync, MethodInfo, MethodResult};
+
+use std::convert::TryFrom;
+
+use crate::{
+    dbus_api::{
+        types::{DbusErrorEnum, TData, OK_STRING},
+        util::{engine_to_dbus_err_tuple, get_next_arg},
+    },
+    engine::{FsGrowthPolicy, PropChangeAction},
+};
+
+pub fn set_growth_policy(m: &MethodInfo<MTSync<TData>, TData>) -> MethodResult {
+    let message: &Message = m.msg;
+    let mut iter = message.iter_init();
+
+    let policy: &str = get_next_arg(&mut iter, 0)?;
+
+    let dbus_context = m.tree.get_data();
+    let object_path = m.path.get_name();
+    let return_message = message.method_return();
+    let default_return = (false, String::new());
+
+    let policy = match FsGrowthPolicy::try_from(policy) {
+        Ok(policy) => policy,
+        Err(err) => {
+            let (rc, rs) = engine_to_dbus_err_tuple(&err);
+            return Ok(vec![return_message.append3(default_return, rc, rs)]);
+        }
+    };
+
+    let filesystem_path = m
+        .tree
+        .get(object_path)
+        .expect("implicit argument must be in tree");
+    let filesystem_data = get_data!(filesystem_path; default_return; return_message);
+
+    let pool_path = get_parent!(m; filesystem_data; default_return; return_message);
+    let pool_uuid = typed_uuid!(
+        get_data!(pool_path; default_return; return_message).uuid;
+        Pool;
+        default_return;
+        return_message
+    );
+
+    let read_lock = dbus_context.engine.blocking_read();
+    let (pool_name, mut pool) = lock_pool!(read_lock; pool_uuid; default_return; return_message);
+
+    let uuid = typed_uuid!(filesystem_data.uuid; Fs; default_return; return_message);
+    let msg = match log_action!(pool.set_fs_growth_policy(&pool_name, uuid, policy)) {
+        Ok(PropChangeAction::Identity) => return_message.append3(
+            default_return,
+            DbusErrorEnum::OK as u16,
+            OK_STRING.to_string(),
+        ),
+        Ok(PropChangeAction::NewValue(policy)) => return_message.append3(
+            (true, policy.to_string()),
+            DbusErrorEnum::OK as u16,
+            OK_STRING.to_string(),
+        ),
+        Err(err) => {
+            let (rc, rs) = engine_to_dbus_err_tuple(&err);
+            return_message.append3(default_return, rc, rs)
+        }
+    };
+
+    Ok(vec![msg])
+}
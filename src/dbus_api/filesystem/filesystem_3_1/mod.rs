@@ -0,0 +1,4 @@
+mod api;
+mod methods;
+
+pub use api::set_growth_policy_method;
@@ -15,9 +15,15 @@ use crate::{
 };
 
 mod fetch_properties_3_0;
+mod fetch_properties_3_1;
 mod filesystem_3_0;
+mod filesystem_3_1;
 mod shared;
 
+pub use fetch_properties_3_1::{
+    fetch_properties as fetch_fs_properties, ALL_PROPERTIES as ALL_FS_PROPERTIES,
+};
+
 pub fn create_dbus_filesystem<'a>(
     dbus_context: &DbusContext,
     parent: dbus::Path<'static>,
@@ -45,10 +51,25 @@ pub fn create_dbus_filesystem<'a>(
                 .add_p(filesystem_3_0::uuid_property(&f))
                 .add_p(filesystem_3_0::created_property(&f)),
         )
+        .add(
+            f.interface(consts::FILESYSTEM_INTERFACE_NAME_3_1, ())
+                .add_m(filesystem_3_0::rename_method(&f))
+                .add_m(filesystem_3_1::set_growth_policy_method(&f))
+                .add_p(filesystem_3_0::devnode_property(&f))
+                .add_p(filesystem_3_0::name_property(&f))
+                .add_p(filesystem_3_0::pool_property(&f))
+                .add_p(filesystem_3_0::uuid_property(&f))
+                .add_p(filesystem_3_0::created_property(&f)),
+        )
         .add(
             f.interface(consts::PROPERTY_FETCH_INTERFACE_NAME_3_0, ())
                 .add_m(fetch_properties_3_0::get_all_properties_method(&f))
                 .add_m(fetch_properties_3_0::get_properties_method(&f)),
+        )
+        .add(
+            f.interface(consts::PROPERTY_FETCH_INTERFACE_NAME_3_1, ())
+                .add_m(fetch_properties_3_1::get_all_properties_method(&f))
+                .add_m(fetch_properties_3_1::get_properties_method(&f)),
         );
 
     let path = object_path.get_name().to_owned();
@@ -67,11 +88,19 @@ pub fn get_fs_properties(
 ) -> InterfacesAddedThreadSafe {
     initial_properties! {
         consts::FILESYSTEM_INTERFACE_NAME_3_0 => {
+            consts::FILESYSTEM_NAME_PROP => shared::fs_name_prop(fs_name),
+            consts::FILESYSTEM_UUID_PROP => uuid_to_string!(fs_uuid),
+            consts::FILESYSTEM_DEVNODE_PROP => shared::fs_devnode_prop(fs, pool_name, fs_name),
+            consts::FILESYSTEM_POOL_PROP => parent.clone(),
+            consts::FILESYSTEM_CREATED_PROP => shared::fs_created_prop(fs)
+        },
+        consts::FILESYSTEM_INTERFACE_NAME_3_1 => {
             consts::FILESYSTEM_NAME_PROP => shared::fs_name_prop(fs_name),
             consts::FILESYSTEM_UUID_PROP => uuid_to_string!(fs_uuid),
             consts::FILESYSTEM_DEVNODE_PROP => shared::fs_devnode_prop(fs, pool_name, fs_name),
             consts::FILESYSTEM_POOL_PROP => parent,
             consts::FILESYSTEM_CREATED_PROP => shared::fs_created_prop(fs)
-        }
+        },
+        consts::PROPERTY_FETCH_INTERFACE_NAME_3_1 => {}
     }
 }
@@ -86,10 +86,11 @@ macro_rules! get_pool {
     };
 }
 
-/// Macro for early return with Ok dbus message on failure to get mutable pool.
-macro_rules! get_mut_pool {
+/// Macro for early return with Ok dbus message on failure to lock pool for
+/// writing.
+macro_rules! lock_pool {
     ($engine:expr; $uuid:ident; $default:expr; $message:expr) => {
-        if let Some(pool) = $engine.get_mut_pool($uuid) {
+        if let Some(pool) = $engine.lock_pool($uuid) {
             pool
         } else {
             let message = format!("engine does not know about pool with uuid {}", $uuid);
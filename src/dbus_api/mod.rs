@@ -9,6 +9,7 @@ mod api;
 mod blockdev;
 mod connection;
 mod consts;
+mod dispatch;
 mod filesystem;
 mod pool;
 mod types;
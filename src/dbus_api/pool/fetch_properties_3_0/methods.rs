@@ -8,7 +8,7 @@ use dbus::{
     arg::{RefArg, Variant},
     Message,
 };
-use dbus_tree::{MTSync, MethodInfo, MethodResult};
+use dbus_tree::{MTSync, MethodInfo, MethodResult, Tree};
 use itertools::Itertools;
 
 use crate::dbus_api::{
@@ -21,7 +21,7 @@ use crate::dbus_api::{
     util::result_to_tuple,
 };
 
-const ALL_PROPERTIES: [&str; 5] = [
+pub const ALL_PROPERTIES: [&str; 5] = [
     consts::POOL_ENCRYPTION_KEY_DESC,
     consts::POOL_HAS_CACHE_PROP,
     consts::POOL_TOTAL_SIZE_PROP,
@@ -29,6 +29,40 @@ const ALL_PROPERTIES: [&str; 5] = [
     consts::POOL_CLEVIS_INFO,
 ];
 
+/// Fetch the given properties of the pool with object path object_path.
+/// Properties that the pool does not have are omitted.
+pub fn fetch_properties(
+    tree: &Tree<MTSync<TData>, TData>,
+    object_path: &dbus::Path<'static>,
+    properties: &mut dyn Iterator<Item = String>,
+) -> HashMap<String, (bool, Variant<Box<dyn RefArg>>)> {
+    properties
+        .unique()
+        .filter_map(|prop| match prop.as_str() {
+            consts::POOL_ENCRYPTION_KEY_DESC => Some((
+                prop,
+                result_to_tuple(get_pool_encryption_key_desc(tree, object_path)),
+            )),
+            consts::POOL_HAS_CACHE_PROP => {
+                Some((prop, result_to_tuple(get_pool_has_cache(tree, object_path))))
+            }
+            consts::POOL_TOTAL_SIZE_PROP => Some((
+                prop,
+                result_to_tuple(get_pool_total_size(tree, object_path)),
+            )),
+            consts::POOL_TOTAL_USED_PROP => Some((
+                prop,
+                result_to_tuple(get_pool_total_used(tree, object_path)),
+            )),
+            consts::POOL_CLEVIS_INFO => Some((
+                prop,
+                result_to_tuple(get_pool_clevis_info(tree, object_path)),
+            )),
+            _ => None,
+        })
+        .collect()
+}
+
 #[allow(clippy::unnecessary_wraps)]
 fn get_properties_shared(
     m: &MethodInfo<MTSync<TData>, TData>,
@@ -38,19 +72,7 @@ fn get_properties_shared(
 
     let return_message = message.method_return();
 
-    let return_value: HashMap<String, (bool, Variant<Box<dyn RefArg>>)> = properties
-        .unique()
-        .filter_map(|prop| match prop.as_str() {
-            consts::POOL_ENCRYPTION_KEY_DESC => {
-                Some((prop, result_to_tuple(get_pool_encryption_key_desc(m))))
-            }
-            consts::POOL_HAS_CACHE_PROP => Some((prop, result_to_tuple(get_pool_has_cache(m)))),
-            consts::POOL_TOTAL_SIZE_PROP => Some((prop, result_to_tuple(get_pool_total_size(m)))),
-            consts::POOL_TOTAL_USED_PROP => Some((prop, result_to_tuple(get_pool_total_used(m)))),
-            consts::POOL_CLEVIS_INFO => Some((prop, result_to_tuple(get_pool_clevis_info(m)))),
-            _ => None,
-        })
-        .collect();
+    let return_value = fetch_properties(m.tree, m.path.get_name(), properties);
 
     Ok(vec![return_message.append1(return_value)])
 }
@@ -15,9 +15,15 @@ use crate::{
 };
 
 mod fetch_properties_3_0;
+mod fetch_properties_3_1;
 mod pool_3_0;
+mod pool_3_1;
 mod shared;
 
+pub use fetch_properties_3_1::{
+    fetch_properties as fetch_pool_properties, ALL_PROPERTIES as ALL_POOL_PROPERTIES,
+};
+
 pub fn create_dbus_pool<'a>(
     dbus_context: &DbusContext,
     parent: dbus::Path<'static>,
@@ -54,10 +60,38 @@ pub fn create_dbus_pool<'a>(
                 .add_p(pool_3_0::uuid_property(&f))
                 .add_p(pool_3_0::encrypted_property(&f)),
         )
+        .add(
+            f.interface(consts::POOL_INTERFACE_NAME_3_1, ())
+                .add_m(pool_3_1::create_filesystems_method(&f))
+                .add_m(pool_3_0::destroy_filesystems_method(&f))
+                .add_m(pool_3_0::snapshot_filesystem_method(&f))
+                .add_m(pool_3_1::snapshot_filesystems_method(&f))
+                .add_m(pool_3_0::add_blockdevs_method(&f))
+                .add_m(pool_3_0::bind_clevis_method(&f))
+                .add_m(pool_3_0::unbind_clevis_method(&f))
+                .add_m(pool_3_0::init_cache_method(&f))
+                .add_m(pool_3_1::init_cache_with_settings_method(&f))
+                .add_m(pool_3_1::set_cache_migration_threshold_method(&f))
+                .add_m(pool_3_1::set_alloc_policy_method(&f))
+                .add_m(pool_3_0::add_cachedevs_method(&f))
+                .add_m(pool_3_0::bind_keyring_method(&f))
+                .add_m(pool_3_0::unbind_keyring_method(&f))
+                .add_m(pool_3_0::rebind_keyring_method(&f))
+                .add_m(pool_3_0::rebind_clevis_method(&f))
+                .add_m(pool_3_0::rename_method(&f))
+                .add_p(pool_3_0::name_property(&f))
+                .add_p(pool_3_0::uuid_property(&f))
+                .add_p(pool_3_0::encrypted_property(&f)),
+        )
         .add(
             f.interface(consts::PROPERTY_FETCH_INTERFACE_NAME_3_0, ())
                 .add_m(fetch_properties_3_0::get_all_properties_method(&f))
                 .add_m(fetch_properties_3_0::get_properties_method(&f)),
+        )
+        .add(
+            f.interface(consts::PROPERTY_FETCH_INTERFACE_NAME_3_1, ())
+                .add_m(fetch_properties_3_1::get_all_properties_method(&f))
+                .add_m(fetch_properties_3_1::get_properties_method(&f)),
         );
 
     let path = object_path.get_name().to_owned();
@@ -77,6 +111,12 @@ pub fn get_pool_properties(
             consts::POOL_NAME_PROP => shared::pool_name_prop(pool_name),
             consts::POOL_UUID_PROP => uuid_to_string!(pool_uuid),
             consts::POOL_ENCRYPTED_PROP => shared::pool_enc_prop(pool)
-        }
+        },
+        consts::POOL_INTERFACE_NAME_3_1 => {
+            consts::POOL_NAME_PROP => shared::pool_name_prop(pool_name),
+            consts::POOL_UUID_PROP => uuid_to_string!(pool_uuid),
+            consts::POOL_ENCRYPTED_PROP => shared::pool_enc_prop(pool)
+        },
+        consts::PROPERTY_FETCH_INTERFACE_NAME_3_1 => {}
     }
 }
@@ -8,105 +8,23 @@ use dbus::{arg::Array, Message};
 use dbus_tree::{MTSync, MethodInfo, MethodResult};
 use serde_json::Value;
 
-use devicemapper::Sectors;
-
 use crate::{
     dbus_api::{
         consts::filesystem_interface_list,
         filesystem::create_dbus_filesystem,
-        pool::shared::{add_blockdevs, BlockDevOp},
+        pool::shared::{add_blockdevs, create_filesystems_shared, BlockDevOp},
         types::{DbusErrorEnum, TData, OK_STRING},
         util::{engine_to_dbus_err_tuple, get_next_arg},
     },
     engine::{
-        CreateAction, DeleteAction, EngineAction, FilesystemUuid, KeyDescription, Name, PoolUuid,
-        RenameAction,
+        CacheSettings, CreateAction, DeleteAction, EngineAction, FilesystemUuid, KeyDescription,
+        Name, PoolUuid, RenameAction,
     },
     stratis::StratisError,
 };
 
 pub fn create_filesystems(m: &MethodInfo<MTSync<TData>, TData>) -> MethodResult {
-    let message: &Message = m.msg;
-    let mut iter = message.iter_init();
-
-    let filesystems: Array<&str, _> = get_next_arg(&mut iter, 0)?;
-    let dbus_context = m.tree.get_data();
-
-    let object_path = m.path.get_name();
-    let return_message = message.method_return();
-    let default_return: (bool, Vec<(dbus::Path, &str)>) = (false, Vec::new());
-
-    if filesystems.count() > 1 {
-        let error_message = "only 1 filesystem per request allowed";
-        let (rc, rs) = (DbusErrorEnum::ERROR as u16, error_message);
-        return Ok(vec![return_message.append3(default_return, rc, rs)]);
-    }
-
-    let pool_path = m
-        .tree
-        .get(object_path)
-        .expect("implicit argument must be in tree");
-    let pool_uuid = typed_uuid!(
-        get_data!(pool_path; default_return; return_message).uuid;
-        Pool;
-        default_return;
-        return_message
-    );
-
-    let mut mutex_lock = dbus_context.engine.blocking_lock();
-    let (pool_name, pool) = get_mut_pool!(mutex_lock; pool_uuid; default_return; return_message);
-
-    let result = log_action!(pool.create_filesystems(
-        &pool_name,
-        pool_uuid,
-        &filesystems
-            .map(|x| (x, None))
-            .collect::<Vec<(&str, Option<Sectors>)>>(),
-    ));
-
-    let infos = match result {
-        Ok(created_set) => created_set.changed(),
-        Err(err) => {
-            let (rc, rs) = engine_to_dbus_err_tuple(&err);
-            return Ok(vec![return_message.append3(default_return, rc, rs)]);
-        }
-    };
-
-    let return_value = match infos {
-        Some(ref newly_created_filesystems) => {
-            let v = newly_created_filesystems
-                .iter()
-                .map(|&(name, uuid)| {
-                    let filesystem = pool
-                        .get_filesystem(uuid)
-                        .expect("just inserted by create_filesystems")
-                        .1;
-                    // FIXME: To avoid this expect, modify create_filesystem
-                    // so that it returns a mutable reference to the
-                    // filesystem created.
-                    (
-                        create_dbus_filesystem(
-                            dbus_context,
-                            object_path.clone(),
-                            &pool_name,
-                            &Name::new(name.to_string()),
-                            uuid,
-                            filesystem,
-                        ),
-                        name,
-                    )
-                })
-                .collect::<Vec<_>>();
-            (true, v)
-        }
-        None => default_return,
-    };
-
-    Ok(vec![return_message.append3(
-        return_value,
-        DbusErrorEnum::OK as u16,
-        OK_STRING.to_string(),
-    )])
+    create_filesystems_shared(m, true)
 }
 
 pub fn destroy_filesystems(m: &MethodInfo<MTSync<TData>, TData>) -> MethodResult {
@@ -131,8 +49,8 @@ pub fn destroy_filesystems(m: &MethodInfo<MTSync<TData>, TData>) -> MethodResult
         return_message
     );
 
-    let mut mutex_lock = dbus_context.engine.blocking_lock();
-    let (pool_name, pool) = get_mut_pool!(mutex_lock; pool_uuid; default_return; return_message);
+    let read_lock = dbus_context.engine.blocking_read();
+    let (pool_name, mut pool) = lock_pool!(read_lock; pool_uuid; default_return; return_message);
 
     let mut filesystem_map: HashMap<FilesystemUuid, dbus::Path<'static>> = HashMap::new();
     for path in filesystems {
@@ -219,8 +137,8 @@ pub fn snapshot_filesystem(m: &MethodInfo<MTSync<TData>, TData>) -> MethodResult
         }
     };
 
-    let mut mutex_lock = dbus_context.engine.blocking_lock();
-    let (pool_name, pool) = get_mut_pool!(mutex_lock; pool_uuid; default_return; return_message);
+    let read_lock = dbus_context.engine.blocking_read();
+    let (pool_name, mut pool) = lock_pool!(read_lock; pool_uuid; default_return; return_message);
 
     let msg = match log_action!(pool.snapshot_filesystem(
         &pool_name,
@@ -285,7 +203,7 @@ pub fn rename_pool(m: &MethodInfo<MTSync<TData>, TData>) -> MethodResult {
 
     let msg = match log_action!(dbus_context
         .engine
-        .blocking_lock()
+        .blocking_write()
         .rename_pool(pool_uuid, new_name))
     {
         Ok(RenameAction::NoSource) => {
@@ -315,7 +233,7 @@ pub fn rename_pool(m: &MethodInfo<MTSync<TData>, TData>) -> MethodResult {
 }
 
 pub fn init_cache(m: &MethodInfo<MTSync<TData>, TData>) -> MethodResult {
-    add_blockdevs(m, BlockDevOp::InitCache)
+    add_blockdevs(m, BlockDevOp::InitCache(CacheSettings::default()))
 }
 
 pub fn add_cachedevs(m: &MethodInfo<MTSync<TData>, TData>) -> MethodResult {
@@ -344,8 +262,8 @@ pub fn bind_clevis(m: &MethodInfo<MTSync<TData>, TData>) -> MethodResult {
         return_message
     );
 
-    let mut mutex_lock = dbus_context.engine.blocking_lock();
-    let (_, pool) = get_mut_pool!(mutex_lock; pool_uuid; default_return; return_message);
+    let read_lock = dbus_context.engine.blocking_read();
+    let (_, mut pool) = lock_pool!(read_lock; pool_uuid; default_return; return_message);
 
     let json: Value = match serde_json::from_str(&json_string) {
         Ok(j) => j,
@@ -388,8 +306,8 @@ pub fn unbind_clevis(m: &MethodInfo<MTSync<TData>, TData>) -> MethodResult {
         return_message
     );
 
-    let mut mutex_lock = dbus_context.engine.blocking_lock();
-    let (_, pool) = get_mut_pool!(mutex_lock; pool_uuid; default_return; return_message);
+    let read_lock = dbus_context.engine.blocking_read();
+    let (_, mut pool) = lock_pool!(read_lock; pool_uuid; default_return; return_message);
 
     let msg = match log_action!(pool.unbind_clevis()) {
         Ok(DeleteAction::Identity) => {
@@ -435,8 +353,8 @@ pub fn bind_keyring(m: &MethodInfo<MTSync<TData>, TData>) -> MethodResult {
         return_message
     );
 
-    let mut mutex_lock = dbus_context.engine.blocking_lock();
-    let (_, pool) = get_mut_pool!(mutex_lock; pool_uuid; default_return; return_message);
+    let read_lock = dbus_context.engine.blocking_read();
+    let (_, mut pool) = lock_pool!(read_lock; pool_uuid; default_return; return_message);
 
     let msg = match log_action!(pool.bind_keyring(&key_desc)) {
         Ok(CreateAction::Identity) => {
@@ -472,8 +390,8 @@ pub fn unbind_keyring(m: &MethodInfo<MTSync<TData>, TData>) -> MethodResult {
         return_message
     );
 
-    let mut mutex_lock = dbus_context.engine.blocking_lock();
-    let (_, pool) = get_mut_pool!(mutex_lock; pool_uuid; default_return; return_message);
+    let read_lock = dbus_context.engine.blocking_read();
+    let (_, mut pool) = lock_pool!(read_lock; pool_uuid; default_return; return_message);
 
     let msg = match log_action!(pool.unbind_keyring()) {
         Ok(DeleteAction::Identity) => {
@@ -519,8 +437,8 @@ pub fn rebind_keyring(m: &MethodInfo<MTSync<TData>, TData>) -> MethodResult {
         return_message
     );
 
-    let mut mutex_lock = dbus_context.engine.blocking_lock();
-    let (_, pool) = get_mut_pool!(mutex_lock; pool_uuid; default_return; return_message);
+    let read_lock = dbus_context.engine.blocking_read();
+    let (_, mut pool) = lock_pool!(read_lock; pool_uuid; default_return; return_message);
 
     let msg = match log_action!(pool.rebind_keyring(&key_desc)) {
         Ok(RenameAction::Identity) => {
@@ -564,8 +482,8 @@ pub fn rebind_clevis(m: &MethodInfo<MTSync<TData>, TData>) -> MethodResult {
         return_message
     );
 
-    let mut mutex_lock = dbus_context.engine.blocking_lock();
-    let (_, pool) = get_mut_pool!(mutex_lock; pool_uuid; default_return; return_message);
+    let read_lock = dbus_context.engine.blocking_read();
+    let (_, mut pool) = lock_pool!(read_lock; pool_uuid; default_return; return_message);
 
     let msg = match log_action!(pool.rebind_clevis()) {
         Ok(_) => return_message.append3(true, DbusErrorEnum::OK as u16, OK_STRING.to_string()),
@@ -0,0 +1,102 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+use dbus_tree::{Factory, MTSync, Method};
+
+use crate::dbus_api::{
+    pool::pool_3_1::methods::{
+        create_filesystems, init_cache_with_settings, set_alloc_policy,
+        set_cache_migration_threshold, snapshot_filesystems,
+    },
+    types::TData,
+};
+
+pub fn create_filesystems_method(
+    f: &Factory<MTSync<TData>, TData>,
+) -> Method<MTSync<TData>, TData> {
+    f.method("CreateFilesystems", (), create_filesystems)
+        // as: Names of the filesystems to create; any number may be
+        // created by a single request
+        .in_arg(("specs", "as"))
+        // b: true if filesystems were created
+        // a(os): Array of tuples with object paths and names
+        //
+        // Rust representation: (bool, Vec<(dbus::Path, String)>)
+        .out_arg(("results", "(ba(os))"))
+        .out_arg(("return_code", "q"))
+        .out_arg(("return_string", "s"))
+}
+
+pub fn snapshot_filesystems_method(
+    f: &Factory<MTSync<TData>, TData>,
+) -> Method<MTSync<TData>, TData> {
+    f.method("SnapshotFilesystems", (), snapshot_filesystems)
+        // a(os): Array of tuples with object paths of origins and names of
+        // their snapshots
+        .in_arg(("snapshots", "a(os)"))
+        // b: true if snapshots were created
+        // a(os): Array of tuples with object paths and names of new snapshots
+        //
+        // Rust representation: (bool, Vec<(dbus::Path, String)>)
+        .out_arg(("results", "(ba(os))"))
+        .out_arg(("return_code", "q"))
+        .out_arg(("return_string", "s"))
+}
+
+pub fn init_cache_with_settings_method(
+    f: &Factory<MTSync<TData>, TData>,
+) -> Method<MTSync<TData>, TData> {
+    f.method("InitCacheWithSettings", (), init_cache_with_settings)
+        .in_arg(("devices", "as"))
+        // b: true if a cache block size in bytes is specified, otherwise the
+        // default is used
+        .in_arg(("block_size", "(bt)"))
+        // b: true if a cache migration threshold in bytes is specified,
+        // otherwise the kernel default is used
+        .in_arg(("migration_threshold", "(bt)"))
+        // b: true if a cache policy is specified; only smq is supported
+        .in_arg(("policy", "(bs)"))
+        // b: true if a cache mode is specified; only writethrough is
+        // supported
+        .in_arg(("mode", "(bs)"))
+        // b: Indicates if any cache devices were added
+        // ao: Array of object paths of created cache devices
+        //
+        // Rust representation: (bool, Vec<dbus::path>)
+        .out_arg(("results", "(bao)"))
+        .out_arg(("return_code", "q"))
+        .out_arg(("return_string", "s"))
+}
+
+pub fn set_cache_migration_threshold_method(
+    f: &Factory<MTSync<TData>, TData>,
+) -> Method<MTSync<TData>, TData> {
+    f.method(
+        "SetCacheMigrationThreshold",
+        (),
+        set_cache_migration_threshold,
+    )
+    // t: the migration threshold in bytes
+    .in_arg(("threshold", "t"))
+    // b: true if the threshold was changed
+    // s: the new threshold in bytes
+    //
+    // Rust representation: (bool, String)
+    .out_arg(("result", "(bs)"))
+    .out_arg(("return_code", "q"))
+    .out_arg(("return_string", "s"))
+}
+
+pub fn set_alloc_policy_method(f: &Factory<MTSync<TData>, TData>) -> Method<MTSync<TData>, TData> {
+    f.method("SetAllocationPolicy", (), set_alloc_policy)
+        // s: fill_first, spread or largest_free
+        .in_arg(("policy", "s"))
+        // b: true if the policy was changed
+        // s: the new policy
+        //
+        // Rust representation: (bool, String)
+        .out_arg(("result", "(bs)"))
+        .out_arg(("return_code", "q"))
+        .out_arg(("return_string", "s"))
+}
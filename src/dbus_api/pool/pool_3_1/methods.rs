@@ -0,0 +1,241 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+use std::convert::TryFrom;
+
+use dbus::{arg::Array, Message};
+use dbus_tree::{MTSync, MethodInfo, MethodResult};
+
+use devicemapper::Bytes;
+
+use crate::{
+    dbus_api::{
+        filesystem::create_dbus_filesystem,
+        pool::shared::{add_blockdevs, create_filesystems_shared, BlockDevOp},
+        types::{DbusErrorEnum, TData, OK_STRING},
+        util::{engine_to_dbus_err_tuple, get_next_arg, tuple_to_option},
+    },
+    engine::{AllocPolicy, CacheSettings, EngineAction, Name, PropChangeAction},
+};
+
+pub fn create_filesystems(m: &MethodInfo<MTSync<TData>, TData>) -> MethodResult {
+    create_filesystems_shared(m, false)
+}
+
+pub fn snapshot_filesystems(m: &MethodInfo<MTSync<TData>, TData>) -> MethodResult {
+    let message: &Message = m.msg;
+    let mut iter = message.iter_init();
+
+    let snapshots: Array<(dbus::Path<'static>, &str), _> = get_next_arg(&mut iter, 0)?;
+
+    let dbus_context = m.tree.get_data();
+    let object_path = m.path.get_name();
+    let return_message = message.method_return();
+    let default_return: (bool, Vec<(dbus::Path, &str)>) = (false, Vec::new());
+
+    let pool_path = m
+        .tree
+        .get(object_path)
+        .expect("implicit argument must be in tree");
+    let pool_uuid = typed_uuid!(
+        get_data!(pool_path; default_return; return_message).uuid;
+        Pool;
+        default_return;
+        return_message
+    );
+
+    let mut specs = Vec::new();
+    for (filesystem, snapshot_name) in snapshots {
+        let fs_uuid = match m.tree.get(&filesystem) {
+            Some(op) => typed_uuid!(
+                get_data!(op; default_return; return_message).uuid;
+                Fs;
+                default_return;
+                return_message
+            ),
+            None => {
+                let message = format!("no data for object path {}", filesystem);
+                let (rc, rs) = (DbusErrorEnum::ERROR as u16, message);
+                return Ok(vec![return_message.append3(default_return, rc, rs)]);
+            }
+        };
+        specs.push((fs_uuid, snapshot_name));
+    }
+
+    let read_lock = dbus_context.engine.blocking_read();
+    let (pool_name, mut pool) = lock_pool!(read_lock; pool_uuid; default_return; return_message);
+
+    let infos = match log_action!(pool.snapshot_filesystems(&pool_name, pool_uuid, &specs)) {
+        Ok(created_set) => created_set.changed(),
+        Err(err) => {
+            let (rc, rs) = engine_to_dbus_err_tuple(&err);
+            return Ok(vec![return_message.append3(default_return, rc, rs)]);
+        }
+    };
+
+    let return_value = match infos {
+        Some(ref snapshots) => {
+            let v = snapshots
+                .iter()
+                .map(|&(name, uuid)| {
+                    let filesystem = pool
+                        .get_filesystem(uuid)
+                        .expect("just inserted by snapshot_filesystems")
+                        .1;
+                    (
+                        create_dbus_filesystem(
+                            dbus_context,
+                            object_path.clone(),
+                            &pool_name,
+                            &Name::new(name.to_string()),
+                            uuid,
+                            filesystem,
+                        ),
+                        name,
+                    )
+                })
+                .collect::<Vec<_>>();
+            (true, v)
+        }
+        None => default_return,
+    };
+
+    Ok(vec![return_message.append3(
+        return_value,
+        DbusErrorEnum::OK as u16,
+        OK_STRING.to_string(),
+    )])
+}
+
+pub fn init_cache_with_settings(m: &MethodInfo<MTSync<TData>, TData>) -> MethodResult {
+    let message: &Message = m.msg;
+    let mut iter = message.iter_init();
+
+    let _: Array<&str, _> = get_next_arg(&mut iter, 0)?;
+    let block_size: (bool, u64) = get_next_arg(&mut iter, 1)?;
+    let migration_threshold: (bool, u64) = get_next_arg(&mut iter, 2)?;
+    let policy: (bool, &str) = get_next_arg(&mut iter, 3)?;
+    let mode: (bool, &str) = get_next_arg(&mut iter, 4)?;
+
+    if let Err(err) =
+        CacheSettings::check_policy_and_mode(tuple_to_option(policy), tuple_to_option(mode))
+    {
+        let (rc, rs) = engine_to_dbus_err_tuple(&err);
+        return Ok(vec![message.method_return().append3(
+            (false, Vec::<dbus::Path>::new()),
+            rc,
+            rs,
+        )]);
+    }
+
+    let default_settings = CacheSettings::default();
+    let settings = CacheSettings {
+        block_size: tuple_to_option(block_size)
+            .map(|bytes| Bytes::from(bytes).sectors())
+            .unwrap_or(default_settings.block_size),
+        migration_threshold: tuple_to_option(migration_threshold)
+            .map(|bytes| Bytes::from(bytes).sectors()),
+    };
+    add_blockdevs(m, BlockDevOp::InitCache(settings))
+}
+
+pub fn set_cache_migration_threshold(m: &MethodInfo<MTSync<TData>, TData>) -> MethodResult {
+    let message: &Message = m.msg;
+    let mut iter = message.iter_init();
+
+    let threshold: u64 = get_next_arg(&mut iter, 0)?;
+
+    let dbus_context = m.tree.get_data();
+    let object_path = m.path.get_name();
+    let return_message = message.method_return();
+    let default_return = (false, String::new());
+
+    let pool_path = m
+        .tree
+        .get(object_path)
+        .expect("implicit argument must be in tree");
+    let pool_uuid = typed_uuid!(
+        get_data!(pool_path; default_return; return_message).uuid;
+        Pool;
+        default_return;
+        return_message
+    );
+
+    let read_lock = dbus_context.engine.blocking_read();
+    let (pool_name, mut pool) = lock_pool!(read_lock; pool_uuid; default_return; return_message);
+
+    let msg = match log_action!(
+        pool.set_cache_migration_threshold(&pool_name, Bytes::from(threshold).sectors())
+    ) {
+        Ok(PropChangeAction::Identity) => return_message.append3(
+            default_return,
+            DbusErrorEnum::OK as u16,
+            OK_STRING.to_string(),
+        ),
+        Ok(PropChangeAction::NewValue(threshold)) => return_message.append3(
+            (true, (*threshold.bytes()).to_string()),
+            DbusErrorEnum::OK as u16,
+            OK_STRING.to_string(),
+        ),
+        Err(err) => {
+            let (rc, rs) = engine_to_dbus_err_tuple(&err);
+            return_message.append3(default_return, rc, rs)
+        }
+    };
+
+    Ok(vec![msg])
+}
+
+pub fn set_alloc_policy(m: &MethodInfo<MTSync<TData>, TData>) -> MethodResult {
+    let message: &Message = m.msg;
+    let mut iter = message.iter_init();
+
+    let policy: &str = get_next_arg(&mut iter, 0)?;
+
+    let dbus_context = m.tree.get_data();
+    let object_path = m.path.get_name();
+    let return_message = message.method_return();
+    let default_return = (false, String::new());
+
+    let policy = match AllocPolicy::try_from(policy) {
+        Ok(policy) => policy,
+        Err(err) => {
+            let (rc, rs) = engine_to_dbus_err_tuple(&err);
+            return Ok(vec![return_message.append3(default_return, rc, rs)]);
+        }
+    };
+
+    let pool_path = m
+        .tree
+        .get(object_path)
+        .expect("implicit argument must be in tree");
+    let pool_uuid = typed_uuid!(
+        get_data!(pool_path; default_return; return_message).uuid;
+        Pool;
+        default_return;
+        return_message
+    );
+
+    let read_lock = dbus_context.engine.blocking_read();
+    let (pool_name, mut pool) = lock_pool!(read_lock; pool_uuid; default_return; return_message);
+
+    let msg = match log_action!(pool.set_alloc_policy(&pool_name, policy)) {
+        Ok(PropChangeAction::Identity) => return_message.append3(
+            default_return,
+            DbusErrorEnum::OK as u16,
+            OK_STRING.to_string(),
+        ),
+        Ok(PropChangeAction::NewValue(policy)) => return_message.append3(
+            (true, policy.to_string()),
+            DbusErrorEnum::OK as u16,
+            OK_STRING.to_string(),
+        ),
+        Err(err) => {
+            let (rc, rs) = engine_to_dbus_err_tuple(&err);
+            return_message.append3(default_return, rc, rs)
+        }
+    };
+
+    Ok(vec![msg])
+}
@@ -0,0 +1,7 @@
+mod api;
+mod methods;
+
+pub use api::{
+    create_filesystems_method, init_cache_with_settings_method, set_alloc_policy_method,
+    set_cache_migration_threshold_method, snapshot_filesystems_method,
+};
@@ -2,7 +2,7 @@
 // License, v. 2.0. If a copy of the MPL was not distributed with this
 // file, You can obtain one at http://mozilla.org/MPL/2.0/.
 
-use std::path::Path;
+use std::{collections::HashMap, path::Path};
 
 use dbus::{
     arg::{Array, IterAppend},
@@ -10,17 +10,20 @@ use dbus::{
 };
 use dbus_tree::{MTSync, MethodErr, MethodInfo, MethodResult, PropInfo, Tree};
 
+use devicemapper::Sectors;
+
 use crate::{
     dbus_api::{
         blockdev::create_dbus_blockdev,
+        filesystem::create_dbus_filesystem,
         types::{DbusErrorEnum, TData, OK_STRING},
         util::{engine_to_dbus_err_tuple, get_next_arg, option_to_tuple},
     },
-    engine::{BlockDevTier, EngineAction, Name, Pool, PoolUuid},
+    engine::{BlockDevTier, CacheSettings, EngineAction, Name, Pool, PoolUuid},
 };
 
 pub enum BlockDevOp {
-    InitCache,
+    InitCache(CacheSettings),
     AddCache,
     AddData,
 }
@@ -49,18 +52,19 @@ where
         Pool
     );
 
-    let mutex_lock = dbus_context.engine.blocking_lock();
-    let (pool_name, pool) = mutex_lock
+    let read_lock = dbus_context.engine.blocking_read();
+    let (pool_name, pool) = read_lock
         .get_pool(pool_uuid)
         .ok_or_else(|| format!("no pool corresponding to uuid {}", &pool_uuid))?;
 
-    closure((pool_name, pool_uuid, pool))
+    closure((pool_name, pool_uuid, &*pool))
 }
 
 pub fn get_pool_encryption_key_desc(
-    m: &MethodInfo<MTSync<TData>, TData>,
+    tree: &Tree<MTSync<TData>, TData>,
+    object_path: &dbus::Path<'static>,
 ) -> Result<(bool, String), String> {
-    pool_operation(m.tree, m.path.get_name(), |(_, _, pool)| {
+    pool_operation(tree, object_path, |(_, _, pool)| {
         Ok(option_to_tuple(
             pool.encryption_info()
                 .key_description
@@ -71,30 +75,51 @@ pub fn get_pool_encryption_key_desc(
     })
 }
 
-pub fn get_pool_has_cache(m: &MethodInfo<MTSync<TData>, TData>) -> Result<bool, String> {
-    pool_operation(m.tree, m.path.get_name(), |(_, _, pool)| {
-        Ok(pool.has_cache())
-    })
+pub fn get_pool_has_cache(
+    tree: &Tree<MTSync<TData>, TData>,
+    object_path: &dbus::Path<'static>,
+) -> Result<bool, String> {
+    pool_operation(tree, object_path, |(_, _, pool)| Ok(pool.has_cache()))
 }
 
-pub fn get_pool_total_size(m: &MethodInfo<MTSync<TData>, TData>) -> Result<String, String> {
-    pool_operation(m.tree, m.path.get_name(), |(_, _, pool)| {
+pub fn get_pool_total_size(
+    tree: &Tree<MTSync<TData>, TData>,
+    object_path: &dbus::Path<'static>,
+) -> Result<String, String> {
+    pool_operation(tree, object_path, |(_, _, pool)| {
         Ok((*pool.total_physical_size().bytes()).to_string())
     })
 }
 
-pub fn get_pool_total_used(m: &MethodInfo<MTSync<TData>, TData>) -> Result<String, String> {
-    pool_operation(m.tree, m.path.get_name(), |(_, _, pool)| {
+pub fn get_pool_total_used(
+    tree: &Tree<MTSync<TData>, TData>,
+    object_path: &dbus::Path<'static>,
+) -> Result<String, String> {
+    pool_operation(tree, object_path, |(_, _, pool)| {
         pool.total_physical_used()
             .map_err(|e| e.to_string())
             .map(|size| (*size.bytes()).to_string())
     })
 }
 
+pub fn get_pool_total_used_age(
+    tree: &Tree<MTSync<TData>, TData>,
+    object_path: &dbus::Path<'static>,
+) -> Result<(bool, String), String> {
+    pool_operation(tree, object_path, |(_, _, pool)| {
+        Ok(option_to_tuple(
+            pool.total_physical_used_age()
+                .map(|age| age.as_secs().to_string()),
+            String::new(),
+        ))
+    })
+}
+
 pub fn get_pool_clevis_info(
-    m: &MethodInfo<MTSync<TData>, TData>,
+    tree: &Tree<MTSync<TData>, TData>,
+    object_path: &dbus::Path<'static>,
 ) -> Result<(bool, (String, String)), String> {
-    pool_operation(m.tree, m.path.get_name(), |(_, _, pool)| {
+    pool_operation(tree, object_path, |(_, _, pool)| {
         Ok(option_to_tuple(
             pool.encryption_info()
                 .clevis_info
@@ -105,12 +130,171 @@ pub fn get_pool_clevis_info(
     })
 }
 
+pub fn get_pool_cache_block_size(
+    tree: &Tree<MTSync<TData>, TData>,
+    object_path: &dbus::Path<'static>,
+) -> Result<(bool, String), String> {
+    pool_operation(tree, object_path, |(_, _, pool)| {
+        Ok(option_to_tuple(
+            pool.cache_settings()
+                .map(|settings| (*settings.block_size.bytes()).to_string()),
+            String::new(),
+        ))
+    })
+}
+
+pub fn get_pool_cache_migration_threshold(
+    tree: &Tree<MTSync<TData>, TData>,
+    object_path: &dbus::Path<'static>,
+) -> Result<(bool, String), String> {
+    pool_operation(tree, object_path, |(_, _, pool)| {
+        Ok(option_to_tuple(
+            pool.cache_settings()
+                .and_then(|settings| settings.migration_threshold)
+                .map(|threshold| (*threshold.bytes()).to_string()),
+            String::new(),
+        ))
+    })
+}
+
+pub fn get_pool_alloc_policy(
+    tree: &Tree<MTSync<TData>, TData>,
+    object_path: &dbus::Path<'static>,
+) -> Result<String, String> {
+    pool_operation(tree, object_path, |(_, _, pool)| {
+        Ok(pool.alloc_policy().to_string())
+    })
+}
+
+pub fn get_pool_cache_stats(
+    tree: &Tree<MTSync<TData>, TData>,
+    object_path: &dbus::Path<'static>,
+) -> Result<(bool, HashMap<String, String>), String> {
+    pool_operation(tree, object_path, |(_, _, pool)| {
+        pool.cache_stats().map_err(|e| e.to_string()).map(|stats| {
+            option_to_tuple(
+                stats.map(|stats| {
+                    let mut map = HashMap::new();
+                    for (key, value) in &[
+                        ("read_hits", stats.read_hits),
+                        ("read_misses", stats.read_misses),
+                        ("write_hits", stats.write_hits),
+                        ("write_misses", stats.write_misses),
+                        ("promotions", stats.promotions),
+                        ("demotions", stats.demotions),
+                        ("dirty", stats.dirty),
+                        ("used_blocks", stats.used_blocks),
+                        ("total_blocks", stats.total_blocks),
+                    ] {
+                        map.insert((*key).to_string(), value.to_string());
+                    }
+                    map.insert("policy".to_string(), stats.policy);
+                    map.insert("write_mode".to_string(), stats.write_mode);
+                    map
+                }),
+                HashMap::new(),
+            )
+        })
+    })
+}
+
 /// A method shared by all pool interfaces and by all blockdev-adding
 /// operations, including cache initialization, which is considered a
 /// blockdev-adding operation because when a cache is initialized, the
 /// data tier must already contain some block devices. The op parameter
 /// determines which method belonging to the engine's Pool interface must
 /// be invoked.
+/// Create the filesystems named in the request. If one_per_request is true,
+/// a request for more than one filesystem is refused.
+pub fn create_filesystems_shared(
+    m: &MethodInfo<MTSync<TData>, TData>,
+    one_per_request: bool,
+) -> MethodResult {
+    let message: &Message = m.msg;
+    let mut iter = message.iter_init();
+
+    let filesystems: Array<&str, _> = get_next_arg(&mut iter, 0)?;
+    let filesystems = filesystems.collect::<Vec<_>>();
+    let dbus_context = m.tree.get_data();
+
+    let object_path = m.path.get_name();
+    let return_message = message.method_return();
+    let default_return: (bool, Vec<(dbus::Path, &str)>) = (false, Vec::new());
+
+    if one_per_request && filesystems.len() > 1 {
+        let error_message = "only 1 filesystem per request allowed";
+        let (rc, rs) = (DbusErrorEnum::ERROR as u16, error_message);
+        return Ok(vec![return_message.append3(default_return, rc, rs)]);
+    }
+
+    let pool_path = m
+        .tree
+        .get(object_path)
+        .expect("implicit argument must be in tree");
+    let pool_uuid = typed_uuid!(
+        get_data!(pool_path; default_return; return_message).uuid;
+        Pool;
+        default_return;
+        return_message
+    );
+
+    let read_lock = dbus_context.engine.blocking_read();
+    let (pool_name, mut pool) = lock_pool!(read_lock; pool_uuid; default_return; return_message);
+
+    let result = log_action!(pool.create_filesystems(
+        &pool_name,
+        pool_uuid,
+        &filesystems
+            .iter()
+            .map(|x| (*x, None))
+            .collect::<Vec<(&str, Option<Sectors>)>>(),
+    ));
+
+    let infos = match result {
+        Ok(created_set) => created_set.changed(),
+        Err(err) => {
+            let (rc, rs) = engine_to_dbus_err_tuple(&err);
+            return Ok(vec![return_message.append3(default_return, rc, rs)]);
+        }
+    };
+
+    let return_value = match infos {
+        Some(ref newly_created_filesystems) => {
+            let v = newly_created_filesystems
+                .iter()
+                .map(|&(name, uuid)| {
+                    let filesystem = pool
+                        .get_filesystem(uuid)
+                        .expect("just inserted by create_filesystems")
+                        .1;
+                    // FIXME: To avoid this expect, modify create_filesystem
+                    // so that it returns a mutable reference to the
+                    // filesystem created.
+                    (
+                        create_dbus_filesystem(
+                            dbus_context,
+                            object_path.clone(),
+                            &pool_name,
+                            &Name::new(name.to_string()),
+                            uuid,
+                            filesystem,
+                        ),
+                        name,
+                    )
+                })
+                .collect::<Vec<_>>();
+            (true, v)
+        }
+        None => default_return,
+    };
+
+    Ok(vec![return_message.append3(
+        return_value,
+        DbusErrorEnum::OK as u16,
+        OK_STRING.to_string(),
+    )])
+}
+
 pub fn add_blockdevs(m: &MethodInfo<MTSync<TData>, TData>, op: BlockDevOp) -> MethodResult {
     let message: &Message = m.msg;
     let mut iter = message.iter_init();
@@ -133,13 +317,15 @@ pub fn add_blockdevs(m: &MethodInfo<MTSync<TData>, TData>, op: BlockDevOp) -> Me
         return_message
     );
 
-    let mut mutex_lock = dbus_context.engine.blocking_lock();
-    let (pool_name, pool) = get_mut_pool!(mutex_lock; pool_uuid; default_return; return_message);
+    let read_lock = dbus_context.engine.blocking_read();
+    let (pool_name, mut pool) = lock_pool!(read_lock; pool_uuid; default_return; return_message);
 
     let blockdevs = devs.map(|x| Path::new(x)).collect::<Vec<&Path>>();
 
     let result = match op {
-        BlockDevOp::InitCache => log_action!(pool.init_cache(pool_uuid, &*pool_name, &blockdevs)),
+        BlockDevOp::InitCache(settings) => {
+            log_action!(pool.init_cache(pool_uuid, &*pool_name, &blockdevs, settings))
+        }
         BlockDevOp::AddCache => {
             log_action!(pool.add_blockdevs(pool_uuid, &*pool_name, &blockdevs, BlockDevTier::Cache))
         }
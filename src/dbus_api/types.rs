@@ -20,10 +20,15 @@ use dbus::{
 use dbus_tree::{DataType, MTSync, ObjectPath, Tree};
 use tokio::sync::{mpsc::UnboundedSender as TokioSender, RwLock};
 
-use crate::engine::{Lockable, LockableEngine, StratisUuid};
+use crate::{
+    dbus_api::dispatch::DispatchStats,
+    engine::{Lockable, LockableEngine, StratisUuid},
+};
 
-/// Type for lockable D-Bus tree object.
-pub type LockableTree = Lockable<Arc<RwLock<Tree<MTSync<TData>, TData>>>>;
+/// Type for lockable D-Bus tree object. Method calls are served from a
+/// reference to the tree taken under the read lock, which is released
+/// before the method runs; changes replace the tree if it is still in use.
+pub type LockableTree = Lockable<Arc<RwLock<Arc<Tree<MTSync<TData>, TData>>>>>;
 
 /// Type for return value of `GetManagedObjects`.
 pub type GetManagedObjects =
@@ -77,6 +82,7 @@ pub struct DbusContext {
     pub(super) engine: LockableEngine,
     pub(super) sender: TokioSender<DbusAction>,
     connection: Arc<SyncConnection>,
+    pub(super) dispatch_stats: Arc<DispatchStats>,
 }
 
 impl Debug for DbusContext {
@@ -100,6 +106,7 @@ impl DbusContext {
             next_index: Arc::new(AtomicU64::new(0)),
             sender,
             connection,
+            dispatch_stats: Arc::new(DispatchStats::default()),
         }
     }
 
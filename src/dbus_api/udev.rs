@@ -14,14 +14,14 @@ use crate::{
 };
 
 pub struct DbusUdevHandler {
-    pub(super) receiver: UnboundedReceiver<UdevEngineEvent>,
+    pub(super) receiver: UnboundedReceiver<Vec<UdevEngineEvent>>,
     pub(super) path: dbus::Path<'static>,
     pub(super) dbus_context: DbusContext,
 }
 
 impl DbusUdevHandler {
     pub fn new(
-        receiver: UnboundedReceiver<UdevEngineEvent>,
+        receiver: UnboundedReceiver<Vec<UdevEngineEvent>>,
         path: dbus::Path<'static>,
         dbus_context: DbusContext,
     ) -> Self {
@@ -32,15 +32,13 @@ impl DbusUdevHandler {
         }
     }
 
-    /// Process udev events that were detected on the udev socket.
+    /// Process a batch of udev events that were detected on the udev socket.
     pub async fn handle_udev_event(&mut self) -> StratisResult<()> {
-        let udev_event = self.receiver.recv().await.ok_or_else(|| {
+        let udev_events = self.receiver.recv().await.ok_or_else(|| {
             StratisError::Msg("Channel from udev handler to D-Bus handler was shut".to_string())
         })?;
-        let mut mutex_lock = self.dbus_context.engine.lock().await;
-        let optional_pool_info = mutex_lock.handle_event(&udev_event);
-
-        if let Some((pool_name, pool_uuid, pool)) = optional_pool_info {
+        let mut write_lock = self.dbus_context.engine.write().await;
+        for (pool_name, pool_uuid, pool) in write_lock.handle_events(&udev_events) {
             self.register_pool(&pool_name, pool_uuid, pool)
         }
 
@@ -24,7 +24,7 @@ use crate::{
         types::{DbusContext, DbusErrorEnum, InterfacesAdded, InterfacesAddedThreadSafe, TData},
         udev::DbusUdevHandler,
     },
-    engine::{Lockable, LockableEngine, UdevEngineEvent},
+    engine::{Lockable, LockableEngine, UdevEngineEvent, DBUS_TREE_LOCK},
     stratis::StratisError,
 };
 
@@ -139,7 +139,7 @@ pub fn get_parent(i: &mut IterAppend, p: &PropInfo<MTSync<TData>, TData>) -> Res
 /// * sent by the DbusContext to the DbusTreeHandler
 pub fn create_dbus_handlers(
     engine: LockableEngine,
-    udev_receiver: UnboundedReceiver<UdevEngineEvent>,
+    udev_receiver: UnboundedReceiver<Vec<UdevEngineEvent>>,
     trigger: Sender<()>,
 ) -> Result<(DbusConnectionHandler, DbusUdevHandler, DbusTreeHandler), dbus::Error> {
     let conn = Arc::new(SyncConnection::new_system()?);
@@ -148,9 +148,13 @@ pub fn create_dbus_handlers(
     let dbus_context = tree.get_data().clone();
     conn.request_name(consts::STRATIS_BASE_SERVICE, false, true, true)?;
 
-    let tree = Lockable::new_shared(tree);
-    let connection =
-        DbusConnectionHandler::new(Arc::clone(&conn), tree.clone(), trigger.subscribe());
+    let tree = Lockable::new_shared(&DBUS_TREE_LOCK, Arc::new(tree));
+    let connection = DbusConnectionHandler::new(
+        Arc::clone(&conn),
+        tree.clone(),
+        trigger.subscribe(),
+        Arc::clone(&dbus_context.dispatch_stats),
+    );
     let udev = DbusUdevHandler::new(udev_receiver, object_path, dbus_context);
     let tree = DbusTreeHandler::new(tree, receiver, conn, trigger.subscribe());
     Ok((connection, udev, tree))
@@ -0,0 +1,48 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+// Reporting for the benchmarks, the ignored tests whose names begin with
+// "bench_". They are run with "make bench", or with "make bench-loop" for
+// those that require loopbacked devices.
+
+use std::{cmp::max, convert::TryFrom, env, fs::OpenOptions, io::Write, time::Duration};
+
+use crate::stratis::VERSION;
+
+/// The environment variable which, if set, names a file to which every
+/// measurement is appended.
+const BENCH_OUTPUT_ENV: &str = "STRATIS_BENCH_OUTPUT";
+
+fn nanos(duration: Duration) -> u64 {
+    u64::try_from(duration.as_nanos()).unwrap_or(std::u64::MAX)
+}
+
+/// Report that ops operations of the benchmark name, on an object of the
+/// given size, e.g., the number of free ranges in an allocator or of
+/// filesystems in a pool, took elapsed time.
+///
+/// Each measurement is printed as a single line of JSON, which records the
+/// version of stratisd measured, so that the results of different releases
+/// can be collected and compared mechanically.
+pub fn report(name: &str, size: u64, ops: u64, elapsed: Duration) {
+    let line = json!({
+        "name": name,
+        "version": VERSION,
+        "size": size,
+        "ops": ops,
+        "elapsed_ns": nanos(elapsed),
+        "ns_per_op": nanos(elapsed) / max(ops, 1),
+    })
+    .to_string();
+    println!("{}", line);
+
+    if let Ok(path) = env::var(BENCH_OUTPUT_ENV) {
+        OpenOptions::new()
+            .create(true)
+            .append(true)
+            .open(&path)
+            .and_then(|mut f| writeln!(f, "{}", line))
+            .unwrap_or_else(|e| panic!("Failed to append to {}: {}", path, e));
+    }
+}
@@ -8,6 +8,7 @@ use std::{
     fmt::Debug,
     os::unix::io::RawFd,
     path::{Path, PathBuf},
+    time::Duration,
 };
 
 use chrono::{DateTime, Utc};
@@ -17,10 +18,11 @@ use devicemapper::{Bytes, Sectors};
 
 use crate::{
     engine::types::{
-        BlockDevTier, Clevis, CreateAction, DeleteAction, DevUuid, EncryptionInfo, FilesystemUuid,
-        Key, KeyDescription, LockedPoolInfo, MappingCreateAction, MappingDeleteAction, Name,
-        PoolUuid, RegenAction, RenameAction, ReportType, SetCreateAction, SetDeleteAction,
-        SetUnlockAction, UdevEngineEvent, UnlockMethod,
+        AllocPolicy, BlockDevTier, CacheSettings, CacheStats, Clevis, CreateAction, DeleteAction,
+        DevUuid, EncryptionInfo, FilesystemUuid, FsGrowthPolicy, Key, KeyDescription,
+        LockedPoolInfo, MappingCreateAction, MappingDeleteAction, Name, PoolGuard, PoolMutGuard,
+        PoolUuid, PropChangeAction, RegenAction, RenameAction, ReportType, SetCreateAction,
+        SetDeleteAction, SetUnlockAction, UdevEngineEvent, UnlockMethod, UsageReadings,
     },
     stratis::StratisResult,
 };
@@ -63,6 +65,14 @@ pub trait Report {
     /// NOTE: The JSON schema for this report is not guaranteed to be stable.
     fn engine_state_report(&self) -> Value;
 
+    /// The supported engine state report, serialized as JSON. This is
+    /// equivalent to serializing the value returned by engine_state_report(),
+    /// but an engine may write it directly from its own data structures,
+    /// which is much quicker for a large engine.
+    fn engine_state_report_json(&self) -> StratisResult<String> {
+        Ok(serde_json::to_string(&self.engine_state_report())?)
+    }
+
     /// Unsupported reports. The available reports and JSON schemas of these reports may change.
     fn get_report(&self, report_type: ReportType) -> Value;
 }
@@ -79,6 +89,14 @@ pub trait Filesystem: Debug {
 
     /// The amount of data stored on the filesystem, including overhead.
     fn used(&self) -> StratisResult<Bytes>;
+
+    /// The time since the value returned by used() was read from the
+    /// device. None if used() reads the device on every call.
+    fn used_age(&self) -> Option<Duration>;
+
+    /// The policy by which the filesystem is grown when it runs low on
+    /// free space.
+    fn growth_policy(&self) -> FsGrowthPolicy;
 }
 
 pub trait BlockDev: Debug {
@@ -120,15 +138,47 @@ pub trait Pool: Debug {
     /// can only be initialized once and if an attempt is made to initialize it
     /// twice with different sets of block devices, the user should be notified
     /// of their error.
+    ///
+    /// The cache is set up with the given settings. They are ignored if the
+    /// cache has already been initialized.
     fn init_cache(
         &mut self,
         pool_uuid: PoolUuid,
         pool_name: &str,
         blockdevs: &[&Path],
+        settings: CacheSettings,
     ) -> StratisResult<SetCreateAction<DevUuid>>;
 
+    /// The settings of the cache, or None if the pool has no cache.
+    fn cache_settings(&self) -> Option<CacheSettings>;
+
+    /// Set the migration threshold of the cache while it is in use.
+    /// Returns an error if the pool has no cache.
+    fn set_cache_migration_threshold(
+        &mut self,
+        pool_name: &str,
+        threshold: Sectors,
+    ) -> StratisResult<PropChangeAction<Sectors>>;
+
+    /// The statistics reported by the cache, or None if the pool has no
+    /// cache.
+    fn cache_stats(&self) -> StratisResult<Option<CacheStats>>;
+
+    /// The policy by which space is allocated from the block devices of the
+    /// data tier.
+    fn alloc_policy(&self) -> AllocPolicy;
+
+    /// Set the policy by which space is allocated from the block devices of
+    /// the data tier. The policy applies only to subsequent allocations.
+    fn set_alloc_policy(
+        &mut self,
+        pool_name: &str,
+        policy: AllocPolicy,
+    ) -> StratisResult<PropChangeAction<AllocPolicy>>;
+
     /// Creates the filesystems specified by specs.
-    /// Returns a list of the names of filesystems actually created.
+    /// Returns a list of the names of filesystems actually created, in the
+    /// order of specs.
     /// Returns an error if any of the specified names are already in use
     /// for filesystems in this pool. If the same name is passed multiple
     /// times, the size associated with the last item is used.
@@ -200,6 +250,16 @@ pub trait Pool: Debug {
         new_name: &str,
     ) -> StratisResult<RenameAction<FilesystemUuid>>;
 
+    /// Set the policy by which the filesystem with the given UUID is grown
+    /// when it runs low on free space.
+    /// Returns an error if there is no filesystem with the given UUID.
+    fn set_fs_growth_policy(
+        &mut self,
+        pool_name: &str,
+        uuid: FilesystemUuid,
+        policy: FsGrowthPolicy,
+    ) -> StratisResult<PropChangeAction<FsGrowthPolicy>>;
+
     /// Snapshot filesystem
     /// Create a CoW snapshot of the origin
     fn snapshot_filesystem(
@@ -210,6 +270,18 @@ pub trait Pool: Debug {
         snapshot_name: &str,
     ) -> StratisResult<CreateAction<(FilesystemUuid, &mut dyn Filesystem)>>;
 
+    /// Snapshot filesystems
+    /// Create CoW snapshots of several origins at once. Each spec pairs the
+    /// UUID of an origin with the name of its snapshot. Snapshots whose names
+    /// are already in use are not created. Either all the remaining snapshots
+    /// are created or none are.
+    fn snapshot_filesystems<'a, 'b>(
+        &'a mut self,
+        pool_name: &str,
+        pool_uuid: PoolUuid,
+        specs: &[(FilesystemUuid, &'b str)],
+    ) -> StratisResult<SetCreateAction<(&'b str, FilesystemUuid)>>;
+
     /// The total number of Sectors belonging to this pool.
     /// There are no exclusions, so this number includes overhead sectors
     /// of all sorts, sectors allocated for every sort of metadata by
@@ -224,6 +296,10 @@ pub trait Pool: Debug {
     /// store user data.
     fn total_physical_used(&self) -> StratisResult<Sectors>;
 
+    /// The time since the value returned by total_physical_used() was read
+    /// from the device. None if it has never been read.
+    fn total_physical_used_age(&self) -> Option<Duration>;
+
     /// Get all the filesystems belonging to this pool.
     fn filesystems(&self) -> Vec<(Name, FilesystemUuid, &dyn Filesystem)>;
 
@@ -259,7 +335,7 @@ pub trait Pool: Debug {
     fn encryption_info(&self) -> Cow<EncryptionInfo>;
 }
 
-pub trait Engine: Debug + Report + Send {
+pub trait Engine: Debug + Report + Send + Sync {
     /// Create a Stratis pool.
     /// Returns the UUID of the newly created pool.
     /// Returns an error if the redundancy code does not correspond to a
@@ -272,12 +348,13 @@ pub trait Engine: Debug + Report + Send {
         encryption_info: &EncryptionInfo,
     ) -> StratisResult<CreateAction<PoolUuid>>;
 
-    /// Handle a libudev event.
-    /// If the handling action resulted in pool creation, return the pool
-    /// and its UUID.
+    /// Handle a batch of libudev events.
+    /// All the events are applied before any pool is set up, so that each
+    /// pool affected by the batch is evaluated at most once.
+    /// Return the name, UUID and pool of each pool that was created.
     ///
-    /// Precondition: the subsystem of the device evented on is "block".
-    fn handle_event(&mut self, event: &UdevEngineEvent) -> Option<(Name, PoolUuid, &dyn Pool)>;
+    /// Precondition: the subsystem of the devices evented on is "block".
+    fn handle_events(&mut self, events: &[UdevEngineEvent]) -> Vec<(Name, PoolUuid, &dyn Pool)>;
 
     /// Destroy a pool.
     /// Ensures that the pool of the given UUID is absent on completion.
@@ -306,8 +383,16 @@ pub trait Engine: Debug + Report + Send {
         unlock_method: UnlockMethod,
     ) -> StratisResult<SetUnlockAction<DevUuid>>;
 
-    /// Find the pool designated by uuid.
-    fn get_pool(&self, uuid: PoolUuid) -> Option<(Name, &dyn Pool)>;
+    /// Find the pool designated by uuid, locked for reading.
+    fn get_pool(&self, uuid: PoolUuid) -> Option<(Name, PoolGuard<'_>)>;
+
+    /// Find the pool designated by uuid, locked for writing. The engine
+    /// need only be locked for reading, so that operations on other pools
+    /// may proceed while the pool is changed.
+    fn lock_pool(&self, uuid: PoolUuid) -> Option<(Name, PoolMutGuard<'_>)>;
+
+    /// Find the pool named name, locked for writing, as by lock_pool().
+    fn lock_pool_by_name(&self, name: &str) -> Option<(PoolUuid, PoolMutGuard<'_>)>;
 
     /// Get a mutable referent to the pool designated by uuid.
     fn get_mut_pool(&mut self, uuid: PoolUuid) -> Option<(Name, &mut dyn Pool)>;
@@ -316,14 +401,38 @@ pub trait Engine: Debug + Report + Send {
     /// been set up and need to be unlocked to their encryption infos.
     fn locked_pools(&self) -> HashMap<PoolUuid, LockedPoolInfo>;
 
-    /// Get all pools belonging to this engine.
-    fn pools(&self) -> Vec<(Name, PoolUuid, &dyn Pool)>;
+    /// Get all pools belonging to this engine, each locked for reading.
+    fn pools(&self) -> Vec<(Name, PoolUuid, PoolGuard<'_>)>;
 
     /// Get mutable references to all pools belonging to this engine.
     fn pools_mut(&mut self) -> Vec<(Name, PoolUuid, &mut dyn Pool)>;
 
     /// Notify the engine that an event has occurred on the DM file descriptor.
-    fn evented(&mut self) -> StratisResult<()>;
+    /// Each pool is locked only for reading, so the engine need only be
+    /// locked for reading.
+    fn evented(&self) -> StratisResult<()>;
+
+    /// Run those checks scheduled on pools by evented() which are now due.
+    /// Returns the time until the next scheduled check becomes due, or None
+    /// if no check remains scheduled. Each pool is locked for writing only
+    /// while its own check runs, so the engine need only be locked for
+    /// reading.
+    fn run_scheduled_checks(&self) -> Option<Duration>;
+
+    /// Returns the time until the next scheduled check becomes due, or None
+    /// if no check is scheduled. A check that is already due yields a zero
+    /// duration.
+    fn next_check_due(&self) -> Option<Duration>;
+
+    /// Read the status of the devices of every pool and filesystem belonging
+    /// to this engine. This changes nothing, so that it may be done while
+    /// the engine is shared with readers.
+    fn read_usage(&self) -> UsageReadings;
+
+    /// Update the cached usage of every pool and filesystem belonging to
+    /// this engine from readings obtained by read_usage(). Readings for pools
+    /// and filesystems which no longer exist are ignored.
+    fn set_usage(&mut self, readings: UsageReadings);
 
     /// Get the handler for kernel keyring operations.
     fn get_key_handler(&self) -> &dyn KeyActions;
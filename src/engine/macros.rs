@@ -18,7 +18,23 @@ macro_rules! get_pool {
     ($s:ident; $uuid:ident) => {
         $s.pools
             .get_by_uuid($uuid)
-            .map(|(name, p)| (name.clone(), p as &dyn $crate::engine::Pool))
+            .map(|(name, p)| (name.clone(), $crate::engine::structures::read_pool(p)))
+    };
+}
+
+macro_rules! lock_pool {
+    ($s:ident; $uuid:ident) => {
+        $s.pools
+            .get_by_uuid($uuid)
+            .map(|(name, p)| (name.clone(), $crate::engine::structures::write_pool(p)))
+    };
+}
+
+macro_rules! lock_pool_by_name {
+    ($s:ident; $name:ident) => {
+        $s.pools
+            .get_by_name($name)
+            .map(|(uuid, p)| (uuid, $crate::engine::structures::write_pool(p)))
     };
 }
 
@@ -26,7 +42,7 @@ macro_rules! get_mut_pool {
     ($s:ident; $uuid:ident) => {
         $s.pools
             .get_mut_by_uuid($uuid)
-            .map(|(name, p)| (name.clone(), p as &mut dyn $crate::engine::Pool))
+            .map(|(name, p)| (name.clone(), p.get_mut() as &mut dyn $crate::engine::Pool))
     };
 }
 
@@ -0,0 +1,554 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+// Counters and latency histograms of the operations of the daemon, kept for
+// the lifetime of the process and rendered in the Prometheus text
+// exposition format.
+
+use std::{
+    collections::BTreeMap,
+    convert::TryFrom,
+    fmt::{self, Write},
+    sync::{
+        atomic::{AtomicU64, Ordering},
+        Mutex,
+    },
+    time::{Duration, Instant},
+};
+
+use serde_json::Value;
+
+// The upper bounds, in microseconds, of the buckets of a latency histogram.
+// Latencies above the last bound are counted in a final, unbounded bucket.
+const LATENCY_BUCKET_BOUNDS_US: [u64; 10] = [
+    100, 500, 1_000, 5_000, 10_000, 50_000, 100_000, 500_000, 1_000_000, 5_000_000,
+];
+
+/// A histogram of latencies.
+#[derive(Debug, Default)]
+pub struct LatencyHistogram {
+    buckets: [u64; LATENCY_BUCKET_BOUNDS_US.len() + 1],
+    count: u64,
+    total: Duration,
+    max: Duration,
+}
+
+// The index of the bucket of a latency histogram which counts latency.
+fn bucket_index(latency: Duration) -> usize {
+    let micros = latency.as_micros();
+    LATENCY_BUCKET_BOUNDS_US
+        .iter()
+        .position(|bound| micros <= u128::from(*bound))
+        .unwrap_or_else(|| LATENCY_BUCKET_BOUNDS_US.len())
+}
+
+impl LatencyHistogram {
+    pub fn record(&mut self, latency: Duration) {
+        self.buckets[bucket_index(latency)] += 1;
+        self.count += 1;
+        self.total += latency;
+        if latency > self.max {
+            self.max = latency;
+        }
+    }
+
+    /// The number of latencies recorded.
+    pub fn count(&self) -> u64 {
+        self.count
+    }
+
+    /// Write the histogram as the samples of the Prometheus histogram name,
+    /// with the given labels, which must already be formatted by
+    /// prometheus_labels().
+    pub fn write_prometheus(&self, out: &mut String, name: &str, labels: &str) -> fmt::Result {
+        let separator = if labels.is_empty() { "" } else { "," };
+        let mut cumulative = 0;
+        for (bound, count) in LATENCY_BUCKET_BOUNDS_US.iter().zip(self.buckets.iter()) {
+            cumulative += count;
+            writeln!(
+                out,
+                "{}_bucket{{{}{}le=\"{}.{:06}\"}} {}",
+                name,
+                labels,
+                separator,
+                bound / 1_000_000,
+                bound % 1_000_000,
+                cumulative
+            )?;
+        }
+        writeln!(
+            out,
+            "{}_bucket{{{}{}le=\"+Inf\"}} {}",
+            name, labels, separator, self.count
+        )?;
+        writeln!(
+            out,
+            "{}_sum{{{}}} {}.{:09}",
+            name,
+            labels,
+            self.total.as_secs(),
+            self.total.subsec_nanos()
+        )?;
+        writeln!(out, "{}_count{{{}}} {}", name, labels, self.count)
+    }
+}
+
+impl<'a> Into<Value> for &'a LatencyHistogram {
+    fn into(self) -> Value {
+        json!({
+            "count": Value::from(self.count),
+            "max_latency_us": Value::from(self.max.as_micros().to_string()),
+            "mean_latency_us": Value::from(
+                if self.count == 0 {
+                    0
+                } else {
+                    self.total.as_micros() / u128::from(self.count)
+                }
+                .to_string()
+            ),
+            "buckets": Value::Array(
+                self.buckets
+                    .iter()
+                    .enumerate()
+                    .map(|(i, count)| json!({
+                        "le_us": LATENCY_BUCKET_BOUNDS_US
+                            .get(i)
+                            .map(|bound| Value::from(*bound))
+                            .unwrap_or(Value::Null),
+                        "count": Value::from(*count),
+                    }))
+                    .collect()
+            ),
+        })
+    }
+}
+
+/// Format pairs of label names and values as the labels of a Prometheus
+/// sample, escaping the values.
+pub fn prometheus_labels(labels: &[(&str, &str)]) -> String {
+    labels
+        .iter()
+        .map(|(name, value)| {
+            format!(
+                "{}=\"{}\"",
+                name,
+                value
+                    .replace('\\', "\\\\")
+                    .replace('"', "\\\"")
+                    .replace('\n', "\\n")
+            )
+        })
+        .collect::<Vec<_>>()
+        .join(",")
+}
+
+/// Write the HELP and TYPE lines that precede the samples of a metric.
+pub fn write_prometheus_header(
+    out: &mut String,
+    name: &str,
+    help: &str,
+    metric_type: &str,
+) -> fmt::Result {
+    writeln!(out, "# HELP {} {}", name, help)?;
+    writeln!(out, "# TYPE {} {}", name, metric_type)
+}
+
+/// A family of latency histograms, one for each combination of the values of
+/// its labels.
+pub struct HistogramFamily {
+    name: &'static str,
+    help: &'static str,
+    labels: &'static [&'static str],
+}
+
+pub static OPERATION_DURATION: HistogramFamily = HistogramFamily {
+    name: "stratisd_operation_duration_seconds",
+    help: "Time taken by engine operations.",
+    labels: &["operation"],
+};
+
+pub static CHILD_PROCESS_DURATION: HistogramFamily = HistogramFamily {
+    name: "stratisd_child_process_duration_seconds",
+    help: "Time spent waiting for child processes.",
+    labels: &["operation"],
+};
+
+pub static LOCK_WAIT_DURATION: HistogramFamily = HistogramFamily {
+    name: "stratisd_lock_wait_duration_seconds",
+    help: "Time spent waiting to acquire a lock.",
+    labels: &["lock", "mode"],
+};
+
+pub static LOCK_HOLD_DURATION: HistogramFamily = HistogramFamily {
+    name: "stratisd_lock_hold_duration_seconds",
+    help: "Time for which a lock was held.",
+    labels: &["lock", "mode"],
+};
+
+static HISTOGRAM_FAMILIES: [&HistogramFamily; 4] = [
+    &OPERATION_DURATION,
+    &CHILD_PROCESS_DURATION,
+    &LOCK_WAIT_DURATION,
+    &LOCK_HOLD_DURATION,
+];
+
+lazy_static! {
+    // Maps the name of each histogram family and the values of its labels
+    // to the histogram for those values.
+    static ref HISTOGRAMS: Mutex<BTreeMap<(&'static str, Vec<&'static str>), LatencyHistogram>> =
+        Mutex::new(BTreeMap::new());
+}
+
+/// Record latency in the histogram of family identified by label_values,
+/// which correspond one to one to the labels of the family.
+pub fn observe(family: &HistogramFamily, label_values: Vec<&'static str>, latency: Duration) {
+    debug_assert_eq!(family.labels.len(), label_values.len());
+    HISTOGRAMS
+        .lock()
+        .expect("no holder of the lock panics")
+        .entry((family.name, label_values))
+        .or_insert_with(LatencyHistogram::default)
+        .record(latency);
+}
+
+/// A timed region, which records the time from its creation to its drop in
+/// a histogram.
+pub struct Span {
+    family: &'static HistogramFamily,
+    label_values: Vec<&'static str>,
+    start: Instant,
+}
+
+impl Span {
+    pub fn new(family: &'static HistogramFamily, label_values: Vec<&'static str>) -> Span {
+        Span {
+            family,
+            label_values,
+            start: Instant::now(),
+        }
+    }
+}
+
+impl Drop for Span {
+    fn drop(&mut self) {
+        let elapsed = self.start.elapsed();
+        trace!(
+            "{} {:?} took {:?}",
+            self.family.name,
+            self.label_values,
+            elapsed
+        );
+        observe(self.family, std::mem::take(&mut self.label_values), elapsed);
+    }
+}
+
+/// Time the engine operation named operation until the returned span is
+/// dropped.
+pub fn span(operation: &'static str) -> Span {
+    Span::new(&OPERATION_DURATION, vec![operation])
+}
+
+/// A latency histogram which may be recorded in concurrently without taking
+/// a lock.
+pub struct AtomicLatencyHistogram {
+    buckets: [AtomicU64; LATENCY_BUCKET_BOUNDS_US.len() + 1],
+    count: AtomicU64,
+    total_nanos: AtomicU64,
+    max_nanos: AtomicU64,
+}
+
+impl AtomicLatencyHistogram {
+    const fn new() -> AtomicLatencyHistogram {
+        AtomicLatencyHistogram {
+            buckets: [
+                AtomicU64::new(0),
+                AtomicU64::new(0),
+                AtomicU64::new(0),
+                AtomicU64::new(0),
+                AtomicU64::new(0),
+                AtomicU64::new(0),
+                AtomicU64::new(0),
+                AtomicU64::new(0),
+                AtomicU64::new(0),
+                AtomicU64::new(0),
+                AtomicU64::new(0),
+            ],
+            count: AtomicU64::new(0),
+            total_nanos: AtomicU64::new(0),
+            max_nanos: AtomicU64::new(0),
+        }
+    }
+
+    pub fn record(&self, latency: Duration) {
+        let nanos = u64::try_from(latency.as_nanos()).unwrap_or(std::u64::MAX);
+        self.buckets[bucket_index(latency)].fetch_add(1, Ordering::Relaxed);
+        self.count.fetch_add(1, Ordering::Relaxed);
+        self.total_nanos.fetch_add(nanos, Ordering::Relaxed);
+        self.max_nanos.fetch_max(nanos, Ordering::Relaxed);
+    }
+
+    /// A copy of the histogram. Latencies recorded while the copy is made
+    /// may be counted in some fields of the copy and not in others.
+    pub fn snapshot(&self) -> LatencyHistogram {
+        let mut histogram = LatencyHistogram::default();
+        for (count, bucket) in histogram.buckets.iter_mut().zip(self.buckets.iter()) {
+            *count = bucket.load(Ordering::Relaxed);
+        }
+        histogram.count = self.count.load(Ordering::Relaxed);
+        histogram.total = Duration::from_nanos(self.total_nanos.load(Ordering::Relaxed));
+        histogram.max = Duration::from_nanos(self.max_nanos.load(Ordering::Relaxed));
+        histogram
+    }
+}
+
+/// A timed region, which records the time from its creation to its drop in
+/// an AtomicLatencyHistogram.
+pub struct AtomicSpan {
+    histogram: &'static AtomicLatencyHistogram,
+    start: Instant,
+}
+
+impl AtomicSpan {
+    pub fn new(histogram: &'static AtomicLatencyHistogram) -> AtomicSpan {
+        AtomicSpan {
+            histogram,
+            start: Instant::now(),
+        }
+    }
+}
+
+impl Drop for AtomicSpan {
+    fn drop(&mut self) {
+        self.histogram.record(self.start.elapsed());
+    }
+}
+
+/// The histograms of the time spent waiting for and holding a lock, in the
+/// LOCK_WAIT_DURATION and LOCK_HOLD_DURATION families. They are allocated
+/// statically, so that acquiring and releasing the lock records its times
+/// without allocating or taking the mutex over the other histograms.
+pub struct LockHistograms {
+    name: &'static str,
+    pub shared_wait: AtomicLatencyHistogram,
+    pub shared_hold: AtomicLatencyHistogram,
+    pub exclusive_wait: AtomicLatencyHistogram,
+    pub exclusive_hold: AtomicLatencyHistogram,
+}
+
+impl LockHistograms {
+    const fn new(name: &'static str) -> LockHistograms {
+        LockHistograms {
+            name,
+            shared_wait: AtomicLatencyHistogram::new(),
+            shared_hold: AtomicLatencyHistogram::new(),
+            exclusive_wait: AtomicLatencyHistogram::new(),
+            exclusive_hold: AtomicLatencyHistogram::new(),
+        }
+    }
+
+    // The histogram in family of each mode in which the lock is acquired.
+    fn histograms(&self, family: &HistogramFamily) -> Vec<(&'static str, &AtomicLatencyHistogram)> {
+        if family.name == LOCK_WAIT_DURATION.name {
+            vec![
+                ("shared", &self.shared_wait),
+                ("exclusive", &self.exclusive_wait),
+            ]
+        } else if family.name == LOCK_HOLD_DURATION.name {
+            vec![
+                ("shared", &self.shared_hold),
+                ("exclusive", &self.exclusive_hold),
+            ]
+        } else {
+            Vec::new()
+        }
+    }
+}
+
+pub static ENGINE_LOCK: LockHistograms = LockHistograms::new("engine");
+
+pub static DBUS_TREE_LOCK: LockHistograms = LockHistograms::new("dbus_tree");
+
+// The locks of all pools share their histograms.
+pub static POOL_LOCK: LockHistograms = LockHistograms::new("pool");
+
+static LOCKS: [&LockHistograms; 3] = [&ENGINE_LOCK, &DBUS_TREE_LOCK, &POOL_LOCK];
+
+/// A counter of events.
+#[derive(Clone, Copy, Debug)]
+pub enum Counter {
+    /// Uses of the devicemapper context, each of which issues one or more
+    /// DM ioctls.
+    DmRequests,
+    /// udev events received from the udev monitor.
+    UdevEventsReceived,
+    /// udev events sent to the engine after those superseded by a later
+    /// event for the same device are discarded.
+    UdevEventsDelivered,
+}
+
+const COUNTERS: [Counter; 3] = [
+    Counter::DmRequests,
+    Counter::UdevEventsReceived,
+    Counter::UdevEventsDelivered,
+];
+
+static COUNTER_VALUES: [AtomicU64; 3] = [AtomicU64::new(0), AtomicU64::new(0), AtomicU64::new(0)];
+
+impl Counter {
+    fn name(self) -> &'static str {
+        match self {
+            Counter::DmRequests => "stratisd_dm_requests_total",
+            Counter::UdevEventsReceived => "stratisd_udev_events_received_total",
+            Counter::UdevEventsDelivered => "stratisd_udev_events_delivered_total",
+        }
+    }
+
+    fn help(self) -> &'static str {
+        match self {
+            Counter::DmRequests => "Uses of the devicemapper context.",
+            Counter::UdevEventsReceived => "udev events received.",
+            Counter::UdevEventsDelivered => "udev events delivered to the engine.",
+        }
+    }
+
+    fn index(self) -> usize {
+        match self {
+            Counter::DmRequests => 0,
+            Counter::UdevEventsReceived => 1,
+            Counter::UdevEventsDelivered => 2,
+        }
+    }
+
+    fn value(self) -> u64 {
+        COUNTER_VALUES[self.index()].load(Ordering::Relaxed)
+    }
+}
+
+/// Add n to counter.
+pub fn increment_counter(counter: Counter, n: usize) {
+    COUNTER_VALUES[counter.index()]
+        .fetch_add(u64::try_from(n).unwrap_or(std::u64::MAX), Ordering::Relaxed);
+}
+
+fn write_metrics(out: &mut String) -> fmt::Result {
+    for counter in COUNTERS.iter() {
+        write_prometheus_header(out, counter.name(), counter.help(), "counter")?;
+        writeln!(out, "{} {}", counter.name(), counter.value())?;
+    }
+
+    let histograms = HISTOGRAMS.lock().expect("no holder of the lock panics");
+    for family in HISTOGRAM_FAMILIES.iter() {
+        write_prometheus_header(out, family.name, family.help, "histogram")?;
+        for ((_, label_values), histogram) in histograms
+            .iter()
+            .filter(|((name, _), _)| *name == family.name)
+        {
+            let labels = family
+                .labels
+                .iter()
+                .cloned()
+                .zip(label_values.iter().cloned())
+                .collect::<Vec<_>>();
+            histogram.write_prometheus(out, family.name, &prometheus_labels(&labels))?;
+        }
+        for lock in LOCKS.iter() {
+            for (mode, histogram) in lock.histograms(family) {
+                let histogram = histogram.snapshot();
+                if histogram.count() == 0 {
+                    continue;
+                }
+                histogram.write_prometheus(
+                    out,
+                    family.name,
+                    &prometheus_labels(&[("lock", lock.name), ("mode", mode)]),
+                )?;
+            }
+        }
+    }
+    Ok(())
+}
+
+/// Render every metric kept by the engine in the Prometheus text exposition
+/// format.
+pub fn render_metrics() -> String {
+    let mut out = String::new();
+    write_metrics(&mut out).expect("writing to a String can not fail");
+    out
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    /// Verify that latencies are counted in the correct buckets.
+    fn test_latency_histogram() {
+        let mut histogram = LatencyHistogram::default();
+        histogram.record(Duration::from_micros(50));
+        histogram.record(Duration::from_micros(100));
+        histogram.record(Duration::from_millis(2));
+        histogram.record(Duration::from_secs(10));
+        assert_eq!(histogram.buckets[0], 2);
+        assert_eq!(histogram.buckets[3], 1);
+        assert_eq!(histogram.buckets[LATENCY_BUCKET_BOUNDS_US.len()], 1);
+        assert_eq!(histogram.count, 4);
+        assert_eq!(histogram.max, Duration::from_secs(10));
+
+        let mut out = String::new();
+        histogram
+            .write_prometheus(&mut out, "test", &prometheus_labels(&[("op", "a\"b")]))
+            .unwrap();
+        let lines = out.lines().collect::<Vec<_>>();
+        assert_eq!(lines[0], "test_bucket{op=\"a\\\"b\",le=\"0.000100\"} 2");
+        assert_eq!(lines[3], "test_bucket{op=\"a\\\"b\",le=\"0.005000\"} 3");
+        assert_eq!(lines[10], "test_bucket{op=\"a\\\"b\",le=\"+Inf\"} 4");
+        assert_eq!(lines[11], "test_sum{op=\"a\\\"b\"} 10.002150000");
+        assert_eq!(lines[12], "test_count{op=\"a\\\"b\"} 4");
+    }
+
+    #[test]
+    /// Verify that the atomic histogram counts latencies in the same buckets
+    /// as the histogram and that recorded lock times are rendered.
+    fn test_atomic_latency_histogram() {
+        static HISTOGRAM: AtomicLatencyHistogram = AtomicLatencyHistogram::new();
+        HISTOGRAM.record(Duration::from_micros(50));
+        HISTOGRAM.record(Duration::from_millis(2));
+        HISTOGRAM.record(Duration::from_secs(10));
+        drop(AtomicSpan::new(&HISTOGRAM));
+
+        let histogram = HISTOGRAM.snapshot();
+        assert_eq!(histogram.buckets[0], 2);
+        assert_eq!(histogram.buckets[3], 1);
+        assert_eq!(histogram.buckets[LATENCY_BUCKET_BOUNDS_US.len()], 1);
+        assert_eq!(histogram.count, 4);
+        assert_eq!(histogram.max, Duration::from_secs(10));
+
+        DBUS_TREE_LOCK
+            .exclusive_wait
+            .record(Duration::from_micros(1));
+        assert!(render_metrics().lines().any(|line| line
+            .strip_prefix(
+                "stratisd_lock_wait_duration_seconds_count{lock=\"dbus_tree\",mode=\"exclusive\"} "
+            )
+            .and_then(|value| value.parse::<u64>().ok())
+            .map_or(false, |value| value >= 1)));
+    }
+
+    #[test]
+    /// Verify that spans and counters appear in the rendered metrics.
+    fn test_render_metrics() {
+        drop(span("test_render_metrics"));
+        increment_counter(Counter::DmRequests, 1);
+
+        let metrics = render_metrics();
+        assert!(metrics.contains("# TYPE stratisd_operation_duration_seconds histogram"));
+        assert!(metrics.contains(
+            "stratisd_operation_duration_seconds_count{operation=\"test_render_metrics\"} 1"
+        ));
+        assert!(metrics.lines().any(|line| line
+            .strip_prefix("stratisd_dm_requests_total ")
+            .and_then(|value| value.parse::<u64>().ok())
+            .map_or(false, |value| value >= 1)));
+    }
+}
@@ -4,25 +4,35 @@
 
 pub use self::{
     engine::{BlockDev, Engine, Filesystem, KeyActions, Pool, Report},
+    metrics::{
+        increment_counter, prometheus_labels, render_metrics, write_prometheus_header, Counter,
+        LatencyHistogram, DBUS_TREE_LOCK,
+    },
     sim_engine::SimEngine,
     strat_engine::{
-        blkdev_size, crypt_metadata_size, get_dm, get_dm_init, StaticHeader, StaticHeaderResult,
-        StratEngine, StratKeyActions, BDA, CLEVIS_TANG_TRUST_URL,
+        blkdev_size, crypt_metadata_size, get_dm, get_dm_init, pool_metadata_to_json,
+        PoolMetadataFormat, StaticHeader, StaticHeaderResult, StratEngine, StratKeyActions, BDA,
+        CLEVIS_TANG_TRUST_URL, DEFAULT_PARALLELISM,
     },
     structures::{ExclusiveGuard, SharedGuard},
     types::{
-        BlockDevTier, CreateAction, DeleteAction, DevUuid, EncryptionInfo, EngineAction,
-        FilesystemUuid, KeyDescription, Lockable, LockableEngine, MappingCreateAction,
-        MappingDeleteAction, Name, PoolUuid, Redundancy, RenameAction, ReportType, SetCreateAction,
-        SetDeleteAction, StratisUuid, UdevEngineEvent, UnlockMethod,
+        AllocPolicy, BlockDevTier, CacheSettings, CacheStats, CreateAction, DeleteAction, DevUuid,
+        EncryptionInfo, EngineAction, FilesystemUuid, FsGrowthPolicy, KeyDescription, Lockable,
+        LockableEngine, MappingCreateAction, MappingDeleteAction, Name, PoolGuard, PoolMutGuard,
+        PoolUuid, PropChangeAction, Redundancy, RenameAction, ReportType, SetCreateAction,
+        SetDeleteAction, StratisUuid, ThinCheckPolicy, UdevEngineDevice, UdevEngineEvent,
+        UnlockMethod, UsageReadings,
     },
 };
 
 #[macro_use]
 mod macros;
 
+#[cfg(test)]
+mod bench;
 #[allow(clippy::module_inception)]
 mod engine;
+mod metrics;
 mod shared;
 mod sim_engine;
 mod strat_engine;
@@ -3,7 +3,10 @@
 // file, You can obtain one at http://mozilla.org/MPL/2.0/.
 
 use std::{
-    collections::{hash_map::RandomState, HashSet},
+    collections::{
+        hash_map::{Entry, RandomState},
+        HashMap, HashSet,
+    },
     fs::File,
     io::Read,
     os::unix::io::{AsRawFd, FromRawFd, RawFd},
@@ -13,7 +16,7 @@ use std::{
 use nix::poll::{poll, PollFd, PollFlags};
 use regex::Regex;
 
-use devicemapper::Bytes;
+use devicemapper::{Bytes, Sectors};
 use libcryptsetup_rs::SafeMemHandle;
 
 use crate::{
@@ -119,6 +122,27 @@ pub fn set_key_shared(key_fd: RawFd) -> StratisResult<SizedKeyMemory> {
     Ok(sized_memory)
 }
 
+/// Remove the specs of filesystems whose names have already appeared in
+/// specs. The specs are kept in the order in which their names first
+/// appear, but if the same name appears more than once, the size of the
+/// last spec with that name is used.
+pub fn dedup_filesystem_specs<'a>(
+    specs: &[(&'a str, Option<Sectors>)],
+) -> Vec<(&'a str, Option<Sectors>)> {
+    let mut indices = HashMap::new();
+    let mut deduped: Vec<(&'a str, Option<Sectors>)> = Vec::with_capacity(specs.len());
+    for &(name, size) in specs {
+        match indices.entry(name) {
+            Entry::Occupied(entry) => deduped[*entry.get()].1 = size,
+            Entry::Vacant(entry) => {
+                entry.insert(deduped.len());
+                deduped.push((name, size));
+            }
+        }
+    }
+    deduped
+}
+
 /// Validate a str for use as a Pool or Filesystem name.
 pub fn validate_name(name: &str) -> StratisResult<()> {
     if name.contains('\u{0}') {
@@ -201,6 +225,22 @@ pub fn validate_paths(paths: &[&Path]) -> StratisResult<()> {
 mod tests {
     use super::*;
 
+    #[test]
+    /// Verify that repeated filesystem names are removed without changing
+    /// the order of the others, and that the last size given is used.
+    fn test_dedup_filesystem_specs() {
+        assert_eq!(
+            dedup_filesystem_specs(&[
+                ("c", None),
+                ("a", Some(Sectors(8))),
+                ("c", Some(Sectors(16))),
+                ("b", None),
+                ("a", None),
+            ]),
+            vec![("c", Some(Sectors(16))), ("a", None), ("b", None)]
+        );
+    }
+
     #[test]
     #[allow(clippy::cognitive_complexity)]
     fn test_validate_name() {
@@ -6,19 +6,22 @@ use std::{
     collections::{hash_map::RandomState, HashMap, HashSet},
     iter::FromIterator,
     path::Path,
+    time::Duration,
 };
 
 use serde_json::{json, Value};
+use tokio::sync::RwLock;
 
 use crate::{
     engine::{
         engine::{Engine, KeyActions, Pool, Report},
         shared::{create_pool_idempotent_or_err, validate_name, validate_paths},
         sim_engine::{keys::SimKeyActions, pool::SimPool},
-        structures::Table,
+        structures::{read_pool, Lockable, Table},
         types::{
-            CreateAction, DeleteAction, DevUuid, EncryptionInfo, LockedPoolInfo, Name, PoolUuid,
-            RenameAction, ReportType, SetUnlockAction, UdevEngineEvent, UnlockMethod,
+            CreateAction, DeleteAction, DevUuid, EncryptionInfo, LockedPoolInfo, Name, PoolGuard,
+            PoolMutGuard, PoolUuid, RenameAction, ReportType, SetUnlockAction, UdevEngineEvent,
+            UnlockMethod, UsageReadings,
         },
     },
     stratis::{StratisError, StratisResult},
@@ -26,7 +29,8 @@ use crate::{
 
 #[derive(Debug, Default)]
 pub struct SimEngine {
-    pools: Table<PoolUuid, SimPool>,
+    // Each pool has a lock of its own; see Lockable.
+    pools: Table<PoolUuid, RwLock<SimPool>>,
     key_handler: SimKeyActions,
 }
 
@@ -41,7 +45,7 @@ impl<'a> Into<Value> for &'a SimEngine {
                         "pool_uuid": uuid.to_string(),
                         "name": name.to_string(),
                     });
-                    let pool_json = pool.into();
+                    let pool_json = (&*Lockable::new_pool(pool).blocking_read()).into();
                     if let (Value::Object(mut map), Value::Object(submap)) = (json, pool_json) {
                         map.extend(submap.into_iter());
                         Value::Object(map)
@@ -68,6 +72,28 @@ impl Report for SimEngine {
                 "errored_pools": json!([]),
                 "hopeless_devices": json!([]),
             }),
+            ReportType::PoolChecks => json!({
+                "queue_depth": 0,
+                "urgent_pending": 0,
+                "background_pending": 0,
+                "urgent_runs": 0,
+                "background_runs": 0,
+                "failures": 0,
+                "coalesced": 0,
+                "last_latency_us": Value::Null,
+                "max_latency_us": "0",
+                "mean_latency_us": "0",
+            }),
+            ReportType::ChildProcesses => json!({
+                "child_processes": json!({}),
+            }),
+            ReportType::DeviceIdentification => json!({
+                "cached_devices": 0,
+                "hits": 0,
+                "misses": 0,
+                "uncacheable": 0,
+                "invalidations": 0,
+            }),
         }
     }
 }
@@ -96,7 +122,9 @@ impl Engine for SimEngine {
         }
 
         match self.pools.get_by_name(name) {
-            Some((_, pool)) => create_pool_idempotent_or_err(pool, name, blockdev_paths),
+            Some((_, pool)) => {
+                create_pool_idempotent_or_err(&*read_pool(pool), name, blockdev_paths)
+            }
             None => {
                 if blockdev_paths.is_empty() {
                     Err(StratisError::Msg(
@@ -109,7 +137,7 @@ impl Engine for SimEngine {
                     let (pool_uuid, pool) = SimPool::new(&devices, redundancy, encryption_info);
 
                     self.pools
-                        .insert(Name::new(name.to_owned()), pool_uuid, pool);
+                        .insert(Name::new(name.to_owned()), pool_uuid, RwLock::new(pool));
 
                     Ok(CreateAction::Created(pool_uuid))
                 }
@@ -117,13 +145,13 @@ impl Engine for SimEngine {
         }
     }
 
-    fn handle_event(&mut self, _event: &UdevEngineEvent) -> Option<(Name, PoolUuid, &dyn Pool)> {
-        None
+    fn handle_events(&mut self, _events: &[UdevEngineEvent]) -> Vec<(Name, PoolUuid, &dyn Pool)> {
+        Vec::new()
     }
 
     fn destroy_pool(&mut self, uuid: PoolUuid) -> StratisResult<DeleteAction<PoolUuid>> {
-        if let Some((_, pool)) = self.pools.get_by_uuid(uuid) {
-            if pool.has_filesystems() {
+        if let Some((_, pool)) = self.pools.get_mut_by_uuid(uuid) {
+            if pool.get_mut().has_filesystems() {
                 return Err(StratisError::Msg("filesystems remaining on pool".into()));
             };
         } else {
@@ -133,6 +161,7 @@ impl Engine for SimEngine {
             .remove_by_uuid(uuid)
             .expect("Must succeed since self.pool.get_by_uuid() returned a value")
             .1
+            .get_mut()
             .destroy()?;
         Ok(DeleteAction::Deleted(uuid))
     }
@@ -162,10 +191,18 @@ impl Engine for SimEngine {
         Ok(SetUnlockAction::empty())
     }
 
-    fn get_pool(&self, uuid: PoolUuid) -> Option<(Name, &dyn Pool)> {
+    fn get_pool(&self, uuid: PoolUuid) -> Option<(Name, PoolGuard<'_>)> {
         get_pool!(self; uuid)
     }
 
+    fn lock_pool(&self, uuid: PoolUuid) -> Option<(Name, PoolMutGuard<'_>)> {
+        lock_pool!(self; uuid)
+    }
+
+    fn lock_pool_by_name(&self, name: &str) -> Option<(PoolUuid, PoolMutGuard<'_>)> {
+        lock_pool_by_name!(self; name)
+    }
+
     fn get_mut_pool(&mut self, uuid: PoolUuid) -> Option<(Name, &mut dyn Pool)> {
         get_mut_pool!(self; uuid)
     }
@@ -174,24 +211,38 @@ impl Engine for SimEngine {
         HashMap::new()
     }
 
-    fn pools(&self) -> Vec<(Name, PoolUuid, &dyn Pool)> {
+    fn pools(&self) -> Vec<(Name, PoolUuid, PoolGuard<'_>)> {
         self.pools
             .iter()
-            .map(|(name, uuid, pool)| (name.clone(), *uuid, pool as &dyn Pool))
+            .map(|(name, uuid, pool)| (name.clone(), *uuid, read_pool(pool)))
             .collect()
     }
 
     fn pools_mut(&mut self) -> Vec<(Name, PoolUuid, &mut dyn Pool)> {
         self.pools
             .iter_mut()
-            .map(|(name, uuid, pool)| (name.clone(), *uuid, pool as &mut dyn Pool))
+            .map(|(name, uuid, pool)| (name.clone(), *uuid, pool.get_mut() as &mut dyn Pool))
             .collect()
     }
 
-    fn evented(&mut self) -> StratisResult<()> {
+    fn evented(&self) -> StratisResult<()> {
         Ok(())
     }
 
+    fn run_scheduled_checks(&self) -> Option<Duration> {
+        None
+    }
+
+    fn next_check_due(&self) -> Option<Duration> {
+        None
+    }
+
+    fn read_usage(&self) -> UsageReadings {
+        UsageReadings::default()
+    }
+
+    fn set_usage(&mut self, _readings: UsageReadings) {}
+
     fn get_key_handler(&self) -> &dyn KeyActions {
         &self.key_handler as &dyn KeyActions
     }
@@ -208,9 +259,14 @@ impl Engine for SimEngine {
 #[cfg(test)]
 mod tests {
 
-    use std::{self, path::Path};
+    use std::{
+        self,
+        path::{Path, PathBuf},
+        time::Instant,
+    };
 
     use crate::engine::{
+        bench,
         types::{EngineAction, RenameAction},
         Engine,
     };
@@ -246,6 +302,43 @@ mod tests {
         assert_matches!(engine.destroy_pool(uuid), Ok(_));
     }
 
+    #[test]
+    /// While one pool is locked for writing, another pool can be locked for
+    /// reading or writing.
+    fn lock_pools_independently() {
+        let mut engine = SimEngine::default();
+        let uuid1 = engine
+            .create_pool(
+                "name1",
+                strs_to_paths!(["/dev/one"]),
+                None,
+                &EncryptionInfo::default(),
+            )
+            .unwrap()
+            .changed()
+            .unwrap();
+        let uuid2 = engine
+            .create_pool(
+                "name2",
+                strs_to_paths!(["/dev/two"]),
+                None,
+                &EncryptionInfo::default(),
+            )
+            .unwrap()
+            .changed()
+            .unwrap();
+
+        let (_, mut pool1) = engine.lock_pool(uuid1).unwrap();
+        pool1
+            .create_filesystems("name1", uuid1, &[("fs", None)])
+            .unwrap();
+        let (_, pool2) = engine.get_pool(uuid2).unwrap();
+        assert!(pool2.filesystems().is_empty());
+        drop(pool2);
+        assert!(engine.lock_pool(uuid2).is_some());
+        assert_eq!(pool1.filesystems().len(), 1);
+    }
+
     #[test]
     /// Destroying a pool with devices should succeed
     fn destroy_pool_w_devices() {
@@ -456,4 +549,113 @@ mod tests {
             Ok(RenameAction::NoSource)
         );
     }
+
+    /// The paths of num_devs distinct simulated devices for the pool named
+    /// pool_name.
+    fn bench_paths(pool_name: &str, num_devs: u64) -> Vec<PathBuf> {
+        (0..num_devs)
+            .map(|i| PathBuf::from(format!("/dev/{}-{}", pool_name, i)))
+            .collect()
+    }
+
+    #[test]
+    #[ignore]
+    /// Measure the cost of creating pools for increasing numbers of devices
+    /// per pool.
+    /// Run with "make bench".
+    fn bench_sim_create_pool() {
+        const NUM_POOLS: u64 = 100;
+
+        for &num_devs in [1, 16, 256].iter() {
+            let mut engine = SimEngine::default();
+            let pools = (0..NUM_POOLS)
+                .map(|i| {
+                    let name = format!("pool{}", i);
+                    let paths = bench_paths(&name, num_devs);
+                    (name, paths)
+                })
+                .collect::<Vec<_>>();
+
+            let start = Instant::now();
+            for (name, paths) in pools.iter() {
+                let paths = paths.iter().map(|p| p.as_path()).collect::<Vec<_>>();
+                engine
+                    .create_pool(name, &paths, None, &EncryptionInfo::default())
+                    .unwrap();
+            }
+            bench::report("sim/create_pool", num_devs, NUM_POOLS, start.elapsed());
+        }
+    }
+
+    #[test]
+    #[ignore]
+    /// Measure the cost of creating filesystems, and of generating reports
+    /// on, and looking up, the pool that contains them, for increasing
+    /// numbers of filesystems.
+    /// Run with "make bench".
+    fn bench_sim_filesystems() {
+        const NUM_REPORTS: u64 = 10;
+        const NUM_LOOKUPS: usize = 10_000;
+
+        for &num_fs in [10, 100, 1000].iter() {
+            let mut engine = SimEngine::default();
+            let pool_name = "pool";
+            let paths = bench_paths(pool_name, 4);
+            let paths = paths.iter().map(|p| p.as_path()).collect::<Vec<_>>();
+            let pool_uuid = engine
+                .create_pool(pool_name, &paths, None, &EncryptionInfo::default())
+                .unwrap()
+                .changed()
+                .unwrap();
+            let fs_names = (0..num_fs).map(|i| format!("fs{}", i)).collect::<Vec<_>>();
+            let specs = fs_names
+                .iter()
+                .map(|name| (name.as_str(), None))
+                .collect::<Vec<_>>();
+
+            let (_, pool) = engine.get_mut_pool(pool_uuid).unwrap();
+            let start = Instant::now();
+            pool.create_filesystems(pool_name, pool_uuid, &specs)
+                .unwrap();
+            bench::report("sim/create_filesystems", num_fs, 1, start.elapsed());
+
+            let start = Instant::now();
+            for _ in 0..NUM_REPORTS {
+                engine.engine_state_report();
+            }
+            bench::report(
+                "sim/engine_state_report",
+                num_fs,
+                NUM_REPORTS,
+                start.elapsed(),
+            );
+
+            let start = Instant::now();
+            for _ in 0..NUM_REPORTS {
+                engine.engine_state_report_json().unwrap();
+            }
+            bench::report(
+                "sim/engine_state_report_json",
+                num_fs,
+                NUM_REPORTS,
+                start.elapsed(),
+            );
+
+            let names = fs_names
+                .iter()
+                .map(|name| Name::new(name.to_owned()))
+                .collect::<Vec<_>>();
+            let (_, pool) = engine.get_pool(pool_uuid).unwrap();
+            let start = Instant::now();
+            for name in names.iter().cycle().take(NUM_LOOKUPS) {
+                assert!(pool.get_filesystem_by_name(name).is_some());
+            }
+            bench::report(
+                "sim/get_filesystem_by_name",
+                num_fs,
+                NUM_LOOKUPS as u64,
+                start.elapsed(),
+            );
+        }
+    }
 }
@@ -4,16 +4,20 @@
 
 use chrono::{DateTime, Utc};
 
-use std::path::PathBuf;
+use std::{path::PathBuf, time::Duration};
 
 use devicemapper::Bytes;
 
-use crate::{engine::Filesystem, stratis::StratisResult};
+use crate::{
+    engine::{Filesystem, FsGrowthPolicy},
+    stratis::StratisResult,
+};
 
 #[derive(Debug)]
 pub struct SimFilesystem {
     rand: u32,
     created: DateTime<Utc>,
+    growth_policy: FsGrowthPolicy,
 }
 
 impl SimFilesystem {
@@ -21,8 +25,16 @@ impl SimFilesystem {
         SimFilesystem {
             rand: rand::random::<u32>(),
             created: Utc::now(),
+            growth_policy: FsGrowthPolicy::default(),
         }
     }
+
+    /// Set the growth policy. Returns true if the policy was changed.
+    pub fn set_growth_policy(&mut self, policy: FsGrowthPolicy) -> bool {
+        let changed = self.growth_policy != policy;
+        self.growth_policy = policy;
+        changed
+    }
 }
 
 impl Filesystem for SimFilesystem {
@@ -43,4 +55,12 @@ impl Filesystem for SimFilesystem {
     fn used(&self) -> StratisResult<Bytes> {
         Ok(Bytes(12_345_678))
     }
+
+    fn used_age(&self) -> Option<Duration> {
+        None
+    }
+
+    fn growth_policy(&self) -> FsGrowthPolicy {
+        self.growth_policy
+    }
 }
@@ -7,6 +7,7 @@ use std::{
     collections::{hash_map::RandomState, HashMap, HashSet},
     iter::FromIterator,
     path::Path,
+    time::Duration,
     vec::Vec,
 };
 
@@ -17,12 +18,15 @@ use devicemapper::{Sectors, IEC};
 use crate::{
     engine::{
         engine::{BlockDev, Filesystem, Pool},
-        shared::{init_cache_idempotent_or_err, validate_name, validate_paths},
+        shared::{
+            dedup_filesystem_specs, init_cache_idempotent_or_err, validate_name, validate_paths,
+        },
         sim_engine::{blockdev::SimDev, filesystem::SimFilesystem},
         structures::Table,
         types::{
-            BlockDevTier, Clevis, CreateAction, DeleteAction, DevUuid, EncryptionInfo,
-            FilesystemUuid, Key, KeyDescription, Name, PoolUuid, Redundancy, RegenAction,
+            AllocPolicy, BlockDevTier, CacheSettings, CacheStats, Clevis, CreateAction,
+            DeleteAction, DevUuid, EncryptionInfo, FilesystemUuid, FsGrowthPolicy, Key,
+            KeyDescription, Name, PoolUuid, PropChangeAction, Redundancy, RegenAction,
             RenameAction, SetCreateAction, SetDeleteAction,
         },
     },
@@ -33,6 +37,9 @@ use crate::{
 pub struct SimPool {
     block_devs: HashMap<DevUuid, SimDev>,
     cache_devs: HashMap<DevUuid, SimDev>,
+    // Meaningful only if there are cache devices
+    cache_settings: CacheSettings,
+    alloc_policy: AllocPolicy,
     filesystems: Table<FilesystemUuid, SimFilesystem>,
     redundancy: Redundancy,
 }
@@ -52,6 +59,8 @@ impl SimPool {
             SimPool {
                 block_devs: device_pairs.collect(),
                 cache_devs: HashMap::new(),
+                cache_settings: CacheSettings::default(),
+                alloc_policy: AllocPolicy::default(),
                 filesystems: Table::default(),
                 redundancy,
             },
@@ -168,6 +177,7 @@ impl Pool for SimPool {
         _pool_uuid: PoolUuid,
         _pool_name: &str,
         blockdevs: &[&Path],
+        settings: CacheSettings,
     ) -> StratisResult<SetCreateAction<DevUuid>> {
         validate_paths(blockdevs)?;
 
@@ -186,8 +196,10 @@ impl Pool for SimPool {
                 .iter()
                 .map(|p| SimDev::new(p, Cow::Owned(EncryptionInfo::default())))
                 .collect();
+            settings.validate()?;
             let blockdev_uuids: Vec<_> = blockdev_pairs.iter().map(|(uuid, _)| *uuid).collect();
             self.cache_devs.extend(blockdev_pairs);
+            self.cache_settings = settings;
             Ok(SetCreateAction::new(blockdev_uuids))
         } else {
             init_cache_idempotent_or_err(
@@ -199,26 +211,94 @@ impl Pool for SimPool {
         }
     }
 
+    fn cache_settings(&self) -> Option<CacheSettings> {
+        if self.has_cache() {
+            Some(self.cache_settings)
+        } else {
+            None
+        }
+    }
+
+    fn set_cache_migration_threshold(
+        &mut self,
+        _pool_name: &str,
+        threshold: Sectors,
+    ) -> StratisResult<PropChangeAction<Sectors>> {
+        if !self.has_cache() {
+            return Err(StratisError::Msg(
+                "The cache has not been initialized; there is no migration threshold to set"
+                    .to_string(),
+            ));
+        }
+        if self.cache_settings.migration_threshold == Some(threshold) {
+            return Ok(PropChangeAction::Identity);
+        }
+        let settings = CacheSettings {
+            migration_threshold: Some(threshold),
+            ..self.cache_settings
+        };
+        settings.validate()?;
+        self.cache_settings = settings;
+        Ok(PropChangeAction::NewValue(threshold))
+    }
+
+    fn cache_stats(&self) -> StratisResult<Option<CacheStats>> {
+        Ok(if self.has_cache() {
+            Some(CacheStats {
+                read_hits: 0,
+                read_misses: 0,
+                write_hits: 0,
+                write_misses: 0,
+                promotions: 0,
+                demotions: 0,
+                dirty: 0,
+                used_blocks: 0,
+                total_blocks: 0,
+                policy: "smq".to_string(),
+                write_mode: "writethrough".to_string(),
+            })
+        } else {
+            None
+        })
+    }
+
+    fn alloc_policy(&self) -> AllocPolicy {
+        self.alloc_policy
+    }
+
+    fn set_alloc_policy(
+        &mut self,
+        _pool_name: &str,
+        policy: AllocPolicy,
+    ) -> StratisResult<PropChangeAction<AllocPolicy>> {
+        if self.alloc_policy == policy {
+            Ok(PropChangeAction::Identity)
+        } else {
+            self.alloc_policy = policy;
+            Ok(PropChangeAction::NewValue(policy))
+        }
+    }
+
     fn create_filesystems<'a, 'b>(
         &'a mut self,
         _pool_name: &str,
         _pool_uuid: PoolUuid,
         specs: &[(&'b str, Option<Sectors>)],
     ) -> StratisResult<SetCreateAction<(&'b str, FilesystemUuid)>> {
-        let names: HashMap<_, _> = specs.iter().map(|&tup| (tup.0, tup.1)).collect();
+        let specs = dedup_filesystem_specs(specs);
 
-        names.iter().fold(Ok(()), |res, (name, _)| {
+        specs.iter().fold(Ok(()), |res, (name, _)| {
             res.and_then(|()| validate_name(name))
         })?;
 
         let mut result = Vec::new();
-        for name in names.keys() {
+        for (name, _) in specs {
             if !self.filesystems.contains_name(name) {
                 let uuid = FilesystemUuid::new_v4();
                 let new_filesystem = SimFilesystem::new();
                 self.filesystems
-                    .insert(Name::new((&**name).to_owned()), uuid, new_filesystem);
-                result.push((*name, uuid));
+                    .insert(Name::new(name.to_owned()), uuid, new_filesystem);
+                result.push((name, uuid));
             }
         }
 
@@ -476,6 +556,25 @@ impl Pool for SimPool {
         Ok(RenameAction::Renamed(uuid))
     }
 
+    fn set_fs_growth_policy(
+        &mut self,
+        _pool_name: &str,
+        uuid: FilesystemUuid,
+        policy: FsGrowthPolicy,
+    ) -> StratisResult<PropChangeAction<FsGrowthPolicy>> {
+        match self.filesystems.get_mut_by_uuid(uuid) {
+            Some((_, filesystem)) => Ok(if filesystem.set_growth_policy(policy) {
+                PropChangeAction::NewValue(policy)
+            } else {
+                PropChangeAction::Identity
+            }),
+            None => Err(StratisError::Msg(format!(
+                "No filesystem with UUID {} belongs to this pool",
+                uuid
+            ))),
+        }
+    }
+
     fn snapshot_filesystem(
         &mut self,
         _pool_name: &str,
@@ -507,6 +606,42 @@ impl Pool for SimPool {
         )))
     }
 
+    fn snapshot_filesystems<'a, 'b>(
+        &'a mut self,
+        _pool_name: &str,
+        _pool_uuid: PoolUuid,
+        specs: &[(FilesystemUuid, &'b str)],
+    ) -> StratisResult<SetCreateAction<(&'b str, FilesystemUuid)>> {
+        let mut names = HashMap::new();
+        for &(origin_uuid, snapshot_name) in specs {
+            validate_name(snapshot_name)?;
+            if self.get_filesystem(origin_uuid).is_none() {
+                return Err(StratisError::Msg(origin_uuid.to_string()));
+            }
+            if names.insert(snapshot_name, origin_uuid).is_some() {
+                return Err(StratisError::Msg(format!(
+                    "Snapshot name {} was requested more than once",
+                    snapshot_name
+                )));
+            }
+        }
+
+        let mut result = Vec::new();
+        for &(_, snapshot_name) in specs {
+            if !self.filesystems.contains_name(snapshot_name) {
+                let uuid = FilesystemUuid::new_v4();
+                self.filesystems.insert(
+                    Name::new(snapshot_name.to_owned()),
+                    uuid,
+                    SimFilesystem::new(),
+                );
+                result.push((snapshot_name, uuid));
+            }
+        }
+
+        Ok(SetCreateAction::new(result))
+    }
+
     fn total_physical_size(&self) -> Sectors {
         // We choose to make our pools very big, and we can change that
         // if it is inconvenient.
@@ -517,6 +652,10 @@ impl Pool for SimPool {
         Ok(Sectors(0))
     }
 
+    fn total_physical_used_age(&self) -> Option<Duration> {
+        None
+    }
+
     fn filesystems(&self) -> Vec<(Name, FilesystemUuid, &dyn Filesystem)> {
         self.filesystems
             .iter()
@@ -654,6 +793,81 @@ mod tests {
         );
     }
 
+    #[test]
+    /// Setting the growth policy of a filesystem is idempotent and fails if
+    /// the filesystem does not exist
+    fn set_growth_policy() {
+        let mut engine = SimEngine::default();
+        let pool_name = "pool_name";
+        let uuid = engine
+            .create_pool(
+                pool_name,
+                strs_to_paths!(["/dev/one", "/dev/two", "/dev/three"]),
+                None,
+                &EncryptionInfo::default(),
+            )
+            .unwrap()
+            .changed()
+            .unwrap();
+        let pool = engine.get_mut_pool(uuid).unwrap().1;
+        let infos = pool
+            .create_filesystems(pool_name, uuid, &[("fs_name", None)])
+            .unwrap()
+            .changed()
+            .unwrap();
+        let policy = FsGrowthPolicy::Percent(10);
+        assert_matches!(
+            pool.set_fs_growth_policy(pool_name, infos[0].1, FsGrowthPolicy::default()),
+            Ok(PropChangeAction::Identity)
+        );
+        assert_matches!(
+            pool.set_fs_growth_policy(pool_name, infos[0].1, policy),
+            Ok(PropChangeAction::NewValue(_))
+        );
+        assert_eq!(
+            pool.get_filesystem(infos[0].1).unwrap().1.growth_policy(),
+            policy
+        );
+        assert_matches!(
+            pool.set_fs_growth_policy(pool_name, infos[0].1, policy),
+            Ok(PropChangeAction::Identity)
+        );
+        assert!(pool
+            .set_fs_growth_policy(pool_name, FilesystemUuid::new_v4(), policy)
+            .is_err());
+    }
+
+    #[test]
+    /// Setting the allocation policy of a pool is idempotent
+    fn set_alloc_policy() {
+        let mut engine = SimEngine::default();
+        let pool_name = "pool_name";
+        let uuid = engine
+            .create_pool(
+                pool_name,
+                strs_to_paths!(["/dev/one", "/dev/two", "/dev/three"]),
+                None,
+                &EncryptionInfo::default(),
+            )
+            .unwrap()
+            .changed()
+            .unwrap();
+        let pool = engine.get_mut_pool(uuid).unwrap().1;
+        assert_matches!(
+            pool.set_alloc_policy(pool_name, AllocPolicy::default()),
+            Ok(PropChangeAction::Identity)
+        );
+        assert_matches!(
+            pool.set_alloc_policy(pool_name, AllocPolicy::Spread),
+            Ok(PropChangeAction::NewValue(AllocPolicy::Spread))
+        );
+        assert_eq!(pool.alloc_policy(), AllocPolicy::Spread);
+        assert_matches!(
+            pool.set_alloc_policy(pool_name, AllocPolicy::Spread),
+            Ok(PropChangeAction::Identity)
+        );
+    }
+
     #[test]
     /// Renaming a filesystem to another filesystem should fail if new name taken
     fn rename_fails() {
@@ -850,6 +1064,58 @@ mod tests {
         assert!(!set_create_action.is_changed());
     }
 
+    #[test]
+    /// Snapshotting several filesystems at once creates a snapshot for each
+    /// name not already in use, and fails without creating any snapshots if
+    /// some origin does not exist.
+    fn snapshot_fs_some() {
+        let mut engine = SimEngine::default();
+        let pool_name = "pool_name";
+        let uuid = engine
+            .create_pool(
+                pool_name,
+                strs_to_paths!(["/dev/one", "/dev/two", "/dev/three"]),
+                None,
+                &EncryptionInfo::default(),
+            )
+            .unwrap()
+            .changed()
+            .unwrap();
+        let pool = engine.get_mut_pool(uuid).unwrap().1;
+        let origins = pool
+            .create_filesystems(pool_name, uuid, &[("one", None), ("two", None)])
+            .unwrap()
+            .changed()
+            .unwrap()
+            .into_iter()
+            .map(|(_, fs_uuid)| fs_uuid)
+            .collect::<Vec<_>>();
+
+        assert_matches!(
+            pool.snapshot_filesystems(
+                pool_name,
+                uuid,
+                &[(origins[0], "snap"), (FilesystemUuid::new_v4(), "other")]
+            ),
+            Err(_)
+        );
+        assert!(pool
+            .get_filesystem_by_name(&Name::new("snap".into()))
+            .is_none());
+
+        let created = pool
+            .snapshot_filesystems(
+                pool_name,
+                uuid,
+                &[(origins[0], "snap"), (origins[1], "two")],
+            )
+            .unwrap()
+            .changed()
+            .unwrap();
+        assert_eq!(created.len(), 1);
+        assert_eq!(created[0].0, "snap");
+    }
+
     #[test]
     /// Requesting identical filesystems succeeds.
     fn create_fs_dups() {
@@ -9,13 +9,13 @@ use std::{borrow::Cow, cmp, path::Path};
 use chrono::{DateTime, Utc};
 use serde_json::Value;
 
-use devicemapper::{CacheDev, Device, DmDevice, LinearDev, Sectors};
+use devicemapper::{CacheDev, CacheDevStatus, DevId, Device, DmDevice, LinearDev, Sectors};
 
 use crate::{
     engine::{
         strat_engine::{
             backstore::{
-                blockdev::StratBlockDev,
+                blockdev::{StratBlockDev, StratBlockDevReport},
                 blockdevmgr::{map_to_dm, BlockDevMgr},
                 cache_tier::CacheTier,
                 data_tier::DataTier,
@@ -26,17 +26,30 @@ use crate::{
             serde_structs::{BackstoreSave, CapSave, Recordable},
             writing::wipe_sectors,
         },
-        types::{BlockDevTier, DevUuid, EncryptionInfo, KeyDescription, PoolUuid},
+        types::{
+            AllocPolicy, BlockDevTier, CacheSettings, CacheStats, DevUuid, EncryptionInfo,
+            KeyDescription, PoolUuid,
+        },
     },
     stratis::{StratisError, StratisResult},
 };
 
-/// Use a cache block size that the kernel docs indicate is the largest
-/// typical size.
-const CACHE_BLOCK_SIZE: Sectors = Sectors(2048); // 1024 KiB
+// The migration threshold that the kernel uses if none is specified
+const DEFAULT_MIGRATION_THRESHOLD: Sectors = Sectors(2048);
+
+/// Send the migration threshold message to the cache policy of the cache
+/// device.
+fn set_migration_threshold(cache: &CacheDev, threshold: Sectors) -> StratisResult<()> {
+    get_dm().target_msg(
+        &DevId::Name(cache.name()),
+        None,
+        &format!("migration_threshold {}", *threshold),
+    )?;
+    Ok(())
+}
 
-/// Make a DM cache device. If the cache device is being made new,
-/// take extra steps to make it clean.
+/// Make a DM cache device with the settings of the cache tier. If the cache
+/// device is being made new, take extra steps to make it clean.
 fn make_cache(
     pool_uuid: PoolUuid,
     cache_tier: &CacheTier,
@@ -69,15 +82,22 @@ fn make_cache(
     )?;
 
     let (dm_name, dm_uuid) = format_backstore_ids(pool_uuid, CacheRole::Cache);
-    Ok(CacheDev::setup(
+    let cache = CacheDev::setup(
         get_dm(),
         &dm_name,
         Some(&dm_uuid),
         meta,
         cache,
         origin,
-        CACHE_BLOCK_SIZE,
-    )?)
+        cache_tier.settings.block_size,
+    )?;
+
+    // The migration threshold is not part of the table, so it must be set
+    // again whenever the device is set up.
+    if let Some(threshold) = cache_tier.settings.migration_threshold {
+        set_migration_threshold(&cache, threshold)?;
+    }
+    Ok(cache)
 }
 
 /// This structure can allocate additional space to the upper layer, but it
@@ -196,7 +216,8 @@ impl Backstore {
         })
     }
 
-    /// Initialize the cache tier and add cachedevs to the backstore.
+    /// Initialize the cache tier with the given settings and add cachedevs
+    /// to the backstore.
     ///
     /// Returns all `DevUuid`s of devices that were added to the cache on initialization.
     ///
@@ -208,6 +229,7 @@ impl Backstore {
         &mut self,
         pool_uuid: PoolUuid,
         paths: &[&Path],
+        settings: CacheSettings,
     ) -> StratisResult<Vec<DevUuid>> {
         match self.cache_tier {
             Some(_) => unreachable!("self.cache.is_none()"),
@@ -230,7 +252,7 @@ impl Backstore {
                     &EncryptionInfo::default(),
                 )?;
 
-                let cache_tier = CacheTier::new(bdm)?;
+                let cache_tier = CacheTier::new(bdm, settings)?;
 
                 let linear = self.linear
                     .take()
@@ -300,6 +322,110 @@ impl Backstore {
         }
     }
 
+    /// The settings of the cache, if there is one.
+    pub fn cache_settings(&self) -> Option<CacheSettings> {
+        self.cache_tier.as_ref().map(|c| c.settings)
+    }
+
+    /// Set the migration threshold of the cache while it is in use. Return
+    /// true if the threshold was changed.
+    /// WARNING: metadata changing event
+    pub fn set_cache_migration_threshold(&mut self, threshold: Sectors) -> StratisResult<bool> {
+        match (self.cache_tier.as_mut(), self.cache.as_ref()) {
+            (Some(cache_tier), Some(cache)) => {
+                if cache_tier.settings.migration_threshold == Some(threshold) {
+                    return Ok(false);
+                }
+                let settings = CacheSettings {
+                    migration_threshold: Some(threshold),
+                    ..cache_tier.settings
+                };
+                settings.validate()?;
+                set_migration_threshold(cache, threshold)?;
+                cache_tier.settings = settings;
+                Ok(true)
+            }
+            _ => Err(StratisError::Msg(
+                "The cache has not been initialized; there is no migration threshold to set"
+                    .to_string(),
+            )),
+        }
+    }
+
+    /// The policy by which space is allocated from the data tier.
+    pub fn alloc_policy(&self) -> AllocPolicy {
+        self.data_tier.block_mgr.alloc_policy()
+    }
+
+    /// Set the policy by which space is allocated from the data tier.
+    /// WARNING: metadata changing event
+    pub fn set_alloc_policy(&mut self, policy: AllocPolicy) {
+        self.data_tier.block_mgr.set_alloc_policy(policy)
+    }
+
+    /// Restore the migration threshold of the cache, which was threshold
+    /// before set_cache_migration_threshold() changed it. If threshold is
+    /// None, the kernel default is restored. If the kernel rejects the
+    /// threshold, the settings are left unchanged, so that they still agree
+    /// with the threshold in use.
+    pub fn restore_cache_migration_threshold(
+        &mut self,
+        threshold: Option<Sectors>,
+    ) -> StratisResult<()> {
+        match (self.cache_tier.as_mut(), self.cache.as_ref()) {
+            (Some(cache_tier), Some(cache)) => {
+                set_migration_threshold(cache, threshold.unwrap_or(DEFAULT_MIGRATION_THRESHOLD))?;
+                cache_tier.settings.migration_threshold = threshold;
+                Ok(())
+            }
+            _ => Err(StratisError::Msg(
+                "The cache has not been initialized; there is no migration threshold to restore"
+                    .to_string(),
+            )),
+        }
+    }
+
+    /// Read the statistics of the cache from its status, if there is a
+    /// cache.
+    pub fn cache_stats(&self) -> StratisResult<Option<CacheStats>> {
+        let cache = match self.cache.as_ref() {
+            Some(cache) => cache,
+            None => return Ok(None),
+        };
+        match cache.status(get_dm())? {
+            CacheDevStatus::Working(status) => {
+                let write_mode = status
+                    .feature_args
+                    .iter()
+                    .find(|arg| {
+                        ["writeback", "writethrough", "passthrough"].contains(&arg.as_str())
+                    })
+                    .cloned()
+                    // This is the kernel's default when no mode is given.
+                    .unwrap_or_else(|| "writethrough".to_string());
+                Ok(Some(CacheStats {
+                    read_hits: status.performance.read_hits,
+                    read_misses: status.performance.read_misses,
+                    write_hits: status.performance.write_hits,
+                    write_misses: status.performance.write_misses,
+                    promotions: status.performance.promotions,
+                    demotions: status.performance.demotions,
+                    dirty: status.performance.dirty,
+                    used_blocks: *status.usage.used_cache,
+                    total_blocks: *status.usage.total_cache,
+                    policy: status.policy,
+                    write_mode,
+                }))
+            }
+            CacheDevStatus::Error => Err(StratisError::Msg(
+                "The status of the cache could not be obtained".to_string(),
+            )),
+            CacheDevStatus::Fail => Err(StratisError::Msg(
+                "The cache is in a failed state".to_string(),
+            )),
+        }
+    }
+
     /// Add datadevs to the backstore. The data tier always exists if the
     /// backstore exists at all, so there is no need to create it.
     pub fn add_datadevs(
@@ -684,22 +810,28 @@ impl Backstore {
     }
 }
 
-impl<'a> Into<Value> for &'a Backstore {
-    fn into(self) -> Value {
-        json!({
-            "blockdevs": {
-                "datadevs": Value::Array(
-                    self.datadevs().into_iter().map(|(_, dev)| {
-                        dev.into()
-                    }).collect()
-                ),
-                "cachedevs": Value::Array(
-                    self.cachedevs().into_iter().map(|(_, dev)| {
-                        dev.into()
-                    }).collect()
-                ),
-            }
-        })
+/// The block devices of a backstore as they appear in the engine state
+/// report. Fields are declared in the order in which they are reported.
+#[derive(Serialize)]
+pub struct BackstoreReport<'a> {
+    cachedevs: Vec<StratBlockDevReport<'a>>,
+    datadevs: Vec<StratBlockDevReport<'a>>,
+}
+
+impl<'a> From<&'a Backstore> for BackstoreReport<'a> {
+    fn from(backstore: &'a Backstore) -> BackstoreReport<'a> {
+        BackstoreReport {
+            cachedevs: backstore
+                .cachedevs()
+                .into_iter()
+                .map(|(_, dev)| StratBlockDevReport::from(dev))
+                .collect(),
+            datadevs: backstore
+                .datadevs()
+                .into_iter()
+                .map(|(_, dev)| StratBlockDevReport::from(dev))
+                .collect(),
+        }
     }
 }
 
@@ -719,17 +851,18 @@ impl Recordable<BackstoreSave> for Backstore {
 mod tests {
     use std::fs::OpenOptions;
 
-    use devicemapper::{CacheDevStatus, DataBlocks, IEC};
+    use devicemapper::{DataBlocks, IEC};
 
     use crate::engine::strat_engine::{
         cmd,
         metadata::device_identifiers,
         tests::{loopbacked, real},
     };
+    use crate::engine::types::DEFAULT_CACHE_BLOCK_SIZE;
 
     use super::*;
 
-    const INITIAL_BACKSTORE_ALLOCATION: Sectors = CACHE_BLOCK_SIZE;
+    const INITIAL_BACKSTORE_ALLOCATION: Sectors = DEFAULT_CACHE_BLOCK_SIZE;
 
     /// Assert some invariants of the backstore
     /// * backstore.cache_tier.is_some() <=> backstore.cache.is_some() &&
@@ -786,12 +919,39 @@ mod tests {
             .alloc(pool_uuid, &[INITIAL_BACKSTORE_ALLOCATION])
             .unwrap();
 
-        let cache_uuids = backstore.init_cache(pool_uuid, initcachepaths).unwrap();
+        let settings = CacheSettings {
+            block_size: Sectors(1024),
+            migration_threshold: Some(Sectors(4096)),
+        };
+        let cache_uuids = backstore
+            .init_cache(pool_uuid, initcachepaths, settings)
+            .unwrap();
 
         invariant(&backstore);
 
         assert_eq!(cache_uuids.len(), initcachepaths.len());
         assert_matches!(backstore.linear, None);
+        assert_eq!(backstore.cache_settings(), Some(settings));
+        assert_eq!(
+            backstore.record().cache_tier.unwrap().block_size,
+            Some(Sectors(1024))
+        );
+
+        assert!(!backstore
+            .set_cache_migration_threshold(Sectors(4096))
+            .unwrap());
+        assert!(backstore
+            .set_cache_migration_threshold(Sectors(8192))
+            .unwrap());
+        assert_matches!(
+            backstore.set_cache_migration_threshold(Sectors(512)),
+            Err(_)
+        );
+
+        let stats = backstore.cache_stats().unwrap().unwrap();
+        assert_eq!(stats.used_blocks, 0);
+        assert!(stats.total_blocks > 0);
+        assert_eq!(stats.dirty, 0);
 
         let cache_status = backstore
             .cache
@@ -951,7 +1111,9 @@ mod tests {
 
         let old_device = backstore.device();
 
-        backstore.init_cache(pool_uuid, paths2).unwrap();
+        backstore
+            .init_cache(pool_uuid, paths2, CacheSettings::default())
+            .unwrap();
 
         for path in paths2 {
             assert_eq!(
@@ -19,7 +19,7 @@ use crate::{
                 crypt::CryptHandle,
                 range_alloc::{PerDevSegments, RangeAllocator},
             },
-            metadata::{disown_device, BDAExtendedSize, BlockdevSize, MDADataSize, BDA},
+            metadata::{disown_device, BDAExtendedSize, BlockdevSize, MDADataSize, MDAWrite, BDA},
             serde_structs::{BaseBlockDevSave, Recordable},
         },
         types::{DevUuid, DevicePath, EncryptionInfo, KeyDescription, PoolUuid},
@@ -27,7 +27,7 @@ use crate::{
     stratis::{StratisError, StratisResult},
 };
 
-#[derive(Debug)]
+#[derive(Clone, Debug)]
 pub enum UnderlyingDevice {
     Encrypted(CryptHandle),
     Unencrypted(DevicePath),
@@ -61,6 +61,28 @@ impl UnderlyingDevice {
             UnderlyingDevice::Unencrypted(_) => None,
         }
     }
+
+    /// Remove information that identifies this device as belonging to Stratis
+    ///
+    /// If the device is encrypted, destroy all keyslots and wipe the LUKS2 header.
+    /// This will render all Stratis and LUKS2 metadata unreadable and unrecoverable
+    /// from the given device.
+    ///
+    /// If the device is not encrypted, wipe the Stratis metadata on the device.
+    /// This will make the Stratis data and metadata invisible to all standard blkid
+    /// and stratisd operations.
+    ///
+    /// Precondition: if the device is encrypted, the data on
+    ///               self.physical_path() has been encrypted with
+    ///               aes-xts-plain64 encryption.
+    pub fn disown(&self) -> StratisResult<()> {
+        match self {
+            UnderlyingDevice::Encrypted(handle) => handle.wipe(),
+            UnderlyingDevice::Unencrypted(path) => {
+                disown_device(&mut OpenOptions::new().write(true).open(&**path)?)
+            }
+        }
+    }
 }
 
 #[derive(Debug)]
@@ -135,37 +157,26 @@ impl StratBlockDev {
         self.underlying_device.metadata_path()
     }
 
-    /// Remove information that identifies this device as belonging to Stratis
-    ///
-    /// If self.is_encrypted() is true, destroy all keyslots and wipe the LUKS2 header.
-    /// This will render all Stratis and LUKS2 metadata unreadable and unrecoverable
-    /// from the given device.
-    ///
-    /// If self.is_encrypted() is false, wipe the Stratis metadata on the device.
-    /// This will make the Stratis data and metadata invisible to all standard blkid
-    /// and stratisd operations.
-    ///
-    /// Precondition: if self.is_encrypted() == true, the data on
-    ///               self.devnode.physical_path() has been encrypted with
-    ///               aes-xts-plain64 encryption.
-    pub fn disown(&mut self) -> StratisResult<()> {
-        if let Some(ref mut handle) = self.underlying_device.crypt_handle_mut() {
-            handle.wipe()?;
-        } else {
-            disown_device(
-                &mut OpenOptions::new()
-                    .write(true)
-                    .open(self.underlying_device.physical_path())?,
-            )?;
-        }
-        Ok(())
+    /// The device on which this blockdev is stored: the unencrypted device,
+    /// or the encryption handle through which the device is accessed.
+    pub fn underlying_device(&self) -> &UnderlyingDevice {
+        &self.underlying_device
     }
 
-    pub fn save_state(&mut self, time: &DateTime<Utc>, metadata: &[u8]) -> StratisResult<()> {
-        let mut f = OpenOptions::new()
-            .write(true)
-            .open(self.underlying_device.metadata_path())?;
-        self.bda.save_state(time, metadata, &mut f)
+    /// Prepare a write of metadata to this blockdev, which may be made on
+    /// another thread by writing to metadata_path(). If the write succeeds,
+    /// it must be recorded with finish_save_state().
+    pub fn prepare_save_state(
+        &self,
+        time: &DateTime<Utc>,
+        metadata: &[u8],
+    ) -> StratisResult<MDAWrite> {
+        self.bda.prepare_save(time, metadata)
+    }
+
+    /// Record a write prepared by prepare_save_state() which has been made.
+    pub fn finish_save_state(&mut self, write: MDAWrite) {
+        self.bda.finish_save(write)
     }
 
     /// The pool's UUID.
@@ -288,26 +299,37 @@ impl StratBlockDev {
     }
 }
 
-impl<'a> Into<Value> for &'a StratBlockDev {
-    fn into(self) -> Value {
-        let mut json = json!({
-            "path": self.underlying_device.physical_path(),
-            "uuid": self.bda.dev_uuid().to_string(),
-        });
-        let map = json.as_object_mut().expect("just created above");
-        if let Some(encryption_info) = self
+/// A block device as it appears in the engine state report, borrowed from
+/// the block device so that it can be serialized without being copied.
+/// Fields are declared in the order in which they are reported.
+#[derive(Serialize)]
+pub struct StratBlockDevReport<'a> {
+    #[serde(skip_serializing_if = "Option::is_none")]
+    clevis_config: Option<&'a Value>,
+    #[serde(skip_serializing_if = "Option::is_none")]
+    clevis_pin: Option<&'a str>,
+    #[serde(skip_serializing_if = "Option::is_none")]
+    key_description: Option<&'a str>,
+    path: &'a Path,
+    uuid: DevUuid,
+}
+
+impl<'a> From<&'a StratBlockDev> for StratBlockDevReport<'a> {
+    fn from(dev: &'a StratBlockDev) -> StratBlockDevReport<'a> {
+        let encryption_info = dev
             .underlying_device
             .crypt_handle()
-            .map(|ch| ch.encryption_info())
-        {
-            if let Value::Object(enc_map) = <&EncryptionInfo as Into<Value>>::into(encryption_info)
-            {
-                map.extend(enc_map);
-            } else {
-                unreachable!("EncryptionInfo conversion returns a JSON object");
-            };
+            .map(|ch| ch.encryption_info());
+        let clevis_info = encryption_info.and_then(|info| info.clevis_info.as_ref());
+        StratBlockDevReport {
+            clevis_config: clevis_info.map(|(_, config)| config),
+            clevis_pin: clevis_info.map(|(pin, _)| pin.as_str()),
+            key_description: encryption_info
+                .and_then(|info| info.key_description.as_ref())
+                .map(|kd| kd.as_application_str()),
+            path: dev.underlying_device.physical_path(),
+            uuid: dev.bda.dev_uuid(),
         }
-        json
     }
 }
 
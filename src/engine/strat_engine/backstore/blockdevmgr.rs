@@ -6,8 +6,9 @@
 
 use std::{
     borrow::Cow,
-    collections::{HashMap, HashSet},
-    fs,
+    cmp::min,
+    collections::{BTreeMap, BTreeSet, HashMap, HashSet},
+    fs::{self, OpenOptions},
     path::Path,
 };
 
@@ -30,9 +31,10 @@ use crate::{
                 devices::{initialize_devices, process_and_verify_devices, wipe_blockdevs},
             },
             metadata::MDADataSize,
+            parallel::bounded_map,
             serde_structs::{BaseBlockDevSave, BaseDevSave, Recordable},
         },
-        types::{DevUuid, EncryptionInfo, KeyDescription, PoolUuid},
+        types::{AllocPolicy, DevUuid, EncryptionInfo, KeyDescription, PoolUuid},
     },
     stratis::{StratisError, StratisResult},
 };
@@ -114,6 +116,104 @@ pub fn map_to_dm(bsegs: &[BlkDevSegment]) -> Vec<TargetLine<LinearDevTargetParam
     table
 }
 
+/// An index of the block devices in a BlockDevMgr which have some space
+/// available for allocation. Block devices are identified by their position
+/// in the BlockDevMgr's list of block devices. The index must be updated
+/// whenever the available space on one of the block devices changes.
+#[derive(Debug, Default)]
+struct FreeSpaceIndex {
+    /// Available sectors for each block device with any space available,
+    /// ordered by position.
+    by_position: BTreeMap<usize, Sectors>,
+    /// The same block devices, ordered by available sectors, and then by
+    /// position.
+    by_size: BTreeSet<(Sectors, usize)>,
+    /// The sum of the available sectors of all the block devices.
+    total: Sectors,
+}
+
+impl FreeSpaceIndex {
+    /// Build an index from the amount of space available on each block
+    /// device.
+    fn new<I>(available: I) -> FreeSpaceIndex
+    where
+        I: IntoIterator<Item = Sectors>,
+    {
+        let mut index = FreeSpaceIndex::default();
+        for (position, avail) in available.into_iter().enumerate() {
+            index.update(position, avail);
+        }
+        index
+    }
+
+    /// Record that the block device at position now has avail sectors
+    /// available.
+    fn update(&mut self, position: usize, avail: Sectors) {
+        if let Some(old) = self.by_position.remove(&position) {
+            self.by_size.remove(&(old, position));
+            self.total -= old;
+        }
+        if avail != Sectors(0) {
+            self.by_position.insert(position, avail);
+            self.by_size.insert((avail, position));
+            self.total += avail;
+        }
+    }
+
+    /// The total number of sectors available on all block devices.
+    fn total(&self) -> Sectors {
+        self.total
+    }
+
+    /// Decide how much space to request from each block device in order to
+    /// satisfy a request for amount sectors according to policy. Only block
+    /// devices with some space available are considered. No block device is
+    /// asked for more space than it has available.
+    ///
+    /// Postcondition: the sum of the amounts in the result is
+    /// min(amount, self.total()).
+    fn plan(&self, policy: AllocPolicy, amount: Sectors) -> Vec<(usize, Sectors)> {
+        let mut remaining = amount;
+        let mut plan = Vec::new();
+        match policy {
+            AllocPolicy::FillFirst | AllocPolicy::LargestFree => {
+                let candidates: Box<dyn Iterator<Item = (usize, Sectors)>> =
+                    if policy == AllocPolicy::FillFirst {
+                        Box::new(self.by_position.iter().map(|(&pos, &avail)| (pos, avail)))
+                    } else {
+                        Box::new(self.by_size.iter().rev().map(|&(avail, pos)| (pos, avail)))
+                    };
+                for (position, avail) in candidates {
+                    if remaining == Sectors(0) {
+                        break;
+                    }
+                    let to_use = min(remaining, avail);
+                    plan.push((position, to_use));
+                    remaining -= to_use;
+                }
+            }
+            AllocPolicy::Spread => {
+                // Visit the devices with the least space first, so that
+                // whatever share a small device can not provide is divided
+                // among the remaining larger devices.
+                let num_devs = self.by_size.len() as u64;
+                for (visited, &(avail, position)) in self.by_size.iter().enumerate() {
+                    if remaining == Sectors(0) {
+                        break;
+                    }
+                    let devs_left = num_devs - visited as u64;
+                    let share = Sectors((*remaining + devs_left - 1) / devs_left);
+                    let to_use = min(share, avail);
+                    plan.push((position, to_use));
+                    remaining -= to_use;
+                }
+                plan.sort_unstable_by_key(|&(position, _)| position);
+            }
+        }
+        plan
+    }
+}
+
 #[derive(Debug)]
 pub struct BlockDevMgr {
     /// All the block devices that belong to this block dev manager.
@@ -121,6 +221,10 @@ pub struct BlockDevMgr {
     /// The most recent time that variable length metadata was saved to the
     /// devices managed by this block dev manager.
     last_update_time: Option<DateTime<Utc>>,
+    /// The block devices which have space available for allocation.
+    free_space: FreeSpaceIndex,
+    /// The policy used to choose block devices to allocate from.
+    alloc_policy: AllocPolicy,
 }
 
 impl BlockDevMgr {
@@ -129,12 +233,32 @@ impl BlockDevMgr {
         block_devs: Vec<StratBlockDev>,
         last_update_time: Option<DateTime<Utc>>,
     ) -> BlockDevMgr {
+        let free_space = FreeSpaceIndex::new(block_devs.iter().map(|bd| bd.available()));
         BlockDevMgr {
             block_devs,
             last_update_time,
+            free_space,
+            alloc_policy: AllocPolicy::default(),
         }
     }
 
+    /// The policy used to choose block devices to allocate from.
+    pub fn alloc_policy(&self) -> AllocPolicy {
+        self.alloc_policy
+    }
+
+    /// Set the policy used to choose block devices to allocate from. The
+    /// policy applies only to subsequent allocations.
+    pub fn set_alloc_policy(&mut self, policy: AllocPolicy) {
+        self.alloc_policy = policy;
+    }
+
+    /// Recompute the index of free space from scratch. This is required
+    /// whenever the positions of the block devices in self.block_devs change.
+    fn rebuild_free_space(&mut self) {
+        self.free_space = FreeSpaceIndex::new(self.block_devs.iter().map(|bd| bd.available()));
+    }
+
     /// Initialize a new StratBlockDevMgr with specified pool and devices.
     pub fn initialize(
         pool_uuid: PoolUuid,
@@ -210,12 +334,16 @@ impl BlockDevMgr {
         // saved.
         let bds = initialize_devices(devices, pool_uuid, MDADataSize::default(), &encryption_info)?;
         let bdev_uuids = bds.iter().map(|bd| bd.uuid()).collect();
-        self.block_devs.extend(bds);
+        for bd in bds {
+            self.free_space
+                .update(self.block_devs.len(), bd.available());
+            self.block_devs.push(bd);
+        }
         Ok(bdev_uuids)
     }
 
     pub fn destroy_all(&mut self) -> StratisResult<()> {
-        wipe_blockdevs(&mut self.block_devs)
+        wipe_blockdevs(&self.block_devs)
     }
 
     /// Remove the specified block devs and erase their metadata.
@@ -245,13 +373,15 @@ impl BlockDevMgr {
                 }
             }
             if !found {
+                self.rebuild_free_space();
                 return Err(StratisError::Msg(format!(
                     "Blockdev corresponding to UUID: {} not found.",
                     uuid
                 )));
             }
         }
-        wipe_blockdevs(&mut removed)?;
+        self.rebuild_free_space();
+        wipe_blockdevs(&removed)?;
         Ok(())
     }
 
@@ -260,6 +390,9 @@ impl BlockDevMgr {
     /// not possible to satisfy the request.
     /// This method is atomic, it either allocates all requested or allocates
     /// nothing.
+    ///
+    /// Only block devices which have some space available are visited; which
+    /// of them are allocated from is determined by self.alloc_policy().
     pub fn alloc_space(&mut self, sizes: &[Sectors]) -> Option<Vec<Vec<BlkDevSegment>>> {
         let total_needed: Sectors = sizes.iter().cloned().sum();
         if self.avail_space() < total_needed {
@@ -270,24 +403,15 @@ impl BlockDevMgr {
         for &needed in sizes {
             let mut alloc = Sectors(0);
             let mut segs = Vec::new();
-            // TODO: Consider greater efficiency for allocation generally.
-            // Over time, the blockdevs at the start will be exhausted. It
-            // might be a good idea to keep an auxiliary structure, so that
-            // only blockdevs with some space left to allocate are accessed.
-            // In the context of this major inefficiency that ensues over time
-            // the obvious but more minor inefficiency of this inner loop is
-            // not worth worrying about.
-            for bd in &mut self.block_devs {
-                if alloc == needed {
-                    break;
-                }
-
-                let r_segs = bd.request_space(needed - alloc);
+            for (position, amount) in self.free_space.plan(self.alloc_policy, needed) {
+                let bd = &mut self.block_devs[position];
+                let r_segs = bd.request_space(amount);
                 let blkdev_segs = r_segs.iter().map(|(&start, &length)| {
                     BlkDevSegment::new(bd.uuid(), Segment::new(*bd.device(), start, length))
                 });
                 segs.extend(blkdev_segs);
                 alloc += r_segs.sum();
+                self.free_space.update(position, bd.available());
             }
             assert_eq!(alloc, needed);
             lists.push(segs);
@@ -315,19 +439,60 @@ impl BlockDevMgr {
         };
 
         let data_size = Bytes::from(metadata.len());
-        let candidates = self
-            .block_devs
-            .iter_mut()
-            .filter(|b| b.max_metadata_size().bytes() >= data_size);
+        let block_devs = &self.block_devs;
+        let candidates = (0..block_devs.len())
+            .filter(|index| block_devs[*index].max_metadata_size().bytes() >= data_size);
 
         // TODO: consider making selection not entirely random, i.e, ensuring
         // distribution of metadata over different paths.
-        let saved = candidates
-            .choose_multiple(&mut thread_rng(), MAX_NUM_TO_WRITE)
-            .iter_mut()
-            .fold(false, |acc, b| {
-                acc | b.save_state(&stamp_time, metadata).is_ok()
-            });
+        let selected = candidates.choose_multiple(&mut thread_rng(), MAX_NUM_TO_WRITE);
+
+        // The metadata is written to the selected blockdevs concurrently, so
+        // that a commit takes about as long as a write to a single device.
+        // Each write is prepared here and made on a worker thread, which
+        // owns everything it writes, so the blockdevs stay in place; the
+        // writes which succeed are recorded afterwards.
+        let mut saved = false;
+        let to_write = selected
+            .into_iter()
+            .filter_map(|index| {
+                let bd = &self.block_devs[index];
+                match bd.prepare_save_state(&stamp_time, metadata) {
+                    Ok(write) => Some((index, bd.metadata_path().to_owned(), write)),
+                    Err(err) => {
+                        warn!(
+                            "Failed to save metadata to block device {}: {}",
+                            bd.physical_path().display(),
+                            err
+                        );
+                        None
+                    }
+                }
+            })
+            .collect::<Vec<_>>();
+        let results = bounded_map(to_write, MAX_NUM_TO_WRITE, |(index, path, write)| {
+            let result = OpenOptions::new()
+                .write(true)
+                .open(&path)
+                .map_err(StratisError::from)
+                .and_then(|mut f| write.write_to(&mut f));
+            (index, write, result)
+        });
+
+        for (index, write, result) in results {
+            let bd = &mut self.block_devs[index];
+            match result {
+                Ok(()) => {
+                    bd.finish_save_state(write);
+                    saved = true;
+                }
+                Err(err) => warn!(
+                    "Failed to save metadata to block device {}: {}",
+                    bd.physical_path().display(),
+                    err
+                ),
+            }
+        }
 
         if saved {
             self.last_update_time = Some(stamp_time);
@@ -362,7 +527,7 @@ impl BlockDevMgr {
 
     /// The number of sectors not allocated for any purpose.
     pub fn avail_space(&self) -> Sectors {
-        self.block_devs.iter().map(|bd| bd.available()).sum()
+        self.free_space.total()
     }
 
     /// The current size of all the blockdevs.
@@ -425,6 +590,12 @@ impl BlockDevMgr {
             let info_set = encryption_infos.iter().collect::<HashSet<_>>();
             assert!(info_set.len() == 1);
         }
+
+        // The index of free space agrees with the block devices
+        let free_space = FreeSpaceIndex::new(self.block_devs.iter().map(|bd| bd.available()));
+        assert_eq!(free_space.by_position, self.free_space.by_position);
+        assert_eq!(free_space.by_size, self.free_space.by_size);
+        assert_eq!(free_space.total, self.free_space.total);
     }
 
     /// Bind all devices in the given blockdev manager using the given clevis
@@ -723,17 +894,75 @@ impl Recordable<Vec<BaseBlockDevSave>> for BlockDevMgr {
 
 #[cfg(test)]
 mod tests {
-    use std::{env, error::Error, path::PathBuf};
+    use std::{env, error::Error, path::PathBuf, time::Instant};
 
-    use crate::engine::strat_engine::{
-        cmd,
-        keys::MemoryFilesystem,
-        names::KeyDescription,
-        tests::{crypt, loopbacked, real},
+    use crate::engine::{
+        bench,
+        strat_engine::{
+            cmd,
+            keys::MemoryFilesystem,
+            names::KeyDescription,
+            tests::{crypt, loopbacked, real},
+        },
     };
 
     use super::*;
 
+    /// Verify that the index of free space tracks updates and that every
+    /// policy plans allocations which use only available space and which sum
+    /// to the amount requested, or to all that is available.
+    #[test]
+    fn test_free_space_index() {
+        let mut index =
+            FreeSpaceIndex::new(vec![Sectors(10), Sectors(0), Sectors(40), Sectors(20)]);
+        assert_eq!(index.total(), Sectors(70));
+        assert_eq!(index.by_position.len(), 3);
+
+        for policy in &[
+            AllocPolicy::FillFirst,
+            AllocPolicy::Spread,
+            AllocPolicy::LargestFree,
+        ] {
+            for amount in &[
+                Sectors(0),
+                Sectors(1),
+                Sectors(25),
+                Sectors(70),
+                Sectors(100),
+            ] {
+                let plan = index.plan(*policy, *amount);
+                assert_eq!(
+                    plan.iter().map(|&(_, amount)| amount).sum::<Sectors>(),
+                    min(*amount, index.total())
+                );
+                assert!(plan
+                    .iter()
+                    .all(|&(position, amount)| amount <= index.by_position[&position]));
+            }
+        }
+
+        assert_eq!(
+            index.plan(AllocPolicy::FillFirst, Sectors(25)),
+            vec![(0, Sectors(10)), (2, Sectors(15))]
+        );
+        assert_eq!(
+            index.plan(AllocPolicy::LargestFree, Sectors(45)),
+            vec![(2, Sectors(40)), (3, Sectors(5))]
+        );
+        assert_eq!(
+            index.plan(AllocPolicy::Spread, Sectors(60)),
+            vec![(0, Sectors(10)), (2, Sectors(30)), (3, Sectors(20))]
+        );
+
+        index.update(0, Sectors(0));
+        index.update(1, Sectors(5));
+        assert_eq!(index.total(), Sectors(65));
+        assert_eq!(
+            index.plan(AllocPolicy::FillFirst, Sectors(10)),
+            vec![(1, Sectors(5)), (2, Sectors(5))]
+        );
+    }
+
     /// Verify that initially,
     /// size() - metadata_size() = avail_space().
     /// After 2 Sectors have been allocated, that amount must also be included
@@ -754,6 +983,26 @@ mod tests {
             mgr.avail_space() + allocated + mgr.metadata_size(),
             mgr.size()
         );
+        mgr.invariant();
+
+        let mut total_allocated = allocated;
+        for policy in &[AllocPolicy::Spread, AllocPolicy::LargestFree] {
+            mgr.set_alloc_policy(*policy);
+            assert_eq!(mgr.alloc_policy(), *policy);
+            let allocated = Sectors(mgr.avail_space().0 / 4);
+            mgr.alloc_space(&[allocated, allocated]).unwrap();
+            total_allocated += allocated + allocated;
+            assert_eq!(
+                mgr.avail_space() + total_allocated + mgr.metadata_size(),
+                mgr.size()
+            );
+            mgr.invariant();
+        }
+
+        assert!(mgr.alloc_space(&[mgr.avail_space() + Sectors(1)]).is_none());
+        mgr.alloc_space(&[mgr.avail_space()]).unwrap();
+        assert_eq!(mgr.avail_space(), Sectors(0));
+        mgr.invariant();
     }
 
     #[test]
@@ -1152,4 +1401,53 @@ mod tests {
             test_clevis_both_rollback,
         );
     }
+
+    /// Measure the cost of allocating space in small requests with each
+    /// allocation policy in turn.
+    fn bench_alloc_space(paths: &[&Path]) {
+        const MAX_REQUESTS: u64 = 20_000;
+        const POLICIES: [AllocPolicy; 3] = [
+            AllocPolicy::FillFirst,
+            AllocPolicy::Spread,
+            AllocPolicy::LargestFree,
+        ];
+
+        let mut mgr = BlockDevMgr::initialize(
+            PoolUuid::new_v4(),
+            paths,
+            MDADataSize::default(),
+            &EncryptionInfo::default(),
+        )
+        .unwrap();
+
+        let request = Sectors(8);
+        let num_requests = min(
+            mgr.avail_space().0 / request.0 / POLICIES.len() as u64,
+            MAX_REQUESTS,
+        );
+        for policy in POLICIES.iter() {
+            mgr.set_alloc_policy(*policy);
+            let start = Instant::now();
+            for _ in 0..num_requests {
+                mgr.alloc_space(&[request]).unwrap();
+            }
+            bench::report(
+                &format!("blockdevmgr/alloc_space/{:?}", policy),
+                paths.len() as u64,
+                num_requests,
+                start.elapsed(),
+            );
+        }
+        mgr.invariant();
+    }
+
+    #[test]
+    #[ignore]
+    /// Run with "make bench-loop".
+    fn bench_loop_alloc_space() {
+        loopbacked::test_with_spec(
+            &loopbacked::DeviceLimits::Range(1, 3, None),
+            bench_alloc_space,
+        );
+    }
 }
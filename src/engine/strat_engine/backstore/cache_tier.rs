@@ -18,18 +18,21 @@ use crate::{
             },
             serde_structs::{BaseDevSave, BlockDevSave, CacheTierSave, Recordable},
         },
-        types::{BlockDevTier, DevUuid, PoolUuid},
+        types::{BlockDevTier, CacheSettings, DevUuid, PoolUuid, DEFAULT_CACHE_BLOCK_SIZE},
     },
     stratis::{StratisError, StratisResult},
 };
 
-/// This is a temporary maximum cache size. In the future it will be possible
+/// Return the temporary maximum cache size. In the future it will be possible
 /// to dynamically increase the cache size beyond this limit. When this is
-/// achieved this constant definition should be removed. This choice of a
-/// maximum cache size is a function of the current values for the cache block
-/// size, 2 Ki-sectors, and the current value for the metadata sub-device size,
-/// 1 Mi-sectors.
-const MAX_CACHE_SIZE: Sectors = Sectors(32 * IEC::Ti / SECTOR_SIZE as u64);
+/// achieved this function should be removed. This choice of a maximum cache
+/// size is a function of the cache block size, by default 2 Ki-sectors, and
+/// the current value for the metadata sub-device size, 1 Mi-sectors, which
+/// bounds the number of cache blocks that can be tracked. Therefore the
+/// maximum scales with the cache block size.
+fn max_cache_size(block_size: Sectors) -> Sectors {
+    Sectors(32 * IEC::Ti / SECTOR_SIZE as u64 / *DEFAULT_CACHE_BLOCK_SIZE * *block_size)
+}
 
 /// Handles the cache devices.
 #[derive(Debug)]
@@ -42,6 +45,8 @@ pub struct CacheTier {
     /// The list of segments granted by block_mgr and used by the metadata
     /// device.
     pub meta_segments: Vec<BlkDevSegment>,
+    /// The settings with which the cache device is set up.
+    pub settings: CacheSettings,
 }
 
 impl CacheTier {
@@ -74,10 +79,19 @@ impl CacheTier {
             .map(&mapper)
             .collect::<StratisResult<Vec<_>>>()?;
 
+        let settings = CacheSettings {
+            block_size: cache_tier_save
+                .block_size
+                .unwrap_or(DEFAULT_CACHE_BLOCK_SIZE),
+            migration_threshold: cache_tier_save.migration_threshold,
+        };
+        settings.validate()?;
+
         Ok(CacheTier {
             block_mgr,
             cache_segments,
             meta_segments,
+            settings,
         })
     }
 
@@ -89,7 +103,8 @@ impl CacheTier {
     /// WARNING: metadata changing event
     ///
     /// Return an error if the addition of the cachedevs would result in a
-    /// cache with a cache sub-device size greater than 32 TiB.
+    /// cache with a cache sub-device size greater than the maximum for the
+    /// cache block size, 32 TiB for the default block size.
     ///
     // FIXME: That all segments on the newly added device are added to the
     // cache sub-device and none to the meta sub-device could lead to failure.
@@ -106,18 +121,19 @@ impl CacheTier {
 
         // FIXME: This check will become unnecessary when cache metadata device
         // can be increased dynamically.
+        let max_size = max_cache_size(self.settings.block_size);
         if avail_space
             + self
                 .cache_segments
                 .iter()
                 .map(|x| x.segment.length)
                 .sum::<Sectors>()
-            > MAX_CACHE_SIZE
+            > max_size
         {
             self.block_mgr.remove_blockdevs(&uuids)?;
             return Err(StratisError::Msg(format!(
                 "The size of the cache sub-device may not exceed {}",
-                MAX_CACHE_SIZE
+                max_size
             )));
         }
 
@@ -134,13 +150,19 @@ impl CacheTier {
         Ok((uuids, (true, false)))
     }
 
-    /// Setup a new CacheTier struct from the block_mgr.
+    /// Setup a new CacheTier struct from the block_mgr, with the given cache
+    /// settings.
     ///
     /// Returns an error if the block devices passed would make the cache
     /// sub-device too big.
     ///
     /// WARNING: metadata changing event
-    pub fn new(mut block_mgr: BlockDevMgr) -> StratisResult<CacheTier> {
+    pub fn new(mut block_mgr: BlockDevMgr, settings: CacheSettings) -> StratisResult<CacheTier> {
+        if let Err(err) = settings.validate() {
+            block_mgr.destroy_all()?;
+            return Err(err);
+        }
+
         let avail_space = block_mgr.avail_space();
 
         // FIXME: Come up with a better way to choose metadata device size
@@ -153,11 +175,12 @@ impl CacheTier {
 
         // FIXME: This check will become unnecessary when cache metadata device
         // can be increased dynamically.
-        if avail_space - meta_space > MAX_CACHE_SIZE {
+        let max_size = max_cache_size(settings.block_size);
+        if avail_space - meta_space > max_size {
             block_mgr.destroy_all()?;
             return Err(StratisError::Msg(format!(
                 "The size of the cache sub-device may not exceed {}",
-                MAX_CACHE_SIZE
+                max_size
             )));
         }
 
@@ -172,6 +195,7 @@ impl CacheTier {
             block_mgr,
             cache_segments,
             meta_segments,
+            settings,
         })
     }
 
@@ -214,6 +238,9 @@ impl Recordable<CacheTierSave> for CacheTier {
                 allocs: vec![self.cache_segments.record(), self.meta_segments.record()],
                 devs: self.block_mgr.record(),
             },
+            block_size: Some(self.settings.block_size)
+                .filter(|size| *size != DEFAULT_CACHE_BLOCK_SIZE),
+            migration_threshold: self.settings.migration_threshold,
         }
     }
 }
@@ -249,7 +276,7 @@ mod tests {
         )
         .unwrap();
 
-        let mut cache_tier = CacheTier::new(mgr).unwrap();
+        let mut cache_tier = CacheTier::new(mgr, CacheSettings::default()).unwrap();
 
         // A cache tier w/ some devices and everything promptly allocated to
         // the tier.
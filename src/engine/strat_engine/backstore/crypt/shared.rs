@@ -21,6 +21,7 @@ use libcryptsetup_rs::{
 
 use crate::{
     engine::{
+        metrics::span,
         strat_engine::{
             backstore::crypt::{
                 consts::{
@@ -615,6 +616,7 @@ pub fn activate(
     unlock_param: Either<(&mut CryptDevice, &KeyDescription), &Path>,
     name: &str,
 ) -> StratisResult<PathBuf> {
+    let _span = span("crypt_activate");
     let crypt_device = match unlock_param {
         Either::Left((device, kd)) => {
             let key_description_missing = keys::search_key_persistent(kd)
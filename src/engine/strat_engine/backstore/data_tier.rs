@@ -18,7 +18,7 @@ use crate::{
             },
             serde_structs::{BaseDevSave, BlockDevSave, DataTierSave, Recordable},
         },
-        types::{BlockDevTier, DevUuid, PoolUuid},
+        types::{AllocPolicy, BlockDevTier, DevUuid, PoolUuid},
     },
     stratis::StratisResult,
 };
@@ -35,7 +35,10 @@ pub struct DataTier {
 impl DataTier {
     /// Setup a previously existing data layer from the block_mgr and
     /// previously allocated segments.
-    pub fn setup(block_mgr: BlockDevMgr, data_tier_save: &DataTierSave) -> StratisResult<DataTier> {
+    pub fn setup(
+        mut block_mgr: BlockDevMgr,
+        data_tier_save: &DataTierSave,
+    ) -> StratisResult<DataTier> {
         let uuid_to_devno = block_mgr.uuid_to_devno();
         let mapper = |ld: &BaseDevSave| -> StratisResult<BlkDevSegment> {
             metadata_to_segment(&uuid_to_devno, ld)
@@ -44,6 +47,7 @@ impl DataTier {
             .iter()
             .map(&mapper)
             .collect::<StratisResult<Vec<_>>>()?;
+        block_mgr.set_alloc_policy(data_tier_save.alloc_policy.unwrap_or_default());
 
         Ok(DataTier {
             block_mgr,
@@ -160,6 +164,8 @@ impl Recordable<DataTierSave> for DataTier {
                 allocs: vec![self.segments.record()],
                 devs: self.block_mgr.record(),
             },
+            alloc_policy: Some(self.block_mgr.alloc_policy())
+                .filter(|policy| *policy != AllocPolicy::default()),
         }
     }
 }
@@ -29,6 +29,7 @@ use crate::{
                 BDA,
             },
             names::KeyDescription,
+            parallel::{bounded_map, DEFAULT_PARALLELISM},
             udev::{block_device_apply, decide_ownership, get_udev_property, UdevOwnership},
         },
         types::{DevUuid, DevicePath, EncryptionInfo, PoolUuid},
@@ -374,7 +375,9 @@ pub fn process_and_verify_devices(
 }
 
 /// Initialze devices in devices.
-/// Clean up previously initialized devices if initialization of any single
+/// The devices are initialized concurrently, on no more than
+/// DEFAULT_PARALLELISM threads at once.
+/// Clean up all other initialized devices if initialization of any single
 /// device fails during initialization. Log at the warning level if cleanup
 /// fails.
 ///
@@ -607,35 +610,65 @@ pub fn initialize_devices(
         }
     }
 
+    // The devices are initialized concurrently. Each device that fails to
+    // initialize is cleaned up by initialize_one; if any device fails, all
+    // the devices that were initialized successfully are wiped.
+    let encryption_info = encryption_info.clone();
+    let results = bounded_map(devices, DEFAULT_PARALLELISM, move |dev_info| {
+        let result = initialize_one(&dev_info, pool_uuid, mda_data_size, &encryption_info);
+        (dev_info.devnode, result)
+    });
+
     let mut initialized_blockdevs: Vec<StratBlockDev> = Vec::new();
-    for dev_info in devices {
-        match initialize_one(&dev_info, pool_uuid, mda_data_size, encryption_info) {
+    let mut failures = Vec::new();
+    for (devnode, result) in results {
+        match result {
             Ok(blockdev) => initialized_blockdevs.push(blockdev),
-            Err(err) => {
-                if let Err(err) = wipe_blockdevs(&mut initialized_blockdevs) {
-                    warn!("Failed to clean up some devices after initialization of device {} for pool with UUID {} failed: {}",
-                          dev_info.devnode.display(),
-                          pool_uuid,
-                          err);
-                }
-                return Err(err);
+            Err(err) => failures.push((devnode, err)),
+        }
+    }
+
+    let mut failures = failures.into_iter();
+    match failures.next() {
+        None => Ok(initialized_blockdevs),
+        Some((devnode, err)) => {
+            for (devnode, err) in failures {
+                warn!(
+                    "Initialization of device {} for pool with UUID {} also failed: {}",
+                    devnode.display(),
+                    pool_uuid,
+                    err
+                );
             }
+            if let Err(err) = wipe_blockdevs(&initialized_blockdevs) {
+                warn!("Failed to clean up some devices after initialization of device {} for pool with UUID {} failed: {}",
+                      devnode.display(),
+                      pool_uuid,
+                      err);
+            }
+            Err(err)
         }
     }
-    Ok(initialized_blockdevs)
 }
 
 /// Wipe some blockdevs of their identifying headers.
 /// Return an error if any of the blockdevs could not be wiped.
 /// If an error occurs while wiping a blockdev, attempt to wipe all remaining.
-pub fn wipe_blockdevs(blockdevs: &mut [StratBlockDev]) -> StratisResult<()> {
-    let unerased_devnodes: Vec<_> = blockdevs
-        .iter_mut()
-        .filter_map(|bd| match bd.disown() {
-            Err(e) => Some((bd.physical_path(), e)),
-            _ => None,
-        })
-        .collect();
+/// The blockdevs are wiped concurrently.
+pub fn wipe_blockdevs(blockdevs: &[StratBlockDev]) -> StratisResult<()> {
+    let devices = blockdevs
+        .iter()
+        .map(|bd| bd.underlying_device().clone())
+        .collect::<Vec<_>>();
+    let unerased_devnodes: Vec<_> = bounded_map(devices, DEFAULT_PARALLELISM, |device| {
+        device
+            .disown()
+            .err()
+            .map(|e| (device.physical_path().to_owned(), e))
+    })
+    .into_iter()
+    .flatten()
+    .collect();
 
     if unerased_devnodes.is_empty() {
         Ok(())
@@ -691,7 +724,7 @@ mod tests {
             )));
         }
 
-        let mut blockdevs = initialize_devices(
+        let blockdevs = initialize_devices(
             dev_infos,
             pool_uuid,
             MDADataSize::default(),
@@ -807,7 +840,7 @@ mod tests {
                 )));
         }
 
-        wipe_blockdevs(&mut blockdevs)?;
+        wipe_blockdevs(&blockdevs)?;
 
         for path in paths {
             if key_description.is_some() {
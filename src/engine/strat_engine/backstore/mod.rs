@@ -14,7 +14,7 @@ mod range_alloc;
 mod shared;
 
 pub use self::{
-    backstore::Backstore,
+    backstore::{Backstore, BackstoreReport},
     blockdev::{StratBlockDev, UnderlyingDevice},
     crypt::{
         crypt_metadata_size, CryptActivationHandle, CryptHandle, CryptMetadataHandle,
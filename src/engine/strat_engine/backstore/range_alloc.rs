@@ -31,6 +31,8 @@ pub struct PerDevSegments {
     // Uses a BTReeMap so that an iteration over the elements in the tree
     // will be ordered by the value of the LHS.
     used: BTreeMap<Sectors, Sectors>,
+    // The sum of the lengths of all the ranges in used.
+    total: Sectors,
 }
 
 impl PerDevSegments {
@@ -40,6 +42,7 @@ impl PerDevSegments {
         PerDevSegments {
             limit,
             used: BTreeMap::new(),
+            total: Sectors(0),
         }
     }
 
@@ -50,7 +53,7 @@ impl PerDevSegments {
 
     /// The number of sectors occupied by all the ranges
     pub fn sum(&self) -> Sectors {
-        self.used.values().cloned().sum()
+        self.total
     }
 
     /// The boundary past which no allocation is considered.
@@ -68,18 +71,8 @@ impl PerDevSegments {
     // If LHS == RHS then they both equal value.
     // Postcondition: result == (None, None) <=> used.len() == 0
     fn locate_prev_and_next(&self, value: Sectors) -> (Option<Sectors>, Option<Sectors>) {
-        let mut prev = None;
-        let mut next = None;
-        for &key in self.used.keys() {
-            if value >= key {
-                prev = Some(key);
-            }
-            if value <= key {
-                next = Some(key);
-                break;
-            }
-        }
-
+        let prev = self.used.range(..=value).next_back().map(|(&key, _)| key);
+        let next = self.used.range(value..).next().map(|(&key, _)| key);
         (prev, next)
     }
 
@@ -204,6 +197,51 @@ impl PerDevSegments {
             self.used.insert(new_start, new_len).is_none(),
             "removed in previous steps if present"
         );
+        self.total += len;
+
+        Ok(())
+    }
+
+    /// Remove the specified range from self. The range must lie entirely
+    /// within a single range already in self; if it does not, return an
+    /// error and leave self unchanged. Removing a 0 length range has no
+    /// effect.
+    pub fn remove(&mut self, range: &(Sectors, Sectors)) -> StratisResult<()> {
+        let &(start, len) = range;
+
+        if len == Sectors(0) {
+            return Ok(());
+        }
+
+        let containing = self
+            .used
+            .range(..=start)
+            .next_back()
+            .map(|(&key, &val)| (key, val))
+            .filter(|&(key, val)| {
+                start
+                    .checked_add(len)
+                    .map(|end| end <= key + val)
+                    .unwrap_or(false)
+            });
+
+        let (key, val) = if let Some(containing) = containing {
+            containing
+        } else {
+            return Err(StratisError::Msg(format!(
+                "range to remove ({}, {}) is not wholly contained in any range",
+                start, len
+            )));
+        };
+
+        self.used.remove(&key);
+        if start > key {
+            self.used.insert(key, start - key);
+        }
+        if start + len < key + val {
+            self.used.insert(start + len, key + val - (start + len));
+        }
+        self.total -= len;
 
         Ok(())
     }
@@ -218,41 +256,19 @@ impl PerDevSegments {
             temp.insert(range)?;
         }
 
-        let union = self.union(&temp)?;
-
-        self.used = union.used;
-
-        Ok(())
-    }
-
-    /// Take the union of two PerDevSegments. Require that both PerDevSegments
-    /// objects have the same limit, for simplicity.
-    pub fn union(&self, other: &PerDevSegments) -> StratisResult<PerDevSegments> {
-        if self.limit != other.limit {
-            return Err(StratisError::Msg(
-                "limits differ between PerDevSegments structs, can not do a union".into(),
-            ));
+        // The ranges in temp are disjoint from each other, so if none of them
+        // overlaps any range in self, none of the insertions below can fail.
+        for (&start, &len) in temp.used.iter() {
+            let (prev, next) = self.locate_prev_and_next(start);
+            self.insertion_result(prev, next, &(start, len))?;
         }
 
-        let keys = self
-            .used
-            .keys()
-            .chain(other.used.keys())
-            .cloned()
-            .collect::<BTreeSet<Sectors>>();
-
-        let mut union = PerDevSegments::new(self.limit);
-
-        for key in keys.iter().rev() {
-            if let Some(val) = self.used.get(key) {
-                union.insert(&(*key, *val))?;
-            }
-            if let Some(val) = other.used.get(key) {
-                union.insert(&(*key, *val))?;
-            }
+        for (&start, &len) in temp.used.iter() {
+            self.insert(&(start, len))
+                .expect("verified to be disjoint from self");
         }
 
-        Ok(union)
+        Ok(())
     }
 
     /// A PerDevSegments object that is the complement of self, i.e., its
@@ -275,6 +291,7 @@ impl PerDevSegments {
         PerDevSegments {
             limit: self.limit,
             used: free,
+            total: self.limit - self.total,
         }
     }
 
@@ -297,10 +314,13 @@ impl PerDevSegments {
             .next()
             .map(|(s, l)| *s + *l <= self.limit)
             .unwrap_or(true));
+        // The cached sum is the sum of the lengths
+        assert_eq!(self.total, self.used.values().cloned().sum());
         // The complement really is the complement
         let same = self.complement().complement();
         assert_eq!(same.limit, self.limit);
         assert_eq!(same.used, self.used);
+        assert_eq!(same.total, self.total);
     }
 }
 
@@ -318,9 +338,52 @@ impl<'a> Iterator for Iter<'a> {
     }
 }
 
+/// The free ranges of a RangeAllocator, indexed both by their initial index
+/// and by their length, so that a request can be satisfied from the free
+/// ranges without first computing them from the used ranges.
+#[derive(Debug)]
+struct FreeExtents {
+    // The free ranges, ordered by their initial index.
+    by_start: PerDevSegments,
+    // The same ranges as (length, start) pairs, ordered by length and then
+    // by initial index.
+    by_len: BTreeSet<(Sectors, Sectors)>,
+}
+
+impl FreeExtents {
+    /// The free extents corresponding to the given used ranges.
+    fn new(used: &PerDevSegments) -> FreeExtents {
+        let by_start = used.complement();
+        let by_len = by_start.iter().map(|(&start, &len)| (len, start)).collect();
+        FreeExtents { by_start, by_len }
+    }
+
+    /// The smallest free range which can hold amount sectors, if any.
+    fn best_fit(&self, amount: Sectors) -> Option<(Sectors, Sectors)> {
+        self.by_len
+            .range((amount, Sectors(0))..)
+            .next()
+            .map(|&(len, start)| (start, len))
+    }
+
+    /// Take to_use sectors from the start of the free range beginning at
+    /// start.
+    /// Precondition: (start, len) is a free range and to_use <= len.
+    fn take(&mut self, start: Sectors, len: Sectors, to_use: Sectors) {
+        assert!(self.by_len.remove(&(len, start)));
+        if to_use < len {
+            self.by_len.insert((len - to_use, start + to_use));
+        }
+        self.by_start
+            .remove(&(start, to_use))
+            .expect("range to take is at the start of a free range");
+    }
+}
+
 #[derive(Debug)]
 pub struct RangeAllocator {
     segments: PerDevSegments,
+    free: FreeExtents,
 }
 
 impl RangeAllocator {
@@ -332,7 +395,8 @@ impl RangeAllocator {
     ) -> StratisResult<RangeAllocator> {
         let mut segments = PerDevSegments::new(limit.sectors());
         segments.insert_all(initial_used)?;
-        Ok(RangeAllocator { segments })
+        let free = FreeExtents::new(&segments);
+        Ok(RangeAllocator { segments, free })
     }
 
     /// The maximum allocation from this manager
@@ -350,58 +414,103 @@ impl RangeAllocator {
         self.segments.sum()
     }
 
+    /// Mark the specified ranges as used. Return an error if any of the
+    /// ranges is already in use, in which case nothing is marked.
+    #[cfg(test)]
+    fn insert_all(&mut self, ranges: &[(Sectors, Sectors)]) -> StratisResult<()> {
+        self.segments.insert_all(ranges)?;
+        self.free = FreeExtents::new(&self.segments);
+        Ok(())
+    }
+
     #[allow(dead_code)]
     /// Just allocate all the sectors that are available.
     pub fn request_all(&mut self) -> PerDevSegments {
-        let segs = self.segments.complement();
-
         let mut temp = PerDevSegments::new(self.segments.limit);
         temp.insert(&(Sectors(0), self.segments.limit))
             .expect("exactly one segment to fill whole range");
         self.segments = temp;
 
-        segs
+        let free = FreeExtents::new(&self.segments);
+        std::mem::replace(&mut self.free, free).by_start
     }
 
     /// Attempt to allocate.
     /// Returns a PerDevSegments object containing the allocated ranges.
+    ///
+    /// If some free range is large enough to hold the whole amount, the
+    /// allocation is made from the start of the smallest such range, so
+    /// that larger free ranges remain available for larger requests.
+    /// Otherwise, free ranges are used in order of their initial index until
+    /// the amount is satisfied or no more free ranges remain.
     pub fn request(&mut self, amount: Sectors) -> PerDevSegments {
         let mut segs = PerDevSegments::new(self.segments.limit());
-        let mut needed = amount;
+        if amount == Sectors(0) {
+            return segs;
+        }
 
-        for (&start, &len) in self.segments.complement().iter() {
-            if needed == Sectors(0) {
-                break;
+        let to_take = match self.free.best_fit(amount) {
+            Some((start, len)) => vec![(start, len, amount)],
+            None => {
+                let mut needed = amount;
+                let mut to_take = Vec::new();
+                for (&start, &len) in self.free.by_start.iter() {
+                    if needed == Sectors(0) {
+                        break;
+                    }
+                    let to_use = min(needed, len);
+                    to_take.push((start, len, to_use));
+                    needed -= to_use;
+                }
+                to_take
             }
-            let to_use = min(needed, len);
-            let used_range = (start, to_use);
-            segs.insert(&used_range)
+        };
+
+        for (start, len, to_use) in to_take {
+            segs.insert(&(start, to_use))
                 .expect("wholly disjoint from other elements in segs");
-            needed -= to_use;
+            self.segments
+                .insert(&(start, to_use))
+                .expect("all segments verified to be in available ranges");
+            self.free.take(start, len, to_use);
         }
 
-        self.segments = self
-            .segments
-            .union(&segs)
-            .expect("all segments verified to be in available ranges");
         segs
     }
 
     #[cfg(test)]
     fn invariant(&self) {
+        self.segments.invariant();
+
+        // Verify that the free extents are exactly the complement of the
+        // used ranges.
+        let free = self.segments.complement();
+        assert_eq!(free.used, self.free.by_start.used);
+        assert_eq!(free.total, self.free.by_start.total);
+        assert_eq!(
+            self.free.by_len,
+            free.iter()
+                .map(|(&start, &len)| (len, start))
+                .collect::<BTreeSet<_>>()
+        );
+
         // Verify that calling request_all() has the identical effect to
         // calling request() and requesting all available.
         let mut dup1 = RangeAllocator {
             segments: PerDevSegments {
                 limit: self.segments.limit,
                 used: self.segments.used.clone(),
+                total: self.segments.total,
             },
+            free: FreeExtents::new(&self.segments),
         };
         let mut dup2 = RangeAllocator {
             segments: PerDevSegments {
                 limit: self.segments.limit,
                 used: self.segments.used.clone(),
+                total: self.segments.total,
             },
+            free: FreeExtents::new(&self.segments),
         };
         let result1 = dup1.request_all();
         let result2 = dup2.request(dup2.available());
@@ -415,6 +524,10 @@ impl RangeAllocator {
 
 #[cfg(test)]
 mod tests {
+    use std::time::{Duration, Instant};
+
+    use crate::engine::bench;
+
     use super::*;
 
     #[test]
@@ -435,7 +548,6 @@ mod tests {
         assert_eq!(allocator.available(), Sectors(128));
 
         allocator
-            .segments
             .insert_all(&[(Sectors(10), Sectors(100))])
             .unwrap();
 
@@ -534,10 +646,7 @@ mod tests {
 
         assert!(allocator.segments.complement().iter().next().is_none());
 
-        assert_matches!(
-            allocator.segments.insert_all(&[(Sectors(1), Sectors(1))]),
-            Err(_)
-        );
+        assert_matches!(allocator.insert_all(&[(Sectors(1), Sectors(1))]), Err(_));
 
         allocator.invariant();
     }
@@ -638,4 +747,151 @@ mod tests {
 
         allocator.invariant();
     }
+
+    #[test]
+    /// Verify that a request is satisfied from the smallest free range that
+    /// can hold it, and that otherwise free ranges are used in order.
+    fn test_allocator_best_fit() {
+        let mut allocator = RangeAllocator::new(
+            BlockdevSize::new(Sectors(128)),
+            &[(Sectors(10), Sectors(10)), (Sectors(25), Sectors(10))],
+        )
+        .unwrap();
+
+        // Free ranges are (0, 10), (20, 5), (35, 93)
+        let request = allocator.request(Sectors(4));
+        assert_eq!(
+            request.iter().collect::<Vec<_>>(),
+            vec![(&Sectors(20), &Sectors(4))]
+        );
+        allocator.invariant();
+
+        let request = allocator.request(Sectors(10));
+        assert_eq!(
+            request.iter().collect::<Vec<_>>(),
+            vec![(&Sectors(0), &Sectors(10))]
+        );
+        allocator.invariant();
+
+        // Free ranges are (24, 1), (35, 93)
+        let request = allocator.request(Sectors(94));
+        assert_eq!(
+            request.iter().collect::<Vec<_>>(),
+            vec![(&Sectors(24), &Sectors(1)), (&Sectors(35), &Sectors(93))]
+        );
+        assert_eq!(allocator.available(), Sectors(0));
+        allocator.invariant();
+    }
+
+    #[test]
+    /// Verify that remove() splits and shrinks ranges properly and rejects
+    /// ranges that are not wholly in use.
+    fn test_segments_remove() {
+        let mut segments = PerDevSegments::new(Sectors(128));
+        segments.insert(&(Sectors(10), Sectors(30))).unwrap();
+
+        segments.remove(&(Sectors(20), Sectors(5))).unwrap();
+        assert_eq!(
+            segments.iter().collect::<Vec<_>>(),
+            vec![(&Sectors(10), &Sectors(10)), (&Sectors(25), &Sectors(15))]
+        );
+        assert_eq!(segments.sum(), Sectors(25));
+        segments.invariant();
+
+        segments.remove(&(Sectors(10), Sectors(10))).unwrap();
+        segments.remove(&(Sectors(35), Sectors(5))).unwrap();
+        assert_eq!(
+            segments.iter().collect::<Vec<_>>(),
+            vec![(&Sectors(25), &Sectors(10))]
+        );
+        segments.invariant();
+
+        assert_matches!(segments.remove(&(Sectors(20), Sectors(10))), Err(_));
+        assert_matches!(segments.remove(&(Sectors(30), Sectors(10))), Err(_));
+        assert_matches!(segments.remove(&(Sectors(30), Sectors(u64::MAX))), Err(_));
+        assert_eq!(segments.sum(), Sectors(10));
+        segments.invariant();
+    }
+
+    /// Make a RangeAllocator with num_used used ranges, each of 8 sectors,
+    /// separated by free ranges of 8 sectors.
+    fn fragmented_allocator(num_used: u64) -> RangeAllocator {
+        let used = (0..num_used)
+            .map(|i| (Sectors(i * 16 + 8), Sectors(8)))
+            .collect::<Vec<_>>();
+        RangeAllocator::new(BlockdevSize::new(Sectors(num_used * 16)), &used).unwrap()
+    }
+
+    fn report(name: &str, num_segments: u64, num_ops: u64, elapsed: Duration) {
+        bench::report(
+            &format!("range_alloc/{}", name),
+            num_segments,
+            num_ops,
+            elapsed,
+        );
+    }
+
+    const BENCH_SIZES: [u64; 3] = [10_000, 100_000, 1_000_000];
+
+    #[test]
+    #[ignore]
+    /// Measure the cost of inserting ranges into PerDevSegments, singly and
+    /// all at once, for increasing numbers of ranges.
+    /// Run with "make bench".
+    fn bench_segments_insert() {
+        for &num_segments in BENCH_SIZES.iter() {
+            let limit = Sectors(num_segments * 16);
+            let ranges = (0..num_segments)
+                .map(|i| (Sectors(i * 16), Sectors(8)))
+                .collect::<Vec<_>>();
+
+            let mut segments = PerDevSegments::new(limit);
+            let start = Instant::now();
+            for range in ranges.iter() {
+                segments.insert(range).unwrap();
+            }
+            report("insert", num_segments, num_segments, start.elapsed());
+
+            let mut segments = PerDevSegments::new(limit);
+            let start = Instant::now();
+            segments.insert_all(&ranges).unwrap();
+            report("insert_all", num_segments, 1, start.elapsed());
+            assert_eq!(segments.len(), ranges.len());
+        }
+    }
+
+    #[test]
+    #[ignore]
+    /// Measure the cost of requests from a RangeAllocator whose free space
+    /// is highly fragmented, for increasing numbers of free ranges.
+    /// Run with "make bench".
+    fn bench_allocator_request() {
+        const NUM_REQUESTS: u64 = 5_000;
+
+        for &num_segments in BENCH_SIZES.iter() {
+            let start = Instant::now();
+            let mut allocator = fragmented_allocator(num_segments);
+            report("new", num_segments, 1, start.elapsed());
+
+            // Each request fits in a single free range.
+            let start = Instant::now();
+            for _ in 0..NUM_REQUESTS {
+                assert_eq!(allocator.request(Sectors(4)).sum(), Sectors(4));
+            }
+            report(
+                "request_best_fit",
+                num_segments,
+                NUM_REQUESTS,
+                start.elapsed(),
+            );
+
+            // Each request must be split among several free ranges.
+            let mut allocator = fragmented_allocator(num_segments);
+            let start = Instant::now();
+            for _ in 0..NUM_REQUESTS {
+                assert_eq!(allocator.request(Sectors(12)).sum(), Sectors(12));
+            }
+            report("request_split", num_segments, NUM_REQUESTS, start.elapsed());
+        }
+    }
 }
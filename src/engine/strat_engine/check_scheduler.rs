@@ -0,0 +1,344 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+//! Scheduling of the checks run on pools in response to devicemapper events.
+//!
+//! Checking the thin pool itself is urgent: it extends the data and metadata
+//! devices when the pool is running low on space. It is run as soon as an
+//! event on one of the pool's devices is handled, unless it failed recently.
+//!
+//! Checking filesystems, which may grow them, is background work. Filesystem
+//! checks are coalesced per pool and are run on any one pool no more often
+//! than once per minimum background interval, so that a burst of events
+//! results in a single check of each filesystem.
+
+use std::{
+    cmp::{max, min},
+    collections::{HashMap, HashSet},
+    time::{Duration, Instant},
+};
+
+use serde_json::Value;
+
+use crate::engine::types::{FilesystemUuid, PoolUuid};
+
+/// The default minimum interval between two background checks of the
+/// filesystems of a single pool. This is also the interval after which a
+/// failed urgent check is retried.
+pub const DEFAULT_MIN_BACKGROUND_INTERVAL: Duration = Duration::from_secs(10);
+
+/// The checks which are to be run on a single pool.
+#[derive(Debug, Default, Eq, PartialEq)]
+pub struct PoolCheck {
+    /// Whether the thin pool and its sub-devices are to be checked.
+    pub thin_pool: bool,
+    /// The filesystems that are to be checked.
+    pub filesystems: HashSet<FilesystemUuid>,
+}
+
+impl PoolCheck {
+    fn is_empty(&self) -> bool {
+        !self.thin_pool && self.filesystems.is_empty()
+    }
+}
+
+/// The checks scheduled on a single pool which have not yet been run.
+#[derive(Debug)]
+struct PendingCheck {
+    check: PoolCheck,
+    // The urgent check is not run before this time
+    thin_pool_not_before: Instant,
+}
+
+/// Counters and timings for the checks run by a CheckScheduler.
+#[derive(Debug, Default)]
+struct CheckStats {
+    urgent_runs: u64,
+    background_runs: u64,
+    failures: u64,
+    // The number of requests which were merged into an already pending check
+    coalesced: u64,
+    last_latency: Option<Duration>,
+    max_latency: Duration,
+    total_latency: Duration,
+}
+
+#[derive(Debug)]
+pub struct CheckScheduler {
+    pending: HashMap<PoolUuid, PendingCheck>,
+    // The time at which the filesystems of each pool were last checked
+    last_background: HashMap<PoolUuid, Instant>,
+    min_background_interval: Duration,
+    stats: CheckStats,
+}
+
+impl Default for CheckScheduler {
+    fn default() -> CheckScheduler {
+        CheckScheduler::new(DEFAULT_MIN_BACKGROUND_INTERVAL)
+    }
+}
+
+impl CheckScheduler {
+    pub fn new(min_background_interval: Duration) -> CheckScheduler {
+        CheckScheduler {
+            pending: HashMap::new(),
+            last_background: HashMap::new(),
+            min_background_interval,
+            stats: CheckStats::default(),
+        }
+    }
+
+    /// Schedule check on the pool with UUID pool_uuid, merging it with any
+    /// check that is already pending on that pool. An urgent check scheduled
+    /// at now is due immediately, even if an earlier one failed recently.
+    pub fn schedule(&mut self, pool_uuid: PoolUuid, check: PoolCheck, now: Instant) {
+        if check.is_empty() {
+            return;
+        }
+        match self.pending.get_mut(&pool_uuid) {
+            Some(pending) => {
+                self.stats.coalesced += 1;
+                if check.thin_pool {
+                    pending.check.thin_pool = true;
+                    pending.thin_pool_not_before = now;
+                }
+                pending.check.filesystems.extend(check.filesystems);
+            }
+            None => {
+                self.pending.insert(
+                    pool_uuid,
+                    PendingCheck {
+                        check,
+                        thin_pool_not_before: now,
+                    },
+                );
+            }
+        }
+    }
+
+    /// Remove and return all the checks which are due at now.
+    pub fn take_due(&mut self, now: Instant) -> Vec<(PoolUuid, PoolCheck)> {
+        let interval = self.min_background_interval;
+        let mut due = Vec::new();
+        for (pool_uuid, pending) in self.pending.iter_mut() {
+            let thin_pool = pending.check.thin_pool && pending.thin_pool_not_before <= now;
+            let background = !pending.check.filesystems.is_empty()
+                && self
+                    .last_background
+                    .get(pool_uuid)
+                    .map(|last| now.saturating_duration_since(*last) >= interval)
+                    .unwrap_or(true);
+            if !thin_pool && !background {
+                continue;
+            }
+
+            let mut check = PoolCheck::default();
+            if thin_pool {
+                check.thin_pool = true;
+                pending.check.thin_pool = false;
+            }
+            if background {
+                check.filesystems = pending.check.filesystems.drain().collect();
+                self.last_background.insert(*pool_uuid, now);
+            }
+            due.push((*pool_uuid, check));
+        }
+        self.pending.retain(|_, pending| !pending.check.is_empty());
+        due
+    }
+
+    /// Return the time from now until the next pending check becomes due,
+    /// or None if no check is pending.
+    pub fn next_due(&self, now: Instant) -> Option<Duration> {
+        self.pending
+            .iter()
+            .map(|(pool_uuid, pending)| {
+                let thin_pool = if pending.check.thin_pool {
+                    Some(pending.thin_pool_not_before.saturating_duration_since(now))
+                } else {
+                    None
+                };
+                let background = if pending.check.filesystems.is_empty() {
+                    None
+                } else {
+                    Some(
+                        self.last_background
+                            .get(pool_uuid)
+                            .map(|last| {
+                                (*last + self.min_background_interval)
+                                    .saturating_duration_since(now)
+                            })
+                            .unwrap_or_else(|| Duration::from_secs(0)),
+                    )
+                };
+                match (thin_pool, background) {
+                    (Some(t), Some(b)) => min(t, b),
+                    (Some(t), None) => t,
+                    (None, Some(b)) => b,
+                    (None, None) => unreachable!("empty checks are never left pending"),
+                }
+            })
+            .min()
+    }
+
+    /// Record that check, which was taken from this scheduler, has finished
+    /// successfully after running for latency.
+    pub fn record_success(&mut self, check: &PoolCheck, latency: Duration) {
+        if check.thin_pool {
+            self.stats.urgent_runs += 1;
+        }
+        if !check.filesystems.is_empty() {
+            self.stats.background_runs += 1;
+        }
+        self.stats.last_latency = Some(latency);
+        self.stats.max_latency = max(self.stats.max_latency, latency);
+        self.stats.total_latency += latency;
+    }
+
+    /// Record that check, which was taken from this scheduler, failed at now.
+    /// The check is scheduled again. A failed urgent check is not retried
+    /// until the minimum background interval has elapsed, unless another
+    /// event requests it sooner.
+    pub fn record_failure(&mut self, pool_uuid: PoolUuid, check: PoolCheck, now: Instant) {
+        self.stats.failures += 1;
+        let retry = check.thin_pool;
+        self.schedule(pool_uuid, check, now);
+        if retry {
+            if let Some(pending) = self.pending.get_mut(&pool_uuid) {
+                pending.thin_pool_not_before = now + self.min_background_interval;
+            }
+        }
+    }
+
+    /// Forget all the state kept about the pool with UUID pool_uuid.
+    pub fn forget(&mut self, pool_uuid: PoolUuid) {
+        self.pending.remove(&pool_uuid);
+        self.last_background.remove(&pool_uuid);
+    }
+
+    /// The number of pools on which checks are pending.
+    pub fn queue_depth(&self) -> usize {
+        self.pending.len()
+    }
+}
+
+impl<'a> Into<Value> for &'a CheckScheduler {
+    fn into(self) -> Value {
+        let runs = self.stats.urgent_runs + self.stats.background_runs;
+        json!({
+            "queue_depth": Value::from(self.queue_depth()),
+            "urgent_pending": Value::from(
+                self.pending.values().filter(|p| p.check.thin_pool).count()
+            ),
+            "background_pending": Value::from(
+                self.pending.values().map(|p| p.check.filesystems.len()).sum::<usize>()
+            ),
+            "urgent_runs": Value::from(self.stats.urgent_runs),
+            "background_runs": Value::from(self.stats.background_runs),
+            "failures": Value::from(self.stats.failures),
+            "coalesced": Value::from(self.stats.coalesced),
+            "last_latency_us": self.stats.last_latency.map(|l| Value::from(l.as_micros().to_string())).unwrap_or(Value::Null),
+            "max_latency_us": Value::from(self.stats.max_latency.as_micros().to_string()),
+            "mean_latency_us": Value::from(
+                if runs == 0 {
+                    0
+                } else {
+                    self.stats.total_latency.as_micros() / u128::from(runs)
+                }
+                .to_string()
+            ),
+        })
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn fs_check(uuids: &[FilesystemUuid]) -> PoolCheck {
+        PoolCheck {
+            thin_pool: false,
+            filesystems: uuids.iter().cloned().collect(),
+        }
+    }
+
+    #[test]
+    /// Verify that urgent checks are due immediately, while background checks
+    /// on a single pool are coalesced and rate limited.
+    fn test_coalesce_and_rate_limit() {
+        let interval = Duration::from_secs(10);
+        let mut scheduler = CheckScheduler::new(interval);
+        let pool_uuid = PoolUuid::new_v4();
+        let (fs1, fs2) = (FilesystemUuid::new_v4(), FilesystemUuid::new_v4());
+        let start = Instant::now();
+
+        scheduler.schedule(pool_uuid, fs_check(&[fs1]), start);
+        let due = scheduler.take_due(start);
+        assert_eq!(due, vec![(pool_uuid, fs_check(&[fs1]))]);
+        assert_eq!(scheduler.next_due(start), None);
+
+        // A burst of events within the interval is coalesced into one check.
+        for _ in 0..10 {
+            scheduler.schedule(pool_uuid, fs_check(&[fs1, fs2]), start);
+        }
+        assert_eq!(scheduler.queue_depth(), 1);
+        assert!(scheduler.take_due(start).is_empty());
+        assert_eq!(scheduler.next_due(start), Some(interval));
+
+        // Urgent checks are not delayed by the pending background checks.
+        scheduler.schedule(
+            pool_uuid,
+            PoolCheck {
+                thin_pool: true,
+                filesystems: HashSet::new(),
+            },
+            start,
+        );
+        assert_eq!(scheduler.next_due(start), Some(Duration::from_secs(0)));
+        let due = scheduler.take_due(start);
+        assert_eq!(
+            due,
+            vec![(
+                pool_uuid,
+                PoolCheck {
+                    thin_pool: true,
+                    filesystems: HashSet::new(),
+                }
+            )]
+        );
+
+        let later = start + interval;
+        assert_eq!(
+            scheduler.take_due(later),
+            vec![(pool_uuid, fs_check(&[fs1, fs2]))]
+        );
+        assert_eq!(scheduler.queue_depth(), 0);
+    }
+
+    #[test]
+    /// Verify that a failed urgent check is retried after the interval, or
+    /// sooner if a new event requests it.
+    fn test_failure_retry() {
+        let interval = Duration::from_secs(10);
+        let mut scheduler = CheckScheduler::new(interval);
+        let pool_uuid = PoolUuid::new_v4();
+        let start = Instant::now();
+        let urgent = || PoolCheck {
+            thin_pool: true,
+            filesystems: HashSet::new(),
+        };
+
+        scheduler.schedule(pool_uuid, urgent(), start);
+        let (_, check) = scheduler.take_due(start).pop().unwrap();
+        scheduler.record_failure(pool_uuid, check, start);
+        assert!(scheduler.take_due(start).is_empty());
+        assert_eq!(scheduler.next_due(start), Some(interval));
+
+        let soon = start + Duration::from_secs(1);
+        scheduler.schedule(pool_uuid, urgent(), soon);
+        assert_eq!(scheduler.take_due(soon), vec![(pool_uuid, urgent())]);
+        scheduler.record_success(&urgent(), Duration::from_millis(5));
+        assert_eq!(scheduler.queue_depth(), 0);
+    }
+}
@@ -15,19 +15,23 @@
 // an explicit error is returned if the executable can not be found.
 
 use std::{
+    cmp::max,
     collections::HashMap,
     io::{Read, Write},
     path::{Path, PathBuf},
-    process::{Command, Stdio},
+    process::{Child, Command, ExitStatus, Output, Stdio},
+    sync::Mutex,
+    time::{Duration, Instant},
 };
 
 use libc::c_uint;
 use libcryptsetup_rs::SafeMemHandle;
-use serde_json::Value;
+use serde_json::{Map, Value};
 
 use crate::{
     engine::{
         engine::MAX_STRATIS_PASS_SIZE,
+        metrics::{observe, CHILD_PROCESS_DURATION},
         types::{FilesystemUuid, SizedKeyMemory, StratisUuid},
     },
     stratis::{StratisError, StratisResult},
@@ -55,7 +59,6 @@ const THIN_CHECK: &str = "thin_check";
 const THIN_REPAIR: &str = "thin_repair";
 const UDEVADM: &str = "udevadm";
 const XFS_DB: &str = "xfs_db";
-const XFS_GROWFS: &str = "xfs_growfs";
 const CLEVIS: &str = "clevis";
 const CLEVIS_LIB: &str = "clevis-luks-common-functions";
 const CLEVIS_BIND: &str = "clevis-luks-bind";
@@ -110,7 +113,6 @@ lazy_static! {
         (THIN_REPAIR.to_string(), find_binary(THIN_REPAIR)),
         (UDEVADM.to_string(), find_binary(UDEVADM)),
         (XFS_DB.to_string(), find_binary(XFS_DB)),
-        (XFS_GROWFS.to_string(), find_binary(XFS_GROWFS)),
     ]
     .iter()
     .cloned()
@@ -156,10 +158,107 @@ pub fn verify_binaries() -> StratisResult<()> {
     }
 }
 
-/// Invoke the specified command. Return an error if invoking the command
-/// fails or if the command itself fails.
-fn execute_cmd(cmd: &mut Command) -> StratisResult<()> {
-    match cmd.output() {
+/// The time spent waiting for the child processes run for a single
+/// operation.
+#[derive(Debug, Default)]
+struct ChildTimes {
+    runs: u64,
+    failures: u64,
+    total: Duration,
+    max: Duration,
+}
+
+lazy_static! {
+    // Maps the name of each operation for which child processes are run to
+    // the time spent running them.
+    static ref CHILD_TIMES: Mutex<HashMap<&'static str, ChildTimes>> = Mutex::new(HashMap::new());
+}
+
+/// Record that a child process run for operation took elapsed, and whether
+/// it succeeded.
+fn record_child_time(operation: &'static str, elapsed: Duration, success: bool) {
+    debug!(
+        "Child process for operation \"{}\" ran for {:?}",
+        operation, elapsed
+    );
+    observe(&CHILD_PROCESS_DURATION, vec![operation], elapsed);
+    let mut child_times = CHILD_TIMES.lock().expect("no holder of the lock panics");
+    let times = child_times
+        .entry(operation)
+        .or_insert_with(ChildTimes::default);
+    times.runs += 1;
+    if !success {
+        times.failures += 1;
+    }
+    times.total += elapsed;
+    times.max = max(times.max, elapsed);
+}
+
+/// Run cmd to completion, capturing its output, and record the time it took
+/// under operation.
+fn timed_output(operation: &'static str, cmd: &mut Command) -> std::io::Result<Output> {
+    let start = Instant::now();
+    let result = cmd.output();
+    record_child_time(
+        operation,
+        start.elapsed(),
+        result.as_ref().map_or(false, |r| r.status.success()),
+    );
+    result
+}
+
+/// Wait for child, which was spawned at start, to exit and record the time
+/// it took under operation.
+fn timed_wait(
+    operation: &'static str,
+    child: &mut Child,
+    start: Instant,
+) -> std::io::Result<ExitStatus> {
+    let result = child.wait();
+    record_child_time(
+        operation,
+        start.elapsed(),
+        result.as_ref().map_or(false, |s| s.success()),
+    );
+    result
+}
+
+/// A report of the number of child processes run for each operation and the
+/// time spent waiting for them.
+pub fn child_process_report() -> Value {
+    let child_times = CHILD_TIMES.lock().expect("no holder of the lock panics");
+    let mut operations = child_times.iter().collect::<Vec<_>>();
+    operations.sort_unstable_by_key(|(operation, _)| *operation);
+    let mut map = Map::new();
+    for (operation, times) in operations {
+        map.insert(
+            (*operation).to_string(),
+            json!({
+                "runs": Value::from(times.runs),
+                "failures": Value::from(times.failures),
+                "total_us": Value::from(times.total.as_micros().to_string()),
+                "max_us": Value::from(times.max.as_micros().to_string()),
+            }),
+        );
+    }
+    json!({ "child_processes": Value::Object(map) })
+}
+
+/// The number of child processes run for operation.
+#[cfg(test)]
+pub fn child_process_runs(operation: &str) -> u64 {
+    CHILD_TIMES
+        .lock()
+        .expect("no holder of the lock panics")
+        .get(operation)
+        .map_or(0, |times| times.runs)
+}
+
+/// Invoke the specified command, recording the time it took under operation.
+/// Return an error if invoking the command fails or if the command itself
+/// fails.
+fn execute_cmd(operation: &'static str, cmd: &mut Command) -> StratisResult<()> {
+    match timed_output(operation, cmd) {
         Err(err) => Err(StratisError::Msg(format!(
             "Failed to execute command {:?}, err: {:?}",
             cmd, err
@@ -237,22 +336,13 @@ pub fn create_fs(devnode: &Path, uuid: Option<StratisUuid>, noalign: bool) -> St
         command.arg("-d");
         command.arg("noalign");
     }
-    execute_cmd(&mut command)
-}
-
-/// Use the xfs_growfs command to expand a filesystem mounted at the given
-/// mount point.
-pub fn xfs_growfs(mount_point: &Path) -> StratisResult<()> {
-    execute_cmd(
-        Command::new(get_executable(XFS_GROWFS).as_os_str())
-            .arg(mount_point)
-            .arg("-d"),
-    )
+    execute_cmd("mkfs.xfs", &mut command)
 }
 
 /// Set a new UUID for filesystem on the devnode.
 pub fn set_uuid(devnode: &Path, uuid: FilesystemUuid) -> StratisResult<()> {
     execute_cmd(
+        "xfs_db uuid",
         Command::new(get_executable(XFS_DB).as_os_str())
             .arg("-x")
             .arg(format!("-c uuid {}", uuid))
@@ -263,8 +353,20 @@ pub fn set_uuid(devnode: &Path, uuid: FilesystemUuid) -> StratisResult<()> {
 /// Call thin_check on a thinpool
 pub fn thin_check(devnode: &Path) -> StratisResult<()> {
     execute_cmd(
+        "thin_check",
+        Command::new(get_executable(THIN_CHECK).as_os_str())
+            .arg("-q")
+            .arg(devnode),
+    )
+}
+
+/// Call thin_check on a thinpool, checking only the superblock
+pub fn thin_check_superblock(devnode: &Path) -> StratisResult<()> {
+    execute_cmd(
+        "thin_check --super-block-only",
         Command::new(get_executable(THIN_CHECK).as_os_str())
             .arg("-q")
+            .arg("--super-block-only")
             .arg(devnode),
     )
 }
@@ -272,6 +374,7 @@ pub fn thin_check(devnode: &Path) -> StratisResult<()> {
 /// Call thin_repair on a thinpool
 pub fn thin_repair(meta_dev: &Path, new_meta_dev: &Path) -> StratisResult<()> {
     execute_cmd(
+        "thin_repair",
         Command::new(get_executable(THIN_REPAIR).as_os_str())
             .arg("-i")
             .arg(meta_dev)
@@ -282,7 +385,10 @@ pub fn thin_repair(meta_dev: &Path, new_meta_dev: &Path) -> StratisResult<()> {
 
 /// Call udevadm settle
 pub fn udev_settle() -> StratisResult<()> {
-    execute_cmd(Command::new(get_executable(UDEVADM).as_os_str()).arg("settle"))
+    execute_cmd(
+        "udevadm settle",
+        Command::new(get_executable(UDEVADM).as_os_str()).arg("settle"),
+    )
 }
 
 /// Bind a LUKS device using clevis.
@@ -311,12 +417,13 @@ pub fn clevis_luks_bind(
         .arg(pin)
         .arg(json.to_string());
 
-    execute_cmd(&mut cmd)
+    execute_cmd("clevis luks bind", &mut cmd)
 }
 
 /// Unbind a LUKS device using clevis.
 pub fn clevis_luks_unbind(dev_path: &Path, keyslot: libc::c_uint) -> StratisResult<()> {
     execute_cmd(
+        "clevis luks unbind",
         Command::new(get_clevis_executable()?)
             .arg("luks")
             .arg("unbind")
@@ -331,6 +438,7 @@ pub fn clevis_luks_unbind(dev_path: &Path, keyslot: libc::c_uint) -> StratisResu
 /// Unlock a device using the clevis CLI.
 pub fn clevis_luks_unlock(dev_path: &Path, dm_name: &str) -> StratisResult<()> {
     execute_cmd(
+        "clevis luks unlock",
         Command::new(get_clevis_executable()?)
             .arg("luks")
             .arg("unlock")
@@ -343,6 +451,7 @@ pub fn clevis_luks_unlock(dev_path: &Path, dm_name: &str) -> StratisResult<()> {
 
 /// Safely query clevis for the decrypted passphrase stored on a LUKS2 volume.
 pub fn clevis_decrypt(jwe: &Value) -> StratisResult<SizedKeyMemory> {
+    let start = Instant::now();
     let mut jose_child = Command::new(get_jose_executable()?)
         .arg("jwe")
         .arg("fmt")
@@ -360,7 +469,7 @@ pub fn clevis_decrypt(jwe: &Value) -> StratisResult<SizedKeyMemory> {
     })?;
     jose_stdin.write_all(jwe.to_string().as_bytes())?;
 
-    jose_child.wait()?;
+    timed_wait("jose jwe fmt", &mut jose_child, start)?;
 
     let mut jose_output = String::new();
     jose_child
@@ -373,6 +482,7 @@ pub fn clevis_decrypt(jwe: &Value) -> StratisResult<SizedKeyMemory> {
         })?
         .read_to_string(&mut jose_output)?;
 
+    let start = Instant::now();
     let mut clevis_child = Command::new(get_clevis_executable()?)
         .arg("decrypt")
         .stdin(Stdio::piped())
@@ -388,7 +498,7 @@ pub fn clevis_decrypt(jwe: &Value) -> StratisResult<SizedKeyMemory> {
     clevis_stdin.write_all(jose_output.as_bytes())?;
     drop(clevis_stdin);
 
-    clevis_child.wait()?;
+    timed_wait("clevis decrypt", &mut clevis_child, start)?;
 
     let mut mem = SafeMemHandle::alloc(MAX_STRATIS_PASS_SIZE)?;
     let bytes_read = clevis_child
@@ -406,6 +516,7 @@ pub fn clevis_decrypt(jwe: &Value) -> StratisResult<SizedKeyMemory> {
 /// Regenerate the bindings for a device using the clevis CLI.
 pub fn clevis_luks_regen(dev_path: &Path, keyslot: c_uint) -> StratisResult<()> {
     execute_cmd(
+        "clevis luks regen",
         Command::new(get_clevis_executable()?)
             .arg("luks")
             .arg("regen")
@@ -416,3 +527,22 @@ pub fn clevis_luks_regen(dev_path: &Path, keyslot: c_uint) -> StratisResult<()>
             .arg("-q"),
     )
 }
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    /// Verify that the time spent running child processes is recorded for
+    /// the operation for which they were run, and that failures are counted.
+    fn test_child_process_report() {
+        let operation = "test_child_process_report";
+        execute_cmd(operation, &mut Command::new("true")).unwrap();
+        assert!(execute_cmd(operation, &mut Command::new("false")).is_err());
+
+        let report = child_process_report();
+        let times = &report["child_processes"][operation];
+        assert_eq!(times["runs"], Value::from(2));
+        assert_eq!(times["failures"], Value::from(1));
+    }
+}
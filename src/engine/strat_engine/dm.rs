@@ -8,7 +8,10 @@ use std::sync::Once;
 
 use devicemapper::{DmResult, DM};
 
-use crate::stratis::{StratisError, StratisResult};
+use crate::{
+    engine::{increment_counter, Counter},
+    stratis::{StratisError, StratisResult},
+};
 
 static INIT: Once = Once::new();
 static mut DM_CONTEXT: Option<DmResult<DM>> = None;
@@ -29,6 +32,7 @@ pub fn get_dm_init() -> StratisResult<&'static DM> {
 }
 
 pub fn get_dm() -> &'static DM {
+    increment_counter(Counter::DmRequests, 1);
     get_dm_init().expect(
         "the engine has already called get_dm_init() and exited if get_dm_init() returned an error",
     )
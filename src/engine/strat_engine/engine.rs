@@ -2,27 +2,39 @@
 // License, v. 2.0. If a copy of the MPL was not distributed with this
 // file, You can obtain one at http://mozilla.org/MPL/2.0/.
 
-use std::{clone::Clone, collections::HashMap, path::Path};
+use std::{
+    clone::Clone,
+    collections::{HashMap, HashSet},
+    path::Path,
+    sync::Mutex,
+    time::{Duration, Instant},
+};
 
 use serde_json::Value;
+use tokio::sync::{RwLock, RwLockReadGuard};
 
 use devicemapper::DmNameBuf;
 
 use crate::{
     engine::{
         engine::KeyActions,
+        metrics::span,
         shared::{create_pool_idempotent_or_err, validate_name, validate_paths},
         strat_engine::{
-            cmd::verify_binaries,
+            check_scheduler::CheckScheduler,
+            cmd::{child_process_report, verify_binaries},
             dm::get_dm,
             keys::{MemoryFilesystem, StratKeyActions},
-            liminal::{find_all, LiminalDevices},
-            pool::StratPool,
+            liminal::{find_all, LiminalDevices, LiminalDevicesReport},
+            metadata::PoolMetadataFormat,
+            parallel::DEFAULT_PARALLELISM,
+            pool::{StratPool, StratPoolReport},
         },
-        structures::Table,
+        structures::{read_pool, Lockable, SharedGuard, Table},
         types::{
-            CreateAction, DeleteAction, DevUuid, EncryptionInfo, LockedPoolInfo, RenameAction,
-            ReportType, SetUnlockAction, UdevEngineEvent, UnlockMethod,
+            CreateAction, DeleteAction, DevUuid, EncryptionInfo, LockedPoolInfo, PoolGuard,
+            PoolMutGuard, RenameAction, ReportType, SetUnlockAction, ThinCheckPolicy,
+            UdevEngineEvent, UnlockMethod, UsageReadings,
         },
         Engine, Name, Pool, PoolUuid, Report,
     },
@@ -31,15 +43,27 @@ use crate::{
 
 #[derive(Debug)]
 pub struct StratEngine {
-    pools: Table<PoolUuid, StratPool>,
+    // Each pool has a lock of its own; see Lockable.
+    pools: Table<PoolUuid, RwLock<StratPool>>,
 
     // Maps pool UUIDs to information about sets of devices that are
     // associated with that UUID but have not been converted into a pool.
     liminal_devices: LiminalDevices,
 
     // Maps name of DM devices we are watching to the most recent event number
-    // we've handled for each
-    watched_dev_last_event_nrs: HashMap<PoolUuid, HashMap<DmNameBuf, u32>>,
+    // we've handled for each. Events are handled while the engine is shared,
+    // so this has a lock of its own.
+    watched_dev_last_event_nrs: Mutex<HashMap<DmNameBuf, u32>>,
+
+    // Checks scheduled on pools in response to devicemapper events. The lock
+    // is never held while a pool is locked.
+    checks: Mutex<CheckScheduler>,
+
+    // The format in which the metadata of newly created pools is written
+    metadata_format: PoolMetadataFormat,
+
+    // The largest number of devices of a pool that are unlocked at once
+    unlock_parallelism: usize,
 
     // Handler for key operations
     key_handler: StratKeyActions,
@@ -57,23 +81,40 @@ impl StratEngine {
     /// 2. Setup all the pools belonging to the engine.
     ///    a. Places any devices which belong to a pool, but are not complete
     ///       in the incomplete pools data structure.
+    ///    b. Reads device headers and sets up independent pools concurrently.
     ///
     /// Returns an error if the kernel doesn't support required DM features.
     /// Returns an error if there was an error reading device nodes.
     /// Returns an error if the binaries on which it depends can not be found.
-    pub fn initialize() -> StratisResult<StratEngine> {
+    ///
+    /// The thin pool metadata of each pool is checked according to
+    /// thin_check_policy. The metadata of each pool created by the engine
+    /// is written in metadata_format. The devices of an encrypted pool are
+    /// unlocked on no more than unlock_parallelism threads at once.
+    pub fn initialize(
+        thin_check_policy: ThinCheckPolicy,
+        metadata_format: PoolMetadataFormat,
+        unlock_parallelism: usize,
+    ) -> StratisResult<StratEngine> {
         verify_binaries()?;
 
-        let mut liminal_devices = LiminalDevices::default();
+        let start = Instant::now();
+        let mut liminal_devices = LiminalDevices::new(thin_check_policy);
         let mut pools = Table::default();
-        for (pool_name, pool_uuid, pool) in liminal_devices.setup_pools(find_all()?) {
-            pools.insert(pool_name, pool_uuid, pool);
+        for (pool_name, pool_uuid, pool) in
+            liminal_devices.setup_pools(find_all(DEFAULT_PARALLELISM)?, DEFAULT_PARALLELISM)
+        {
+            pools.insert(pool_name, pool_uuid, RwLock::new(pool));
         }
+        info!("Set up {} pools in {:?}", pools.len(), start.elapsed());
 
         Ok(StratEngine {
             pools,
             liminal_devices,
-            watched_dev_last_event_nrs: HashMap::new(),
+            watched_dev_last_event_nrs: Mutex::new(HashMap::new()),
+            checks: Mutex::new(CheckScheduler::default()),
+            metadata_format,
+            unlock_parallelism,
             key_handler: StratKeyActions,
             key_fs: MemoryFilesystem::new()?,
         })
@@ -85,7 +126,8 @@ impl StratEngine {
     pub fn teardown(self) -> StratisResult<()> {
         let mut untorndown_pools = Vec::new();
         for (_, uuid, mut pool) in self.pools {
-            pool.teardown()
+            pool.get_mut()
+                .teardown()
                 .unwrap_or_else(|_| untorndown_pools.push(uuid));
         }
         if untorndown_pools.is_empty() {
@@ -100,43 +142,52 @@ impl StratEngine {
     }
 }
 
+/// The engine state report, borrowed from the engine's data structures so
+/// that it can be serialized directly to its destination, without first
+/// being built as a Value. Fields are declared in the order in which they
+/// are reported.
+#[derive(Serialize)]
+struct StratEngineReport<'a> {
+    #[serde(flatten)]
+    liminal_devices: LiminalDevicesReport<'a>,
+    pools: Vec<StratPoolReport<'a>>,
+}
+
+/// A pool locked for reading, with its name and UUID.
+type ReadPool<'a> = (
+    &'a Name,
+    PoolUuid,
+    SharedGuard<RwLockReadGuard<'a, StratPool>>,
+);
+
+impl StratEngine {
+    /// Lock every pool for reading, in the order in which the engine lists
+    /// its pools.
+    fn read_pools(&self) -> Vec<ReadPool<'_>> {
+        self.pools
+            .iter()
+            .map(|(name, uuid, pool)| (name, *uuid, Lockable::new_pool(pool).blocking_read()))
+            .collect()
+    }
+
+    /// The engine state report, borrowing from pools, as locked by
+    /// read_pools().
+    fn report<'a>(&'a self, pools: &'a [ReadPool<'a>]) -> StratEngineReport<'a> {
+        StratEngineReport {
+            liminal_devices: LiminalDevicesReport::from(&self.liminal_devices),
+            pools: pools
+                .iter()
+                .map(|(name, uuid, pool)| pool.report(name, *uuid))
+                .collect(),
+        }
+    }
+}
+
 impl<'a> Into<Value> for &'a StratEngine {
-    // Precondition: (&StratPool).into() pattern matches Value::Object(_)
-    // Precondition: (&LiminalDevices).into() pattern matches Value::Object(_)
     fn into(self) -> Value {
-        let json = json!({
-            "pools": Value::Array(
-                self.pools.iter()
-                    .map(|(name, uuid, pool)| {
-                        let mut json = json!({
-                            "uuid": Value::from(uuid.to_string()),
-                            "name": Value::from(name.to_string()),
-                        });
-                        if let Value::Object(ref mut map) = json {
-                            map.extend(
-                                if let Value::Object(map) = <&StratPool as Into<Value>>::into(pool) {
-                                    map.into_iter()
-                                } else {
-                                    unreachable!("StratPool conversion returns a JSON object");
-                                }
-                            );
-                        } else {
-                            unreachable!("json!() always creates a JSON object")
-                        }
-                        json
-                    })
-                    .collect()
-            ),
-        });
-        if let (Value::Object(mut j), Value::Object(map)) = (
-            json,
-            <&LiminalDevices as Into<Value>>::into(&self.liminal_devices),
-        ) {
-            j.extend(map.into_iter());
-            Value::Object(j)
-        } else {
-            unreachable!("json!() and LiminalDevices::into() always return JSON object");
-        }
+        let pools = self.read_pools();
+        serde_json::to_value(self.report(&pools))
+            .expect("all values in the engine state report are representable in JSON")
     }
 }
 
@@ -145,27 +196,60 @@ impl Report for StratEngine {
         self.into()
     }
 
+    fn engine_state_report_json(&self) -> StratisResult<String> {
+        let pools = self.read_pools();
+        Ok(serde_json::to_string(&self.report(&pools))?)
+    }
+
     fn get_report(&self, report_type: ReportType) -> Value {
         match report_type {
             ReportType::ErroredPoolDevices => (&self.liminal_devices).into(),
+            ReportType::PoolChecks => {
+                (&*self.checks.lock().expect("no holder of the lock panics")).into()
+            }
+            ReportType::ChildProcesses => child_process_report(),
+            ReportType::DeviceIdentification => self.liminal_devices.identification_report(),
         }
     }
 }
 
 impl Engine for StratEngine {
-    fn handle_event(&mut self, event: &UdevEngineEvent) -> Option<(Name, PoolUuid, &dyn Pool)> {
-        if let Some((pool_uuid, pool_name, pool)) =
-            self.liminal_devices.block_evaluate(&self.pools, event)
-        {
-            self.pools.insert(pool_name.clone(), pool_uuid, pool);
-            Some((
-                pool_name,
-                pool_uuid,
-                self.pools.get_by_uuid(pool_uuid).expect("just_inserted").1 as &dyn Pool,
-            ))
-        } else {
-            None
+    fn handle_events(&mut self, events: &[UdevEngineEvent]) -> Vec<(Name, PoolUuid, &dyn Pool)> {
+        let _span = span("handle_events");
+        let mut affected = Vec::new();
+        for event in events {
+            if let Some(pool_uuid) = self.liminal_devices.block_apply(&self.pools, event) {
+                if !affected.contains(&pool_uuid) {
+                    affected.push(pool_uuid);
+                }
+            }
         }
+        debug!(
+            "Applied {} udev events, affecting {} pools that are not set up",
+            events.len(),
+            affected.len()
+        );
+
+        // Each pool is inserted before the next is evaluated, so that
+        // setting up the next pool takes account of it.
+        let mut set_up = Vec::new();
+        for pool_uuid in affected {
+            if let Some((pool_name, pool)) = self
+                .liminal_devices
+                .block_evaluate_pool(&self.pools, pool_uuid)
+            {
+                self.pools.insert(pool_name, pool_uuid, RwLock::new(pool));
+                set_up.push(pool_uuid);
+            }
+        }
+
+        self.pools
+            .iter_mut()
+            .filter(|(_, pool_uuid, _)| set_up.contains(pool_uuid))
+            .map(|(pool_name, pool_uuid, pool)| {
+                (pool_name.clone(), *pool_uuid, pool.get_mut() as &dyn Pool)
+            })
+            .collect()
     }
 
     fn create_pool(
@@ -175,6 +259,7 @@ impl Engine for StratEngine {
         redundancy: Option<u16>,
         encryption_info: &EncryptionInfo,
     ) -> StratisResult<CreateAction<PoolUuid>> {
+        let _span = span("create_pool");
         let redundancy = calculate_redundancy!(redundancy);
 
         validate_name(name)?;
@@ -182,18 +267,25 @@ impl Engine for StratEngine {
         validate_paths(blockdev_paths)?;
 
         match self.pools.get_by_name(name) {
-            Some((_, pool)) => create_pool_idempotent_or_err(pool, name, blockdev_paths),
+            Some((_, pool)) => {
+                create_pool_idempotent_or_err(&*read_pool(pool), name, blockdev_paths)
+            }
             None => {
                 if blockdev_paths.is_empty() {
                     Err(StratisError::Msg(
                         "At least one blockdev is required to create a pool.".to_string(),
                     ))
                 } else {
-                    let (uuid, pool) =
-                        StratPool::initialize(name, blockdev_paths, redundancy, encryption_info)?;
+                    let (uuid, pool) = StratPool::initialize(
+                        name,
+                        blockdev_paths,
+                        redundancy,
+                        encryption_info,
+                        self.metadata_format,
+                    )?;
 
                     let name = Name::new(name.to_owned());
-                    self.pools.insert(name, uuid, pool);
+                    self.pools.insert(name, uuid, RwLock::new(pool));
                     Ok(CreateAction::Created(uuid))
                 }
             }
@@ -201,8 +293,9 @@ impl Engine for StratEngine {
     }
 
     fn destroy_pool(&mut self, uuid: PoolUuid) -> StratisResult<DeleteAction<PoolUuid>> {
-        if let Some((_, pool)) = self.pools.get_by_uuid(uuid) {
-            if pool.has_filesystems() {
+        let _span = span("destroy_pool");
+        if let Some((_, pool)) = self.pools.get_mut_by_uuid(uuid) {
+            if pool.get_mut().has_filesystems() {
                 return Err(StratisError::Msg("filesystems remaining on pool".into()));
             };
         } else {
@@ -214,7 +307,7 @@ impl Engine for StratEngine {
             .remove_by_uuid(uuid)
             .expect("Must succeed since self.pools.get_by_uuid() returned a value");
 
-        if let Err(err) = pool.destroy() {
+        if let Err(err) = pool.get_mut().destroy() {
             self.pools.insert(pool_name, uuid, pool);
             Err(err)
         } else {
@@ -227,6 +320,7 @@ impl Engine for StratEngine {
         uuid: PoolUuid,
         new_name: &str,
     ) -> StratisResult<RenameAction<PoolUuid>> {
+        let _span = span("rename_pool");
         validate_name(new_name)?;
         let old_name = rename_pool_pre_idem!(self; uuid; new_name);
 
@@ -236,13 +330,13 @@ impl Engine for StratEngine {
             .expect("Must succeed since self.pools.get_by_uuid() returned a value");
 
         let new_name = Name::new(new_name.to_owned());
-        if let Err(err) = pool.write_metadata(&new_name) {
+        if let Err(err) = pool.get_mut().write_metadata(&new_name) {
             self.pools.insert(old_name, uuid, pool);
             Err(err)
         } else {
             self.pools.insert(new_name, uuid, pool);
-            let (new_name, pool) = self.pools.get_by_uuid(uuid).expect("Inserted above");
-            pool.udev_pool_change(&new_name);
+            let (new_name, pool) = self.pools.get_mut_by_uuid(uuid).expect("Inserted above");
+            pool.get_mut().udev_pool_change(&new_name);
             Ok(RenameAction::Renamed(uuid))
         }
     }
@@ -252,16 +346,28 @@ impl Engine for StratEngine {
         pool_uuid: PoolUuid,
         unlock_method: UnlockMethod,
     ) -> StratisResult<SetUnlockAction<DevUuid>> {
-        let unlocked = self
-            .liminal_devices
-            .unlock_pool(&self.pools, pool_uuid, unlock_method)?;
+        let _span = span("unlock_pool");
+        let unlocked = self.liminal_devices.unlock_pool(
+            &self.pools,
+            pool_uuid,
+            unlock_method,
+            self.unlock_parallelism,
+        )?;
         Ok(SetUnlockAction::new(unlocked))
     }
 
-    fn get_pool(&self, uuid: PoolUuid) -> Option<(Name, &dyn Pool)> {
+    fn get_pool(&self, uuid: PoolUuid) -> Option<(Name, PoolGuard<'_>)> {
         get_pool!(self; uuid)
     }
 
+    fn lock_pool(&self, uuid: PoolUuid) -> Option<(Name, PoolMutGuard<'_>)> {
+        lock_pool!(self; uuid)
+    }
+
+    fn lock_pool_by_name(&self, name: &str) -> Option<(PoolUuid, PoolMutGuard<'_>)> {
+        lock_pool_by_name!(self; name)
+    }
+
     fn get_mut_pool(&mut self, uuid: PoolUuid) -> Option<(Name, &mut dyn Pool)> {
         get_mut_pool!(self; uuid)
     }
@@ -270,57 +376,147 @@ impl Engine for StratEngine {
         self.liminal_devices.locked_pools()
     }
 
-    fn pools(&self) -> Vec<(Name, PoolUuid, &dyn Pool)> {
+    fn pools(&self) -> Vec<(Name, PoolUuid, PoolGuard<'_>)> {
         self.pools
             .iter()
-            .map(|(name, uuid, pool)| (name.clone(), *uuid, pool as &dyn Pool))
+            .map(|(name, uuid, pool)| (name.clone(), *uuid, read_pool(pool)))
             .collect()
     }
 
     fn pools_mut(&mut self) -> Vec<(Name, PoolUuid, &mut dyn Pool)> {
         self.pools
             .iter_mut()
-            .map(|(name, uuid, pool)| (name.clone(), *uuid, pool as &mut dyn Pool))
+            .map(|(name, uuid, pool)| (name.clone(), *uuid, pool.get_mut() as &mut dyn Pool))
             .collect()
     }
 
-    fn evented(&mut self) -> StratisResult<()> {
-        let device_list: HashMap<_, _> = get_dm()
-            .list_devices()?
+    fn evented(&self) -> StratisResult<()> {
+        let _span = span("evented");
+        // Index the devices watched by every pool by name, so that each
+        // device listed by devicemapper is matched to its pool in constant
+        // time.
+        let mut watched = HashMap::new();
+        for (_, pool_uuid, pool) in self.pools.iter() {
+            for dm_name in Lockable::new_pool(pool)
+                .blocking_read()
+                .get_eventing_dev_names(*pool_uuid)
+            {
+                watched.insert(dm_name, *pool_uuid);
+            }
+        }
+
+        let mut last_event_nrs = self
+            .watched_dev_last_event_nrs
+            .lock()
+            .expect("no holder of the lock panics");
+        let mut event_nrs = HashMap::with_capacity(watched.len());
+        let mut evented: HashMap<PoolUuid, HashSet<DmNameBuf>> = HashMap::new();
+        for (dm_name, _, event_nr) in get_dm().list_devices()? {
+            if let Some(pool_uuid) = watched.get(&dm_name) {
+                let event_nr = event_nr.expect("Supported DM versions always provide a value");
+                if last_event_nrs.get(&dm_name) != Some(&event_nr) {
+                    evented
+                        .entry(*pool_uuid)
+                        .or_insert_with(HashSet::new)
+                        .insert(dm_name.clone());
+                }
+                event_nrs.insert(dm_name, event_nr);
+            }
+        }
+
+        let now = Instant::now();
+        let pool_checks = evented
             .into_iter()
-            .map(|(dm_name, _, event_nr)| {
-                (
-                    dm_name,
-                    event_nr.expect("Supported DM versions always provide a value"),
-                )
+            .map(|(pool_uuid, dm_names)| {
+                let (_, pool) = self
+                    .pools
+                    .get_by_uuid(pool_uuid)
+                    .expect("pool_uuid was obtained from self.pools above");
+                let check = Lockable::new_pool(pool)
+                    .blocking_read()
+                    .event_on(pool_uuid, &dm_names);
+                (pool_uuid, check)
             })
-            .collect();
+            .collect::<Vec<_>>();
+        let mut checks = self.checks.lock().expect("no holder of the lock panics");
+        for (pool_uuid, check) in pool_checks {
+            checks.schedule(pool_uuid, check, now);
+        }
+        *last_event_nrs = event_nrs;
 
-        for (pool_name, pool_uuid, pool) in self.pools.iter_mut() {
-            let dev_names = pool.get_eventing_dev_names(*pool_uuid);
-            let event_nrs = device_list
+        Ok(())
+    }
+
+    fn run_scheduled_checks(&self) -> Option<Duration> {
+        let _span = span("run_scheduled_checks");
+        let due = self
+            .checks
+            .lock()
+            .expect("no holder of the lock panics")
+            .take_due(Instant::now());
+        for (pool_uuid, check) in due {
+            // Each pool is locked only for its own check, so that the other
+            // pools remain available meanwhile.
+            let result = self.pools.get_by_uuid(pool_uuid).map(|(pool_name, pool)| {
+                let mut pool = Lockable::new_pool(pool).blocking_write();
+                let start = Instant::now();
+                pool.run_check(pool_uuid, &pool_name, &check)
+                    .map(|_| start.elapsed())
+            });
+            let mut checks = self.checks.lock().expect("no holder of the lock panics");
+            match result {
+                Some(Ok(elapsed)) => checks.record_success(&check, elapsed),
+                Some(Err(err)) => {
+                    warn!(
+                        "Check of pool with UUID {} failed: {}; it will be retried",
+                        pool_uuid, err
+                    );
+                    checks.record_failure(pool_uuid, check, Instant::now());
+                }
+                None => checks.forget(pool_uuid),
+            }
+        }
+        self.checks
+            .lock()
+            .expect("no holder of the lock panics")
+            .next_due(Instant::now())
+    }
+
+    fn next_check_due(&self) -> Option<Duration> {
+        self.checks
+            .lock()
+            .expect("no holder of the lock panics")
+            .next_due(Instant::now())
+    }
+
+    fn read_usage(&self) -> UsageReadings {
+        let _span = span("read_usage");
+        UsageReadings {
+            pools: self
+                .pools
                 .iter()
-                .filter_map(|(dm_name, event_nr)| {
-                    if dev_names.contains(dm_name) {
-                        Some((dm_name.clone(), *event_nr))
-                    } else {
-                        None
-                    }
+                .map(|(_, pool_uuid, pool)| {
+                    (
+                        *pool_uuid,
+                        Lockable::new_pool(pool).blocking_read().read_usage(),
+                    )
                 })
-                .collect::<HashMap<_, _>>();
-
-            if self.watched_dev_last_event_nrs.get(pool_uuid) != Some(&event_nrs) {
-                // Return error early before updating the watched event numbers
-                // so that if another event comes in on any pool, this method
-                // will retry eventing as the event number will be higher than
-                // what was previously recorded.
-                pool.event_on(*pool_uuid, pool_name)?;
-            }
-            self.watched_dev_last_event_nrs
-                .insert(*pool_uuid, event_nrs);
+                .collect(),
         }
+    }
 
-        Ok(())
+    fn set_usage(&mut self, mut readings: UsageReadings) {
+        let _span = span("set_usage");
+        for (pool_name, pool_uuid, pool) in self.pools.iter_mut() {
+            if let Some(pool_readings) = readings.pools.remove(pool_uuid) {
+                if let Err(err) = pool.get_mut().set_usage(pool_readings) {
+                    warn!(
+                        "Failed to refresh the usage of pool with name {}: {}",
+                        pool_name, err
+                    );
+                }
+            }
+        }
     }
 
     fn get_key_handler(&self) -> &dyn KeyActions {
@@ -341,6 +537,7 @@ mod test {
     use devicemapper::Sectors;
 
     use crate::engine::{
+        bench,
         strat_engine::{
             cmd,
             tests::{loopbacked, real},
@@ -351,8 +548,15 @@ mod test {
     use super::*;
 
     /// Verify that a pool rename causes the pool metadata to get the new name.
+    /// The pool is created in the binary metadata format, which is read back
+    /// by an engine started with the default format.
     fn test_pool_rename(paths: &[&Path]) {
-        let mut engine = StratEngine::initialize().unwrap();
+        let mut engine = StratEngine::initialize(
+            ThinCheckPolicy::default(),
+            PoolMetadataFormat::Binary,
+            DEFAULT_PARALLELISM,
+        )
+        .unwrap();
 
         let name1 = "name1";
         let uuid1 = engine
@@ -364,6 +568,7 @@ mod test {
         let fs_name1 = "testfs1";
         let fs_name2 = "testfs2";
         let (_, pool) = engine.pools.get_mut_by_uuid(uuid1).unwrap();
+        let pool = pool.get_mut();
         let fs_uuid1 = pool
             .create_filesystems(name1, uuid1, &[(fs_name1, None)])
             .unwrap()
@@ -391,6 +596,7 @@ mod test {
         assert!(Path::new(&format!("/dev/stratis/{}/{}", name2, fs_name2)).exists());
 
         let (_, pool) = engine.pools.get_mut_by_uuid(uuid1).unwrap();
+        let pool = pool.get_mut();
         pool.destroy_filesystems(
             name2,
             fs_uuid1
@@ -413,7 +619,12 @@ mod test {
         assert_eq!(action, RenameAction::Renamed(uuid1));
         engine.teardown().unwrap();
 
-        let engine = StratEngine::initialize().unwrap();
+        let engine = StratEngine::initialize(
+            ThinCheckPolicy::default(),
+            PoolMetadataFormat::default(),
+            DEFAULT_PARALLELISM,
+        )
+        .unwrap();
         let pool_name: String = engine.get_pool(uuid1).unwrap().0.to_owned();
         assert_eq!(pool_name, name2);
     }
@@ -448,7 +659,12 @@ mod test {
 
         let (paths1, paths2) = paths.split_at(paths.len() / 2);
 
-        let mut engine = StratEngine::initialize().unwrap();
+        let mut engine = StratEngine::initialize(
+            ThinCheckPolicy::default(),
+            PoolMetadataFormat::default(),
+            DEFAULT_PARALLELISM,
+        )
+        .unwrap();
 
         let name1 = "name1";
         let uuid1 = engine
@@ -469,14 +685,24 @@ mod test {
 
         engine.teardown().unwrap();
 
-        let engine = StratEngine::initialize().unwrap();
+        let engine = StratEngine::initialize(
+            ThinCheckPolicy::default(),
+            PoolMetadataFormat::default(),
+            DEFAULT_PARALLELISM,
+        )
+        .unwrap();
 
         assert!(engine.get_pool(uuid1).is_some());
         assert!(engine.get_pool(uuid2).is_some());
 
         engine.teardown().unwrap();
 
-        let engine = StratEngine::initialize().unwrap();
+        let engine = StratEngine::initialize(
+            ThinCheckPolicy::default(),
+            PoolMetadataFormat::default(),
+            DEFAULT_PARALLELISM,
+        )
+        .unwrap();
 
         assert!(engine.get_pool(uuid1).is_some());
         assert!(engine.get_pool(uuid2).is_some());
@@ -493,4 +719,109 @@ mod test {
     fn real_test_setup() {
         real::test_with_spec(&real::DeviceLimits::AtLeast(2, None, None), test_setup);
     }
+
+    /// Verify that the engine state report written directly from the engine
+    /// is the same as the report constructed as a Value, and that it
+    /// describes the pool and its filesystem.
+    fn test_engine_state_report(paths: &[&Path]) {
+        let mut engine = StratEngine::initialize(
+            ThinCheckPolicy::default(),
+            PoolMetadataFormat::default(),
+            DEFAULT_PARALLELISM,
+        )
+        .unwrap();
+
+        let pool_name = "pool";
+        let pool_uuid = engine
+            .create_pool(pool_name, paths, None, &EncryptionInfo::default())
+            .unwrap()
+            .changed()
+            .unwrap();
+        let fs_name = "fs";
+        let (_, pool) = engine.pools.get_mut_by_uuid(pool_uuid).unwrap();
+        let pool = pool.get_mut();
+        pool.create_filesystems(pool_name, pool_uuid, &[(fs_name, None)])
+            .unwrap();
+
+        let report = engine.engine_state_report();
+        assert_eq!(
+            serde_json::from_str::<Value>(&engine.engine_state_report_json().unwrap()).unwrap(),
+            report
+        );
+        assert_eq!(report["pools"][0]["name"], pool_name);
+        assert_eq!(report["pools"][0]["uuid"], pool_uuid.to_string());
+        assert_eq!(report["pools"][0]["filesystems"][0]["name"], fs_name);
+        assert_eq!(
+            report["pools"][0]["blockdevs"]["datadevs"]
+                .as_array()
+                .unwrap()
+                .len(),
+            paths.len()
+        );
+        assert_eq!(report["errored_pools"], json!([]));
+        assert_eq!(report["hopeless_devices"], json!([]));
+
+        engine.teardown().unwrap();
+    }
+
+    #[test]
+    fn loop_test_engine_state_report() {
+        loopbacked::test_with_spec(
+            &loopbacked::DeviceLimits::Range(1, 3, None),
+            test_engine_state_report,
+        );
+    }
+
+    /// Measure the cost of generating the engine state report for a pool,
+    /// and of setting the pool up when the engine is initialized.
+    fn bench_setup(paths: &[&Path]) {
+        const NUM_REPORTS: u64 = 100;
+
+        let mut engine = StratEngine::initialize(
+            ThinCheckPolicy::default(),
+            PoolMetadataFormat::default(),
+            DEFAULT_PARALLELISM,
+        )
+        .unwrap();
+        let pool_name = "pool";
+        let pool_uuid = engine
+            .create_pool(pool_name, paths, None, &EncryptionInfo::default())
+            .unwrap()
+            .changed()
+            .unwrap();
+        let (_, pool) = engine.pools.get_mut_by_uuid(pool_uuid).unwrap();
+        let pool = pool.get_mut();
+        pool.create_filesystems(pool_name, pool_uuid, &[("fs1", None), ("fs2", None)])
+            .unwrap();
+
+        let start = Instant::now();
+        for _ in 0..NUM_REPORTS {
+            engine.engine_state_report_json().unwrap();
+        }
+        bench::report(
+            "strat/engine_state_report_json",
+            paths.len() as u64,
+            NUM_REPORTS,
+            start.elapsed(),
+        );
+        engine.teardown().unwrap();
+
+        let start = Instant::now();
+        let engine = StratEngine::initialize(
+            ThinCheckPolicy::default(),
+            PoolMetadataFormat::default(),
+            DEFAULT_PARALLELISM,
+        )
+        .unwrap();
+        bench::report("strat/initialize", paths.len() as u64, 1, start.elapsed());
+        assert!(engine.get_pool(pool_uuid).is_some());
+        engine.teardown().unwrap();
+    }
+
+    #[test]
+    #[ignore]
+    /// Run with "make bench-loop".
+    fn bench_loop_setup() {
+        loopbacked::test_with_spec(&loopbacked::DeviceLimits::Range(1, 3, None), bench_setup);
+    }
 }
@@ -9,6 +9,7 @@ use std::{
     fmt,
 };
 
+use serde::{Serialize, Serializer};
 use serde_json::Value;
 
 use crate::engine::{
@@ -525,9 +526,14 @@ impl DeviceSet {
     }
 }
 
-impl<'a> Into<Value> for &'a DeviceSet {
-    fn into(self) -> Value {
-        Value::Array(self.internal.values().map(|info| info.into()).collect())
+impl Serialize for DeviceSet {
+    /// Serialize the devices one at a time, so that only the value of the
+    /// device being serialized is in memory.
+    fn serialize<S>(&self, serializer: S) -> Result<S::Ok, S::Error>
+    where
+        S: Serializer,
+    {
+        serializer.collect_seq(self.internal.values().map(<&LInfo as Into<Value>>::into))
     }
 }
 
@@ -552,8 +558,13 @@ impl DeviceBag {
     }
 }
 
-impl<'a> Into<Value> for &'a DeviceBag {
-    fn into(self) -> Value {
-        Value::Array(self.internal.iter().map(|info| info.into()).collect())
+impl Serialize for DeviceBag {
+    /// Serialize the devices one at a time, so that only the value of the
+    /// device being serialized is in memory.
+    fn serialize<S>(&self, serializer: S) -> Result<S::Ok, S::Error>
+    where
+        S: Serializer,
+    {
+        serializer.collect_seq(self.internal.iter().map(<&LInfo as Into<Value>>::into))
     }
 }
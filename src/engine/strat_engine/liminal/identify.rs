@@ -37,12 +37,16 @@
 //! find_all is public because it is the method that is invoked by the
 //! engine on startup. identify_block_device is public because it
 //! is suitable for identifying a block device associated with a uevent.
+//! IdentificationCache wraps identify_block_device so that devices which
+//! have already been identified are not read again on every uevent.
 
 use std::{
     collections::HashMap,
+    ffi::OsStr,
     fmt,
     fs::OpenOptions,
     path::{Path, PathBuf},
+    time::Instant,
 };
 
 use serde_json::Value;
@@ -53,6 +57,7 @@ use crate::engine::{
     strat_engine::{
         backstore::CryptMetadataHandle,
         metadata::{device_identifiers, StratisIdentifiers},
+        parallel::bounded_map,
         udev::{
             block_enumerator, decide_ownership, UdevOwnership, CRYPTO_FS_TYPE, FS_TYPE_KEY,
             STRATIS_FS_TYPE,
@@ -126,7 +131,7 @@ impl<'a> Into<Value> for &'a StratisInfo {
 
 /// An enum type to distinguish between LUKS devices belong to Stratis and
 /// Stratis devices.
-#[derive(Debug, Eq, Hash, PartialEq)]
+#[derive(Clone, Debug, Eq, Hash, PartialEq)]
 pub enum DeviceInfo {
     Luks(LuksInfo),
     Stratis(StratisInfo),
@@ -273,14 +278,20 @@ fn process_stratis_device(dev: &UdevEngineDevice) -> Option<StratisInfo> {
 
 // Find all devices identified by udev and cryptsetup as LUKS devices
 // belonging to Stratis.
-fn find_all_luks_devices() -> libudev::Result<HashMap<PoolUuid, Vec<LuksInfo>>> {
+// Identify the devices on at most parallelism threads at once.
+fn find_all_luks_devices(parallelism: usize) -> libudev::Result<HashMap<PoolUuid, Vec<LuksInfo>>> {
     let context = libudev::Context::new()?;
     let mut enumerator = block_enumerator(&context)?;
     enumerator.match_property(FS_TYPE_KEY, CRYPTO_FS_TYPE)?;
 
-    let pool_map = enumerator
+    let devices = enumerator
         .scan_devices()?
-        .filter_map(|dev| identify_luks_device(&UdevEngineDevice::from(&dev)))
+        .map(|dev| UdevEngineDevice::from(&dev))
+        .collect::<Vec<_>>();
+
+    let pool_map = bounded_map(devices, parallelism, |dev| identify_luks_device(&dev))
+        .into_iter()
+        .flatten()
         .fold(HashMap::new(), |mut acc, info| {
             acc.entry(info.info.identifiers.pool_uuid)
                 .or_insert_with(Vec::new)
@@ -289,15 +300,24 @@ fn find_all_luks_devices() -> libudev::Result<HashMap<PoolUuid, Vec<LuksInfo>>>
         });
     Ok(pool_map)
 }
+
 // Find all devices identified by udev as Stratis devices.
-fn find_all_stratis_devices() -> libudev::Result<HashMap<PoolUuid, Vec<StratisInfo>>> {
+// Identify the devices on at most parallelism threads at once.
+fn find_all_stratis_devices(
+    parallelism: usize,
+) -> libudev::Result<HashMap<PoolUuid, Vec<StratisInfo>>> {
     let context = libudev::Context::new()?;
     let mut enumerator = block_enumerator(&context)?;
     enumerator.match_property(FS_TYPE_KEY, STRATIS_FS_TYPE)?;
 
-    let pool_map = enumerator
+    let devices = enumerator
         .scan_devices()?
-        .filter_map(|dev| identify_stratis_device(&UdevEngineDevice::from(&dev)))
+        .map(|dev| UdevEngineDevice::from(&dev))
+        .collect::<Vec<_>>();
+
+    let pool_map = bounded_map(devices, parallelism, |dev| identify_stratis_device(&dev))
+        .into_iter()
+        .flatten()
         .fold(HashMap::new(), |mut acc, info| {
             acc.entry(info.identifiers.pool_uuid)
                 .or_insert_with(Vec::new)
@@ -407,6 +427,161 @@ pub fn identify_block_device(event: &UdevEngineEvent) -> Option<DeviceInfo> {
     })
 }
 
+/// The udev property which holds the disk sequence number of a block device.
+/// The kernel assigns a new sequence number whenever a device number is
+/// reused for a different disk, or the media in a device changes.
+const DISKSEQ_KEY: &str = "DISKSEQ";
+
+/// The udev properties, from blkid and multipath, on which the
+/// identification of a block device depends. If any of these change, e.g.,
+/// because the device has been wiped, the device is identified again.
+const IDENTIFYING_PROPERTIES: &[&str] = &[
+    FS_TYPE_KEY,
+    "ID_FS_UUID",
+    "ID_FS_UUID_SUB",
+    "ID_FS_USAGE",
+    "ID_PART_TABLE_TYPE",
+    "ID_PART_ENTRY_DISK",
+    "DM_MULTIPATH_DEVICE_PATH",
+];
+
+/// Everything about a block device which must be unchanged for an earlier
+/// identification of the device to remain valid.
+#[derive(Debug, Eq, PartialEq)]
+struct IdentificationKey {
+    diskseq: u64,
+    devnode: Option<PathBuf>,
+    properties: Vec<Option<Box<OsStr>>>,
+}
+
+impl IdentificationKey {
+    /// Get the key for a device. Returns None if the device has no disk
+    /// sequence number, in which case its identification can not be cached,
+    /// since its device number might have been reused for another disk.
+    fn new(device: &UdevEngineDevice) -> Option<IdentificationKey> {
+        let diskseq = device
+            .property_value(DISKSEQ_KEY)
+            .and_then(|value| value.to_str())
+            .and_then(|value| value.parse::<u64>().ok())?;
+        Some(IdentificationKey {
+            diskseq,
+            devnode: device.devnode().map(|d| d.to_owned()),
+            properties: IDENTIFYING_PROPERTIES
+                .iter()
+                .map(|name| device.property_value(name).map(Box::from))
+                .collect(),
+        })
+    }
+}
+
+/// Counters for the lookups made in an IdentificationCache.
+#[derive(Debug, Default, Eq, PartialEq)]
+struct IdentificationStats {
+    hits: u64,
+    misses: u64,
+    // Lookups for devices which have no disk sequence number
+    uncacheable: u64,
+    // Cache entries discarded because the device changed
+    invalidations: u64,
+}
+
+/// The identifications of the Stratis block devices seen in udev events,
+/// keyed by device number and validated by disk sequence number and the
+/// identifying udev properties of the device.
+///
+/// A storm of change events, e.g., from a multipath path flapping or from
+/// "udevadm trigger", is thereby handled without reading the Stratis
+/// metadata of each device again. Only successful identifications are
+/// cached: identifying a device that does not belong to Stratis requires
+/// only its udev properties, and a device that could not be read should be
+/// tried again on the next event. LUKS devices are never cached, since
+/// binding or unbinding Clevis changes their encryption information without
+/// changing any udev property.
+#[derive(Debug, Default, Eq, PartialEq)]
+pub struct IdentificationCache {
+    entries: HashMap<Device, (IdentificationKey, DeviceInfo)>,
+    stats: IdentificationStats,
+}
+
+impl IdentificationCache {
+    /// Identify the block device of an add or change event, as
+    /// identify_block_device does, using the cached identification if the
+    /// device is unchanged since it was last identified.
+    pub fn identify(&mut self, event: &UdevEngineEvent) -> Option<DeviceInfo> {
+        self.identify_with(event, identify_block_device)
+    }
+
+    fn identify_with<F>(&mut self, event: &UdevEngineEvent, identify: F) -> Option<DeviceInfo>
+    where
+        F: FnOnce(&UdevEngineEvent) -> Option<DeviceInfo>,
+    {
+        let device = event.device();
+        let (devno, key) = match (
+            device.devnum().map(Device::from),
+            IdentificationKey::new(device),
+        ) {
+            (Some(devno), Some(key)) if device.is_initialized() => (devno, key),
+            _ => {
+                self.stats.uncacheable += 1;
+                return identify(event);
+            }
+        };
+
+        match self.entries.get(&devno) {
+            Some((cached_key, info)) if *cached_key == key => {
+                self.stats.hits += 1;
+                return Some(info.clone());
+            }
+            Some(_) => {
+                self.stats.invalidations += 1;
+                self.entries.remove(&devno);
+            }
+            None => (),
+        }
+
+        self.stats.misses += 1;
+        let info = identify(event);
+        if let Some(info @ DeviceInfo::Stratis(_)) = &info {
+            self.entries.insert(devno, (key, info.clone()));
+        }
+        info
+    }
+
+    /// Identify the block device of a remove event. The device can no longer
+    /// be read, so the identification cached for the device, if it is for
+    /// the same disk, is removed from the cache and returned. Otherwise, the
+    /// device is identified from the event by identify_block_device.
+    pub fn remove(&mut self, event: &UdevEngineEvent) -> Option<DeviceInfo> {
+        let device = event.device();
+        let cached = device
+            .devnum()
+            .map(Device::from)
+            .and_then(|devno| self.entries.remove(&devno));
+        match (cached, IdentificationKey::new(device)) {
+            (Some((cached_key, info)), Some(key)) if cached_key.diskseq == key.diskseq => {
+                self.stats.hits += 1;
+                Some(info)
+            }
+            _ => {
+                self.stats.misses += 1;
+                identify_block_device(event)
+            }
+        }
+    }
+}
+
+impl<'a> Into<Value> for &'a IdentificationCache {
+    fn into(self) -> Value {
+        json!({
+            "cached_devices": Value::from(self.entries.len()),
+            "hits": Value::from(self.stats.hits),
+            "misses": Value::from(self.stats.misses),
+            "uncacheable": Value::from(self.stats.uncacheable),
+            "invalidations": Value::from(self.stats.invalidations),
+        })
+    }
+}
+
 /// Retrieve all block devices that should be made use of by the
 /// Stratis engine. This excludes Stratis block devices that appear to be
 /// multipath members.
@@ -421,21 +596,43 @@ pub fn identify_block_device(event: &UdevEngineEvent) -> Option<DeviceInfo> {
 /// Return an error only on a failure to construct or scan with a udev
 /// enumerator.
 ///
+/// The headers of the devices found are read on at most parallelism threads
+/// at once; a value of 1 reads them one at a time.
+///
 /// Returns a map of pool uuids to a map of devices to devnodes for each pool.
 #[allow(clippy::type_complexity)]
-pub fn find_all() -> libudev::Result<(
+pub fn find_all(
+    parallelism: usize,
+) -> libudev::Result<(
     HashMap<PoolUuid, Vec<LuksInfo>>,
     HashMap<PoolUuid, Vec<StratisInfo>>,
 )> {
     info!("Beginning initial search for Stratis block devices");
-    find_all_luks_devices()
-        .and_then(|luks| find_all_stratis_devices().map(|stratis| (luks, stratis)))
+    let start = Instant::now();
+    let luks = find_all_luks_devices(parallelism)?;
+    info!(
+        "Identified {} LUKS devices belonging to Stratis in {:?}",
+        luks.values().map(|infos| infos.len()).sum::<usize>(),
+        start.elapsed()
+    );
+
+    let start = Instant::now();
+    let stratis = find_all_stratis_devices(parallelism)?;
+    info!(
+        "Identified {} Stratis devices in {:?}",
+        stratis.values().map(|infos| infos.len()).sum::<usize>(),
+        start.elapsed()
+    );
+
+    Ok((luks, stratis))
 }
 
 #[cfg(test)]
 mod tests {
 
-    use std::{collections::HashSet, error::Error};
+    use std::{cell::Cell, collections::HashSet, error::Error};
+
+    use libudev::EventType;
 
     use crate::{
         engine::{
@@ -446,13 +643,110 @@ mod tests {
                 tests::{crypt, loopbacked, real},
                 udev::block_device_apply,
             },
-            types::{EncryptionInfo, KeyDescription},
+            types::{DevUuid, EncryptionInfo, KeyDescription},
         },
         stratis::StratisError,
     };
 
     use super::*;
 
+    fn udev_event(event_type: EventType, diskseq: Option<u64>, fs_type: &str) -> UdevEngineEvent {
+        let mut properties: HashMap<Box<OsStr>, Box<OsStr>> = HashMap::new();
+        properties.insert(
+            Box::from(OsStr::new(FS_TYPE_KEY)),
+            Box::from(OsStr::new(fs_type)),
+        );
+        if let Some(diskseq) = diskseq {
+            properties.insert(
+                Box::from(OsStr::new(DISKSEQ_KEY)),
+                Box::from(OsStr::new(&diskseq.to_string())),
+            );
+        }
+        UdevEngineEvent::new(
+            event_type,
+            UdevEngineDevice::new(
+                true,
+                Some(PathBuf::from("/dev/sdb")),
+                Some(0x0810),
+                properties,
+            ),
+        )
+    }
+
+    #[test]
+    /// Verify that a device is identified again only when its disk sequence
+    /// number or its identifying udev properties change, that devices
+    /// without a disk sequence number are never cached, and that remove
+    /// events are identified from the cache.
+    fn test_identification_cache() {
+        let info = DeviceInfo::Stratis(StratisInfo {
+            identifiers: StratisIdentifiers::new(PoolUuid::new_v4(), DevUuid::new_v4()),
+            device_number: Device::from(0x0810),
+            devnode: PathBuf::from("/dev/sdb"),
+        });
+        let reads = Cell::new(0);
+        let identify = |_: &UdevEngineEvent| {
+            reads.set(reads.get() + 1);
+            Some(info.clone())
+        };
+
+        let mut cache = IdentificationCache::default();
+        let change = udev_event(EventType::Change, Some(1), STRATIS_FS_TYPE);
+        for _ in 0..10 {
+            assert_eq!(cache.identify_with(&change, identify), Some(info.clone()));
+        }
+        assert_eq!(reads.get(), 1);
+        assert_eq!((cache.stats.hits, cache.stats.misses), (9, 1));
+
+        // A new disk with the same device number is identified again.
+        let new_disk = udev_event(EventType::Change, Some(2), STRATIS_FS_TYPE);
+        cache.identify_with(&new_disk, identify);
+        assert_eq!(reads.get(), 2);
+        assert_eq!(cache.stats.invalidations, 1);
+
+        // So is the same disk once its udev properties change.
+        let wiped = udev_event(EventType::Change, Some(2), CRYPTO_FS_TYPE);
+        cache.identify_with(&wiped, identify);
+        assert_eq!(reads.get(), 3);
+
+        let no_diskseq = udev_event(EventType::Change, None, CRYPTO_FS_TYPE);
+        cache.identify_with(&no_diskseq, identify);
+        cache.identify_with(&no_diskseq, identify);
+        assert_eq!(reads.get(), 5);
+        assert_eq!(cache.stats.uncacheable, 2);
+
+        let remove = udev_event(EventType::Remove, Some(2), CRYPTO_FS_TYPE);
+        assert_eq!(cache.remove(&remove), Some(info));
+        assert!(cache.entries.is_empty());
+    }
+
+    #[test]
+    /// Verify that LUKS devices are identified again on every event, so that
+    /// a change to their encryption information is always seen.
+    fn test_identification_cache_luks() {
+        let info = DeviceInfo::Luks(LuksInfo {
+            info: StratisInfo {
+                identifiers: StratisIdentifiers::new(PoolUuid::new_v4(), DevUuid::new_v4()),
+                device_number: Device::from(0x0810),
+                devnode: PathBuf::from("/dev/sdb"),
+            },
+            encryption_info: EncryptionInfo::default(),
+        });
+        let reads = Cell::new(0);
+        let identify = |_: &UdevEngineEvent| {
+            reads.set(reads.get() + 1);
+            Some(info.clone())
+        };
+
+        let mut cache = IdentificationCache::default();
+        let change = udev_event(EventType::Change, Some(1), CRYPTO_FS_TYPE);
+        for _ in 0..3 {
+            assert_eq!(cache.identify_with(&change, identify), Some(info.clone()));
+        }
+        assert_eq!(reads.get(), 3);
+        assert!(cache.entries.is_empty());
+    }
+
     /// Test that an encrypted device initialized by stratisd is properly
     /// recognized.
     ///
@@ -7,9 +7,12 @@
 use std::{
     collections::{HashMap, HashSet},
     fmt,
+    path::Path,
+    time::Instant,
 };
 
 use serde_json::Value;
+use tokio::sync::RwLock;
 
 use crate::{
     engine::{
@@ -18,14 +21,17 @@ use crate::{
             backstore::CryptActivationHandle,
             liminal::{
                 device_info::{DeviceBag, DeviceSet, LInfo, LLuksInfo, LStratisInfo},
-                identify::{identify_block_device, DeviceInfo, LuksInfo, StratisInfo},
+                identify::{DeviceInfo, IdentificationCache, LuksInfo, StratisInfo},
                 setup::{get_bdas, get_blockdevs, get_metadata},
             },
             metadata::StratisIdentifiers,
+            parallel::{bounded_map, DEFAULT_PARALLELISM},
             pool::StratPool,
         },
-        structures::Table,
-        types::{DevUuid, LockedPoolInfo, Name, PoolUuid, UdevEngineEvent, UnlockMethod},
+        structures::{Lockable, Table},
+        types::{
+            DevUuid, LockedPoolInfo, Name, PoolUuid, ThinCheckPolicy, UdevEngineEvent, UnlockMethod,
+        },
     },
     stratis::{StratisError, StratisResult},
 };
@@ -56,9 +62,20 @@ pub struct LiminalDevices {
     /// Sets of devices which possess some internal contradiction which makes
     /// it impossible for them to be made into sensible pools ever.
     hopeless_device_sets: HashMap<PoolUuid, DeviceBag>,
+    /// The identifications of the block devices seen in udev events.
+    identification_cache: IdentificationCache,
+    /// How the thin pool metadata of each pool is checked when it is set up.
+    thin_check_policy: ThinCheckPolicy,
 }
 
 impl LiminalDevices {
+    pub fn new(thin_check_policy: ThinCheckPolicy) -> LiminalDevices {
+        LiminalDevices {
+            thin_check_policy,
+            ..LiminalDevices::default()
+        }
+    }
+
     #[allow(dead_code)]
     fn invariant(&self) {
         assert!(self
@@ -78,20 +95,25 @@ impl LiminalDevices {
     }
 
     /// Unlock the liminal encrypted devices that correspond to the given pool UUID.
+    ///
+    /// The devices are unlocked on no more than parallelism threads at once.
+    /// Every device is attempted even if unlocking some other device fails;
+    /// if any device fails to unlock, the first error is returned.
     pub fn unlock_pool(
         &mut self,
-        pools: &Table<PoolUuid, StratPool>,
+        pools: &Table<PoolUuid, RwLock<StratPool>>,
         pool_uuid: PoolUuid,
         unlock_method: UnlockMethod,
+        parallelism: usize,
     ) -> StratisResult<Vec<DevUuid>> {
-        fn handle_luks(luks_info: &LLuksInfo, unlock_method: UnlockMethod) -> StratisResult<()> {
-            if CryptActivationHandle::setup(&luks_info.ids.devnode, unlock_method)?.is_some() {
+        fn handle_luks(devnode: &Path, unlock_method: UnlockMethod) -> StratisResult<()> {
+            if CryptActivationHandle::setup(devnode, unlock_method)?.is_some() {
                 Ok(())
             } else {
                 Err(StratisError::Msg(format!(
                     "Block device {} does not appear to be formatted with
                         the proper Stratis LUKS2 metadata.",
-                    luks_info.ids.devnode.display(),
+                    devnode.display(),
                 )))
             }
         }
@@ -107,21 +129,39 @@ impl LiminalDevices {
                     ));
                 }
 
+                let luks_devices = map
+                    .iter()
+                    .filter_map(|(dev_uuid, info)| match info {
+                        LInfo::Stratis(_) => None,
+                        LInfo::Luks(ref luks_info) => {
+                            Some((*dev_uuid, luks_info.ids.devnode.clone()))
+                        }
+                    })
+                    .collect::<Vec<_>>();
+
+                let results = bounded_map(luks_devices, parallelism, move |(dev_uuid, devnode)| {
+                    (dev_uuid, handle_luks(&devnode, unlock_method))
+                });
+
                 let mut unlocked = Vec::new();
-                for (dev_uuid, info) in map.iter() {
-                    match info {
-                        LInfo::Stratis(_) => (),
-                        LInfo::Luks(ref luks_info) => match handle_luks(luks_info, unlock_method) {
-                            Ok(()) => unlocked.push(*dev_uuid),
-                            Err(e) => return Err(e),
-                        },
+                let mut first_err = None;
+                for (dev_uuid, result) in results {
+                    match result {
+                        Ok(()) => unlocked.push(dev_uuid),
+                        Err(e) => {
+                            warn!("Failed to unlock device with UUID {}: {}", dev_uuid, e);
+                            first_err.get_or_insert(e);
+                        }
                     }
                 }
+                if let Some(e) = first_err {
+                    return Err(e);
+                }
                 unlocked
             }
             None => match pools.get_by_uuid(pool_uuid) {
                 Some((_, pool)) => {
-                    if pool.is_encrypted() {
+                    if Lockable::new_pool(pool).blocking_read().is_encrypted() {
                         vec![]
                     } else {
                         return Err(StratisError::Msg(format!(
@@ -142,6 +182,11 @@ impl LiminalDevices {
         Ok(unlocked)
     }
 
+    /// Get the counters of the cache of block device identifications.
+    pub fn identification_report(&self) -> Value {
+        (&self.identification_cache).into()
+    }
+
     /// Get a mapping of pool UUIDs from all of the LUKS2 devices that are currently
     /// locked to their encryption info in the set of pools that are not yet set up.
     // Precondition: All devices for a given errored pool have been determined to have
@@ -156,6 +201,9 @@ impl LiminalDevices {
     /// Take maps of pool UUIDs to sets of devices and return a list of
     /// information about created pools.
     ///
+    /// Independent pools are set up concurrently, on no more than parallelism
+    /// threads at once.
+    ///
     /// Precondition: No pools have yet been set up, i.e., it is unnecessary
     /// to check for membership in any of the existing categories of device
     /// sets.
@@ -165,8 +213,8 @@ impl LiminalDevices {
             HashMap<PoolUuid, Vec<LuksInfo>>,
             HashMap<PoolUuid, Vec<StratisInfo>>,
         ),
+        parallelism: usize,
     ) -> Vec<(Name, PoolUuid, StratPool)> {
-        let table = Table::default();
         let (mut luks_devices, mut stratis_devices) = all_devices;
 
         let pool_uuids: HashSet<PoolUuid> = luks_devices
@@ -177,38 +225,65 @@ impl LiminalDevices {
             .cloned()
             .collect();
 
-        pool_uuids
-            .iter()
-            .filter_map(|pool_uuid| {
-                let luks_infos = luks_devices.remove(pool_uuid);
-                let stratis_infos = stratis_devices.remove(pool_uuid);
-                let mut infos: Vec<DeviceInfo> = stratis_infos
-                    .unwrap_or_else(Vec::new)
-                    .drain(..)
-                    .map(DeviceInfo::Stratis)
-                    .chain(
-                        luks_infos
-                            .unwrap_or_else(Vec::new)
-                            .drain(..)
-                            .map(DeviceInfo::Luks),
-                    )
-                    .collect();
-
-                let mut info_map = DeviceSet::new();
-                while !infos.is_empty() && !self.hopeless_device_sets.contains_key(pool_uuid) {
-                    let info: DeviceInfo = infos.pop().expect("!infos.is_empty()");
-                    if let Err(mut hopeless) = info_map.process_info_add(info) {
-                        hopeless.extend(infos.drain(..).map(|x| x.into()));
-                        self.hopeless_device_sets.insert(*pool_uuid, hopeless);
-                    }
+        let mut device_sets = Vec::new();
+        for pool_uuid in pool_uuids {
+            let luks_infos = luks_devices.remove(&pool_uuid);
+            let stratis_infos = stratis_devices.remove(&pool_uuid);
+            let mut infos: Vec<DeviceInfo> = stratis_infos
+                .unwrap_or_else(Vec::new)
+                .drain(..)
+                .map(DeviceInfo::Stratis)
+                .chain(
+                    luks_infos
+                        .unwrap_or_else(Vec::new)
+                        .drain(..)
+                        .map(DeviceInfo::Luks),
+                )
+                .collect();
+
+            let mut info_map = DeviceSet::new();
+            while !infos.is_empty() && !self.hopeless_device_sets.contains_key(&pool_uuid) {
+                let info: DeviceInfo = infos.pop().expect("!infos.is_empty()");
+                if let Err(mut hopeless) = info_map.process_info_add(info) {
+                    hopeless.extend(infos.drain(..).map(|x| x.into()));
+                    self.hopeless_device_sets.insert(pool_uuid, hopeless);
                 }
+            }
 
-                if !self.hopeless_device_sets.contains_key(pool_uuid) {
-                    self.try_setup_pool(&table, *pool_uuid, info_map)
-                        .map(|(pool_name, pool)| (pool_name, *pool_uuid, pool))
-                } else {
-                    None
-                }
+            if !self.hopeless_device_sets.contains_key(&pool_uuid) {
+                device_sets.push((pool_uuid, info_map));
+            }
+        }
+
+        // No pools have been set up yet, so each pool can be set up in the
+        // context of an empty table of pools without regard to the others.
+        let start = Instant::now();
+        let num_pools = device_sets.len();
+        let thin_check_policy = self.thin_check_policy;
+        // The threads are shared out among the pools, so that reading the
+        // BDAs of each pool does not multiply the number of threads.
+        let pool_parallelism = (parallelism / num_pools.max(1)).max(1);
+        let results = bounded_map(device_sets, parallelism, |(pool_uuid, infos)| {
+            let result = attempt_setup(
+                &Table::default(),
+                pool_uuid,
+                &infos,
+                thin_check_policy,
+                pool_parallelism,
+            );
+            (pool_uuid, infos, result)
+        });
+        info!(
+            "Finished attempting to set up {} pools in {:?}",
+            num_pools,
+            start.elapsed()
+        );
+
+        results
+            .into_iter()
+            .filter_map(|(pool_uuid, infos, result)| {
+                self.handle_setup_result(pool_uuid, infos, result)
+                    .map(|(pool_name, pool)| (pool_name, pool_uuid, pool))
             })
             .collect::<Vec<(Name, PoolUuid, StratPool)>>()
     }
@@ -226,7 +301,7 @@ impl LiminalDevices {
     ///               self.hopeless_device_sets.get(pool_uuid).is_none()
     fn try_setup_pool(
         &mut self,
-        pools: &Table<PoolUuid, StratPool>,
+        pools: &Table<PoolUuid, RwLock<StratPool>>,
         pool_uuid: PoolUuid,
         infos: DeviceSet,
     ) -> Option<(Name, StratPool)> {
@@ -234,123 +309,41 @@ impl LiminalDevices {
         assert!(self.errored_pool_devices.get(&pool_uuid).is_none());
         assert!(self.hopeless_device_sets.get(&pool_uuid).is_none());
 
-        // Setup a pool from constituent devices in the context of some already
-        // setup pools.
-        //
-        // Precondition: every device represented by an item in infos has
-        // already been determined to belong to the pool with pool_uuid.
-        fn setup_pool(
-            pools: &Table<PoolUuid, StratPool>,
-            pool_uuid: PoolUuid,
-            infos: &HashMap<DevUuid, &LStratisInfo>,
-        ) -> Result<(Name, StratPool), Destination> {
-            let bdas = match get_bdas(infos) {
-                Err(err) => Err(
-                    Destination::Errored(format!(
-                        "There was an error encountered when reading the BDAs for the devices found for pool with UUID {}: {}",
-                        pool_uuid,
-                        err))),
-                Ok(infos) => Ok(infos),
-            }?;
-
-            if let Some((dev_uuid, bda)) = bdas.iter().find(|(dev_uuid, bda)| {
-                **dev_uuid != bda.dev_uuid() || pool_uuid != bda.pool_uuid()
-            }) {
-                return Err(
-                    Destination::Hopeless(format!(
-                        "Mismatch between Stratis identifiers previously read and those found on some BDA: {} != {}",
-                        StratisIdentifiers::new(pool_uuid, *dev_uuid),
-                        StratisIdentifiers::new(bda.pool_uuid(), bda.dev_uuid())
-                        )));
-            }
-
-            let (timestamp, metadata) = match get_metadata(infos, &bdas) {
-                Err(err) => return Err(
-                    Destination::Errored(format!(
-                        "There was an error encountered when reading the metadata for the devices found for pool with UUID {}: {}",
-                        pool_uuid,
-                        err))),
-                Ok(None) => return Err(
-                    Destination::Errored(format!(
-                        "No metadata found on devices associated with pool UUID {}",
-                        pool_uuid))),
-                Ok(Some((timestamp, metadata))) => (timestamp, metadata),
-            };
-
-            if let Some((uuid, _)) = pools.get_by_name(&metadata.name) {
-                return Err(
-                    Destination::Errored(format!(
-                        "There is a pool name conflict. The devices currently being processed have been identified as belonging to the pool with UUID {} and name {}, but a pool with the same name and UUID {} is already active",
-                        pool_uuid,
-                        &metadata.name,
-                        uuid)));
-            }
-
-            let (datadevs, cachedevs) = match get_blockdevs(&metadata.backstore, infos, bdas) {
-                Err(err) => return Err(
-                    Destination::Errored(format!(
-                        "There was an error encountered when calculating the block devices for pool with UUID {} and name {}: {}",
-                        pool_uuid,
-                        &metadata.name,
-                        err))),
-                Ok((datadevs, cachedevs)) => (datadevs, cachedevs),
-            };
-
-            if datadevs.get(0).is_none() {
-                return Err(Destination::Hopeless(format!(
-                    "There do not appear to be any data devices in the set with pool UUID {}",
-                    pool_uuid
-                )));
-            }
-
-            // NOTE: DeviceSet provides infos variable in setup_pool. DeviceSet
-            // ensures that all encryption infos match so we do not need to
-            // check again here.
-            let num_with_luks = datadevs
-                .iter()
-                .filter(|sbd| sbd.encryption_info().is_encrypted())
-                .count();
-
-            if num_with_luks != 0 && num_with_luks != datadevs.len() {
-                // NOTE: This is not actually a hopeless situation. It may be
-                // that a LUKS device owned by Stratis corresponding to a
-                // Stratis device has just not been discovered yet. If it
-                // is, the appropriate info will be updated, and setup may
-                // yet succeed.
-                return Err(
-                    Destination::Errored(format!(
-                            "Some data devices in the set belonging to pool with UUID {} and name {} appear to be encrypted devices managed by Stratis, and some do not",
-                            pool_uuid,
-                            &metadata.name)));
-            }
-
-            StratPool::setup(pool_uuid, datadevs, cachedevs, timestamp, &metadata).map_err(|err| {
-                Destination::Errored(format!(
-                    "An attempt to set up pool with UUID {} from the assembled devices failed: {}",
-                    pool_uuid, err
-                ))
-            })
-        }
+        let result = attempt_setup(
+            pools,
+            pool_uuid,
+            &infos,
+            self.thin_check_policy,
+            DEFAULT_PARALLELISM,
+        );
+        self.handle_setup_result(pool_uuid, infos, result)
+    }
 
-        let opened = match infos.as_opened_set() {
-            Some(opened) => opened,
+    /// Given the result of an attempt to set up a pool from a set of devices,
+    /// return the pool information if a pool was set up. Otherwise, distribute
+    /// the pool information to the appropriate data structure.
+    ///
+    /// A result of None indicates that no attempt was made because the
+    /// set of devices contained some unopened devices.
+    fn handle_setup_result(
+        &mut self,
+        pool_uuid: PoolUuid,
+        infos: DeviceSet,
+        result: Option<Result<(Name, StratPool), Destination>>,
+    ) -> Option<(Name, StratPool)> {
+        match result {
             None => {
                 self.errored_pool_devices.insert(pool_uuid, infos);
-                return None;
+                None
             }
-        };
-
-        let result = setup_pool(pools, pool_uuid, &opened);
-
-        match result {
-            Ok((pool_name, pool)) => {
+            Some(Ok((pool_name, pool))) => {
                 info!(
                     "Pool with name \"{}\" and UUID \"{}\" set up",
                     pool_name, pool_uuid
                 );
                 Some((pool_name, pool))
             }
-            Err(Destination::Hopeless(err)) => {
+            Some(Err(Destination::Hopeless(err))) => {
                 warn!(
                     "Attempt to set up pool failed, moving to hopeless devices: {}",
                     err
@@ -359,7 +352,7 @@ impl LiminalDevices {
                     .insert(pool_uuid, infos.into_bag());
                 None
             }
-            Err(Destination::Errored(err)) => {
+            Some(Err(Destination::Errored(err))) => {
                 info!("Attempt to set up pool failed, but it may be possible to set up the pool later, if the situation changes: {}", err);
                 self.errored_pool_devices.insert(pool_uuid, infos);
                 None
@@ -367,25 +360,35 @@ impl LiminalDevices {
         }
     }
 
-    /// Given some information gathered about a single Stratis device, determine
-    /// whether or not a pool can be constructed, and if it can, construct the
-    /// pool and return the newly constructed pool. If the device appears to
-    /// belong to a pool that has already been set up assume that no further
-    /// processing is required and return None. If there is an error
-    /// constructing the pool, retain the set of devices.
-    pub fn block_evaluate(
+    /// Given a udev event on a single block device, record what has been
+    /// learned about the device. If the device belongs to a pool that has not
+    /// yet been set up and that may still be set up, return the UUID of the
+    /// pool, so that the caller can attempt to set it up by means of
+    /// block_evaluate_pool. If the device appears to belong to a pool that has
+    /// already been set up assume that no further processing is required and
+    /// return None.
+    ///
+    /// Applying all the events in a batch before evaluating the pools they
+    /// affect means that a pool whose devices all appear at once is set up
+    /// in a single attempt, rather than in one failed attempt per device.
+    pub fn block_apply(
         &mut self,
-        pools: &Table<PoolUuid, StratPool>,
+        pools: &Table<PoolUuid, RwLock<StratPool>>,
         event: &UdevEngineEvent,
-    ) -> Option<(PoolUuid, Name, StratPool)> {
+    ) -> Option<PoolUuid> {
         let event_type = event.event_type();
         if event_type == libudev::EventType::Add || event_type == libudev::EventType::Change {
-            identify_block_device(event).and_then(move |info| {
+            let info = self.identification_cache.identify(event);
+            info.and_then(move |info| {
                 let stratis_identifiers = info.stratis_identifiers();
                 let pool_uuid = stratis_identifiers.pool_uuid;
                 let device_uuid = stratis_identifiers.device_uuid;
                 if let Some((_, pool)) = pools.get_by_uuid(pool_uuid) {
-                    if pool.get_strat_blockdev(device_uuid).is_none() {
+                    if Lockable::new_pool(pool)
+                        .blocking_read()
+                        .get_strat_blockdev(device_uuid)
+                        .is_none()
+                    {
                         warn!("Found a device with {} that identifies itself as belonging to pool with UUID {}, but that pool is already up and running and does not appear to contain the device",
                               info,
                               pool_uuid);
@@ -417,17 +420,22 @@ impl LiminalDevices {
                     // leave a pool that could be set up in limbo forever. An
                     // alternative, where the user can explicitly ask to try to
                     // set up an incomplete pool would be a better choice.
-                    self.try_setup_pool(pools, pool_uuid, devices)
-                        .map(|(name, pool)| (pool_uuid, name, pool))
+                    self.errored_pool_devices.insert(pool_uuid, devices);
+                    Some(pool_uuid)
                 }
             })
         } else if event_type == libudev::EventType::Remove {
-            identify_block_device(event).and_then(move |info| {
+            let info = self.identification_cache.remove(event);
+            info.and_then(move |info| {
                 let stratis_identifiers = info.stratis_identifiers();
                 let pool_uuid = stratis_identifiers.pool_uuid;
                 let device_uuid = stratis_identifiers.device_uuid;
                 if let Some((_, pool)) = pools.get_by_uuid(pool_uuid) {
-                    if pool.get_strat_blockdev(device_uuid).is_some() {
+                    if Lockable::new_pool(pool)
+                        .blocking_read()
+                        .get_strat_blockdev(device_uuid)
+                        .is_some()
+                    {
                         warn!("udev reports that a device with {} that appears to belong to a pool with UUID {} has just been removed; this is likely to result in data loss",
                               info,
                               pool_uuid);
@@ -445,41 +453,214 @@ impl LiminalDevices {
 
                     devices.process_info_remove(info);
 
-                    self.try_setup_pool(pools, pool_uuid, devices)
-                        .map(|(name, pool)| (pool_uuid, name, pool))
+                    self.errored_pool_devices.insert(pool_uuid, devices);
+                    Some(pool_uuid)
                 }
             })
         } else {
             None
         }
     }
+
+    /// Determine whether or not the pool with the given UUID, whose devices
+    /// have changed, can be constructed, and if it can, construct the pool
+    /// and return the newly constructed pool. If there is an error
+    /// constructing the pool, retain the set of devices.
+    pub fn block_evaluate_pool(
+        &mut self,
+        pools: &Table<PoolUuid, RwLock<StratPool>>,
+        pool_uuid: PoolUuid,
+    ) -> Option<(Name, StratPool)> {
+        if pools.get_by_uuid(pool_uuid).is_some() {
+            return None;
+        }
+        let devices = self.errored_pool_devices.remove(&pool_uuid)?;
+        self.try_setup_pool(pools, pool_uuid, devices)
+    }
+}
+
+/// Setup a pool from constituent devices in the context of some already
+/// setup pools.
+///
+/// The BDAs of the devices are read on no more than parallelism threads at
+/// once.
+///
+/// Precondition: every device represented by an item in infos has
+/// already been determined to belong to the pool with pool_uuid.
+fn setup_pool(
+    pools: &Table<PoolUuid, RwLock<StratPool>>,
+    pool_uuid: PoolUuid,
+    infos: &HashMap<DevUuid, &LStratisInfo>,
+    thin_check_policy: ThinCheckPolicy,
+    parallelism: usize,
+) -> Result<(Name, StratPool), Destination> {
+    let start = Instant::now();
+    let bdas = match get_bdas(infos, parallelism) {
+        Err(err) => Err(
+            Destination::Errored(format!(
+                "There was an error encountered when reading the BDAs for the devices found for pool with UUID {}: {}",
+                pool_uuid,
+                err))),
+        Ok(infos) => Ok(infos),
+    }?;
+
+    if let Some((dev_uuid, bda)) = bdas
+        .iter()
+        .find(|(dev_uuid, bda)| **dev_uuid != bda.dev_uuid() || pool_uuid != bda.pool_uuid())
+    {
+        return Err(
+            Destination::Hopeless(format!(
+                "Mismatch between Stratis identifiers previously read and those found on some BDA: {} != {}",
+                StratisIdentifiers::new(pool_uuid, *dev_uuid),
+                StratisIdentifiers::new(bda.pool_uuid(), bda.dev_uuid())
+                )));
+    }
+
+    let (timestamp, metadata, format) = match get_metadata(infos, &bdas) {
+        Err(err) => return Err(
+            Destination::Errored(format!(
+                "There was an error encountered when reading the metadata for the devices found for pool with UUID {}: {}",
+                pool_uuid,
+                err))),
+        Ok(None) => return Err(
+            Destination::Errored(format!(
+                "No metadata found on devices associated with pool UUID {}",
+                pool_uuid))),
+        Ok(Some((timestamp, metadata, format))) => (timestamp, metadata, format),
+    };
+    let metadata_read_time = start.elapsed();
+
+    if let Some((uuid, _)) = pools.get_by_name(&metadata.name) {
+        return Err(
+            Destination::Errored(format!(
+                "There is a pool name conflict. The devices currently being processed have been identified as belonging to the pool with UUID {} and name {}, but a pool with the same name and UUID {} is already active",
+                pool_uuid,
+                &metadata.name,
+                uuid)));
+    }
+
+    let (datadevs, cachedevs) = match get_blockdevs(&metadata.backstore, infos, bdas) {
+        Err(err) => return Err(
+            Destination::Errored(format!(
+                "There was an error encountered when calculating the block devices for pool with UUID {} and name {}: {}",
+                pool_uuid,
+                &metadata.name,
+                err))),
+        Ok((datadevs, cachedevs)) => (datadevs, cachedevs),
+    };
+
+    if datadevs.get(0).is_none() {
+        return Err(Destination::Hopeless(format!(
+            "There do not appear to be any data devices in the set with pool UUID {}",
+            pool_uuid
+        )));
+    }
+
+    // NOTE: DeviceSet provides infos variable in setup_pool. DeviceSet
+    // ensures that all encryption infos match so we do not need to
+    // check again here.
+    let num_with_luks = datadevs
+        .iter()
+        .filter(|sbd| sbd.encryption_info().is_encrypted())
+        .count();
+
+    if num_with_luks != 0 && num_with_luks != datadevs.len() {
+        // NOTE: This is not actually a hopeless situation. It may be
+        // that a LUKS device owned by Stratis corresponding to a
+        // Stratis device has just not been discovered yet. If it
+        // is, the appropriate info will be updated, and setup may
+        // yet succeed.
+        return Err(
+            Destination::Errored(format!(
+                    "Some data devices in the set belonging to pool with UUID {} and name {} appear to be encrypted devices managed by Stratis, and some do not",
+                    pool_uuid,
+                    &metadata.name)));
+    }
+
+    let start = Instant::now();
+    let result = StratPool::setup(
+        pool_uuid,
+        datadevs,
+        cachedevs,
+        timestamp,
+        &metadata,
+        format,
+        thin_check_policy,
+    )
+    .map_err(|err| {
+        Destination::Errored(format!(
+            "An attempt to set up pool with UUID {} from the assembled devices failed: {}",
+            pool_uuid, err
+        ))
+    });
+    info!(
+        "Read metadata from {} devices for pool with UUID {} in {:?}; set up pool devices in {:?}",
+        infos.len(),
+        pool_uuid,
+        metadata_read_time,
+        start.elapsed()
+    );
+    result
+}
+
+/// Attempt to set up a pool from a set of devices in the context of some
+/// already set up pools. Return None, without attempting setup, if the set
+/// contains any unopened devices.
+fn attempt_setup(
+    pools: &Table<PoolUuid, RwLock<StratPool>>,
+    pool_uuid: PoolUuid,
+    infos: &DeviceSet,
+    thin_check_policy: ThinCheckPolicy,
+    parallelism: usize,
+) -> Option<Result<(Name, StratPool), Destination>> {
+    infos
+        .as_opened_set()
+        .map(|opened| setup_pool(pools, pool_uuid, &opened, thin_check_policy, parallelism))
+}
+
+/// The devices of a pool that has not been set up, as they appear in the
+/// engine state report.
+#[derive(Serialize)]
+struct PoolDevicesReport<'a, T> {
+    devices: &'a T,
+    pool_uuid: PoolUuid,
+}
+
+/// The devices that have not been assembled into pools, as they appear in the
+/// engine state report, borrowed from LiminalDevices. Fields are declared in
+/// the order in which they are reported.
+#[derive(Serialize)]
+pub struct LiminalDevicesReport<'a> {
+    errored_pools: Vec<PoolDevicesReport<'a, DeviceSet>>,
+    hopeless_devices: Vec<PoolDevicesReport<'a, DeviceBag>>,
+}
+
+impl<'a> From<&'a LiminalDevices> for LiminalDevicesReport<'a> {
+    fn from(devices: &'a LiminalDevices) -> LiminalDevicesReport<'a> {
+        LiminalDevicesReport {
+            errored_pools: devices
+                .errored_pool_devices
+                .iter()
+                .map(|(pool_uuid, set)| PoolDevicesReport {
+                    devices: set,
+                    pool_uuid: *pool_uuid,
+                })
+                .collect(),
+            hopeless_devices: devices
+                .hopeless_device_sets
+                .iter()
+                .map(|(pool_uuid, bag)| PoolDevicesReport {
+                    devices: bag,
+                    pool_uuid: *pool_uuid,
+                })
+                .collect(),
+        }
+    }
 }
 
 impl<'a> Into<Value> for &'a LiminalDevices {
     fn into(self) -> Value {
-        json!({
-            "errored_pools": Value::Array(
-                self.errored_pool_devices
-                    .iter()
-                    .map(|(uuid, map)| {
-                        json!({
-                            "pool_uuid": uuid.to_string(),
-                            "devices": <&DeviceSet as Into<Value>>::into(&map),
-                        })
-                    })
-                    .collect(),
-            ),
-            "hopeless_devices": Value::Array(
-                self.hopeless_device_sets
-                    .iter()
-                    .map(|(uuid, set)| {
-                        json!({
-                            "pool_uuid": uuid.to_string(),
-                            "devices": <&DeviceBag as Into<Value>>::into(&set),
-                        })
-                    })
-                    .collect()
-            )
-        })
+        serde_json::to_value(LiminalDevicesReport::from(self))
+            .expect("all values in the liminal devices report are representable in JSON")
     }
 }
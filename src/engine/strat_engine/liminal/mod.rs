@@ -8,4 +8,7 @@ mod identify;
 mod liminal;
 mod setup;
 
-pub use self::{identify::find_all, liminal::LiminalDevices};
+pub use self::{
+    identify::find_all,
+    liminal::{LiminalDevices, LiminalDevicesReport},
+};
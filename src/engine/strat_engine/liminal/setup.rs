@@ -20,7 +20,8 @@ use crate::{
             backstore::{CryptHandle, StratBlockDev, UnderlyingDevice},
             device::blkdev_size,
             liminal::device_info::LStratisInfo,
-            metadata::{StaticHeader, BDA},
+            metadata::{decode_pool_metadata, PoolMetadataFormat, StaticHeader, BDA},
+            parallel::bounded_map,
             serde_structs::{BackstoreSave, BaseBlockDevSave, PoolSave},
         },
         types::{BlockDevTier, DevUuid, DevicePath},
@@ -34,9 +35,14 @@ use crate::{
 /// identified as having the given pool UUID and their associated device
 /// UUID.
 ///
+/// The BDAs are read on no more than parallelism threads at once.
+///
 /// Postconditions: keys in result are equal to keys in infos OR an error
 /// is returned.
-pub fn get_bdas(infos: &HashMap<DevUuid, &LStratisInfo>) -> StratisResult<HashMap<DevUuid, BDA>> {
+pub fn get_bdas(
+    infos: &HashMap<DevUuid, &LStratisInfo>,
+    parallelism: usize,
+) -> StratisResult<HashMap<DevUuid, BDA>> {
     fn read_bda(info: &LStratisInfo) -> StratisResult<BDA> {
         OpenOptions::new()
             .read(true)
@@ -70,13 +76,20 @@ pub fn get_bdas(infos: &HashMap<DevUuid, &LStratisInfo>) -> StratisResult<HashMa
             })
     }
 
-    infos
+    let infos = infos
         .iter()
-        .map(|(dev_uuid, info)| read_bda(info).map(|bda| (*dev_uuid, bda)))
-        .collect()
+        .map(|(dev_uuid, info)| (*dev_uuid, (*info).clone()))
+        .collect::<Vec<_>>();
+
+    bounded_map(infos, parallelism, |(dev_uuid, info)| {
+        read_bda(&info).map(|bda| (dev_uuid, bda))
+    })
+    .into_iter()
+    .collect()
 }
 
-/// Get the most recent metadata from a set of devices.
+/// Get the most recent metadata from a set of devices, together with the
+/// format in which it was encoded.
 /// Returns None if no metadata found for this pool on any device. This can
 /// happen if the pool was constructed but failed in the interval before the
 /// metadata could be written.
@@ -87,7 +100,7 @@ pub fn get_bdas(infos: &HashMap<DevUuid, &LStratisInfo>) -> StratisResult<HashMa
 pub fn get_metadata(
     infos: &HashMap<DevUuid, &LStratisInfo>,
     bdas: &HashMap<DevUuid, BDA>,
-) -> StratisResult<Option<(DateTime<Utc>, PoolSave)>> {
+) -> StratisResult<Option<(DateTime<Utc>, PoolSave, PoolMetadataFormat)>> {
     // Most recent time should never be None if this was a properly
     // created pool; this allows for the method to be called in other
     // circumstances.
@@ -119,7 +132,7 @@ pub fn get_metadata(
                     )
                     .ok()
                     .and_then(|mut f| bda.load_state(&mut f).unwrap_or(None))
-                    .and_then(|data| serde_json::from_slice(&data).ok())
+                    .and_then(|data| decode_pool_metadata(&data).ok())
             } else {
                 None
             }
@@ -130,7 +143,7 @@ pub fn get_metadata(
                 "timestamp indicates data was written, but no data successfully read".into(),
             )
         })
-        .map(|psave| Some((*most_recent_time, psave)))
+        .map(|(psave, format)| Some((*most_recent_time, psave, format)))
 }
 
 /// Get all the blockdevs corresponding to this pool that can be obtained from
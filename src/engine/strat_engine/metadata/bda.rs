@@ -86,6 +86,7 @@ impl BDA {
     }
 
     /// Save metadata to the disk
+    #[cfg(test)]
     pub fn save_state<F>(
         &mut self,
         time: &DateTime<Utc>,
@@ -99,6 +100,22 @@ impl BDA {
             .save_state(STATIC_HEADER_SIZE.sectors().bytes(), time, metadata, f)
     }
 
+    /// Prepare a write of metadata to the disk, to be recorded with
+    /// finish_save() once it has been made.
+    pub fn prepare_save(
+        &self,
+        time: &DateTime<Utc>,
+        metadata: &[u8],
+    ) -> StratisResult<mda::MDAWrite> {
+        self.regions
+            .prepare_save(STATIC_HEADER_SIZE.sectors().bytes(), time, metadata)
+    }
+
+    /// Record a write prepared by prepare_save() which has been made.
+    pub fn finish_save(&mut self, write: mda::MDAWrite) {
+        self.regions.finish_save(write)
+    }
+
     /// Read latest metadata from the disk
     pub fn load_state<F>(&self, mut f: &mut F) -> StratisResult<Option<Vec<u8>>>
     where
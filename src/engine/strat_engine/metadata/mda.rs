@@ -143,6 +143,7 @@ impl MDARegions {
     /// error. If the size of the data is greater than the available space,
     /// return an error. If there is an error when writing the data, return
     /// an error.
+    #[cfg(test)]
     pub fn save_state<F>(
         &mut self,
         header_size: Bytes,
@@ -153,6 +154,25 @@ impl MDARegions {
     where
         F: Seek + SyncAll,
     {
+        let write = self.prepare_save(header_size, time, data)?;
+        write.write_to(f)?;
+        self.finish_save(write);
+        Ok(())
+    }
+
+    /// Prepare a write of metadata to the older of the metadata regions,
+    /// without writing anything or changing these regions. The write may
+    /// be made without access to these regions, and, if it succeeds, must
+    /// be recorded with finish_save().
+    /// If time specified is earlier than the last update time, return an
+    /// error. If the size of the data is greater than the available space,
+    /// return an error.
+    pub fn prepare_save(
+        &self,
+        header_size: Bytes,
+        time: &DateTime<Utc>,
+        data: &[u8],
+    ) -> StratisResult<MDAWrite> {
         if self.last_update_time() >= Some(time) {
             return Err(StratisError::Msg("Overwriting newer data".into()));
         }
@@ -172,32 +192,36 @@ impl MDARegions {
             used: MetaDataSize::new(used),
             data_crc: crc32::checksum_castagnoli(data),
         };
-        let hdr_buf = header.to_buf();
+        // The header and the data are written together, by a single write.
+        let mut region_buf = Vec::with_capacity(mda_size::_MDA_REGION_HDR_SIZE + data.len());
+        region_buf.extend_from_slice(&header.to_buf());
+        region_buf.extend_from_slice(data);
 
-        // Write data to a region specified by index.
         let region_size = self.region_size.sectors().bytes();
-        let mut save_region = |index: usize| -> StratisResult<()> {
-            f.seek(SeekFrom::Start(convert_int!(
+        let offset = |index: usize| -> StratisResult<u64> {
+            convert_int!(
                 MDARegions::mda_offset(header_size, index, region_size),
                 u128,
                 u64
-            )?))?;
-            f.write_all(&hdr_buf)?;
-            f.write_all(data)?;
-            f.sync_all()?;
-
-            Ok(())
+            )
         };
 
-        // TODO: Consider if there is an action that should be taken if
-        // saving to one or the other region fails.
         let older_region = self.older();
-        save_region(older_region)?;
-        save_region(older_region + mda_size::NUM_PRIMARY_MDA_REGIONS)?;
-
-        self.mda_headers[older_region] = Some(header);
+        Ok(MDAWrite {
+            region: older_region,
+            offsets: [
+                offset(older_region)?,
+                offset(older_region + mda_size::NUM_PRIMARY_MDA_REGIONS)?,
+            ],
+            header,
+            region_buf,
+        })
+    }
 
-        Ok(())
+    /// Record a write prepared by prepare_save(), which has been made
+    /// successfully, by updating the value of the older MDAHeader.
+    pub fn finish_save(&mut self, write: MDAWrite) {
+        self.mda_headers[write.region] = Some(write.header);
     }
 
     /// Load metadata from the newer MDA region.
@@ -275,6 +299,36 @@ impl MDARegions {
     }
 }
 
+/// A write of metadata to a primary MDA region and to its backup, made by
+/// MDARegions::prepare_save().
+#[derive(Debug)]
+pub struct MDAWrite {
+    // The index of the primary region written
+    region: usize,
+    // The offsets of the primary region and of its backup
+    offsets: [u64; 2],
+    header: MDAHeader,
+    region_buf: Vec<u8>,
+}
+
+impl MDAWrite {
+    /// Write the header and the metadata to the primary region and then to
+    /// its backup.
+    pub fn write_to<F>(&self, f: &mut F) -> StratisResult<()>
+    where
+        F: Seek + SyncAll,
+    {
+        // TODO: Consider if there is an action that should be taken if
+        // saving to one or the other region fails.
+        for offset in self.offsets.iter() {
+            f.seek(SeekFrom::Start(*offset))?;
+            f.write_all(&self.region_buf)?;
+            f.sync_all()?;
+        }
+        Ok(())
+    }
+}
+
 /// A type representing the actual size of variable length metadata written within this metadata
 /// region. This amount must never be greater than the size of the region allocated for the variable
 /// length metadata, which has `MDADataSize` type.
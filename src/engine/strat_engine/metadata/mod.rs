@@ -12,11 +12,16 @@ macro_rules! bytes {
 
 mod bda;
 mod mda;
+mod pool_format;
 mod sizes;
 mod static_header;
 
 pub use self::{
     bda::BDA,
+    mda::MDAWrite,
+    pool_format::{
+        decode_pool_metadata, encode_pool_metadata, pool_metadata_to_json, PoolMetadataFormat,
+    },
     sizes::{BDAExtendedSize, BlockdevSize, MDADataSize},
     static_header::{
         device_identifiers, disown_device, StaticHeader, StaticHeaderResult, StratisIdentifiers,
@@ -0,0 +1,734 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+// Encodings of the pool-level metadata stored in the MDA regions.
+//
+// The original encoding is JSON. The compact binary encoding begins with a
+// magic prefix that starts with a NUL byte, which can never begin a JSON
+// document, followed by a version number. Integers are encoded as LEB128
+// varints. UUIDs are stored as 16 raw bytes, and each segment of a block
+// device refers to its parent by its index in the list of block devices
+// rather than by UUID. The start of each segment is stored as a zig-zag
+// encoded offset from the end of the previous segment in the same list, so
+// that the encoded size of a segment depends only weakly on its position.
+// No stratisd release has written the binary encoding, so it has a single
+// version; fields added before the first release belong to version 1.
+
+use std::{collections::HashMap, convert::TryFrom};
+
+use serde_json::Value;
+
+use devicemapper::Sectors;
+
+use crate::{
+    engine::{
+        strat_engine::serde_structs::{
+            BackstoreSave, BaseBlockDevSave, BaseDevSave, BlockDevSave, CacheTierSave, CapSave,
+            CheckedSuperblockSave, DataTierSave, FlexDevsSave, PoolSave, ThinPoolDevSave,
+        },
+        types::{AllocPolicy, DevUuid},
+    },
+    stratis::{StratisError, StratisResult},
+};
+
+const BINARY_MAGIC: &[u8; 4] = b"\0STB";
+const BINARY_VERSION: u8 = 1;
+
+/// The encoding used for a pool's pool-level metadata. A new pool is
+/// written in the format selected when stratisd was started; a pool that is
+/// set up keeps the format in which its metadata was found.
+#[derive(Clone, Copy, Debug, Eq, PartialEq)]
+pub enum PoolMetadataFormat {
+    /// serde_json text, readable by all versions of stratisd.
+    Json,
+    /// The compact binary encoding.
+    Binary,
+}
+
+impl Default for PoolMetadataFormat {
+    fn default() -> PoolMetadataFormat {
+        PoolMetadataFormat::Json
+    }
+}
+
+impl<'a> TryFrom<&'a str> for PoolMetadataFormat {
+    type Error = StratisError;
+
+    fn try_from(format: &str) -> StratisResult<PoolMetadataFormat> {
+        match format {
+            "json" => Ok(PoolMetadataFormat::Json),
+            "binary" => Ok(PoolMetadataFormat::Binary),
+            _ => Err(StratisError::Msg(format!(
+                "pool metadata format {} not understood; expected json or binary",
+                format
+            ))),
+        }
+    }
+}
+
+/// Encode the pool metadata in the given format.
+pub fn encode_pool_metadata(
+    metadata: &PoolSave,
+    format: PoolMetadataFormat,
+) -> StratisResult<Vec<u8>> {
+    match format {
+        PoolMetadataFormat::Json => Ok(serde_json::to_vec(metadata)?),
+        PoolMetadataFormat::Binary => {
+            let mut encoder = Encoder::default();
+            encoder.buf.extend_from_slice(BINARY_MAGIC);
+            encoder.buf.push(BINARY_VERSION);
+            encoder.pool(metadata);
+            Ok(encoder.buf)
+        }
+    }
+}
+
+/// Decode pool metadata in either format. Return the metadata and the
+/// format in which it was found.
+pub fn decode_pool_metadata(data: &[u8]) -> StratisResult<(PoolSave, PoolMetadataFormat)> {
+    if data.starts_with(BINARY_MAGIC) {
+        let mut decoder = Decoder {
+            data,
+            pos: BINARY_MAGIC.len(),
+        };
+        let version = decoder.byte()?;
+        if version != BINARY_VERSION {
+            return Err(StratisError::Msg(format!(
+                "Unsupported binary pool metadata version {}",
+                version
+            )));
+        }
+        let metadata = decoder.pool()?;
+        if decoder.pos != data.len() {
+            return Err(StratisError::Msg(format!(
+                "{} unexpected bytes following binary pool metadata",
+                data.len() - decoder.pos
+            )));
+        }
+        Ok((metadata, PoolMetadataFormat::Binary))
+    } else {
+        Ok((serde_json::from_slice(data)?, PoolMetadataFormat::Json))
+    }
+}
+
+/// Convert pool metadata in either format to a JSON value, for display.
+/// JSON metadata is converted directly, so that fields unknown to this
+/// version of stratisd are retained.
+pub fn pool_metadata_to_json(data: &[u8]) -> StratisResult<Value> {
+    if data.starts_with(BINARY_MAGIC) {
+        let (metadata, _) = decode_pool_metadata(data)?;
+        Ok(serde_json::to_value(&metadata)?)
+    } else {
+        Ok(serde_json::from_slice(data)?)
+    }
+}
+
+fn zigzag(value: u64) -> u64 {
+    let value = value as i64;
+    ((value << 1) ^ (value >> 63)) as u64
+}
+
+fn unzigzag(value: u64) -> u64 {
+    (value >> 1) ^ (0u64.wrapping_sub(value & 1))
+}
+
+#[derive(Default)]
+struct Encoder {
+    buf: Vec<u8>,
+}
+
+impl Encoder {
+    fn varint(&mut self, mut value: u64) {
+        loop {
+            let byte = value.to_le_bytes()[0] & 0x7f;
+            value >>= 7;
+            if value == 0 {
+                self.buf.push(byte);
+                return;
+            }
+            self.buf.push(byte | 0x80);
+        }
+    }
+
+    fn len(&mut self, len: usize) {
+        self.varint(len as u64);
+    }
+
+    fn string(&mut self, value: &str) {
+        self.len(value.len());
+        self.buf.extend_from_slice(value.as_bytes());
+    }
+
+    fn opt_string(&mut self, value: &Option<String>) {
+        match value {
+            Some(value) => {
+                self.buf.push(1);
+                self.string(value);
+            }
+            None => self.buf.push(0),
+        }
+    }
+
+    fn opt_varint(&mut self, value: Option<u64>) {
+        match value {
+            Some(value) => {
+                self.buf.push(1);
+                self.varint(value);
+            }
+            None => self.buf.push(0),
+        }
+    }
+
+    fn uuid(&mut self, uuid: DevUuid) {
+        self.buf.extend_from_slice(uuid.as_bytes());
+    }
+
+    /// A list of segments on a single device; each start is encoded relative
+    /// to the end of the previous segment.
+    fn segments(&mut self, segments: &[(Sectors, Sectors)]) {
+        self.len(segments.len());
+        let mut prev_end = 0u64;
+        for &(start, length) in segments {
+            self.varint(zigzag(start.wrapping_sub(prev_end)));
+            self.varint(*length);
+            prev_end = start.wrapping_add(*length);
+        }
+    }
+
+    fn blockdev(&mut self, blockdev: &BlockDevSave) {
+        self.len(blockdev.devs.len());
+        for dev in blockdev.devs.iter() {
+            self.uuid(dev.uuid);
+            self.opt_string(&dev.user_info);
+            self.opt_string(&dev.hardware_info);
+        }
+
+        // Each parent is encoded as its index in devs, and each start
+        // relative to the end of the previous segment on the same parent. An
+        // index of devs.len() is followed by the UUID of a parent that is
+        // not in devs.
+        let indices = blockdev
+            .devs
+            .iter()
+            .enumerate()
+            .map(|(index, dev)| (dev.uuid, index))
+            .collect::<HashMap<_, _>>();
+        let mut prev_ends = vec![0u64; blockdev.devs.len()];
+        let mut other_prev_end = 0u64;
+        self.len(blockdev.allocs.len());
+        for alloc in blockdev.allocs.iter() {
+            self.len(alloc.len());
+            for seg in alloc.iter() {
+                let prev_end = match indices.get(&seg.parent) {
+                    Some(&index) => {
+                        self.len(index);
+                        &mut prev_ends[index]
+                    }
+                    None => {
+                        self.len(blockdev.devs.len());
+                        self.uuid(seg.parent);
+                        &mut other_prev_end
+                    }
+                };
+                let delta = zigzag(seg.start.wrapping_sub(*prev_end));
+                *prev_end = seg.start.wrapping_add(*seg.length);
+                self.varint(delta);
+                self.varint(*seg.length);
+            }
+        }
+    }
+
+    fn pool(&mut self, pool: &PoolSave) {
+        self.string(&pool.name);
+
+        self.blockdev(&pool.backstore.data_tier.blockdev);
+        self.opt_varint(
+            pool.backstore
+                .data_tier
+                .alloc_policy
+                .map(|policy| match policy {
+                    AllocPolicy::FillFirst => 0,
+                    AllocPolicy::Spread => 1,
+                    AllocPolicy::LargestFree => 2,
+                }),
+        );
+        self.segments(&pool.backstore.cap.allocs);
+        match pool.backstore.cache_tier {
+            Some(ref cache_tier) => {
+                self.buf.push(1);
+                self.blockdev(&cache_tier.blockdev);
+                self.opt_varint(cache_tier.block_size.map(|size| *size));
+                self.opt_varint(cache_tier.migration_threshold.map(|size| *size));
+            }
+            None => self.buf.push(0),
+        }
+
+        self.segments(&pool.flex_devs.meta_dev);
+        self.segments(&pool.flex_devs.thin_meta_dev);
+        self.segments(&pool.flex_devs.thin_data_dev);
+        self.segments(&pool.flex_devs.thin_meta_dev_spare);
+
+        self.varint(*pool.thinpool_dev.data_block_size);
+        match pool.thinpool_dev.checked_superblock {
+            Some(superblock) => {
+                self.buf.push(1);
+                self.varint(u64::from(superblock.csum));
+                self.varint(superblock.trans_id);
+                self.varint(superblock.short_checks);
+            }
+            None => self.buf.push(0),
+        }
+    }
+}
+
+struct Decoder<'a> {
+    data: &'a [u8],
+    pos: usize,
+}
+
+impl<'a> Decoder<'a> {
+    fn take(&mut self, len: usize) -> StratisResult<&'a [u8]> {
+        if self.data.len() - self.pos < len {
+            return Err(StratisError::Msg(
+                "Binary pool metadata is truncated".to_string(),
+            ));
+        }
+        let bytes = &self.data[self.pos..self.pos + len];
+        self.pos += len;
+        Ok(bytes)
+    }
+
+    fn byte(&mut self) -> StratisResult<u8> {
+        self.take(1).map(|bytes| bytes[0])
+    }
+
+    fn varint(&mut self) -> StratisResult<u64> {
+        let mut value = 0u64;
+        for shift in (0..64).step_by(7) {
+            let byte = self.byte()?;
+            let bits = u64::from(byte & 0x7f);
+            if shift == 63 && bits > 1 {
+                break;
+            }
+            value |= bits << shift;
+            if byte & 0x80 == 0 {
+                return Ok(value);
+            }
+        }
+        Err(StratisError::Msg(
+            "Binary pool metadata contains an integer that overflows 64 bits".to_string(),
+        ))
+    }
+
+    /// A length or index, which can not exceed the number of remaining
+    /// bytes, since every item that is counted occupies at least one byte.
+    fn len(&mut self) -> StratisResult<usize> {
+        let value = self.varint()?;
+        match usize::try_from(value) {
+            Ok(len) if len <= self.data.len() - self.pos => Ok(len),
+            _ => Err(StratisError::Msg(format!(
+                "Binary pool metadata contains a length {} that exceeds the metadata remaining",
+                value
+            ))),
+        }
+    }
+
+    /// An index into a list that has already been decoded.
+    fn index(&mut self) -> StratisResult<usize> {
+        let value = self.varint()?;
+        usize::try_from(value).map_err(|_| {
+            StratisError::Msg(format!(
+                "Binary pool metadata contains an index {} that is out of range",
+                value
+            ))
+        })
+    }
+
+    fn flag(&mut self) -> StratisResult<bool> {
+        match self.byte()? {
+            0 => Ok(false),
+            1 => Ok(true),
+            byte => Err(StratisError::Msg(format!(
+                "Binary pool metadata contains an invalid flag value {}",
+                byte
+            ))),
+        }
+    }
+
+    fn string(&mut self) -> StratisResult<String> {
+        let len = self.len()?;
+        let bytes = self.take(len)?;
+        String::from_utf8(bytes.to_vec()).map_err(|_| {
+            StratisError::Msg("Binary pool metadata contains an invalid string".to_string())
+        })
+    }
+
+    fn opt_string(&mut self) -> StratisResult<Option<String>> {
+        if self.flag()? {
+            self.string().map(Some)
+        } else {
+            Ok(None)
+        }
+    }
+
+    fn opt_varint(&mut self) -> StratisResult<Option<u64>> {
+        if self.flag()? {
+            self.varint().map(Some)
+        } else {
+            Ok(None)
+        }
+    }
+
+    fn uuid(&mut self) -> StratisResult<DevUuid> {
+        let mut bytes = [0u8; 16];
+        bytes.copy_from_slice(self.take(16)?);
+        Ok(DevUuid(uuid::Uuid::from_bytes(bytes)))
+    }
+
+    fn segments(&mut self) -> StratisResult<Vec<(Sectors, Sectors)>> {
+        let len = self.len()?;
+        let mut segments = Vec::with_capacity(len);
+        let mut prev_end = 0u64;
+        for _ in 0..len {
+            let start = prev_end.wrapping_add(unzigzag(self.varint()?));
+            let length = self.varint()?;
+            prev_end = start.wrapping_add(length);
+            segments.push((Sectors(start), Sectors(length)));
+        }
+        Ok(segments)
+    }
+
+    fn blockdev(&mut self) -> StratisResult<BlockDevSave> {
+        let num_devs = self.len()?;
+        let mut devs = Vec::with_capacity(num_devs);
+        for _ in 0..num_devs {
+            devs.push(BaseBlockDevSave {
+                uuid: self.uuid()?,
+                user_info: self.opt_string()?,
+                hardware_info: self.opt_string()?,
+            });
+        }
+
+        let mut prev_ends = vec![0u64; num_devs];
+        let mut other_prev_end = 0u64;
+        let num_allocs = self.len()?;
+        let mut allocs = Vec::with_capacity(num_allocs);
+        for _ in 0..num_allocs {
+            let num_segs = self.len()?;
+            let mut alloc = Vec::with_capacity(num_segs);
+            for _ in 0..num_segs {
+                let index = self.index()?;
+                let (parent, prev_end) = match index {
+                    index if index < num_devs => (devs[index].uuid, &mut prev_ends[index]),
+                    index if index == num_devs => (self.uuid()?, &mut other_prev_end),
+                    index => {
+                        return Err(StratisError::Msg(format!(
+                            "Binary pool metadata refers to block device {} of {}",
+                            index, num_devs
+                        )))
+                    }
+                };
+                let start = prev_end.wrapping_add(unzigzag(self.varint()?));
+                let length = self.varint()?;
+                *prev_end = start.wrapping_add(length);
+                alloc.push(BaseDevSave {
+                    parent,
+                    start: Sectors(start),
+                    length: Sectors(length),
+                });
+            }
+            allocs.push(alloc);
+        }
+
+        Ok(BlockDevSave { allocs, devs })
+    }
+
+    fn pool(&mut self) -> StratisResult<PoolSave> {
+        let name = self.string()?;
+
+        let blockdev = self.blockdev()?;
+        let alloc_policy = match self.opt_varint()? {
+            None => None,
+            Some(0) => Some(AllocPolicy::FillFirst),
+            Some(1) => Some(AllocPolicy::Spread),
+            Some(2) => Some(AllocPolicy::LargestFree),
+            Some(code) => {
+                return Err(StratisError::Msg(format!(
+                    "Binary pool metadata contains an unknown allocation policy {}",
+                    code
+                )))
+            }
+        };
+        let data_tier = DataTierSave {
+            blockdev,
+            alloc_policy,
+        };
+        let cap = CapSave {
+            allocs: self.segments()?,
+        };
+        let cache_tier = if self.flag()? {
+            Some(CacheTierSave {
+                blockdev: self.blockdev()?,
+                block_size: self.opt_varint()?.map(Sectors),
+                migration_threshold: self.opt_varint()?.map(Sectors),
+            })
+        } else {
+            None
+        };
+
+        let flex_devs = FlexDevsSave {
+            meta_dev: self.segments()?,
+            thin_meta_dev: self.segments()?,
+            thin_data_dev: self.segments()?,
+            thin_meta_dev_spare: self.segments()?,
+        };
+
+        let data_block_size = Sectors(self.varint()?);
+        let checked_superblock = if self.flag()? {
+            Some(CheckedSuperblockSave {
+                csum: u32::try_from(self.varint()?).map_err(|_| {
+                    StratisError::Msg(
+                        "Binary pool metadata contains an invalid superblock checksum".to_string(),
+                    )
+                })?,
+                trans_id: self.varint()?,
+                short_checks: self.varint()?,
+            })
+        } else {
+            None
+        };
+        let thinpool_dev = ThinPoolDevSave {
+            data_block_size,
+            checked_superblock,
+        };
+
+        Ok(PoolSave {
+            name,
+            backstore: BackstoreSave {
+                data_tier,
+                cap,
+                cache_tier,
+            },
+            flex_devs,
+            thinpool_dev,
+        })
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use proptest::{collection::vec, option, prelude::*};
+
+    use super::*;
+
+    fn segments() -> impl Strategy<Value = Vec<(Sectors, Sectors)>> {
+        vec((any::<u64>(), any::<u64>()), 0..20).prop_map(|v| {
+            v.into_iter()
+                .map(|(s, l)| (Sectors(s), Sectors(l)))
+                .collect()
+        })
+    }
+
+    fn blockdev() -> impl Strategy<Value = BlockDevSave> {
+        (
+            vec((any::<u128>(), option::of(".*"), option::of(".*")), 0..5),
+            vec(
+                vec(
+                    (any::<u128>(), 0..6usize, any::<u64>(), any::<u64>()),
+                    0..10,
+                ),
+                0..3,
+            ),
+        )
+            .prop_map(|(devs, allocs)| {
+                let devs = devs
+                    .into_iter()
+                    .map(|(uuid, user_info, hardware_info)| BaseBlockDevSave {
+                        uuid: DevUuid(uuid::Uuid::from_u128(uuid)),
+                        user_info,
+                        hardware_info,
+                    })
+                    .collect::<Vec<_>>();
+                let allocs = allocs
+                    .into_iter()
+                    .map(|alloc| {
+                        alloc
+                            .into_iter()
+                            .map(|(uuid, index, start, length)| BaseDevSave {
+                                parent: devs
+                                    .get(index)
+                                    .map(|dev| dev.uuid)
+                                    .unwrap_or_else(|| DevUuid(uuid::Uuid::from_u128(uuid))),
+                                start: Sectors(start),
+                                length: Sectors(length),
+                            })
+                            .collect()
+                    })
+                    .collect();
+                BlockDevSave { allocs, devs }
+            })
+    }
+
+    fn pool() -> impl Strategy<Value = PoolSave> {
+        (
+            ".*",
+            (blockdev(), option::of(0..3u8)),
+            segments(),
+            option::of((
+                blockdev(),
+                option::of(any::<u64>()),
+                option::of(any::<u64>()),
+            )),
+            (segments(), segments(), segments(), segments()),
+            (
+                any::<u64>(),
+                option::of((any::<u32>(), any::<u64>(), any::<u64>())),
+            ),
+        )
+            .prop_map(
+                |(
+                    name,
+                    (data, alloc_policy),
+                    cap,
+                    cache,
+                    (meta, thin_meta, thin_data, spare),
+                    (block_size, superblock),
+                )| {
+                    PoolSave {
+                        name,
+                        backstore: BackstoreSave {
+                            data_tier: DataTierSave {
+                                blockdev: data,
+                                alloc_policy: alloc_policy.map(|code| match code {
+                                    0 => AllocPolicy::FillFirst,
+                                    1 => AllocPolicy::Spread,
+                                    _ => AllocPolicy::LargestFree,
+                                }),
+                            },
+                            cap: CapSave { allocs: cap },
+                            cache_tier: cache.map(
+                                |(blockdev, cache_block_size, migration_threshold)| CacheTierSave {
+                                    blockdev,
+                                    block_size: cache_block_size.map(Sectors),
+                                    migration_threshold: migration_threshold.map(Sectors),
+                                },
+                            ),
+                        },
+                        flex_devs: FlexDevsSave {
+                            meta_dev: meta,
+                            thin_meta_dev: thin_meta,
+                            thin_data_dev: thin_data,
+                            thin_meta_dev_spare: spare,
+                        },
+                        thinpool_dev: ThinPoolDevSave {
+                            data_block_size: Sectors(block_size),
+                            checked_superblock: superblock.map(|(csum, trans_id, short_checks)| {
+                                CheckedSuperblockSave {
+                                    csum,
+                                    trans_id,
+                                    short_checks,
+                                }
+                            }),
+                        },
+                    }
+                },
+            )
+    }
+
+    proptest! {
+        #[test]
+        /// Verify that metadata encoded in either format decodes to the same
+        /// metadata, and that the format is correctly identified.
+        fn encode_decode(metadata in pool()) {
+            for format in &[PoolMetadataFormat::Json, PoolMetadataFormat::Binary] {
+                let data = encode_pool_metadata(&metadata, *format).unwrap();
+                let (decoded, decoded_format) = decode_pool_metadata(&data).unwrap();
+                prop_assert_eq!(&decoded, &metadata);
+                prop_assert_eq!(decoded_format, *format);
+                prop_assert_eq!(
+                    pool_metadata_to_json(&data).unwrap(),
+                    serde_json::to_value(&metadata).unwrap()
+                );
+            }
+        }
+
+        #[test]
+        /// Verify that decoding truncated binary metadata fails rather than
+        /// panicking or yielding different metadata.
+        fn decode_truncated(metadata in pool(), cut in any::<prop::sample::Index>()) {
+            let data = encode_pool_metadata(&metadata, PoolMetadataFormat::Binary).unwrap();
+            let cut = cut.index(data.len());
+            prop_assert!(decode_pool_metadata(&data[..cut]).is_err());
+        }
+
+        #[test]
+        /// Verify that zig-zag encoding round trips.
+        fn zigzag_round_trip(value in any::<u64>()) {
+            prop_assert_eq!(unzigzag(zigzag(value)), value);
+        }
+    }
+
+    #[test]
+    /// Verify that the binary encoding of a pool with many segments is much
+    /// smaller than its JSON encoding.
+    fn test_binary_size() {
+        let devs = (0..16u128)
+            .map(|i| BaseBlockDevSave {
+                uuid: DevUuid(uuid::Uuid::from_u128(i)),
+                user_info: None,
+                hardware_info: None,
+            })
+            .collect::<Vec<_>>();
+        let allocs = vec![(0..4096u64)
+            .map(|i| BaseDevSave {
+                parent: devs[usize::try_from(i % 16).unwrap()].uuid,
+                start: Sectors(8192 + (i / 16) * 2048),
+                length: Sectors(1024),
+            })
+            .collect::<Vec<_>>()];
+        let cap = (0..4096u64)
+            .map(|i| (Sectors(i * 1024), Sectors(1024)))
+            .collect::<Vec<_>>();
+        let metadata = PoolSave {
+            name: "stratis-test-pool".to_string(),
+            backstore: BackstoreSave {
+                data_tier: DataTierSave {
+                    blockdev: BlockDevSave { allocs, devs },
+                    alloc_policy: None,
+                },
+                cap: CapSave {
+                    allocs: cap.clone(),
+                },
+                cache_tier: None,
+            },
+            flex_devs: FlexDevsSave {
+                meta_dev: cap.clone(),
+                thin_meta_dev: cap.clone(),
+                thin_data_dev: cap.clone(),
+                thin_meta_dev_spare: cap,
+            },
+            thinpool_dev: ThinPoolDevSave {
+                data_block_size: Sectors(2048),
+                checked_superblock: None,
+            },
+        };
+
+        let json = encode_pool_metadata(&metadata, PoolMetadataFormat::Json).unwrap();
+        let binary = encode_pool_metadata(&metadata, PoolMetadataFormat::Binary).unwrap();
+        assert!(binary.len() * 5 < json.len());
+        assert_eq!(decode_pool_metadata(&binary).unwrap().0, metadata);
+    }
+
+    #[test]
+    /// Verify that binary metadata of any version but the current one is
+    /// rejected.
+    fn test_decode_unknown_version() {
+        let mut data = BINARY_MAGIC.to_vec();
+        for version in &[0, BINARY_VERSION + 1] {
+            data.truncate(BINARY_MAGIC.len());
+            data.push(*version);
+            assert!(decode_pool_metadata(&data).is_err());
+        }
+    }
+}
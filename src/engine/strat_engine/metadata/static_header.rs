@@ -192,36 +192,41 @@ impl StaticHeader {
     // If first location is specified, write zeroes to empty regions in the
     // first 8 sectors. If the second location is specified, writes zeroes to empty
     // regions in the second 8 sectors.
+    //
+    // Each region, including its padding, is written by a single write and
+    // synced before the next region is written, so that at least one intact
+    // copy of the signature block is on the device at all times.
     pub fn write<F>(&self, f: &mut F, which: MetadataLocation) -> io::Result<()>
     where
         F: Seek + SyncAll,
     {
-        let signature_block = self.sigblock_to_buf();
-        let zeroed = [0u8; bytes!(static_header_size::POST_SIGBLOCK_PADDING_SECTORS)];
-        f.seek(SeekFrom::Start(0))?;
+        let mut region = [0u8; bytes!(static_header_size::SIGBLOCK_REGION_SECTORS)];
+        region[bytes!(static_header_size::PRE_SIGBLOCK_PADDING_SECTORS)
+            ..bytes!(static_header_size::PRE_SIGBLOCK_PADDING_SECTORS)
+                + bytes!(static_header_size::SIGBLOCK_SECTORS)]
+            .copy_from_slice(&self.sigblock_to_buf());
 
         // Write to a static header region in the static header.
-        fn write_region<F>(f: &mut F, signature_block: &[u8], zeroed: &[u8]) -> io::Result<()>
+        fn write_region<F>(f: &mut F, offset: usize, region: &[u8]) -> io::Result<()>
         where
             F: Seek + SyncAll,
         {
-            f.write_all(&zeroed[..bytes!(static_header_size::PRE_SIGBLOCK_PADDING_SECTORS)])?;
-            f.write_all(signature_block)?;
-            f.write_all(&zeroed[..bytes!(static_header_size::POST_SIGBLOCK_PADDING_SECTORS)])?;
+            f.seek(SeekFrom::Start(offset as u64))?;
+            f.write_all(region)?;
             f.sync_all()?;
             Ok(())
         }
 
         if which == MetadataLocation::Both || which == MetadataLocation::First {
-            write_region(f, &signature_block, &zeroed)?;
-        } else {
-            f.seek(SeekFrom::Start(
-                bytes!(static_header_size::SIGBLOCK_REGION_SECTORS) as u64,
-            ))?;
+            write_region(f, 0, &region)?;
         }
 
         if which == MetadataLocation::Both || which == MetadataLocation::Second {
-            write_region(f, &signature_block, &zeroed)?;
+            write_region(
+                f,
+                bytes!(static_header_size::SIGBLOCK_REGION_SECTORS),
+                &region,
+            )?;
         }
         Ok(())
     }
@@ -3,6 +3,7 @@
 // file, You can obtain one at http://mozilla.org/MPL/2.0/.
 
 mod backstore;
+mod check_scheduler;
 mod cmd;
 mod device;
 mod devlinks;
@@ -12,6 +13,7 @@ mod keys;
 mod liminal;
 mod metadata;
 mod names;
+mod parallel;
 mod pool;
 mod serde_structs;
 mod thinpool;
@@ -24,7 +26,8 @@ pub use self::{
     dm::{get_dm, get_dm_init},
     engine::StratEngine,
     keys::StratKeyActions,
-    metadata::{StaticHeader, StaticHeaderResult, BDA},
+    metadata::{pool_metadata_to_json, PoolMetadataFormat, StaticHeader, StaticHeaderResult, BDA},
+    parallel::DEFAULT_PARALLELISM,
 };
 
 #[cfg(test)]
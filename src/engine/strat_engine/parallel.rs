@@ -0,0 +1,113 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+//! Support for running blocking engine operations on several devices or
+//! pools at once.
+
+use std::{
+    cmp::min,
+    panic::resume_unwind,
+    sync::{Arc, Mutex},
+    thread,
+};
+
+/// The default number of threads used for operations that are run
+/// concurrently across devices or pools.
+pub const DEFAULT_PARALLELISM: usize = 8;
+
+/// Apply f to every item in items using no more than max_threads threads.
+/// Return the results in the same order as the items which produced them.
+///
+/// If max_threads is 0 or 1, or there is at most one item, f is applied
+/// serially on the calling thread, exactly as an ordinary map would.
+///
+/// If f panics on some worker thread, the panic is propagated to the caller
+/// once all the worker threads have exited.
+pub fn bounded_map<I, T, F>(items: Vec<I>, max_threads: usize, f: F) -> Vec<T>
+where
+    I: Send + 'static,
+    T: Send + 'static,
+    F: Fn(I) -> T + Send + Sync + 'static,
+{
+    let num_items = items.len();
+    let num_threads = min(max_threads, num_items);
+    if num_threads <= 1 {
+        return items.into_iter().map(f).collect();
+    }
+
+    let work = Arc::new(Mutex::new(items.into_iter().enumerate()));
+    let f = Arc::new(f);
+
+    let handles = (0..num_threads)
+        .map(|_| {
+            let work = Arc::clone(&work);
+            let f = Arc::clone(&f);
+            thread::spawn(move || {
+                let mut results = Vec::new();
+                loop {
+                    let next = work.lock().expect("no holder of the lock panics").next();
+                    match next {
+                        Some((index, item)) => results.push((index, f(item))),
+                        None => return results,
+                    }
+                }
+            })
+        })
+        .collect::<Vec<_>>();
+
+    let mut indexed = Vec::with_capacity(num_items);
+    let mut panic = None;
+    for handle in handles {
+        match handle.join() {
+            Ok(results) => indexed.extend(results),
+            Err(err) => panic = Some(err),
+        }
+    }
+    if let Some(err) = panic {
+        resume_unwind(err);
+    }
+
+    indexed.sort_unstable_by_key(|&(index, _)| index);
+    assert_eq!(indexed.len(), num_items);
+    indexed.into_iter().map(|(_, result)| result).collect()
+}
+
+#[cfg(test)]
+mod tests {
+    use std::time::Duration;
+
+    use super::*;
+
+    #[test]
+    /// Verify that results are returned in the order of the items, regardless
+    /// of the number of threads used or the order in which they complete.
+    fn test_bounded_map_order() {
+        let items = (0..50u64).collect::<Vec<_>>();
+        for max_threads in &[0, 1, 3, 8, 100] {
+            let results = bounded_map(items.clone(), *max_threads, |i| {
+                thread::sleep(Duration::from_millis(50 - i));
+                i * 2
+            });
+            assert_eq!(results, items.iter().map(|i| i * 2).collect::<Vec<_>>());
+        }
+    }
+
+    #[test]
+    /// Verify that an empty list of items yields an empty list of results.
+    fn test_bounded_map_empty() {
+        assert!(bounded_map(Vec::<u64>::new(), 4, |i| i).is_empty());
+    }
+
+    #[test]
+    #[should_panic]
+    /// Verify that a panic on a worker thread is propagated to the caller.
+    fn test_bounded_map_panic() {
+        bounded_map((0..10u64).collect(), 4, |i| {
+            if i == 7 {
+                panic!("failed on item {}", i);
+            }
+            i
+        });
+    }
+}
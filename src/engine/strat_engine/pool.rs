@@ -2,27 +2,38 @@
 // License, v. 2.0. If a copy of the MPL was not distributed with this
 // file, You can obtain one at http://mozilla.org/MPL/2.0/.
 
-use std::{borrow::Cow, collections::HashMap, path::Path, vec::Vec};
+use std::{
+    borrow::Cow,
+    collections::{HashMap, HashSet},
+    path::Path,
+    time::Duration,
+    vec::Vec,
+};
 
 use chrono::{DateTime, Utc};
-use serde_json::{Map, Value};
+use serde_json::Value;
 
 use devicemapper::{DmNameBuf, Sectors};
 
 use crate::{
     engine::{
         engine::{BlockDev, Filesystem, Pool},
-        shared::{init_cache_idempotent_or_err, validate_name, validate_paths},
+        metrics::span,
+        shared::{
+            dedup_filesystem_specs, init_cache_idempotent_or_err, validate_name, validate_paths,
+        },
         strat_engine::{
-            backstore::{Backstore, StratBlockDev},
-            metadata::MDADataSize,
+            backstore::{Backstore, BackstoreReport, StratBlockDev},
+            check_scheduler::PoolCheck,
+            metadata::{encode_pool_metadata, MDADataSize, PoolMetadataFormat},
             serde_structs::{FlexDevsSave, PoolSave, Recordable},
-            thinpool::{ThinPool, ThinPoolSizeParams, DATA_BLOCK_SIZE},
+            thinpool::{FilesystemReport, ThinPool, ThinPoolSizeParams, DATA_BLOCK_SIZE},
         },
         types::{
-            BlockDevTier, Clevis, CreateAction, DeleteAction, DevUuid, EncryptionInfo,
-            FilesystemUuid, Key, KeyDescription, Name, PoolUuid, Redundancy, RegenAction,
-            RenameAction, SetCreateAction, SetDeleteAction,
+            AllocPolicy, BlockDevTier, CacheSettings, CacheStats, Clevis, CreateAction,
+            DeleteAction, DevUuid, EncryptionInfo, FilesystemUuid, FsGrowthPolicy, Key,
+            KeyDescription, Name, PoolUsageReadings, PoolUuid, PropChangeAction, Redundancy,
+            RegenAction, RenameAction, SetCreateAction, SetDeleteAction, ThinCheckPolicy,
         },
     },
     stratis::{StratisError, StratisResult},
@@ -128,11 +139,39 @@ fn check_metadata(metadata: &PoolSave) -> StratisResult<()> {
     Ok(())
 }
 
+/// Tracks writes of pool-level metadata to the pool's block devices so that
+/// requests to write metadata that is identical to the metadata most
+/// recently written can be discarded.
+#[derive(Debug, Default, Serialize)]
+struct MetadataWrites {
+    /// The number of writes actually issued to the block devices.
+    issued: u64,
+    /// The encoded metadata most recently written successfully.
+    #[serde(skip)]
+    last_written: Option<Vec<u8>>,
+    /// The number of requests to write metadata.
+    requested: u64,
+}
+
+/// A pool as it appears in the engine state report, borrowed from the pool
+/// and from the engine's table of pools, so that it can be serialized without
+/// being copied. Fields are declared in the order in which they are reported.
+#[derive(Serialize)]
+pub struct StratPoolReport<'a> {
+    blockdevs: BackstoreReport<'a>,
+    filesystems: Vec<FilesystemReport<'a>>,
+    metadata_writes: &'a MetadataWrites,
+    name: &'a str,
+    uuid: PoolUuid,
+}
+
 #[derive(Debug)]
 pub struct StratPool {
     backstore: Backstore,
     redundancy: Redundancy,
     thin_pool: ThinPool,
+    metadata_format: PoolMetadataFormat,
+    metadata_writes: MetadataWrites,
 }
 
 impl StratPool {
@@ -145,6 +184,7 @@ impl StratPool {
         paths: &[&Path],
         redundancy: Redundancy,
         encryption_info: &EncryptionInfo,
+        metadata_format: PoolMetadataFormat,
     ) -> StratisResult<(PoolUuid, StratPool)> {
         let pool_uuid = PoolUuid::new_v4();
 
@@ -175,6 +215,8 @@ impl StratPool {
             backstore,
             redundancy,
             thin_pool: thinpool,
+            metadata_format,
+            metadata_writes: MetadataWrites::default(),
         };
 
         pool.write_metadata(&Name::new(name.to_owned()))?;
@@ -193,12 +235,18 @@ impl StratPool {
     ///   * key_description.is_none() -> no StratBlockDev in datadevs has a
     ///   key description.
     ///   * no StratBlockDev in cachdevs has a key description
+    ///
+    /// The pool's metadata continues to be written in metadata_format, the
+    /// format in which it was found. The thin pool metadata is checked as
+    /// specified by thin_check_policy.
     pub fn setup(
         uuid: PoolUuid,
         datadevs: Vec<StratBlockDev>,
         cachedevs: Vec<StratBlockDev>,
         timestamp: DateTime<Utc>,
         metadata: &PoolSave,
+        metadata_format: PoolMetadataFormat,
+        thin_check_policy: ThinCheckPolicy,
     ) -> StratisResult<(Name, StratPool)> {
         check_metadata(metadata)?;
 
@@ -212,14 +260,21 @@ impl StratPool {
             &metadata.thinpool_dev,
             &metadata.flex_devs,
             &backstore,
+            thin_check_policy,
         )?;
 
-        let changed = thinpool.check(uuid, &mut backstore)?;
+        // The superblock recorded as verified changes whenever the metadata
+        // had to be checked in full, and must be saved so that the check
+        // need not be repeated at the next setup.
+        let changed = thinpool.check(uuid, &mut backstore)?
+            || thinpool.checked_superblock() != metadata.thinpool_dev.checked_superblock;
 
         let mut pool = StratPool {
             backstore,
             redundancy: Redundancy::NONE,
             thin_pool: thinpool,
+            metadata_format,
+            metadata_writes: MetadataWrites::default(),
         };
 
         if changed {
@@ -237,9 +292,27 @@ impl StratPool {
     }
 
     /// Write current metadata to pool members.
+    ///
+    /// If the current metadata is identical to the metadata that was most
+    /// recently written, the write is skipped, as the block devices already
+    /// record the current state of the pool. When this method returns Ok,
+    /// the current metadata is durable.
     pub fn write_metadata(&mut self, name: &str) -> StratisResult<()> {
-        let data = serde_json::to_string(&self.record(name))?;
-        self.backstore.save_state(data.as_bytes())
+        let _span = span("save_state");
+        self.metadata_writes.requested += 1;
+
+        let data = encode_pool_metadata(&self.record(name), self.metadata_format)?;
+        if self.metadata_writes.last_written.as_ref() == Some(&data) {
+            return Ok(());
+        }
+
+        // If the write fails, it is not known what is on the devices, so the
+        // next request must be written regardless of its contents.
+        self.metadata_writes.last_written = None;
+        self.backstore.save_state(&data)?;
+        self.metadata_writes.issued += 1;
+        self.metadata_writes.last_written = Some(data);
+        Ok(())
     }
 
     /// Teardown a pool.
@@ -258,14 +331,36 @@ impl StratPool {
         self.thin_pool.get_eventing_dev_names(pool_uuid)
     }
 
-    /// Called when a DM device in this pool has generated an event.
-    // TODO: Just check the device that evented. Currently checks
-    // everything.
-    pub fn event_on(&mut self, pool_uuid: PoolUuid, pool_name: &Name) -> StratisResult<()> {
-        if self.thin_pool.check(pool_uuid, &mut self.backstore)? {
+    /// Called when some DM devices in this pool have generated events.
+    /// dm_names are the names of the devices that evented. Returns the
+    /// checks that must be run on this pool as a consequence.
+    pub fn event_on(&self, pool_uuid: PoolUuid, dm_names: &HashSet<DmNameBuf>) -> PoolCheck {
+        self.thin_pool.evented_components(pool_uuid, dm_names)
+    }
+
+    /// Run the checks specified by check on this pool.
+    pub fn run_check(
+        &mut self,
+        pool_uuid: PoolUuid,
+        pool_name: &Name,
+        check: &PoolCheck,
+    ) -> StratisResult<()> {
+        if check.thin_pool && self.thin_pool.check_pool(pool_uuid, &mut self.backstore)? {
             self.write_metadata(pool_name)?;
         }
-        Ok(())
+        self.thin_pool
+            .check_filesystems(pool_uuid, &check.filesystems)
+    }
+
+    /// Read the status of the thin pool and of its filesystems.
+    pub fn read_usage(&self) -> PoolUsageReadings {
+        self.thin_pool.read_usage()
+    }
+
+    /// Update the cached usage of the thin pool and of its filesystems from
+    /// readings obtained by read_usage().
+    pub fn set_usage(&mut self, readings: PoolUsageReadings) -> StratisResult<()> {
+        self.thin_pool.set_usage(readings)
     }
 
     pub fn record(&self, name: &str) -> PoolSave {
@@ -277,6 +372,18 @@ impl StratPool {
         }
     }
 
+    /// This pool as it appears in the engine state report, where it is
+    /// identified by name and uuid.
+    pub fn report<'a>(&'a self, name: &'a str, uuid: PoolUuid) -> StratPoolReport<'a> {
+        StratPoolReport {
+            blockdevs: BackstoreReport::from(&self.backstore),
+            filesystems: self.thin_pool.filesystems_report(),
+            metadata_writes: &self.metadata_writes,
+            name,
+            uuid,
+        }
+    }
+
     fn datadevs_encrypted(&self) -> bool {
         self.backstore.data_tier_is_encrypted()
     }
@@ -302,34 +409,13 @@ impl StratPool {
     }
 }
 
-impl<'a> Into<Value> for &'a StratPool {
-    // Precondition: (&ThinPool).into() pattern matches Value::Object(_)
-    // Precondition: (&Backstore).into() pattern matches Value::Object(_)
-    fn into(self) -> Value {
-        let mut map: Map<_, _> =
-            if let Value::Object(map) = <&ThinPool as Into<Value>>::into(&self.thin_pool) {
-                map.into_iter()
-            } else {
-                unreachable!("ThinPool conversion returns a JSON object")
-            }
-            .collect();
-        map.extend(
-            if let Value::Object(map) = <&Backstore as Into<Value>>::into(&self.backstore) {
-                map.into_iter()
-            } else {
-                unreachable!("Backstore conversion returns a JSON object")
-            },
-        );
-        Value::from(map)
-    }
-}
-
 impl Pool for StratPool {
     fn init_cache(
         &mut self,
         pool_uuid: PoolUuid,
         pool_name: &str,
         blockdevs: &[&Path],
+        settings: CacheSettings,
     ) -> StratisResult<SetCreateAction<DevUuid>> {
         validate_paths(blockdevs)?;
 
@@ -348,7 +434,7 @@ impl Pool for StratPool {
             // If adding cache devices, must suspend the pool, since the cache
             // must be augmented with the new devices.
             self.thin_pool.suspend()?;
-            let devices_result = self.backstore.init_cache(pool_uuid, blockdevs);
+            let devices_result = self.backstore.init_cache(pool_uuid, blockdevs, settings);
             self.thin_pool.resume()?;
             let devices = devices_result?;
             self.write_metadata(pool_name)?;
@@ -364,6 +450,63 @@ impl Pool for StratPool {
         }
     }
 
+    fn cache_settings(&self) -> Option<CacheSettings> {
+        self.backstore.cache_settings()
+    }
+
+    fn set_cache_migration_threshold(
+        &mut self,
+        pool_name: &str,
+        threshold: Sectors,
+    ) -> StratisResult<PropChangeAction<Sectors>> {
+        let old_threshold = self
+            .backstore
+            .cache_settings()
+            .and_then(|settings| settings.migration_threshold);
+        if self.backstore.set_cache_migration_threshold(threshold)? {
+            if let Err(err) = self.write_metadata(pool_name) {
+                if let Err(err2) = self
+                    .backstore
+                    .restore_cache_migration_threshold(old_threshold)
+                {
+                    warn!(
+                        "Failed to restore the cache migration threshold after the metadata write failed: {}",
+                        err2
+                    );
+                }
+                return Err(err);
+            }
+            Ok(PropChangeAction::NewValue(threshold))
+        } else {
+            Ok(PropChangeAction::Identity)
+        }
+    }
+
+    fn cache_stats(&self) -> StratisResult<Option<CacheStats>> {
+        self.backstore.cache_stats()
+    }
+
+    fn alloc_policy(&self) -> AllocPolicy {
+        self.backstore.alloc_policy()
+    }
+
+    fn set_alloc_policy(
+        &mut self,
+        pool_name: &str,
+        policy: AllocPolicy,
+    ) -> StratisResult<PropChangeAction<AllocPolicy>> {
+        let old_policy = self.backstore.alloc_policy();
+        if old_policy == policy {
+            return Ok(PropChangeAction::Identity);
+        }
+        self.backstore.set_alloc_policy(policy);
+        if let Err(err) = self.write_metadata(pool_name) {
+            self.backstore.set_alloc_policy(old_policy);
+            return Err(err);
+        }
+        Ok(PropChangeAction::NewValue(policy))
+    }
+
     fn bind_clevis(
         &mut self,
         pin: &str,
@@ -428,24 +571,20 @@ impl Pool for StratPool {
         pool_uuid: PoolUuid,
         specs: &[(&'b str, Option<Sectors>)],
     ) -> StratisResult<SetCreateAction<(&'b str, FilesystemUuid)>> {
-        let names: HashMap<_, _> = specs.iter().map(|&tup| (tup.0, tup.1)).collect();
+        let specs = dedup_filesystem_specs(specs);
 
-        names.iter().fold(Ok(()), |res, (name, _)| {
+        specs.iter().fold(Ok(()), |res, (name, _)| {
             res.and_then(|()| validate_name(name))
         })?;
 
-        // TODO: Roll back on filesystem initialization failure.
-        let mut result = Vec::new();
-        for (name, size) in names {
-            if self.thin_pool.get_mut_filesystem_by_name(name).is_none() {
-                let fs_uuid = self
-                    .thin_pool
-                    .create_filesystem(pool_name, pool_uuid, name, size)?;
-                result.push((name, fs_uuid));
-            }
-        }
+        let to_create = specs
+            .into_iter()
+            .filter(|(name, _)| self.thin_pool.get_filesystem_by_name(name).is_none())
+            .collect::<Vec<_>>();
 
-        Ok(SetCreateAction::new(result))
+        self.thin_pool
+            .create_filesystems(pool_name, pool_uuid, &to_create)
+            .map(SetCreateAction::new)
     }
 
     fn add_blockdevs(
@@ -536,6 +675,22 @@ impl Pool for StratPool {
         }
     }
 
+    fn set_fs_growth_policy(
+        &mut self,
+        _pool_name: &str,
+        uuid: FilesystemUuid,
+        policy: FsGrowthPolicy,
+    ) -> StratisResult<PropChangeAction<FsGrowthPolicy>> {
+        match self.thin_pool.set_fs_growth_policy(uuid, policy)? {
+            Some(true) => Ok(PropChangeAction::NewValue(policy)),
+            Some(false) => Ok(PropChangeAction::Identity),
+            None => Err(StratisError::Msg(format!(
+                "No filesystem with UUID {} belongs to this pool",
+                uuid
+            ))),
+        }
+    }
+
     fn snapshot_filesystem(
         &mut self,
         pool_name: &str,
@@ -558,6 +713,38 @@ impl Pool for StratPool {
             .map(CreateAction::Created)
     }
 
+    fn snapshot_filesystems<'a, 'b>(
+        &'a mut self,
+        pool_name: &str,
+        pool_uuid: PoolUuid,
+        specs: &[(FilesystemUuid, &'b str)],
+    ) -> StratisResult<SetCreateAction<(&'b str, FilesystemUuid)>> {
+        let mut names = HashMap::new();
+        for &(origin_uuid, snapshot_name) in specs {
+            validate_name(snapshot_name)?;
+            if names.insert(snapshot_name, origin_uuid).is_some() {
+                return Err(StratisError::Msg(format!(
+                    "Snapshot name {} was requested more than once",
+                    snapshot_name
+                )));
+            }
+        }
+
+        let to_create = specs
+            .iter()
+            .filter(|(_, snapshot_name)| {
+                self.thin_pool
+                    .get_filesystem_by_name(snapshot_name)
+                    .is_none()
+            })
+            .cloned()
+            .collect::<Vec<_>>();
+
+        self.thin_pool
+            .snapshot_filesystems(pool_name, pool_uuid, &to_create)
+            .map(SetCreateAction::new)
+    }
+
     fn total_physical_size(&self) -> Sectors {
         self.backstore.datatier_size()
     }
@@ -574,6 +761,10 @@ impl Pool for StratPool {
             .map(|v| v + self.backstore.datatier_metadata_size())
     }
 
+    fn total_physical_used_age(&self) -> Option<Duration> {
+        self.thin_pool.usage_age()
+    }
+
     fn filesystems(&self) -> Vec<(Name, FilesystemUuid, &dyn Filesystem)> {
         self.thin_pool
             .filesystems()
@@ -649,7 +840,10 @@ mod tests {
     use devicemapper::{Bytes, ThinPoolStatus, ThinPoolStatusSummary, IEC, SECTOR_SIZE};
 
     use crate::engine::{
-        strat_engine::tests::{loopbacked, real},
+        strat_engine::{
+            metadata::decode_pool_metadata,
+            tests::{loopbacked, real},
+        },
         types::{EngineAction, Redundancy},
     };
 
@@ -674,7 +868,8 @@ mod tests {
                 "stratis_test_pool",
                 paths,
                 Redundancy::NONE,
-                &EncryptionInfo::default()
+                &EncryptionInfo::default(),
+                PoolMetadataFormat::default()
             ),
             Err(_)
         );
@@ -699,9 +894,14 @@ mod tests {
         let (paths1, paths2) = paths.split_at(paths.len() / 2);
 
         let name = "stratis-test-pool";
-        let (uuid, mut pool) =
-            StratPool::initialize(name, paths2, Redundancy::NONE, &EncryptionInfo::default())
-                .unwrap();
+        let (uuid, mut pool) = StratPool::initialize(
+            name,
+            paths2,
+            Redundancy::NONE,
+            &EncryptionInfo::default(),
+            PoolMetadataFormat::default(),
+        )
+        .unwrap();
         invariant(&pool, name);
 
         let metadata1 = pool.record(name);
@@ -740,7 +940,8 @@ mod tests {
                 .unwrap();
         }
 
-        pool.init_cache(uuid, name, paths1).unwrap();
+        pool.init_cache(uuid, name, paths1, CacheSettings::default())
+            .unwrap();
         invariant(&pool, name);
 
         let metadata2 = pool.record(name);
@@ -784,9 +985,14 @@ mod tests {
         let (paths1, paths2) = paths.split_at(1);
 
         let name = "stratis-test-pool";
-        let (pool_uuid, mut pool) =
-            StratPool::initialize(name, paths1, Redundancy::NONE, &EncryptionInfo::default())
-                .unwrap();
+        let (pool_uuid, mut pool) = StratPool::initialize(
+            name,
+            paths1,
+            Redundancy::NONE,
+            &EncryptionInfo::default(),
+            PoolMetadataFormat::default(),
+        )
+        .unwrap();
         invariant(&pool, name);
 
         let fs_name = "stratis_test_filesystem";
@@ -859,4 +1065,68 @@ mod tests {
             test_add_datadevs,
         );
     }
+
+    /// Verify that a request to write metadata which is unchanged since the
+    /// last write is not issued to the block devices, but that a request to
+    /// write changed metadata is.
+    fn test_metadata_writes(paths: &[&Path]) {
+        let name = "stratis-test-pool";
+        let (_, mut pool) = StratPool::initialize(
+            name,
+            paths,
+            Redundancy::NONE,
+            &EncryptionInfo::default(),
+            PoolMetadataFormat::default(),
+        )
+        .unwrap();
+        invariant(&pool, name);
+        assert_eq!(pool.metadata_writes.requested, 1);
+        assert_eq!(pool.metadata_writes.issued, 1);
+
+        pool.write_metadata(name).unwrap();
+        pool.write_metadata(name).unwrap();
+        assert_eq!(pool.metadata_writes.requested, 3);
+        assert_eq!(pool.metadata_writes.issued, 1);
+
+        let (dev_uuid, _, _) = pool.blockdevs()[0];
+        assert_matches!(
+            pool.set_blockdev_user_info(name, dev_uuid, Some("user_info")),
+            Ok(RenameAction::Renamed(_))
+        );
+        assert_eq!(pool.metadata_writes.requested, 4);
+        assert_eq!(pool.metadata_writes.issued, 2);
+
+        let new_name = "stratis-test-pool-renamed";
+        pool.write_metadata(new_name).unwrap();
+        assert_eq!(pool.metadata_writes.requested, 5);
+        assert_eq!(pool.metadata_writes.issued, 3);
+
+        // Changing the format changes the data written, even though the
+        // pool itself is unchanged.
+        pool.metadata_format = PoolMetadataFormat::Binary;
+        pool.write_metadata(new_name).unwrap();
+        assert_eq!(pool.metadata_writes.issued, 4);
+        let (written, format) =
+            decode_pool_metadata(pool.metadata_writes.last_written.as_ref().unwrap()).unwrap();
+        assert_eq!(format, PoolMetadataFormat::Binary);
+        assert_eq!(written, pool.record(new_name));
+
+        pool.teardown().unwrap();
+    }
+
+    #[test]
+    fn loop_test_metadata_writes() {
+        loopbacked::test_with_spec(
+            &loopbacked::DeviceLimits::Range(1, 3, None),
+            test_metadata_writes,
+        );
+    }
+
+    #[test]
+    fn real_test_metadata_writes() {
+        real::test_with_spec(
+            &real::DeviceLimits::AtLeast(1, None, None),
+            test_metadata_writes,
+        );
+    }
 }
@@ -16,7 +16,7 @@ use serde::Serialize;
 
 use devicemapper::{Sectors, ThinDevId};
 
-use crate::engine::types::{DevUuid, FilesystemUuid};
+use crate::engine::types::{AllocPolicy, DevUuid, FilesystemUuid, FsGrowthPolicy};
 
 /// Implements saving struct data to a serializable form. The form should be
 /// sufficient, in conjunction with the environment, to reconstruct the
@@ -48,6 +48,8 @@ pub struct BackstoreSave {
 #[derive(Debug, Deserialize, Eq, PartialEq, Serialize)]
 pub struct DataTierSave {
     pub blockdev: BlockDevSave,
+    #[serde(default, skip_serializing_if = "Option::is_none")]
+    pub alloc_policy: Option<AllocPolicy>,
 }
 
 #[derive(Debug, Deserialize, Eq, PartialEq, Serialize)]
@@ -80,6 +82,11 @@ pub struct CapSave {
 #[derive(Debug, Deserialize, Eq, PartialEq, Serialize)]
 pub struct CacheTierSave {
     pub blockdev: BlockDevSave,
+    // The cache block size, if it is not the default
+    #[serde(default, skip_serializing_if = "Option::is_none")]
+    pub block_size: Option<Sectors>,
+    #[serde(default, skip_serializing_if = "Option::is_none")]
+    pub migration_threshold: Option<Sectors>,
 }
 
 #[derive(Debug, Deserialize, Eq, PartialEq, Serialize)]
@@ -93,16 +100,42 @@ pub struct FlexDevsSave {
 #[derive(Debug, Deserialize, Eq, PartialEq, Serialize)]
 pub struct ThinPoolDevSave {
     pub data_block_size: Sectors,
+    #[serde(default, skip_serializing_if = "Option::is_none")]
+    pub checked_superblock: Option<CheckedSuperblockSave>,
+}
+
+// Identifies the superblock of the thin pool's metadata device as it was
+// when the metadata was last verified by a full thin_check before the pool
+// was activated. Metadata committed by the kernel since has a greater
+// transaction id. short_checks counts the setups since then at which a
+// shorter check, or none, was made instead of a full check.
+#[derive(Clone, Copy, Debug, Deserialize, Eq, PartialEq, Serialize)]
+pub struct CheckedSuperblockSave {
+    pub csum: u32,
+    pub trans_id: u64,
+    #[serde(default)]
+    pub short_checks: u64,
 }
 
 // Struct representing filesystem metadata. This metadata is not held in the
 // variable length metadata but on a separate filesystem that is maintained
 // by stratisd.
-#[derive(Debug, Deserialize, Eq, PartialEq, Serialize)]
+#[derive(Clone, Debug, Deserialize, Eq, PartialEq, Serialize)]
 pub struct FilesystemSave {
     pub name: String,
     pub uuid: FilesystemUuid,
     pub thin_id: ThinDevId,
     pub size: Sectors,
     pub created: u64, // Unix timestamp
+    #[serde(default, skip_serializing_if = "Option::is_none")]
+    pub growth_policy: Option<FsGrowthPolicy>,
+}
+
+// A record in the log of filesystem metadata that is kept on the MDV. The
+// current state of a filesystem is given by the last record that refers to
+// it. The type parameter allows a record to be written from a reference.
+#[derive(Debug, Deserialize, Eq, PartialEq, Serialize)]
+pub enum FilesystemLogRecord<T = FilesystemSave> {
+    Save(T),
+    Remove(FilesystemUuid),
 }
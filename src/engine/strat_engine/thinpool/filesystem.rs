@@ -6,11 +6,11 @@ use chrono::{DateTime, TimeZone, Utc};
 use data_encoding::BASE32_NOPAD;
 
 use std::{
+    cmp::max,
     fs::{File, OpenOptions},
     io::{Read, Write},
     path::{Path, PathBuf},
-    thread::sleep,
-    time::Duration,
+    time::{Duration, Instant},
 };
 
 use devicemapper::{
@@ -26,14 +26,16 @@ use crate::{
     engine::{
         engine::Filesystem,
         strat_engine::{
-            cmd::{create_fs, set_uuid, udev_settle, xfs_growfs},
+            cmd::set_uuid,
             devlinks,
             dm::get_dm,
             names::{format_thin_ids, ThinRole},
             serde_structs::FilesystemSave,
-            thinpool::{thinpool::DATA_LOWATER, DATA_BLOCK_SIZE},
+            thinpool::{
+                fill_rate::FillRate, thinpool::DATA_LOWATER, xfs::xfs_grow_data, DATA_BLOCK_SIZE,
+            },
         },
-        types::{FilesystemUuid, Name, PoolUuid, StratisUuid},
+        types::{FilesystemUuid, FsGrowthPolicy, Name, PoolUuid},
     },
     stratis::{StratisError, StratisResult},
 };
@@ -46,14 +48,28 @@ const TEMP_MNT_POINT_PREFIX: &str = "stratis_mp_";
 /// expansion check is triggered by crossing the data low water mark for the thin pool.
 pub const FILESYSTEM_LOWATER: Sectors = Sectors(4 * (DATA_LOWATER.0 * DATA_BLOCK_SIZE.0));
 
+/// The usage of a filesystem's thin device as of the last time its status
+/// was read, or the reason the usage could not be obtained.
+#[derive(Debug)]
+struct CachedUsage {
+    used: Result<Bytes, String>,
+    updated: Instant,
+}
+
 #[derive(Debug)]
 pub struct StratFilesystem {
     thin_dev: ThinDev,
     created: DateTime<Utc>,
+    usage: Option<CachedUsage>,
+    growth_policy: FsGrowthPolicy,
+    // The rate, in sectors per second, at which the filesystem is filling
+    fill_rate: FillRate,
 }
 
 impl StratFilesystem {
-    /// Create a StratFilesystem on top of the given ThinDev.
+    /// Create the ThinDev for a new StratFilesystem, but do not make a
+    /// filesystem on it. The caller must either run create_fs() on the
+    /// devnode, using the returned UUID, or destroy the StratFilesystem.
     pub fn initialize(
         pool_uuid: PoolUuid,
         thinpool_dev: &ThinPoolDev,
@@ -62,7 +78,7 @@ impl StratFilesystem {
     ) -> StratisResult<(FilesystemUuid, StratFilesystem)> {
         let fs_uuid = FilesystemUuid::new_v4();
         let (dm_name, dm_uuid) = format_thin_ids(pool_uuid, ThinRole::Filesystem(fs_uuid));
-        let mut thin_dev = ThinDev::new(
+        let thin_dev = ThinDev::new(
             get_dm(),
             &dm_name,
             Some(&dm_uuid),
@@ -71,29 +87,14 @@ impl StratFilesystem {
             id,
         )?;
 
-        if let Err(err) = create_fs(&thin_dev.devnode(), Some(StratisUuid::Fs(fs_uuid)), false) {
-            udev_settle().unwrap_or_else(|err| {
-                warn!("{}", err);
-                sleep(Duration::from_secs(5));
-            });
-            if let Err(err2) = thin_dev.destroy(get_dm(), thinpool_dev) {
-                error!(
-                    "While handling create_fs error, thin_dev.destroy() failed: {}",
-                    err2
-                );
-                // This will result in a dangling DM device that will prevent
-                // the thinpool from being destroyed, and wasted space in the
-                // thinpool.
-                // TODO: Recover. But how?
-            }
-            return Err(err);
-        }
-
         Ok((
             fs_uuid,
             StratFilesystem {
                 thin_dev,
                 created: Utc::now(),
+                usage: None,
+                growth_policy: FsGrowthPolicy::default(),
+                fill_rate: FillRate::default(),
             },
         ))
     }
@@ -116,6 +117,9 @@ impl StratFilesystem {
         Ok(StratFilesystem {
             thin_dev,
             created: Utc.timestamp(fssave.created as i64, 0),
+            usage: None,
+            growth_policy: fssave.growth_policy.unwrap_or_default(),
+            fill_rate: FillRate::default(),
         })
     }
 
@@ -174,6 +178,32 @@ impl StratFilesystem {
         snapshot_fs_uuid: FilesystemUuid,
         snapshot_thin_id: ThinDevId,
     ) -> StratisResult<StratFilesystem> {
+        let pending = self.start_snapshot(
+            thin_pool,
+            snapshot_name,
+            snapshot_dm_name,
+            snapshot_dm_uuid,
+            snapshot_fs_name,
+            snapshot_thin_id,
+        )?;
+        finish_snapshot(&pending.devnode(), pending.origin_mounted, snapshot_fs_uuid)?;
+        Ok(pending.into_filesystem())
+    }
+
+    /// Create the thin device for a snapshot of the filesystem, but do not
+    /// yet give the filesystem on it a UUID of its own. The caller must
+    /// either call finish_snapshot() on its devnode and then convert it
+    /// into a StratFilesystem, or destroy it.
+    pub fn start_snapshot(
+        &self,
+        thin_pool: &ThinPoolDev,
+        snapshot_name: &str,
+        snapshot_dm_name: &DmName,
+        snapshot_dm_uuid: Option<&DmUuid>,
+        snapshot_fs_name: &Name,
+        snapshot_thin_id: ThinDevId,
+    ) -> StratisResult<PendingSnapshot> {
+        let origin_mounted = !self.mount_points()?.is_empty();
         match self.thin_dev.snapshot(
             get_dm(),
             snapshot_dm_name,
@@ -181,38 +211,11 @@ impl StratFilesystem {
             thin_pool,
             snapshot_thin_id,
         ) {
-            Ok(thin_dev) => {
-                // If the source is mounted, XFS puts a dummy record in the
-                // log to enforce replay of the snapshot to deal with any
-                // orphaned inodes. The dummy record put the log in a dirty
-                // state. xfs_admin won't allow a filesystem UUID
-                // to be updated when the log is dirty.  To clear the log
-                // we mount/unmount the filesystem before updating the UUID.
-                //
-                // If the source is unmounted the XFS log will be clean so
-                // we can skip the mount/unmount.
-                if !self.mount_points()?.is_empty() {
-                    let tmp_dir = tempfile::Builder::new()
-                        .prefix(TEMP_MNT_POINT_PREFIX)
-                        .tempdir()?;
-                    // Mount the snapshot with the "nouuid" option. mount
-                    // will fail due to duplicate UUID otherwise.
-                    mount(
-                        Some(&thin_dev.devnode()),
-                        tmp_dir.path(),
-                        Some("xfs"),
-                        MsFlags::empty(),
-                        Some("nouuid"),
-                    )?;
-                    umount(tmp_dir.path())?;
-                }
-
-                set_uuid(&thin_dev.devnode(), snapshot_fs_uuid)?;
-                Ok(StratFilesystem {
-                    thin_dev,
-                    created: Utc::now(),
-                })
-            }
+            Ok(thin_dev) => Ok(PendingSnapshot {
+                thin_dev,
+                origin_mounted,
+                growth_policy: self.growth_policy,
+            }),
             Err(e) => Err(StratisError::Msg(format!(
                 "failed to create {} snapshot for {} - {}",
                 snapshot_name, snapshot_fs_name, e
@@ -223,20 +226,28 @@ impl StratFilesystem {
     /// check if filesystem is getting full and needs to be extended
     /// TODO: deal with the thindev in a Fail state.
     pub fn check(&mut self) -> StratisResult<bool> {
-        match self.thin_dev.status(get_dm())? {
+        let status = self.thin_dev.status(get_dm())?;
+        self.set_usage(&status);
+        match status {
             ThinStatus::Working(_) => {
                 if let Some(mount_point) = self.mount_points()?.first() {
                     let (fs_total_bytes, fs_total_used_bytes) = fs_usage(mount_point)?;
-                    let free_bytes = fs_total_bytes - fs_total_used_bytes;
-                    if free_bytes.sectors() < FILESYSTEM_LOWATER {
+                    self.fill_rate
+                        .sample(*fs_total_used_bytes.sectors(), Instant::now());
+                    let free = (fs_total_bytes - fs_total_used_bytes).sectors();
+                    let lowater = self.lowater();
+                    if free < lowater {
                         let mut table = self.thin_dev.table().table.clone();
-                        table.length =
-                            self.thin_dev.size() + Self::extend_size(self.thin_dev.size());
+                        table.length = self.thin_dev.size() + self.extend_size(lowater);
                         if self.thin_dev.set_table(get_dm(), table).is_err() {
                             return Ok(false);
                         }
-                        if xfs_growfs(mount_point).is_err() {
-                            return Ok(true);
+                        if let Err(e) = xfs_grow_data(mount_point, self.thin_dev.size()) {
+                            warn!(
+                                "Failed to grow the filesystem mounted at {} to fill its thin device: {}",
+                                mount_point.display(),
+                                e
+                            );
                         }
                         return Ok(true);
                     }
@@ -254,11 +265,57 @@ impl StratFilesystem {
         }
     }
 
-    /// Return an extend size for the thindev under the filesystem
-    /// TODO: returning the current size will double the space provisioned to
-    /// the thin device.  We should determine if this is a reasonable value.
-    fn extend_size(current_size: Sectors) -> Sectors {
-        current_size
+    /// Read the status of the thin device, from which the cached usage may
+    /// be updated by set_usage().
+    pub fn read_usage(&self) -> StratisResult<ThinStatus> {
+        Ok(self.thin_dev.status(get_dm())?)
+    }
+
+    /// Cache the usage reported by status, which has just been read.
+    pub fn set_usage(&mut self, status: &ThinStatus) {
+        self.usage = Some(CachedUsage {
+            used: used_from_status(&self.thin_dev, status).map_err(|e| e.to_string()),
+            updated: Instant::now(),
+        });
+    }
+
+    /// The amount of free space below which the filesystem is grown. When
+    /// the growth policy is predictive, this is the amount of space that the
+    /// filesystem is expected to use within the policy's time, if that is
+    /// more than FILESYSTEM_LOWATER.
+    fn lowater(&self) -> Sectors {
+        match self.growth_policy {
+            FsGrowthPolicy::Predictive(secs) => max(
+                Sectors(self.fill_rate.predict(Duration::from_secs(secs))),
+                FILESYSTEM_LOWATER,
+            ),
+            _ => FILESYSTEM_LOWATER,
+        }
+    }
+
+    /// Return an extend size for the thindev under the filesystem, as
+    /// specified by the growth policy. The extend size is never less than
+    /// lowater, so that the filesystem is not found to be low on space again
+    /// as soon as it has been grown.
+    fn extend_size(&self, lowater: Sectors) -> Sectors {
+        let current_size = self.thin_dev.size();
+        let extend_size = match self.growth_policy {
+            FsGrowthPolicy::Double => current_size,
+            FsGrowthPolicy::Fixed(size) => size,
+            FsGrowthPolicy::Percent(percent) => {
+                Sectors((*current_size).saturating_mul(u64::from(percent)) / 100)
+            }
+            FsGrowthPolicy::Predictive(_) => lowater,
+        };
+        max(extend_size, lowater)
+    }
+
+    /// Set the policy by which this filesystem is grown. Returns true if the
+    /// policy was changed.
+    pub fn set_growth_policy(&mut self, policy: FsGrowthPolicy) -> bool {
+        let changed = self.growth_policy != policy;
+        self.growth_policy = policy;
+        changed
     }
 
     /// Tear down the filesystem.
@@ -267,6 +324,11 @@ impl StratFilesystem {
         Ok(())
     }
 
+    /// The id of the filesystem's thin device within the thin pool.
+    pub fn thin_id(&self) -> ThinDevId {
+        self.thin_dev.id()
+    }
+
     /// Destroy the filesystem.
     pub fn destroy(&mut self, thin_pool: &ThinPoolDev) -> StratisResult<()> {
         self.thin_dev.destroy(get_dm(), thin_pool)?;
@@ -280,6 +342,8 @@ impl StratFilesystem {
             thin_id: self.thin_dev.id(),
             size: self.thin_dev.size(),
             created: self.created.timestamp() as u64,
+            growth_policy: Some(self.growth_policy)
+                .filter(|policy| *policy != FsGrowthPolicy::default()),
         }
     }
 
@@ -339,22 +403,125 @@ impl Filesystem for StratFilesystem {
         devlinks::filesystem_mount_path(pool_name, fs_name)
     }
 
+    /// Return the usage cached by the last check or refresh. If the usage
+    /// has never been cached, read the status of the thin device instead.
     fn used(&self) -> StratisResult<Bytes> {
-        match self.thin_dev.status(get_dm())? {
-            ThinStatus::Working(wk_status) => Ok(wk_status.nr_mapped_sectors.bytes()),
-            ThinStatus::Error => {
-                let error_msg = format!(
-                    "Unable to get status for filesystem thin device {}",
-                    self.thin_dev.device()
-                );
-                Err(StratisError::Msg(error_msg))
-            }
-            ThinStatus::Fail => {
-                let error_msg = format!("ThinDev {} is in a failed state", self.thin_dev.device());
-                Err(StratisError::Msg(error_msg))
-            }
+        match self.usage {
+            Some(CachedUsage { used: Ok(used), .. }) => Ok(used),
+            Some(CachedUsage {
+                used: Err(ref msg), ..
+            }) => Err(StratisError::Msg(msg.clone())),
+            None => used_from_status(&self.thin_dev, &self.thin_dev.status(get_dm())?),
+        }
+    }
+
+    fn used_age(&self) -> Option<Duration> {
+        self.usage.as_ref().map(|usage| usage.updated.elapsed())
+    }
+
+    fn growth_policy(&self) -> FsGrowthPolicy {
+        self.growth_policy
+    }
+}
+
+/// Obtain the number of bytes used by thin_dev from its status.
+fn used_from_status(thin_dev: &ThinDev, status: &ThinStatus) -> StratisResult<Bytes> {
+    match status {
+        ThinStatus::Working(wk_status) => Ok(wk_status.nr_mapped_sectors.bytes()),
+        ThinStatus::Error => {
+            let error_msg = format!(
+                "Unable to get status for filesystem thin device {}",
+                thin_dev.device()
+            );
+            Err(StratisError::Msg(error_msg))
+        }
+        ThinStatus::Fail => {
+            let error_msg = format!("ThinDev {} is in a failed state", thin_dev.device());
+            Err(StratisError::Msg(error_msg))
+        }
+    }
+}
+
+/// The thin device of a snapshot which has been created by
+/// StratFilesystem::start_snapshot(), but whose filesystem does not yet
+/// have a UUID of its own.
+#[derive(Debug)]
+pub struct PendingSnapshot {
+    thin_dev: ThinDev,
+    origin_mounted: bool,
+    // The growth policy of the origin, which the snapshot inherits
+    growth_policy: FsGrowthPolicy,
+}
+
+impl PendingSnapshot {
+    /// The devnode of the snapshot's thin device.
+    pub fn devnode(&self) -> PathBuf {
+        self.thin_dev.devnode()
+    }
+
+    /// The id of the snapshot's thin device within the thin pool.
+    pub fn thin_id(&self) -> ThinDevId {
+        self.thin_dev.id()
+    }
+
+    /// Whether the origin was mounted when the snapshot was taken.
+    pub fn origin_mounted(&self) -> bool {
+        self.origin_mounted
+    }
+
+    /// Convert into a StratFilesystem. Must only be called once
+    /// finish_snapshot() has succeeded on this snapshot's devnode.
+    pub fn into_filesystem(self) -> StratFilesystem {
+        StratFilesystem {
+            thin_dev: self.thin_dev,
+            created: Utc::now(),
+            usage: None,
+            growth_policy: self.growth_policy,
+            fill_rate: FillRate::default(),
         }
     }
+
+    /// Destroy the snapshot's thin device.
+    pub fn destroy(mut self, thin_pool: &ThinPoolDev) -> StratisResult<()> {
+        self.thin_dev.destroy(get_dm(), thin_pool)?;
+        Ok(())
+    }
+}
+
+/// Give the XFS filesystem on a newly created snapshot device the UUID
+/// snapshot_fs_uuid. This does not touch the thin pool, so it may be run
+/// on several snapshots at once.
+pub fn finish_snapshot(
+    devnode: &Path,
+    origin_mounted: bool,
+    snapshot_fs_uuid: FilesystemUuid,
+) -> StratisResult<()> {
+    // If the source is mounted, XFS puts a dummy record in the
+    // log to enforce replay of the snapshot to deal with any
+    // orphaned inodes. The dummy record put the log in a dirty
+    // state. xfs_admin won't allow a filesystem UUID
+    // to be updated when the log is dirty.  To clear the log
+    // we mount/unmount the filesystem before updating the UUID.
+    //
+    // If the source is unmounted the XFS log will be clean so
+    // we can skip the mount/unmount.
+    if origin_mounted {
+        let tmp_dir = tempfile::Builder::new()
+            .prefix(TEMP_MNT_POINT_PREFIX)
+            .tempdir()?;
+        // Mount the snapshot with the "nouuid" option. mount
+        // will fail due to duplicate UUID otherwise.
+        mount(
+            Some(devnode),
+            tmp_dir.path(),
+            Some("xfs"),
+            MsFlags::empty(),
+            Some("nouuid"),
+        )?;
+        umount(tmp_dir.path())?;
+    }
+
+    set_uuid(devnode, snapshot_fs_uuid)
 }
 
 /// Return total bytes allocated to the filesystem, total bytes used by data/metadata
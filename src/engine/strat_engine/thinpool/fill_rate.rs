@@ -0,0 +1,106 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+// Tracking of the rate at which space is allocated in a thin pool or used
+// in a filesystem.
+
+use std::{
+    cmp::max,
+    convert::TryFrom,
+    time::{Duration, Instant},
+};
+
+/// The length of time for which the thin pool should be able to absorb
+/// writes at the observed allocation rate once it has passed its low water
+/// mark, so that stratisd has time to handle the event before the pool runs
+/// out of space.
+pub const TARGET_HEADROOM: Duration = Duration::from_secs(30);
+
+// Samples taken closer together than this are ignored, as the rate computed
+// from them would be dominated by noise.
+const MIN_SAMPLE_INTERVAL: Duration = Duration::from_secs(1);
+
+/// An estimate of the rate at which some quantity, e.g., the number of data
+/// blocks in use in a thin pool, is growing, obtained from successive samples
+/// of that quantity.
+///
+/// The rate is an exponentially weighted moving average, in which the most
+/// recent sample has a weight of 1/4, so that a burst of writes is noticed
+/// quickly, but the estimate does not collapse as soon as writing pauses.
+#[derive(Debug, Default)]
+pub struct FillRate {
+    last: Option<(u64, Instant)>,
+    // Units per second
+    rate: u64,
+}
+
+impl FillRate {
+    /// Record that used units were in use at time now.
+    pub fn sample(&mut self, used: u64, now: Instant) {
+        match self.last {
+            Some((last_used, last_time)) => {
+                let elapsed = now.saturating_duration_since(last_time);
+                if elapsed < MIN_SAMPLE_INTERVAL {
+                    return;
+                }
+                // A decrease in usage, e.g., on account of a discard, is
+                // sampled as a rate of 0.
+                let allocated = u128::from(used.saturating_sub(last_used));
+                let sample = allocated * 1000 / max(elapsed.as_millis(), 1);
+                let rate = (u128::from(self.rate) * 3 + sample) / 4;
+                self.rate = u64::try_from(rate).unwrap_or(std::u64::MAX);
+            }
+            None => self.rate = 0,
+        }
+        self.last = Some((used, now));
+    }
+
+    /// The estimated number of units allocated per second.
+    pub fn rate(&self) -> u64 {
+        self.rate
+    }
+
+    /// The number of units that will be allocated in the given time at the
+    /// estimated rate.
+    pub fn predict(&self, headroom: Duration) -> u64 {
+        self.rate.saturating_mul(headroom.as_secs())
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    /// Verify that the rate follows the allocation rate across samples and
+    /// that predictions are derived from it.
+    fn test_fill_rate() {
+        let start = Instant::now();
+        let mut fill_rate = FillRate::default();
+        assert_eq!(fill_rate.rate(), 0);
+
+        fill_rate.sample(0, start);
+        // Samples too close together are ignored.
+        fill_rate.sample(1000, start + Duration::from_millis(10));
+        assert_eq!(fill_rate.rate(), 0);
+
+        let mut used = 0;
+        for secs in 1..=20 {
+            used += 1000;
+            fill_rate.sample(used, start + Duration::from_secs(secs));
+        }
+        assert!(fill_rate.rate() > 990 && fill_rate.rate() <= 1000);
+        assert_eq!(
+            fill_rate.predict(TARGET_HEADROOM),
+            fill_rate.rate() * TARGET_HEADROOM.as_secs()
+        );
+
+        // Once writing stops, the rate decays to nothing.
+        for secs in 21..=60 {
+            fill_rate.sample(used, start + Duration::from_secs(secs));
+        }
+        assert_eq!(fill_rate.rate(), 0);
+        assert_eq!(fill_rate.predict(TARGET_HEADROOM), 0);
+    }
+}
@@ -5,9 +5,13 @@
 // Manage the linear volume that stores metadata on pool levels 5-7.
 
 use std::{
+    collections::HashMap,
     convert::From,
-    fs::{create_dir, create_dir_all, read_dir, remove_dir, remove_file, rename, OpenOptions},
-    io::{prelude::*, ErrorKind},
+    fs::{
+        create_dir, create_dir_all, read_dir, remove_dir, remove_file, rename, File, OpenOptions,
+    },
+    io::{self, prelude::*, ErrorKind},
+    os::unix::io::AsRawFd,
     path::{Path, PathBuf},
 };
 
@@ -18,7 +22,9 @@ use devicemapper::{DmDevice, LinearDev, LinearDevTargetParams, TargetLine};
 use crate::{
     engine::{
         strat_engine::{
-            cmd::create_fs, dm::get_dm, serde_structs::FilesystemSave,
+            cmd::create_fs,
+            dm::get_dm,
+            serde_structs::{FilesystemLogRecord, FilesystemSave},
             thinpool::filesystem::StratFilesystem,
         },
         types::{FilesystemUuid, Name, PoolUuid, StratisUuid},
@@ -30,59 +36,280 @@ use crate::{
 // TODO: Document format of stuff on MDV in SWDD (currently ad-hoc)
 
 const RUN_DIR: &str = "/run/stratisd";
+// The directory in which filesystem metadata is stored, one file per
+// filesystem, in the format read by earlier versions.
 const FILESYSTEM_DIR: &str = "filesystems";
-
+// The log of filesystem metadata records. Each line is a JSON encoded
+// FilesystemLogRecord; the last record for a filesystem determines its
+// state.
+const FILESYSTEM_LOG: &str = "filesystems.log";
+const FILESYSTEM_LOG_TEMP: &str = "filesystems.log.temp";
+// The log is never compacted while it contains fewer records than this.
+const COMPACTION_MIN_RECORDS: usize = 1024;
+
+/// The Metadata Volume. The MDV is mounted when it is set up and remains
+/// mounted until it is torn down. Filesystem metadata is kept in a single
+/// log file, to which a batch of updates is appended with a single sync.
+/// The log is rewritten, containing only the current record for each
+/// filesystem, when superseded records come to outnumber current ones.
+///
+/// Earlier versions know nothing of the log, and read and write one file
+/// per filesystem. So that a pool can still be set up by such a version,
+/// those files are kept up to date together with the log. They may only
+/// cease to be written in a release which drops support for downgrading
+/// to a version that does not read the log.
 #[derive(Debug)]
 pub struct MetadataVol {
     dev: LinearDev,
     mount_pt: PathBuf,
+    // The log, open for appending. None if the log must be rewritten
+    // before anything more is appended to it, e.g., because an append
+    // failed and may have left a partial record.
+    log: Option<File>,
+    // The current record for each filesystem.
+    records: HashMap<FilesystemUuid, FilesystemSave>,
+    // The number of records in the log, current or superseded.
+    log_records: usize,
 }
 
-/// A helper struct that borrows the MetadataVol and ensures that the MDV is
-/// mounted as long as it is borrowed, and then unmounted.
-#[derive(Debug)]
-struct MountedMDV<'a> {
-    mdv: &'a MetadataVol,
+/// The contents of the log of filesystem records.
+struct FilesystemLog {
+    // The current record for each filesystem
+    filesystems: HashMap<FilesystemUuid, FilesystemSave>,
+    // The number of complete records in the log, current or superseded
+    records: usize,
+    // Whether the log ends with an incomplete record
+    incomplete: bool,
 }
 
-impl<'a> MountedMDV<'a> {
-    /// Borrow the MDV and ensure it's mounted.
-    fn mount(mdv: &MetadataVol) -> StratisResult<MountedMDV> {
-        if let Err(err) = create_dir_all(&mdv.mount_pt) {
-            if err.kind() != ErrorKind::AlreadyExists {
+/// Read the records from the per-filesystem files in the MDV mounted at
+/// mount_pt, or return None if there is no directory for them.
+fn read_legacy_records(
+    mount_pt: &Path,
+) -> StratisResult<Option<HashMap<FilesystemUuid, FilesystemSave>>> {
+    let entries = match read_dir(mount_pt.join(FILESYSTEM_DIR)) {
+        Ok(entries) => entries,
+        Err(err) if err.kind() == ErrorKind::NotFound => return Ok(None),
+        Err(err) => return Err(From::from(err)),
+    };
+    let mut filesystems = HashMap::new();
+    for path in entries
+        .filter_map(|e| e.ok()) // Just ignore entry on intermittent IO error
+        .map(|e| e.path())
+        .filter(|p| p.extension().and_then(|e| e.to_str()) == Some("json"))
+    {
+        let mut data = Vec::new();
+        File::open(&path)?.read_to_end(&mut data)?;
+        let fssave: FilesystemSave = serde_json::from_slice(&data)?;
+        filesystems.insert(fssave.uuid, fssave);
+    }
+    Ok(Some(filesystems))
+}
+
+/// Remove the temporary files left in the per-filesystem directory of the
+/// MDV mounted at mount_pt by an interrupted update.
+fn remove_legacy_temp_files(mount_pt: &Path) -> StratisResult<()> {
+    for path in read_dir(mount_pt.join(FILESYSTEM_DIR))?
+        .filter_map(|e| e.ok()) // Just ignore entry on intermittent IO error
+        .map(|e| e.path())
+        .filter(|p| p.extension().and_then(|e| e.to_str()) == Some("temp"))
+    {
+        remove_file(&path)?;
+    }
+    Ok(())
+}
+
+/// Make everything written to the filesystem that contains path durable.
+fn sync_fs(path: &Path) -> StratisResult<()> {
+    let f = File::open(path)?;
+    if unsafe { libc::syncfs(f.as_raw_fd()) } != 0 {
+        return Err(From::from(io::Error::last_os_error()));
+    }
+    Ok(())
+}
+
+/// Save or, for None, remove the per-filesystem files of the filesystems
+/// in changes in the MDV mounted at mount_pt. The new files are all made
+/// durable with a single sync before they replace the old ones.
+fn write_legacy_files(
+    mount_pt: &Path,
+    changes: &[(FilesystemUuid, Option<&FilesystemSave>)],
+) -> StratisResult<()> {
+    let dir = mount_pt.join(FILESYSTEM_DIR);
+    let path = |uuid: FilesystemUuid| dir.join(uuid_to_string!(uuid)).with_extension("json");
+
+    for (uuid, fssave) in changes {
+        if let Some(fssave) = fssave {
+            OpenOptions::new()
+                .write(true)
+                .create(true)
+                .truncate(true)
+                .open(path(*uuid).with_extension("temp"))?
+                .write_all(serde_json::to_string(fssave)?.as_bytes())?;
+        }
+    }
+    sync_fs(&dir)?;
+
+    for (uuid, fssave) in changes {
+        let fs_path = path(*uuid);
+        if fssave.is_some() {
+            rename(fs_path.with_extension("temp"), fs_path)?;
+        } else if let Err(err) = remove_file(fs_path) {
+            if err.kind() != ErrorKind::NotFound {
                 return Err(From::from(err));
             }
         }
+    }
+    File::open(&dir)?.sync_all()?;
+    Ok(())
+}
 
-        match mount(
-            Some(&mdv.dev.devnode()),
-            &mdv.mount_pt,
-            Some("xfs"),
-            MsFlags::empty(),
-            None as Option<&str>,
-        ) {
-            Err(nix::Error::Sys(nix::errno::Errno::EBUSY)) => {
-                // The device is already mounted at the specified mount point
-                Ok(())
+/// Read the log in the MDV mounted at mount_pt, or return None if there is
+/// no log.
+fn read_log(mount_pt: &Path) -> StratisResult<Option<FilesystemLog>> {
+    let mut bytes = Vec::new();
+    match File::open(mount_pt.join(FILESYSTEM_LOG)) {
+        Ok(mut f) => {
+            f.read_to_end(&mut bytes)?;
+        }
+        Err(err) if err.kind() == ErrorKind::NotFound => return Ok(None),
+        Err(err) => return Err(From::from(err)),
+    }
+
+    // An interrupted append may have split a multi-byte character, so any
+    // invalid UTF-8 is replaced; it can only occur in the final record.
+    let data = String::from_utf8_lossy(&bytes);
+    let mut log = FilesystemLog {
+        filesystems: HashMap::new(),
+        records: 0,
+        incomplete: false,
+    };
+    let mut lines = data.split_terminator('\n').peekable();
+    while let Some(line) = lines.next() {
+        match serde_json::from_str::<FilesystemLogRecord>(line) {
+            Ok(FilesystemLogRecord::Save(fssave)) => {
+                log.filesystems.insert(fssave.uuid, fssave);
             }
-            Err(err) => Err(err),
-            Ok(_) => Ok(()),
-        }?;
+            Ok(FilesystemLogRecord::Remove(uuid)) => {
+                log.filesystems.remove(&uuid);
+            }
+            // A partial record at the end of the log is the result of an
+            // interrupted append, which never completed, so it is ignored.
+            Err(_) if lines.peek().is_none() && !data.ends_with('\n') => {
+                warn!(
+                    "Ignoring incomplete record at the end of MDV filesystem log {}",
+                    mount_pt.join(FILESYSTEM_LOG).display()
+                );
+                log.incomplete = true;
+                break;
+            }
+            Err(err) => return Err(From::from(err)),
+        }
+        log.records += 1;
+    }
 
-        Ok(MountedMDV { mdv })
+    // An append interrupted just before its final newline leaves a record
+    // that parses, but the next append would be written onto the same line,
+    // so the log must be rewritten before anything more is appended to it.
+    if !data.is_empty() && !data.ends_with('\n') {
+        log.incomplete = true;
     }
 
-    fn mount_pt(&self) -> &Path {
-        &self.mdv.mount_pt
+    Ok(Some(log))
+}
+
+/// Write a log that contains only the given records to the MDV mounted at
+/// mount_pt, and return it, open for appending. The new log is written to
+/// a temporary file that replaces the log atomically, so the log on the
+/// MDV is always valid.
+fn write_log(
+    mount_pt: &Path,
+    records: &HashMap<FilesystemUuid, FilesystemSave>,
+) -> StratisResult<File> {
+    let log_path = mount_pt.join(FILESYSTEM_LOG);
+    let temp_path = mount_pt.join(FILESYSTEM_LOG_TEMP);
+
+    let mut data = String::new();
+    for fssave in records.values() {
+        data.push_str(&serde_json::to_string(&FilesystemLogRecord::Save(fssave))?);
+        data.push('\n');
     }
+
+    // Braces to ensure f is closed before renaming
+    {
+        let mut f = OpenOptions::new()
+            .write(true)
+            .create(true)
+            .truncate(true)
+            .open(&temp_path)?;
+        f.write_all(data.as_bytes())?;
+
+        // Try really hard to make sure it goes to disk
+        f.sync_all()?;
+    }
+
+    rename(temp_path, &log_path)?;
+    File::open(mount_pt)?.sync_all()?;
+
+    Ok(OpenOptions::new().append(true).open(log_path)?)
 }
 
-impl<'a> Drop for MountedMDV<'a> {
-    fn drop(&mut self) {
-        if let Err(err) = umount(&self.mdv.mount_pt) {
-            warn!("Could not unmount MDV: {}", err);
-        } else if let Err(err) = remove_dir(&self.mdv.mount_pt) {
-            warn!("Could not remove MDV mount point: {}", err);
+/// Load the filesystem records from the MDV mounted at mount_pt. Returns
+/// the current record for each filesystem, the number of records in the
+/// log, and the log, open for appending.
+///
+/// The per-filesystem files are written before the log, so if they
+/// disagree with the log, they are the newer: either an earlier version,
+/// which writes only the files, has changed them since, or an append to
+/// the log was interrupted. The records are then taken from the files, and
+/// the log is rewritten from them. If there are no files, e.g., because the
+/// pool was last set up by a version that removed them, they are written
+/// from the log. The log is also rewritten if it ends with an incomplete
+/// record, which must not be appended to.
+#[allow(clippy::type_complexity)]
+fn load_records(
+    mount_pt: &Path,
+) -> StratisResult<(HashMap<FilesystemUuid, FilesystemSave>, usize, File)> {
+    let log = read_log(mount_pt)?;
+    let filesystems = match read_legacy_records(mount_pt)? {
+        Some(legacy) => {
+            remove_legacy_temp_files(mount_pt)?;
+            if log.as_ref().map_or(false, |log| log.filesystems != legacy) {
+                warn!(
+                    "MDV filesystem log {} does not agree with the per-filesystem metadata files; using the files",
+                    mount_pt.join(FILESYSTEM_LOG).display()
+                );
+            }
+            legacy
+        }
+        None => {
+            let filesystems = log
+                .as_ref()
+                .map(|log| log.filesystems.clone())
+                .unwrap_or_default();
+            create_dir(mount_pt.join(FILESYSTEM_DIR))?;
+            write_legacy_files(
+                mount_pt,
+                &filesystems
+                    .iter()
+                    .map(|(uuid, fssave)| (*uuid, Some(fssave)))
+                    .collect::<Vec<_>>(),
+            )?;
+            filesystems
+        }
+    };
+
+    match log {
+        Some(log) if !log.incomplete && log.filesystems == filesystems => {
+            let f = OpenOptions::new()
+                .append(true)
+                .open(mount_pt.join(FILESYSTEM_LOG))?;
+            Ok((filesystems, log.records, f))
+        }
+        _ => {
+            let f = write_log(mount_pt, &filesystems)?;
+            let records = filesystems.len();
+            Ok((filesystems, records, f))
         }
     }
 }
@@ -94,112 +321,186 @@ impl MetadataVol {
         MetadataVol::setup(pool_uuid, dev)
     }
 
-    /// Set up an existing Metadata Volume.
+    /// Set up an existing Metadata Volume and mount it.
+    /// If filesystem metadata is stored only in the format used by earlier
+    /// versions, one file per filesystem, a log is made from it.
     pub fn setup(pool_uuid: PoolUuid, dev: LinearDev) -> StratisResult<MetadataVol> {
         let filename = format!(".mdv-{}", uuid_to_string!(pool_uuid));
         let mount_pt: PathBuf = vec![RUN_DIR, &filename].iter().collect();
 
-        let mdv = MetadataVol { dev, mount_pt };
+        if let Err(err) = create_dir_all(&mount_pt) {
+            if err.kind() != ErrorKind::AlreadyExists {
+                return Err(From::from(err));
+            }
+        }
 
-        {
-            let mount = MountedMDV::mount(&mdv)?;
-            let filesystem_path = mount.mount_pt().join(FILESYSTEM_DIR);
+        match mount(
+            Some(&dev.devnode()),
+            &mount_pt,
+            Some("xfs"),
+            MsFlags::empty(),
+            None as Option<&str>,
+        ) {
+            Err(nix::Error::Sys(nix::errno::Errno::EBUSY)) => {
+                // The device is already mounted at the specified mount point
+                Ok(())
+            }
+            Err(err) => Err(err),
+            Ok(_) => Ok(()),
+        }?;
 
-            if let Err(err) = create_dir(&filesystem_path) {
-                if err.kind() != ErrorKind::AlreadyExists {
-                    return Err(From::from(err));
-                }
+        let (records, log_records, log) = match load_records(&mount_pt) {
+            Ok(loaded) => loaded,
+            Err(err) => {
+                unmount(&mount_pt);
+                return Err(err);
             }
+        };
+
+        Ok(MetadataVol {
+            dev,
+            mount_pt,
+            log: Some(log),
+            records,
+            log_records,
+        })
+    }
 
-            let _ = remove_temp_files(&filesystem_path)?;
-        }
+    /// Whether superseded records in the log have come to outnumber the
+    /// current records sufficiently that the log should be rewritten.
+    fn needs_compaction(&self) -> bool {
+        self.log_records >= COMPACTION_MIN_RECORDS && self.log_records > 2 * self.records.len()
+    }
 
-        Ok(mdv)
+    /// Rewrite the log so that it contains only the current record for each
+    /// filesystem.
+    fn compact(&mut self) -> StratisResult<()> {
+        self.log = None;
+        self.log = Some(write_log(&self.mount_pt, &self.records)?);
+        self.log_records = self.records.len();
+        Ok(())
     }
 
-    /// Save info on a new filesystem to persistent storage, or update
-    /// the existing info on a filesystem.
-    // Write to a temp file and then rename to actual filename, to
-    // ensure file contents are not truncated if operation is
-    // interrupted.
-    pub fn save_fs(
-        &self,
-        name: &Name,
-        uuid: FilesystemUuid,
-        fs: &StratFilesystem,
-    ) -> StratisResult<()> {
-        let data = serde_json::to_string(&fs.record(name, uuid))?;
-        let path = self
-            .mount_pt
-            .join(FILESYSTEM_DIR)
-            .join(uuid_to_string!(uuid))
-            .with_extension("json");
+    /// Append data to the log and sync it.
+    fn append_to_log(&mut self, data: &str) -> StratisResult<()> {
+        if self.log.is_none() {
+            self.compact()?;
+        }
+        let log = self.log.as_mut().expect("compact() opens the log");
+        if let Err(err) = log.write_all(data.as_bytes()).and_then(|_| log.sync_all()) {
+            // A partial record may have been written; it must be discarded
+            // before anything more is appended.
+            self.log = None;
+            return Err(From::from(err));
+        }
+        Ok(())
+    }
 
-        let temp_path = path.with_extension("temp");
+    /// Return the per-filesystem files of the filesystems in changes, which
+    /// could not be recorded in the log, to the current records, so that
+    /// they continue to agree with the log.
+    fn restore_legacy_files(&self, changes: &[(FilesystemUuid, Option<&FilesystemSave>)]) {
+        let current = changes
+            .iter()
+            .map(|(uuid, _)| (*uuid, self.records.get(uuid)))
+            .collect::<Vec<_>>();
+        if let Err(err) = write_legacy_files(&self.mount_pt, &current) {
+            warn!(
+                "Could not restore MDV per-filesystem metadata files after a failed update: {}",
+                err
+            );
+        }
+    }
 
-        let _mount = MountedMDV::mount(self)?;
+    /// Save or, for None, remove the record of each filesystem, first in
+    /// the per-filesystem files and then in the log, to which the records
+    /// are appended with a single write and a single sync. The records are
+    /// durable if this method returns Ok. Compact the log if appending has
+    /// made that worthwhile.
+    fn append(
+        &mut self,
+        changes: &[(FilesystemUuid, Option<&FilesystemSave>)],
+    ) -> StratisResult<()> {
+        let mut data = String::new();
+        for (uuid, fssave) in changes {
+            let record = match fssave {
+                Some(fssave) => serde_json::to_string(&FilesystemLogRecord::Save(fssave))?,
+                None => {
+                    serde_json::to_string(&FilesystemLogRecord::<FilesystemSave>::Remove(*uuid))?
+                }
+            };
+            data.push_str(&record);
+            data.push('\n');
+        }
 
-        // Braces to ensure f is closed before renaming
+        if let Err(err) =
+            write_legacy_files(&self.mount_pt, changes).and_then(|_| self.append_to_log(&data))
         {
-            let mut f = OpenOptions::new()
-                .write(true)
-                .create(true)
-                .open(&temp_path)?;
-            f.write_all(data.as_bytes())?;
-
-            // Try really hard to make sure it goes to disk
-            f.sync_all()?;
+            self.restore_legacy_files(changes);
+            return Err(err);
         }
 
-        rename(temp_path, path)?;
-
-        Ok(())
-    }
-
-    /// Remove info on a filesystem from persistent storage.
-    pub fn rm_fs(&self, fs_uuid: FilesystemUuid) -> StratisResult<()> {
-        let fs_path = self
-            .mount_pt
-            .join(FILESYSTEM_DIR)
-            .join(uuid_to_string!(fs_uuid))
-            .with_extension("json");
-
-        let _mount = MountedMDV::mount(self)?;
+        self.log_records += changes.len();
+        for (uuid, fssave) in changes {
+            match fssave {
+                Some(fssave) => self.records.insert(*uuid, (*fssave).clone()),
+                None => self.records.remove(uuid),
+            };
+        }
 
-        if let Err(err) = remove_file(fs_path) {
-            if err.kind() != ErrorKind::NotFound {
-                return Err(From::from(err));
+        if self.needs_compaction() {
+            if let Err(err) = self.compact() {
+                warn!("Could not compact MDV filesystem log: {}", err);
             }
         }
 
         Ok(())
     }
 
-    /// Get list of filesystems stored on the MDV.
-    pub fn filesystems(&self) -> StratisResult<Vec<FilesystemSave>> {
-        let mut filesystems = Vec::new();
-
-        let mount = MountedMDV::mount(self)?;
-
-        for dir_e in read_dir(mount.mount_pt().join(FILESYSTEM_DIR))? {
-            let dir_e = dir_e?;
+    /// Save info on new filesystems to persistent storage, or update
+    /// the existing info on filesystems. All the records are written with a
+    /// single sync.
+    pub fn save_filesystems(&mut self, fssaves: &[FilesystemSave]) -> StratisResult<()> {
+        if fssaves.is_empty() {
+            return Ok(());
+        }
 
-            if dir_e.path().ends_with(".temp") {
-                continue;
-            }
+        self.append(
+            &fssaves
+                .iter()
+                .map(|fssave| (fssave.uuid, Some(fssave)))
+                .collect::<Vec<_>>(),
+        )
+    }
 
-            let mut f = OpenOptions::new().read(true).open(&dir_e.path())?;
-            let mut data = Vec::new();
-            f.read_to_end(&mut data)?;
+    /// Save info on a new filesystem to persistent storage, or update
+    /// the existing info on a filesystem.
+    pub fn save_fs(
+        &mut self,
+        name: &Name,
+        uuid: FilesystemUuid,
+        fs: &StratFilesystem,
+    ) -> StratisResult<()> {
+        self.save_filesystems(&[fs.record(name, uuid)])
+    }
 
-            filesystems.push(serde_json::from_slice(&data)?);
+    /// Remove info on a filesystem from persistent storage.
+    pub fn rm_fs(&mut self, fs_uuid: FilesystemUuid) -> StratisResult<()> {
+        if !self.records.contains_key(&fs_uuid) {
+            return Ok(());
         }
+        self.append(&[(fs_uuid, None)])
+    }
 
-        Ok(filesystems)
+    /// Get list of filesystems stored on the MDV.
+    pub fn filesystems(&self) -> Vec<FilesystemSave> {
+        self.records.values().cloned().collect()
     }
 
     /// Tear down a Metadata Volume.
     pub fn teardown(&mut self) -> StratisResult<()> {
+        self.log = None;
+        unmount(&self.mount_pt);
         self.dev.teardown(get_dm())?;
 
         Ok(())
@@ -232,23 +533,226 @@ impl MetadataVol {
     }
 }
 
-/// Remove temp files from the designated directory.
-/// Returns an error if the directory can not be read.
-/// Persists if an individual directory entry can not be read due to an
-/// intermittent IO error.
-/// Returns the following summary values:
-///  * the number of temp files found
-///  * paths of those unremoved, if any
-fn remove_temp_files(dir: &Path) -> StratisResult<(u64, Vec<PathBuf>)> {
-    let mut found = 0;
-    let mut failed = Vec::new();
-    for path in read_dir(dir)?
-        .filter_map(|e| e.ok()) // Just ignore entry on intermittent IO error
-        .map(|e| e.path())
-        .filter(|p| p.ends_with(".temp"))
-    {
-        found += 1;
-        remove_file(&path).unwrap_or_else(|_| failed.push(path));
+/// Unmount the MDV mounted at mount_pt and remove the mount point.
+fn unmount(mount_pt: &Path) {
+    if let Err(err) = umount(mount_pt) {
+        warn!("Could not unmount MDV: {}", err);
+    } else if let Err(err) = remove_dir(mount_pt) {
+        warn!("Could not remove MDV mount point: {}", err);
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use std::{convert::TryFrom, fs::remove_dir_all, time::Instant};
+
+    use devicemapper::{Sectors, ThinDevId};
+
+    use crate::engine::bench;
+
+    use super::*;
+
+    fn fssave(name: &str, thin_id: u32) -> FilesystemSave {
+        FilesystemSave {
+            name: name.to_owned(),
+            uuid: FilesystemUuid::new_v4(),
+            thin_id: ThinDevId::new_u64(u64::from(thin_id)).unwrap(),
+            size: Sectors(1024),
+            created: 0,
+            growth_policy: None,
+        }
+    }
+
+    fn write_file(path: &Path, data: &str) {
+        OpenOptions::new()
+            .write(true)
+            .create(true)
+            .truncate(true)
+            .open(path)
+            .unwrap()
+            .write_all(data.as_bytes())
+            .unwrap();
+    }
+
+    fn write_legacy_file(mount_pt: &Path, fssave: &FilesystemSave) {
+        write_file(
+            &mount_pt
+                .join(FILESYSTEM_DIR)
+                .join(uuid_to_string!(fssave.uuid))
+                .with_extension("json"),
+            &serde_json::to_string(fssave).unwrap(),
+        );
+    }
+
+    #[test]
+    /// Verify that a log is made from the per-filesystem files of earlier
+    /// versions, that the files are kept, that the files are preferred to
+    /// the log when the two disagree, that the files are written from the
+    /// log if they are missing, that the last record in the log for a
+    /// filesystem determines its state, and that an incomplete final record
+    /// is discarded.
+    fn test_load_records() {
+        let tmp_dir = tempfile::Builder::new()
+            .prefix("stratis_testing")
+            .tempdir()
+            .unwrap();
+        let mount_pt = tmp_dir.path();
+        create_dir(mount_pt.join(FILESYSTEM_DIR)).unwrap();
+
+        let legacy = fssave("legacy", 0);
+        write_legacy_file(mount_pt, &legacy);
+
+        let (filesystems, log_records, _) = load_records(mount_pt).unwrap();
+        assert_eq!(filesystems.len(), 1);
+        assert_eq!(filesystems[&legacy.uuid], legacy);
+        assert_eq!(log_records, 1);
+        assert_eq!(read_legacy_records(mount_pt).unwrap(), Some(filesystems));
+
+        let first = fssave("first", 1);
+        let second = fssave("second", 2);
+        let renamed = FilesystemSave {
+            name: "renamed".to_owned(),
+            ..first.clone()
+        };
+        let log = [
+            serde_json::to_string(&FilesystemLogRecord::Save(&legacy)).unwrap(),
+            serde_json::to_string(&FilesystemLogRecord::Save(&first)).unwrap(),
+            serde_json::to_string(&FilesystemLogRecord::Save(&second)).unwrap(),
+            serde_json::to_string(&FilesystemLogRecord::Save(&renamed)).unwrap(),
+            serde_json::to_string(&FilesystemLogRecord::<FilesystemSave>::Remove(second.uuid))
+                .unwrap(),
+        ];
+        let mut data = log.join("\n");
+        data.push('\n');
+        write_file(&mount_pt.join(FILESYSTEM_LOG), &data);
+
+        // The files are missing, e.g., because a version which removed them
+        // last set up the pool, so they are written from the log, which is
+        // kept as it is.
+        remove_dir_all(mount_pt.join(FILESYSTEM_DIR)).unwrap();
+
+        let (filesystems, log_records, _) = load_records(mount_pt).unwrap();
+        assert_eq!(filesystems.len(), 2);
+        assert_eq!(filesystems[&first.uuid], renamed);
+        assert_eq!(log_records, 5);
+        assert_eq!(read_legacy_records(mount_pt).unwrap(), Some(filesystems));
+
+        // The files have been changed by an earlier version after a
+        // downgrade, so they are used, and the log is rewritten from them.
+        // A temporary file left by an interrupted update is removed.
+        let downgraded = fssave("downgraded", 4);
+        write_legacy_file(mount_pt, &first);
+        write_legacy_file(mount_pt, &downgraded);
+        let temp = mount_pt
+            .join(FILESYSTEM_DIR)
+            .join(uuid_to_string!(second.uuid))
+            .with_extension("temp");
+        write_file(&temp, &serde_json::to_string(&second).unwrap());
+
+        let (filesystems, log_records, _) = load_records(mount_pt).unwrap();
+        assert_eq!(filesystems.len(), 3);
+        assert_eq!(filesystems[&first.uuid], first);
+        assert_eq!(filesystems[&downgraded.uuid], downgraded);
+        assert_eq!(log_records, 3);
+        assert!(!temp.exists());
+        assert_eq!(
+            read_log(mount_pt).unwrap().unwrap().filesystems,
+            filesystems
+        );
+
+        let mut data = std::fs::read_to_string(mount_pt.join(FILESYSTEM_LOG)).unwrap();
+        let partial =
+            serde_json::to_string(&FilesystemLogRecord::Save(&fssave("partial", 3))).unwrap();
+        data.push_str(&partial[..partial.len() / 2]);
+        write_file(&mount_pt.join(FILESYSTEM_LOG), &data);
+
+        let (filesystems, log_records, _) = load_records(mount_pt).unwrap();
+        assert_eq!(filesystems.len(), 3);
+        assert_eq!(log_records, 3);
+        let log = read_log(mount_pt).unwrap().unwrap();
+        assert!(!log.incomplete);
+        assert_eq!(log.records, 3);
+        assert_eq!(log.filesystems, filesystems);
+
+        let mut data = std::fs::read_to_string(mount_pt.join(FILESYSTEM_LOG)).unwrap();
+        data.push_str("garbage\n");
+        write_file(&mount_pt.join(FILESYSTEM_LOG), &data);
+        assert_matches!(load_records(mount_pt), Err(_));
+    }
+
+    #[test]
+    /// Verify that a log whose final record is complete but lacks its
+    /// newline is rewritten, so that a later append starts on a line of its
+    /// own.
+    fn test_load_records_missing_newline() {
+        let tmp_dir = tempfile::Builder::new()
+            .prefix("stratis_testing")
+            .tempdir()
+            .unwrap();
+        let mount_pt = tmp_dir.path();
+
+        let first = fssave("first", 0);
+        let second = fssave("second", 1);
+        let data = [
+            serde_json::to_string(&FilesystemLogRecord::Save(&first)).unwrap(),
+            serde_json::to_string(&FilesystemLogRecord::Save(&second)).unwrap(),
+        ]
+        .join("\n");
+        write_file(&mount_pt.join(FILESYSTEM_LOG), &data);
+
+        let log = read_log(mount_pt).unwrap().unwrap();
+        assert!(log.incomplete);
+        assert_eq!(log.records, 2);
+
+        let (filesystems, log_records, mut f) = load_records(mount_pt).unwrap();
+        assert_eq!(filesystems.len(), 2);
+        assert_eq!(filesystems[&second.uuid], second);
+        assert_eq!(log_records, 2);
+
+        let third = fssave("third", 2);
+        let mut record = serde_json::to_string(&FilesystemLogRecord::Save(&third)).unwrap();
+        record.push('\n');
+        f.write_all(record.as_bytes()).unwrap();
+
+        let log = read_log(mount_pt).unwrap().unwrap();
+        assert!(!log.incomplete);
+        assert_eq!(log.records, 3);
+        assert_eq!(log.filesystems[&third.uuid], third);
+    }
+
+    #[test]
+    #[ignore]
+    /// Measure the cost of encoding the records that are appended to the
+    /// filesystem log when filesystems are saved, and of reading the log when
+    /// the MDV is set up, for increasing numbers of filesystems.
+    /// Run with "make bench".
+    fn bench_filesystem_log() {
+        let tmp_dir = tempfile::Builder::new()
+            .prefix("stratis_testing")
+            .tempdir()
+            .unwrap();
+        let mount_pt = tmp_dir.path();
+
+        for &num_fs in [100, 1000, 10_000].iter() {
+            let fssaves = (0..num_fs)
+                .map(|i| fssave(&format!("fs{}", i), u32::try_from(i).unwrap()))
+                .collect::<Vec<_>>();
+
+            let start = Instant::now();
+            let records = fssaves
+                .iter()
+                .map(|fssave| serde_json::to_string(&FilesystemLogRecord::Save(fssave)).unwrap())
+                .collect::<Vec<_>>();
+            bench::report("mdv/encode_records", num_fs, num_fs, start.elapsed());
+
+            let mut data = records.join("\n");
+            data.push('\n');
+            write_file(&mount_pt.join(FILESYSTEM_LOG), &data);
+
+            let start = Instant::now();
+            let log = read_log(mount_pt).unwrap().unwrap();
+            bench::report("mdv/read_log", num_fs, 1, start.elapsed());
+            assert_eq!(log.filesystems.len() as u64, num_fs);
+        }
     }
-    Ok((found, failed))
 }
@@ -3,9 +3,12 @@
 // file, You can obtain one at http://mozilla.org/MPL/2.0/.
 
 mod filesystem;
+mod fill_rate;
 mod mdv;
+mod superblock;
 mod thinids;
 #[allow(clippy::module_inception)]
 mod thinpool;
+mod xfs;
 
-pub use self::thinpool::{ThinPool, ThinPoolSizeParams, DATA_BLOCK_SIZE};
+pub use self::thinpool::{FilesystemReport, ThinPool, ThinPoolSizeParams, DATA_BLOCK_SIZE};
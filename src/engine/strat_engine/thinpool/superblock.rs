@@ -0,0 +1,160 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+// Reading the superblock of a thin pool's metadata device, which identifies
+// the most recently committed metadata transaction.
+
+use std::{convert::TryFrom, fs::File, io::Read, os::unix::io::AsRawFd, path::Path};
+
+use nix::fcntl::{posix_fadvise, PosixFadviseAdvice};
+
+use crate::{
+    engine::strat_engine::serde_structs::CheckedSuperblockSave,
+    stratis::{StratisError, StratisResult},
+};
+
+// The superblock occupies the first metadata block, struct
+// thin_disk_superblock in the kernel's dm-thin-metadata.c.
+const SUPERBLOCK_SIZE: usize = 4096;
+const SUPERBLOCK_MAGIC: u64 = 27_022_010;
+const CSUM_OFFSET: usize = 0;
+const FLAGS_OFFSET: usize = 4;
+const MAGIC_OFFSET: usize = 32;
+const TRANS_ID_OFFSET: usize = 48;
+// Set by the kernel when it has encountered an error in the metadata
+const NEEDS_CHECK_FLAG: u32 = 1;
+
+fn le_u32(buf: &[u8], offset: usize) -> u32 {
+    u32::from_le_bytes(<[u8; 4]>::try_from(&buf[offset..offset + 4]).expect("4 bytes"))
+}
+
+fn le_u64(buf: &[u8], offset: usize) -> u64 {
+    u64::from_le_bytes(<[u8; 8]>::try_from(&buf[offset..offset + 8]).expect("8 bytes"))
+}
+
+/// Identify the metadata transaction recorded in buf, the contents of a
+/// superblock. Return None if buf is not a thin metadata superblock or if
+/// the kernel has marked the metadata as needing a check.
+fn parse_superblock(buf: &[u8]) -> Option<CheckedSuperblockSave> {
+    if buf.len() < SUPERBLOCK_SIZE || le_u64(buf, MAGIC_OFFSET) != SUPERBLOCK_MAGIC {
+        return None;
+    }
+    if le_u32(buf, FLAGS_OFFSET) & NEEDS_CHECK_FLAG != 0 {
+        return None;
+    }
+    Some(CheckedSuperblockSave {
+        csum: le_u32(buf, CSUM_OFFSET),
+        trans_id: le_u64(buf, TRANS_ID_OFFSET),
+        short_checks: 0,
+    })
+}
+
+/// Read the superblock of the thin pool metadata device at devnode. The
+/// thin pool must not be active, since the kernel writes the superblock
+/// whenever it commits a transaction. Any cached copy is discarded first,
+/// as the kernel writes the metadata without going through the page cache.
+pub fn read_superblock(devnode: &Path) -> StratisResult<Option<CheckedSuperblockSave>> {
+    let mut f = File::open(devnode)?;
+    posix_fadvise(
+        f.as_raw_fd(),
+        0,
+        SUPERBLOCK_SIZE as libc::off_t,
+        PosixFadviseAdvice::POSIX_FADV_DONTNEED,
+    )
+    .map_err(StratisError::Nix)?;
+    let mut buf = vec![0u8; SUPERBLOCK_SIZE];
+    f.read_exact(&mut buf)?;
+    Ok(parse_superblock(&buf))
+}
+
+/// Whether superblock identifies metadata which the kernel has committed
+/// in the course of normal operation since the metadata identified by
+/// verified was verified, or which is the verified metadata itself. Every
+/// commit, e.g., on account of I/O to a thin device, increments the
+/// transaction id, so the superblock differs from the verified one
+/// whenever the pool has been used. The kernel marks metadata that it has
+/// found errors in as needing a check, and such a superblock is never
+/// identified. This does not establish that the metadata is undamaged, as
+/// the kernel finds only the errors that it happens to encounter.
+pub fn descends_from(superblock: &CheckedSuperblockSave, verified: &CheckedSuperblockSave) -> bool {
+    superblock.trans_id > verified.trans_id
+        || (superblock.trans_id == verified.trans_id && superblock.csum == verified.csum)
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn superblock(flags: u32) -> Vec<u8> {
+        let mut buf = vec![0u8; SUPERBLOCK_SIZE];
+        buf[CSUM_OFFSET..CSUM_OFFSET + 4].copy_from_slice(&0xdead_beefu32.to_le_bytes());
+        buf[FLAGS_OFFSET..FLAGS_OFFSET + 4].copy_from_slice(&flags.to_le_bytes());
+        buf[MAGIC_OFFSET..MAGIC_OFFSET + 8].copy_from_slice(&SUPERBLOCK_MAGIC.to_le_bytes());
+        buf[TRANS_ID_OFFSET..TRANS_ID_OFFSET + 8].copy_from_slice(&42u64.to_le_bytes());
+        buf
+    }
+
+    #[test]
+    /// Verify that the transaction is identified only in a valid superblock
+    /// that does not need to be checked.
+    fn test_parse_superblock() {
+        assert_eq!(
+            parse_superblock(&superblock(0)),
+            Some(CheckedSuperblockSave {
+                csum: 0xdead_beef,
+                trans_id: 42,
+                short_checks: 0,
+            })
+        );
+        assert_eq!(parse_superblock(&superblock(NEEDS_CHECK_FLAG)), None);
+        assert_eq!(parse_superblock(&vec![0u8; SUPERBLOCK_SIZE]), None);
+        assert_eq!(
+            parse_superblock(&superblock(0)[..SUPERBLOCK_SIZE - 1]),
+            None
+        );
+    }
+
+    #[test]
+    /// Verify that only the verified superblock or one from a later
+    /// transaction descends from the verified superblock.
+    fn test_descends_from() {
+        let verified = CheckedSuperblockSave {
+            csum: 1,
+            trans_id: 42,
+            short_checks: 3,
+        };
+        assert!(descends_from(&verified, &verified));
+        assert!(descends_from(
+            &CheckedSuperblockSave {
+                short_checks: 0,
+                ..verified
+            },
+            &verified
+        ));
+        assert!(descends_from(
+            &CheckedSuperblockSave {
+                csum: 2,
+                trans_id: 43,
+                short_checks: 0,
+            },
+            &verified
+        ));
+        assert!(!descends_from(
+            &CheckedSuperblockSave {
+                csum: 2,
+                trans_id: 42,
+                short_checks: 0,
+            },
+            &verified
+        ));
+        assert!(!descends_from(
+            &CheckedSuperblockSave {
+                csum: 2,
+                trans_id: 41,
+                short_checks: 0,
+            },
+            &verified
+        ));
+    }
+}
@@ -4,33 +4,175 @@
 
 // Functions for handling thin ids.
 
+use std::{cmp::min, collections::BTreeMap, convert::TryFrom};
+
 use devicemapper::ThinDevId;
 
-use crate::stratis::StratisResult;
+use crate::stratis::{StratisError, StratisResult};
+
+// A thin device id is a 24 bit number.
+const THIN_DEV_ID_LIMIT: u32 = 1 << 24;
 
 #[derive(Debug)]
-/// A pool of thindev ids, all unique.
+/// A pool of thindev ids, all unique. Ids which are released are reused,
+/// lowest first, so that the pool only runs out of ids if every 24 bit
+/// number is in use.
 pub struct ThinDevIdPool {
-    next_id: u32,
+    // Maps the first id of each range of unused ids to the id following the
+    // range. The ranges are disjoint and no two are adjacent.
+    free: BTreeMap<u32, u32>,
+    // The number of unused ids
+    available: u32,
 }
 
 impl ThinDevIdPool {
-    /// Make a new pool from a possibly empty Vec of ids.
-    /// Does not verify the absence of duplicate ids.
+    /// Make a new pool in which every id except for those in ids, which may
+    /// be empty, is unused.
     pub fn new_from_ids(ids: &[ThinDevId]) -> ThinDevIdPool {
-        let max_id: Option<u32> = ids.iter().map(|x| (*x).into()).max();
-        ThinDevIdPool {
-            next_id: max_id.map(|x| x + 1).unwrap_or(0),
+        let mut used = ids.iter().map(|x| u32::from(*x)).collect::<Vec<_>>();
+        used.sort_unstable();
+        used.dedup();
+
+        let mut free = BTreeMap::new();
+        let mut start = 0;
+        for id in used {
+            if id > start {
+                free.insert(start, id);
+            }
+            start = id + 1;
+        }
+        if start < THIN_DEV_ID_LIMIT {
+            free.insert(start, THIN_DEV_ID_LIMIT);
         }
+
+        let available = free.iter().map(|(start, end)| end - start).sum();
+        ThinDevIdPool { free, available }
     }
 
     /// Get a new id for a thindev.
-    /// Returns an error if no thindev id can be constructed.
-    // TODO: Improve this so that it is guaranteed only to fail if every 24 bit
-    // number has been used.
+    /// Returns an error if every id is in use.
     pub fn new_id(&mut self) -> StratisResult<ThinDevId> {
-        let next_id = ThinDevId::new_u64(u64::from(self.next_id))?;
-        self.next_id += 1;
-        Ok(next_id)
+        Ok(self
+            .new_ids(1)?
+            .pop()
+            .expect("exactly one id was allocated"))
+    }
+
+    /// Get n new ids for thindevs, taken from as few ranges of unused ids
+    /// as possible. Returns an error, and allocates no ids, if fewer than n
+    /// ids are unused.
+    pub fn new_ids(&mut self, n: usize) -> StratisResult<Vec<ThinDevId>> {
+        let mut remaining = u32::try_from(n)
+            .ok()
+            .filter(|n| *n <= self.available)
+            .ok_or_else(|| {
+                StratisError::Msg(format!(
+                    "Requested {} thin device ids, but only {} are unused",
+                    n, self.available
+                ))
+            })?;
+        self.available -= remaining;
+
+        let mut ids = Vec::with_capacity(n);
+        while remaining > 0 {
+            let (start, end) = self
+                .free
+                .iter()
+                .next()
+                .map(|(start, end)| (*start, *end))
+                .expect("available counts the ids in the free ranges");
+            self.free.remove(&start);
+            let taken = min(end - start, remaining);
+            if start + taken < end {
+                self.free.insert(start + taken, end);
+            }
+            ids.extend(
+                (start..start + taken)
+                    .map(|id| ThinDevId::new_u64(u64::from(id)).expect("id < THIN_DEV_ID_LIMIT")),
+            );
+            remaining -= taken;
+        }
+        Ok(ids)
+    }
+
+    /// Return id to the pool, so that it may be reused. Must only be
+    /// called once the thindev with this id has been deleted from the thin
+    /// pool.
+    pub fn release_id(&mut self, id: ThinDevId) {
+        let id = u32::from(id);
+        let prev = self
+            .free
+            .range(..=id)
+            .next_back()
+            .map(|(start, end)| (*start, *end));
+        if let Some((_, end)) = prev {
+            if id < end {
+                warn!("Thin device id {} was released, but it was not in use", id);
+                return;
+            }
+        }
+
+        let start = match prev {
+            Some((start, end)) if end == id => start,
+            _ => id,
+        };
+        let end = self.free.remove(&(id + 1)).unwrap_or(id + 1);
+        self.free.insert(start, end);
+        self.available += 1;
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn thin_id(id: u32) -> ThinDevId {
+        ThinDevId::new_u64(u64::from(id)).unwrap()
+    }
+
+    fn thin_ids(ids: &[u32]) -> Vec<ThinDevId> {
+        ids.iter().map(|id| thin_id(*id)).collect()
+    }
+
+    #[test]
+    /// Verify that the ids not saved are allocated, lowest first, and that
+    /// released ids are reused.
+    fn test_reuse() {
+        let mut pool = ThinDevIdPool::new_from_ids(&thin_ids(&[1, 3, 4]));
+        assert_eq!(pool.new_ids(3).unwrap(), thin_ids(&[0, 2, 5]));
+
+        pool.release_id(thin_id(3));
+        pool.release_id(thin_id(2));
+        pool.release_id(thin_id(4));
+        assert_eq!(pool.free.len(), 2);
+        assert_eq!(pool.free[&2], 5);
+
+        pool.release_id(thin_id(4));
+        assert_eq!(pool.available, THIN_DEV_ID_LIMIT - 3);
+
+        assert_eq!(pool.new_id().unwrap(), thin_id(2));
+        assert_eq!(pool.new_ids(4).unwrap(), thin_ids(&[3, 4, 6, 7]));
+    }
+
+    #[test]
+    /// Verify that a request for more ids than are unused allocates nothing
+    /// and that the pool runs out of ids only when every id is in use.
+    fn test_exhaustion() {
+        let mut pool = ThinDevIdPool::new_from_ids(&thin_ids(&[THIN_DEV_ID_LIMIT - 1]));
+        assert!(pool
+            .new_ids(usize::try_from(THIN_DEV_ID_LIMIT).unwrap())
+            .is_err());
+        assert_eq!(pool.available, THIN_DEV_ID_LIMIT - 1);
+
+        let mut free = BTreeMap::new();
+        free.insert(5, 7);
+        let mut pool = ThinDevIdPool { free, available: 2 };
+        assert!(pool.new_ids(3).is_err());
+        assert_eq!(pool.new_ids(2).unwrap(), thin_ids(&[5, 6]));
+        assert!(pool.new_id().is_err());
+
+        pool.release_id(thin_id(THIN_DEV_ID_LIMIT - 1));
+        assert_eq!(pool.new_id().unwrap(), thin_id(THIN_DEV_ID_LIMIT - 1));
+        assert!(pool.new_id().is_err());
     }
 }
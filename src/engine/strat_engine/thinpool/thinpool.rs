@@ -6,13 +6,12 @@
 
 use std::{
     cmp::{max, min},
+    collections::{HashMap, HashSet},
     fmt,
     thread::sleep,
-    time::Duration,
+    time::{Duration, Instant},
 };
 
-use serde_json::Value;
-
 use devicemapper::{
     device_exists, DataBlocks, Device, DmDevice, DmName, DmNameBuf, FlakeyTargetParams, LinearDev,
     LinearDevTargetParams, LinearTargetParams, MetaBlocks, Sectors, TargetLine, ThinDevId,
@@ -22,20 +21,32 @@ use devicemapper::{
 use crate::{
     engine::{
         engine::Filesystem,
+        metrics::span,
         strat_engine::{
             backstore::Backstore,
-            cmd::{thin_check, thin_repair, udev_settle},
+            check_scheduler::PoolCheck,
+            cmd::{create_fs, thin_check, thin_check_superblock, thin_repair, udev_settle},
             dm::get_dm,
             names::{
                 format_flex_ids, format_thin_ids, format_thinpool_ids, FlexRole, ThinPoolRole,
                 ThinRole,
             },
-            serde_structs::{FlexDevsSave, Recordable, ThinPoolDevSave},
-            thinpool::{filesystem::StratFilesystem, mdv::MetadataVol, thinids::ThinDevIdPool},
+            parallel::{bounded_map, DEFAULT_PARALLELISM},
+            serde_structs::{CheckedSuperblockSave, FlexDevsSave, Recordable, ThinPoolDevSave},
+            thinpool::{
+                filesystem::{finish_snapshot, PendingSnapshot, StratFilesystem},
+                fill_rate::{FillRate, TARGET_HEADROOM},
+                mdv::MetadataVol,
+                superblock::{descends_from, read_superblock},
+                thinids::ThinDevIdPool,
+            },
             writing::wipe_sectors,
         },
         structures::Table,
-        types::{FilesystemUuid, Name, PoolUuid},
+        types::{
+            FilesystemUuid, FsGrowthPolicy, Name, PoolUsageReadings, PoolUuid, StratisUuid,
+            ThinCheckPolicy,
+        },
     },
     stratis::{StratisError, StratisResult},
 };
@@ -54,6 +65,10 @@ const MAX_META_SIZE: MetaBlocks = MetaBlocks(255 * ((1 << 14) - 64));
 
 const SPACE_CRIT_PCT: u8 = 95;
 
+// If a shorter check than a full thin_check is allowed, a full check is
+// still made at every setup which follows this many setups without one.
+const FULL_CHECK_INTERVAL: u64 = 10;
+
 fn sectors_to_datablocks(sectors: Sectors) -> DataBlocks {
     DataBlocks(sectors / DATA_BLOCK_SIZE)
 }
@@ -141,28 +156,38 @@ fn coalesce_segs(
 /// Calculate new low water based on the current thinpool data device size and
 /// the number of free sectors in the backstore (free in data tier; or
 /// allocated *to* the backstore cap device, but not yet allocated *from* the
-/// cap device.)
+/// cap device.) margin is the number of free data blocks which should remain
+/// when the event for extending the pool is received; it is DATA_LOWATER
+/// unless a higher value has been predicted from the rate at which data is
+/// being written to the pool. The event for extending filesystems always
+/// uses DATA_LOWATER, since a larger margin would make that event less
+/// frequent just when filesystems are filling fastest.
 /// Lowater needed for three things:
 /// 1. Extend data device (currently not applicable due to greedy allocation)
 /// 2. Get an event when pool exceeds SPACE_CRIT_PCT
 /// 3. Get an event when usage has increased enough that we might need to
 ///    extend a filesystem
-fn calc_lowater(used: DataBlocks, data_dev_size: DataBlocks, available: DataBlocks) -> DataBlocks {
+fn calc_lowater(
+    used: DataBlocks,
+    data_dev_size: DataBlocks,
+    available: DataBlocks,
+    margin: DataBlocks,
+) -> DataBlocks {
     let total = data_dev_size + available;
 
     // Calculate #2. Calculated against total size.
     let crit_percent_total = (total * SPACE_CRIT_PCT) / 100u8;
     assert!(crit_percent_total < total);
     let low_water_for_crit = total - crit_percent_total;
-    assert!(DataBlocks(std::u64::MAX) - available >= DATA_LOWATER);
+    assert!(DataBlocks(std::u64::MAX) - available >= margin);
 
     // Compare values of #1 and #2 above to get which one is higher
     // WARNING: Do not alter this if-expression to a max-expression.
     // Doing so would invalidate the assertion below.
     // Need to add available to LOWATER to make it apples-to-apples with
     // low_water_for_crit.
-    let prelim_max = if DATA_LOWATER + available > low_water_for_crit {
-        DATA_LOWATER
+    let prelim_max = if margin + available > low_water_for_crit {
+        margin
     } else {
         assert!(low_water_for_crit >= available);
         // Adjust for against end of data dev instead of total
@@ -274,6 +299,14 @@ pub struct ThinPool {
     /// The device will change if the backstore adds or removes a cache.
     backstore_device: Device,
     thin_pool_status: Option<ThinPoolStatus>,
+    /// When thin_pool_status was last read from the thin pool device.
+    thin_pool_status_updated: Option<Instant>,
+    /// The observed rate at which data blocks are allocated, used to set the
+    /// low water mark.
+    fill_rate: FillRate,
+    /// The superblock of the metadata device when its contents were last
+    /// verified by a full thin_check.
+    checked_superblock: Option<CheckedSuperblockSave>,
 }
 
 impl ThinPool {
@@ -365,6 +398,7 @@ impl ThinPool {
                 DataBlocks(0),
                 sectors_to_datablocks(data_dev_size),
                 sectors_to_datablocks(backstore.available_in_backstore()),
+                DATA_LOWATER,
             ),
         )?;
 
@@ -381,6 +415,9 @@ impl ThinPool {
             mdv,
             backstore_device,
             thin_pool_status: None,
+            thin_pool_status_updated: None,
+            fill_rate: FillRate::default(),
+            checked_superblock: None,
         })
     }
 
@@ -390,13 +427,15 @@ impl ThinPool {
     /// is a device where the metadata is already stored on its meta device.
     /// If initial setup fails due to a thin_check failure, attempt to fix
     /// the problem by running thin_repair. If failure recurs, return an
-    /// error.
+    /// error. How thoroughly the metadata is checked when it is unchanged
+    /// since it was last verified is determined by thin_check_policy.
     pub fn setup(
         pool_name: &str,
         pool_uuid: PoolUuid,
         thin_pool_save: &ThinPoolDevSave,
         flex_devs: &FlexDevsSave,
         backstore: &Backstore,
+        thin_check_policy: ThinCheckPolicy,
     ) -> StratisResult<ThinPool> {
         let mdv_segments = flex_devs.meta_dev.to_vec();
         let meta_segments = flex_devs.thin_meta_dev.to_vec();
@@ -406,12 +445,14 @@ impl ThinPool {
         let backstore_device = backstore.device().expect("When stratisd was running previously, space was allocated from the backstore, so backstore must have a cap device");
 
         let (thinpool_name, thinpool_uuid) = format_thinpool_ids(pool_uuid, ThinPoolRole::Pool);
-        let (meta_dev, meta_segments, spare_segments) = setup_metadev(
+        let (meta_dev, meta_segments, spare_segments, checked_superblock) = setup_metadev(
             pool_uuid,
             &thinpool_name,
             backstore_device,
             meta_segments,
             spare_segments,
+            thin_pool_save.checked_superblock,
+            thin_check_policy,
         )?;
 
         let (dm_name, dm_uuid) = format_flex_ids(pool_uuid, FlexRole::ThinData);
@@ -436,6 +477,7 @@ impl ThinPool {
                 DataBlocks(0),
                 sectors_to_datablocks(data_dev_size),
                 sectors_to_datablocks(backstore.available_in_backstore()),
+                DATA_LOWATER,
             ),
         )?;
 
@@ -447,7 +489,7 @@ impl ThinPool {
             segs_to_table(backstore_device, &mdv_segments),
         )?;
         let mdv = MetadataVol::setup(pool_uuid, mdv_dev)?;
-        let filesystem_metadatas = mdv.filesystems()?;
+        let filesystem_metadatas = mdv.filesystems();
 
         let filesystems = filesystem_metadatas
             .iter()
@@ -494,13 +536,42 @@ impl ThinPool {
             mdv,
             backstore_device,
             thin_pool_status: None,
+            thin_pool_status_updated: None,
+            fill_rate: FillRate::default(),
+            checked_superblock,
         })
     }
 
+    /// The superblock of the metadata device when its contents were last
+    /// verified by a full thin_check, if known.
+    pub fn checked_superblock(&self) -> Option<CheckedSuperblockSave> {
+        self.checked_superblock
+    }
+
     /// Run status checks and take actions on the thinpool and its components.
     /// Returns a bool communicating if a configuration change requiring a
     /// metadata save has been made.
     pub fn check(&mut self, pool_uuid: PoolUuid, backstore: &mut Backstore) -> StratisResult<bool> {
+        let _span = span("thinpool_check");
+        let should_save = self.check_pool(pool_uuid, backstore)?;
+        let filesystems = self
+            .filesystems
+            .iter()
+            .map(|(_, uuid, _)| *uuid)
+            .collect::<HashSet<_>>();
+        self.check_filesystems(pool_uuid, &filesystems)?;
+        Ok(should_save)
+    }
+
+    /// Run status checks and take actions on the thinpool and its data and
+    /// metadata devices, but not on its filesystems.
+    /// Returns a bool communicating if a configuration change requiring a
+    /// metadata save has been made.
+    pub fn check_pool(
+        &mut self,
+        pool_uuid: PoolUuid,
+        backstore: &mut Backstore,
+    ) -> StratisResult<bool> {
         let mut should_save = false;
 
         // Re-run to ensure pool status is updated if we made any changes
@@ -511,7 +582,82 @@ impl ThinPool {
         Ok(should_save)
     }
 
-    /// Do the real work of check().
+    /// Run status checks and take actions on the filesystems with the given
+    /// UUIDs, saving the records of any filesystems that changed to the MDV.
+    /// UUIDs of filesystems which no longer exist are ignored.
+    /// If checking a filesystem fails, no further filesystems are checked,
+    /// but the records of the filesystems that changed before the failure
+    /// are saved before the error is returned.
+    pub fn check_filesystems(
+        &mut self,
+        pool_uuid: PoolUuid,
+        filesystems: &HashSet<FilesystemUuid>,
+    ) -> StratisResult<()> {
+        let mut to_save = Vec::new();
+        let mut result = Ok(());
+        for uuid in filesystems {
+            if let Some((name, fs)) = self.filesystems.get_mut_by_uuid(*uuid) {
+                match fs.check() {
+                    Ok(true) => to_save.push(fs.record(&name, *uuid)),
+                    Ok(false) => (),
+                    Err(err) => {
+                        result = Err(err);
+                        break;
+                    }
+                }
+            }
+        }
+        if to_save.is_empty() {
+            return result;
+        }
+        if let Err(e) = self.mdv.save_filesystems(&to_save) {
+            error!("Could not save MDV for filesystems with UUIDs {} belonging to pool with UUID {}, reason: {:?}",
+                   to_save.iter().map(|fssave| fssave.uuid.to_string()).collect::<Vec<_>>().join(", "),
+                   pool_uuid, e);
+        }
+        result
+    }
+
+    /// Determine which components of the thin pool must be checked, given
+    /// the names of the devices that have generated events. If any device
+    /// other than the thin device of a filesystem evented, the thin pool and
+    /// all its filesystems must be checked. Otherwise, only the filesystems
+    /// that evented must be checked.
+    pub fn evented_components(
+        &self,
+        pool_uuid: PoolUuid,
+        dm_names: &HashSet<DmNameBuf>,
+    ) -> PoolCheck {
+        let fs_dm_names = self
+            .filesystems
+            .iter()
+            .map(|(_, uuid, _)| {
+                (
+                    format_thin_ids(pool_uuid, ThinRole::Filesystem(*uuid)).0,
+                    *uuid,
+                )
+            })
+            .collect::<HashMap<_, _>>();
+        if dm_names
+            .iter()
+            .any(|dm_name| !fs_dm_names.contains_key(dm_name))
+        {
+            PoolCheck {
+                thin_pool: true,
+                filesystems: fs_dm_names.values().cloned().collect(),
+            }
+        } else {
+            PoolCheck {
+                thin_pool: false,
+                filesystems: dm_names
+                    .iter()
+                    .map(|dm_name| fs_dm_names[dm_name])
+                    .collect(),
+            }
+        }
+    }
+
+    /// Do the real work of check_pool().
     fn do_check(&mut self, pool_uuid: PoolUuid, backstore: &mut Backstore) -> StratisResult<bool> {
         assert_eq!(
             backstore.device().expect(
@@ -563,10 +709,20 @@ impl ThinPool {
 
             let current_total = usage.total_data + total_extended;
 
+            self.fill_rate.sample(*usage.used_data, Instant::now());
             let lowater = calc_lowater(
                 usage.used_data,
                 current_total,
                 sectors_to_datablocks(backstore.available_in_backstore()),
+                // A margin larger than the free space would cause an event
+                // as soon as the low water mark is set.
+                max(
+                    min(
+                        DataBlocks(self.fill_rate.predict(TARGET_HEADROOM)),
+                        DataBlocks((*current_total).saturating_sub(*usage.used_data)),
+                    ),
+                    DATA_LOWATER,
+                ),
             );
 
             self.thin_pool.set_low_water_mark(get_dm(), lowater)?;
@@ -575,15 +731,6 @@ impl ThinPool {
 
         self.set_state(thin_pool_status);
 
-        for (name, uuid, fs) in self.filesystems.iter_mut() {
-            let save_mdv = fs.check()?;
-            if save_mdv {
-                if let Err(e) = self.mdv.save_fs(name, *uuid, fs) {
-                    error!("Could not save MDV for fs with UUID {} and name {} belonging to pool with UUID {}, reason: {:?}",
-                                uuid, name, pool_uuid, e);
-                }
-            }
-        }
         Ok(should_save)
     }
 
@@ -618,6 +765,54 @@ impl ThinPool {
         }
 
         self.thin_pool_status = Some(thin_pool_status);
+        self.thin_pool_status_updated = Some(Instant::now());
+    }
+
+    /// Read the status of the thin pool and of each of its filesystems.
+    /// Unlike check(), this never changes the devices or any cached state.
+    pub fn read_usage(&self) -> PoolUsageReadings {
+        PoolUsageReadings {
+            read_at: Instant::now(),
+            thin_pool: self.thin_pool.status(get_dm()).map_err(StratisError::from),
+            filesystems: self
+                .filesystems
+                .iter()
+                .map(|(_, uuid, fs)| (*uuid, fs.read_usage()))
+                .collect(),
+        }
+    }
+
+    /// Update the cached usage of the thin pool and of each of its
+    /// filesystems from readings obtained by read_usage(), and sample the
+    /// rate at which the thin pool is filling. The usage of every filesystem
+    /// is updated even if some reading failed; the first failure is
+    /// returned.
+    pub fn set_usage(&mut self, mut readings: PoolUsageReadings) -> StratisResult<()> {
+        if let Ok(ThinPoolStatus::Working(status)) = &readings.thin_pool {
+            self.fill_rate
+                .sample(*status.usage.used_data, readings.read_at);
+        }
+        let mut result = readings.thin_pool.map(|status| self.set_state(status));
+        for (_, uuid, fs) in self.filesystems.iter_mut() {
+            let fs_result = match readings.filesystems.remove(uuid) {
+                Some(Ok(status)) => {
+                    fs.set_usage(&status);
+                    Ok(())
+                }
+                Some(Err(err)) => Err(err),
+                None => Ok(()),
+            };
+            if result.is_ok() {
+                result = fs_result;
+            }
+        }
+        result
+    }
+
+    /// The time since the status of the thin pool was last read.
+    pub fn usage_age(&self) -> Option<Duration> {
+        self.thin_pool_status_updated
+            .map(|updated| updated.elapsed())
     }
 
     /// Tear down the components managed here: filesystems, the MDV,
@@ -818,6 +1013,18 @@ impl ThinPool {
             .collect()
     }
 
+    /// The filesystems in this thin pool as they appear in the engine state
+    /// report.
+    pub fn filesystems_report(&self) -> Vec<FilesystemReport<'_>> {
+        self.filesystems
+            .iter()
+            .map(|(name, uuid, _)| FilesystemReport {
+                name: name.as_ref(),
+                uuid: *uuid,
+            })
+            .collect()
+    }
+
     pub fn filesystems_mut(&mut self) -> Vec<(Name, FilesystemUuid, &mut StratFilesystem)> {
         self.filesystems
             .iter_mut()
@@ -834,30 +1041,97 @@ impl ThinPool {
         name: &str,
         size: Option<Sectors>,
     ) -> StratisResult<FilesystemUuid> {
-        let (fs_uuid, mut new_filesystem) =
-            StratFilesystem::initialize(pool_uuid, &self.thin_pool, size, self.id_gen.new_id()?)?;
-        let name = Name::new(name.to_owned());
-        if let Err(err) = self.mdv.save_fs(&name, fs_uuid, &new_filesystem) {
+        self.create_filesystems(pool_name, pool_uuid, &[(name, size)])
+            .map(|created| created[0].1)
+    }
+
+    /// Create several filesystems within the thin pool. The given names
+    /// must not already be in use. Returns the name and UUID of each new
+    /// filesystem, in the order of specs.
+    ///
+    /// The thin devices are all created first, then mkfs is run on at most
+    /// DEFAULT_PARALLELISM of them at a time, and finally the records for
+    /// all the new filesystems are written to the MDV in a single commit.
+    /// If any step fails, all the thin devices created so far are destroyed.
+    pub fn create_filesystems<'a>(
+        &mut self,
+        pool_name: &str,
+        pool_uuid: PoolUuid,
+        specs: &[(&'a str, Option<Sectors>)],
+    ) -> StratisResult<Vec<(&'a str, FilesystemUuid)>> {
+        fn destroy_all(
+            thin_pool: &ThinPoolDev,
+            id_gen: &mut ThinDevIdPool,
+            new_filesystems: Vec<(&str, FilesystemUuid, StratFilesystem)>,
+        ) {
             udev_settle().unwrap_or_else(|err| {
                 warn!("{}", err);
                 sleep(Duration::from_secs(5));
             });
-            if let Err(err2) = new_filesystem.destroy(&self.thin_pool) {
-                error!(
-                    "When handling failed save_fs(), fs.destroy() failed: {}",
-                    err2
-                )
+            for (_, _, mut fs) in new_filesystems {
+                match fs.destroy(thin_pool) {
+                    Ok(_) => id_gen.release_id(fs.thin_id()),
+                    Err(err) => {
+                        error!(
+                            "While rolling back create_filesystems(), fs.destroy() failed: {}",
+                            err
+                        );
+                        // This will result in a dangling DM device that will
+                        // prevent the thinpool from being destroyed, and wasted
+                        // space in the thinpool.
+                    }
+                }
+            }
+        }
+
+        let ids = self.id_gen.new_ids(specs.len())?;
+        let mut new_filesystems = Vec::with_capacity(specs.len());
+        for (&(name, size), &id) in specs.iter().zip(ids.iter()) {
+            match StratFilesystem::initialize(pool_uuid, &self.thin_pool, size, id) {
+                Ok((fs_uuid, fs)) => new_filesystems.push((name, fs_uuid, fs)),
+                Err(err) => {
+                    // The ids of the filesystems not yet created are
+                    // unused. The id of the one that failed may have been
+                    // given to a thin device, and so is not reused.
+                    for unused in &ids[new_filesystems.len() + 1..] {
+                        self.id_gen.release_id(*unused);
+                    }
+                    destroy_all(&self.thin_pool, &mut self.id_gen, new_filesystems);
+                    return Err(err);
+                }
             }
+        }
+
+        let results = bounded_map(
+            new_filesystems
+                .iter()
+                .map(|(_, fs_uuid, fs)| (fs.devnode(), *fs_uuid))
+                .collect(),
+            DEFAULT_PARALLELISM,
+            |(devnode, fs_uuid)| create_fs(&devnode, Some(StratisUuid::Fs(fs_uuid)), false),
+        );
+        if let Some(err) = results.into_iter().find_map(|res| res.err()) {
+            destroy_all(&self.thin_pool, &mut self.id_gen, new_filesystems);
+            return Err(err);
+        }
+
+        let records = new_filesystems
+            .iter()
+            .map(|(name, fs_uuid, fs)| fs.record(&Name::new((*name).to_owned()), *fs_uuid))
+            .collect::<Vec<_>>();
+        if let Err(err) = self.mdv.save_filesystems(&records) {
+            destroy_all(&self.thin_pool, &mut self.id_gen, new_filesystems);
             return Err(err);
         }
-        self.filesystems.insert(name, fs_uuid, new_filesystem);
-        let (name, fs) = self
-            .filesystems
-            .get_by_uuid(fs_uuid)
-            .expect("Inserted above");
-        fs.udev_fs_change(&pool_name, fs_uuid, &name);
 
-        Ok(fs_uuid)
+        let mut created = Vec::with_capacity(new_filesystems.len());
+        for (name, fs_uuid, fs) in new_filesystems {
+            let fs_name = Name::new(name.to_owned());
+            fs.udev_fs_change(pool_name, fs_uuid, &fs_name);
+            self.filesystems.insert(fs_name, fs_uuid, fs);
+            created.push((name, fs_uuid));
+        }
+        Ok(created)
     }
 
     /// Create a filesystem snapshot of the origin.  Given origin_uuid
@@ -872,8 +1146,7 @@ impl ThinPool {
         let snapshot_fs_uuid = FilesystemUuid::new_v4();
         let (snapshot_dm_name, snapshot_dm_uuid) =
             format_thin_ids(pool_uuid, ThinRole::Filesystem(snapshot_fs_uuid));
-        let snapshot_id = self.id_gen.new_id()?;
-        let new_filesystem = match self.get_filesystem_by_uuid(origin_uuid) {
+        let new_filesystem = match self.filesystems.get_by_uuid(origin_uuid) {
             Some((fs_name, filesystem)) => filesystem.snapshot(
                 &self.thin_pool,
                 snapshot_name,
@@ -881,7 +1154,7 @@ impl ThinPool {
                 Some(&snapshot_dm_uuid),
                 &fs_name,
                 snapshot_fs_uuid,
-                snapshot_id,
+                self.id_gen.new_id()?,
             )?,
             None => {
                 return Err(StratisError::Msg(
@@ -908,6 +1181,135 @@ impl ThinPool {
         ))
     }
 
+    /// Create snapshots of several origins at once. Each spec pairs the UUID
+    /// of an origin, which must exist, with the name of its snapshot.
+    /// Returns the name and UUID of each new filesystem, in the order of
+    /// specs.
+    ///
+    /// The snapshot thin devices are created one after another, since each
+    /// requires a message to the thin pool. The new XFS filesystems are then
+    /// given their own UUIDs concurrently, and the records for all the new
+    /// filesystems are written to the MDV in a single commit. If any step
+    /// fails, all the snapshots created so far are destroyed.
+    pub fn snapshot_filesystems<'a>(
+        &mut self,
+        pool_name: &str,
+        pool_uuid: PoolUuid,
+        specs: &[(FilesystemUuid, &'a str)],
+    ) -> StratisResult<Vec<(&'a str, FilesystemUuid)>> {
+        fn destroy_pending(
+            thin_pool: &ThinPoolDev,
+            id_gen: &mut ThinDevIdPool,
+            pending: Vec<PendingSnapshot>,
+        ) {
+            udev_settle().unwrap_or_else(|err| {
+                warn!("{}", err);
+                sleep(Duration::from_secs(5));
+            });
+            for snapshot in pending {
+                let thin_id = snapshot.thin_id();
+                match snapshot.destroy(thin_pool) {
+                    Ok(_) => id_gen.release_id(thin_id),
+                    Err(err) => {
+                        error!(
+                            "While rolling back snapshot_filesystems(), failed to destroy a snapshot: {}",
+                            err
+                        );
+                    }
+                }
+            }
+        }
+
+        let ids = self.id_gen.new_ids(specs.len())?;
+        let mut pending = Vec::with_capacity(specs.len());
+        for (&(origin_uuid, snapshot_name), &snapshot_id) in specs.iter().zip(ids.iter()) {
+            let snapshot_fs_uuid = FilesystemUuid::new_v4();
+            let (snapshot_dm_name, snapshot_dm_uuid) =
+                format_thin_ids(pool_uuid, ThinRole::Filesystem(snapshot_fs_uuid));
+            let result = match self.filesystems.get_by_uuid(origin_uuid) {
+                Some((fs_name, filesystem)) => filesystem.start_snapshot(
+                    &self.thin_pool,
+                    snapshot_name,
+                    &snapshot_dm_name,
+                    Some(&snapshot_dm_uuid),
+                    &fs_name,
+                    snapshot_id,
+                ),
+                None => Err(StratisError::Msg(format!(
+                    "snapshot_filesystems failed, filesystem {} not found",
+                    origin_uuid
+                ))),
+            };
+            match result {
+                Ok(snapshot) => pending.push((snapshot_name, snapshot_fs_uuid, snapshot)),
+                Err(err) => {
+                    // As in create_filesystems(), the id that failed is not
+                    // reused.
+                    for unused in &ids[pending.len() + 1..] {
+                        self.id_gen.release_id(*unused);
+                    }
+                    destroy_pending(
+                        &self.thin_pool,
+                        &mut self.id_gen,
+                        pending.into_iter().map(|(_, _, p)| p).collect(),
+                    );
+                    return Err(err);
+                }
+            }
+        }
+
+        let results = bounded_map(
+            pending
+                .iter()
+                .map(|(_, uuid, snapshot)| (snapshot.devnode(), snapshot.origin_mounted(), *uuid))
+                .collect(),
+            DEFAULT_PARALLELISM,
+            |(devnode, origin_mounted, uuid)| finish_snapshot(&devnode, origin_mounted, uuid),
+        );
+        if let Some(err) = results.into_iter().find_map(|res| res.err()) {
+            destroy_pending(
+                &self.thin_pool,
+                &mut self.id_gen,
+                pending.into_iter().map(|(_, _, p)| p).collect(),
+            );
+            return Err(err);
+        }
+
+        let new_filesystems = pending
+            .into_iter()
+            .map(|(name, uuid, snapshot)| (name, uuid, snapshot.into_filesystem()))
+            .collect::<Vec<_>>();
+        let records = new_filesystems
+            .iter()
+            .map(|(name, uuid, fs)| fs.record(&Name::new((*name).to_owned()), *uuid))
+            .collect::<Vec<_>>();
+        if let Err(err) = self.mdv.save_filesystems(&records) {
+            udev_settle().unwrap_or_else(|err| {
+                warn!("{}", err);
+                sleep(Duration::from_secs(5));
+            });
+            for (_, _, mut fs) in new_filesystems {
+                match fs.destroy(&self.thin_pool) {
+                    Ok(_) => self.id_gen.release_id(fs.thin_id()),
+                    Err(err2) => error!(
+                        "When handling failed save_filesystems(), fs.destroy() failed: {}",
+                        err2
+                    ),
+                }
+            }
+            return Err(err);
+        }
+
+        let mut created = Vec::with_capacity(new_filesystems.len());
+        for (name, uuid, fs) in new_filesystems {
+            let fs_name = Name::new(name.to_owned());
+            fs.udev_fs_change(pool_name, uuid, &fs_name);
+            self.filesystems.insert(fs_name, uuid, fs);
+            created.push((name, uuid));
+        }
+        Ok(created)
+    }
+
     /// Destroy a filesystem within the thin pool. Destroy metadata associated
     /// with the thinpool. If there is a failure to destroy the filesystem,
     /// retain it, and return an error.
@@ -923,12 +1325,17 @@ impl ThinPool {
         match self.filesystems.remove_by_uuid(uuid) {
             Some((fs_name, mut fs)) => match fs.destroy(&self.thin_pool) {
                 Ok(_) => {
+                    // The id is reused only if no record of the filesystem
+                    // remains, since the filesystem would otherwise be set
+                    // up again from its record when the pool is next set up.
                     if let Err(err) = self.mdv.rm_fs(uuid) {
                         error!("Could not remove metadata for fs with UUID {} and name {} belonging to pool {}, reason: {:?}",
                                uuid,
                                fs_name,
                                pool_name,
                                err);
+                    } else {
+                        self.id_gen.release_id(fs.thin_id());
                     }
                     Ok(Some(uuid))
                 }
@@ -978,6 +1385,29 @@ impl ThinPool {
         }
     }
 
+    /// Set the growth policy of the filesystem with the given UUID.
+    /// Returns None if there is no such filesystem, and otherwise whether
+    /// the policy was changed.
+    pub fn set_fs_growth_policy(
+        &mut self,
+        uuid: FilesystemUuid,
+        policy: FsGrowthPolicy,
+    ) -> StratisResult<Option<bool>> {
+        let (name, fs) = match self.filesystems.get_mut_by_uuid(uuid) {
+            Some(name_fs) => name_fs,
+            None => return Ok(None),
+        };
+        let old_policy = fs.growth_policy();
+        if !fs.set_growth_policy(policy) {
+            return Ok(Some(false));
+        }
+        if let Err(err) = self.mdv.save_fs(&name, uuid, fs) {
+            fs.set_growth_policy(old_policy);
+            return Err(err);
+        }
+        Ok(Some(true))
+    }
+
     /// The names of DM devices belonging to this pool that may generate events
     pub fn get_eventing_dev_names(&self, pool_uuid: PoolUuid) -> Vec<DmNameBuf> {
         let mut eventing = vec![
@@ -1093,19 +1523,12 @@ impl ThinPool {
     }
 }
 
-impl<'a> Into<Value> for &'a ThinPool {
-    fn into(self) -> Value {
-        json!({
-            "filesystems": Value::Array(
-                self.filesystems.iter()
-                    .map(|(name, uuid, _)| json!({
-                        "name": name.to_string(),
-                        "uuid": uuid.to_string(),
-                    }))
-                    .collect()
-            )
-        })
-    }
+/// A filesystem as it appears in the engine state report. Fields are
+/// declared in the order in which they are reported.
+#[derive(Serialize)]
+pub struct FilesystemReport<'a> {
+    name: &'a str,
+    uuid: FilesystemUuid,
 }
 
 impl Recordable<FlexDevsSave> for Segments {
@@ -1129,6 +1552,7 @@ impl Recordable<ThinPoolDevSave> for ThinPool {
     fn record(&self) -> ThinPoolDevSave {
         ThinPoolDevSave {
             data_block_size: self.thin_pool.data_block_size(),
+            checked_superblock: self.checked_superblock,
         }
     }
 }
@@ -1137,8 +1561,14 @@ impl Recordable<ThinPoolDevSave> for ThinPool {
 /// Attempt to verify that the metadata dev is valid for the given thinpool
 /// using thin_check. If thin_check indicates that the metadata is corrupted
 /// run thin_repair, using the spare segments, to try to repair the metadata
-/// dev. Return the metadata device, the metadata segments, and the
-/// spare segments.
+/// dev. Return the metadata device, the metadata segments, the
+/// spare segments, and the superblock as of the last full thin_check.
+///
+/// If the superblock descends from checked_superblock, the metadata has
+/// been changed since it was last verified only by transactions that the
+/// kernel committed without finding an error, and it is checked only as
+/// thoroughly as thin_check_policy requires, unless FULL_CHECK_INTERVAL
+/// setups have passed without a full check.
 #[allow(clippy::type_complexity)]
 fn setup_metadev(
     pool_uuid: PoolUuid,
@@ -1146,7 +1576,14 @@ fn setup_metadev(
     device: Device,
     meta_segments: Vec<(Sectors, Sectors)>,
     spare_segments: Vec<(Sectors, Sectors)>,
-) -> StratisResult<(LinearDev, Vec<(Sectors, Sectors)>, Vec<(Sectors, Sectors)>)> {
+    checked_superblock: Option<CheckedSuperblockSave>,
+    thin_check_policy: ThinCheckPolicy,
+) -> StratisResult<(
+    LinearDev,
+    Vec<(Sectors, Sectors)>,
+    Vec<(Sectors, Sectors)>,
+    Option<CheckedSuperblockSave>,
+)> {
     let (dm_name, dm_uuid) = format_flex_ids(pool_uuid, FlexRole::ThinMeta);
     let mut meta_dev = LinearDev::setup(
         get_dm(),
@@ -1155,17 +1592,55 @@ fn setup_metadev(
         segs_to_table(device, &meta_segments),
     )?;
 
-    if !device_exists(get_dm(), thinpool_name)? {
-        // TODO: Refine policy about failure to run thin_check.
-        // If, e.g., thin_check is unavailable, that doesn't necessarily
-        // mean that data is corrupted.
-        if thin_check(&meta_dev.devnode()).is_err() {
-            meta_dev = attempt_thin_repair(pool_uuid, meta_dev, device, &spare_segments)?;
-            return Ok((meta_dev, spare_segments, meta_segments));
+    // If the thin pool is already active, its metadata can not be checked,
+    // and the superblock is overwritten by the kernel at every commit.
+    if device_exists(get_dm(), thinpool_name)? {
+        return Ok((meta_dev, meta_segments, spare_segments, checked_superblock));
+    }
+
+    let superblock = match read_superblock(&meta_dev.devnode()) {
+        Ok(superblock) => superblock,
+        Err(err) => {
+            warn!(
+                "Failed to read the superblock of the thin pool metadata device for pool with UUID {}: {}",
+                pool_uuid, err
+            );
+            None
         }
+    };
+    let shorten = thin_check_policy != ThinCheckPolicy::Full
+        && match (superblock, checked_superblock) {
+            (Some(superblock), Some(checked)) => {
+                descends_from(&superblock, &checked)
+                    && checked.short_checks + 1 < FULL_CHECK_INTERVAL
+            }
+            _ => false,
+        };
+
+    // TODO: Refine policy about failure to run thin_check.
+    // If, e.g., thin_check is unavailable, that doesn't necessarily
+    // mean that data is corrupted.
+    let checked = match thin_check_policy {
+        ThinCheckPolicy::Skip if shorten => Ok(()),
+        ThinCheckPolicy::Superblock if shorten => thin_check_superblock(&meta_dev.devnode()),
+        _ => thin_check(&meta_dev.devnode()),
+    };
+    if checked.is_err() {
+        meta_dev = attempt_thin_repair(pool_uuid, meta_dev, device, &spare_segments)?;
+        return Ok((meta_dev, spare_segments, meta_segments, None));
     }
 
-    Ok((meta_dev, meta_segments, spare_segments))
+    // The superblock recorded is that of the last full check, so that a
+    // check of the superblock alone never stands in for a full check.
+    let checked_superblock = if shorten {
+        checked_superblock.map(|checked| CheckedSuperblockSave {
+            short_checks: checked.short_checks + 1,
+            ..checked
+        })
+    } else {
+        superblock
+    };
+    Ok((meta_dev, meta_segments, spare_segments, checked_superblock))
 }
 
 /// Attempt a thin repair operation on the meta device.
@@ -1197,6 +1672,7 @@ fn attempt_thin_repair(
 #[cfg(test)]
 mod tests {
     use std::{
+        collections::HashSet,
         fs::OpenOptions,
         io::{BufWriter, Read, Write},
         path::Path,
@@ -1213,7 +1689,7 @@ mod tests {
             tests::{loopbacked, real},
             writing::SyncAll,
         },
-        types::EncryptionInfo,
+        types::{CacheSettings, EncryptionInfo},
     };
 
     use crate::engine::strat_engine::thinpool::filesystem::{fs_usage, FILESYSTEM_LOWATER};
@@ -1531,6 +2007,266 @@ mod tests {
         );
     }
 
+    /// Verify that filesystem usage is served from the cache once it has been
+    /// refreshed, and that the age of the cached usage is reported.
+    fn test_usage_cache(paths: &[&Path]) {
+        let pool_name = "pool";
+        let pool_uuid = PoolUuid::new_v4();
+        let mut backstore = Backstore::initialize(
+            pool_uuid,
+            paths,
+            MDADataSize::default(),
+            &EncryptionInfo::default(),
+        )
+        .unwrap();
+        let mut pool = ThinPool::new(
+            pool_uuid,
+            &ThinPoolSizeParams::default(),
+            DATA_BLOCK_SIZE,
+            &mut backstore,
+        )
+        .unwrap();
+
+        let fs_uuid = pool
+            .create_filesystem(pool_name, pool_uuid, "stratis_test_filesystem", None)
+            .unwrap();
+        let (_, fs) = pool.get_filesystem_by_uuid(fs_uuid).unwrap();
+        assert_eq!(fs.used_age(), None);
+        let used = fs.used().unwrap();
+
+        let readings = pool.read_usage();
+        pool.set_usage(readings).unwrap();
+        assert!(pool.usage_age().is_some());
+        let (_, fs) = pool.get_filesystem_by_uuid(fs_uuid).unwrap();
+        assert!(fs.used_age().is_some());
+        assert_eq!(fs.used().unwrap(), used);
+    }
+
+    #[test]
+    fn loop_test_usage_cache() {
+        loopbacked::test_with_spec(
+            &loopbacked::DeviceLimits::Range(1, 3, None),
+            test_usage_cache,
+        );
+    }
+
+    #[test]
+    fn real_test_usage_cache() {
+        real::test_with_spec(
+            &real::DeviceLimits::AtLeast(1, None, None),
+            test_usage_cache,
+        );
+    }
+
+    /// Verify that several filesystems can be created at once, that each is
+    /// given an XFS filesystem with its own UUID, and that all are recorded
+    /// in the MDV.
+    fn test_create_filesystems(paths: &[&Path]) {
+        let pool_name = "pool";
+        let pool_uuid = PoolUuid::new_v4();
+        let mut backstore = Backstore::initialize(
+            pool_uuid,
+            paths,
+            MDADataSize::default(),
+            &EncryptionInfo::default(),
+        )
+        .unwrap();
+        let mut pool = ThinPool::new(
+            pool_uuid,
+            &ThinPoolSizeParams::default(),
+            DATA_BLOCK_SIZE,
+            &mut backstore,
+        )
+        .unwrap();
+
+        let names = (0..10).map(|i| format!("fs{}", i)).collect::<Vec<_>>();
+        let specs = names
+            .iter()
+            .map(|name| (name.as_str(), None))
+            .collect::<Vec<_>>();
+        let created = pool
+            .create_filesystems(pool_name, pool_uuid, &specs)
+            .unwrap();
+        assert_eq!(
+            created.iter().map(|(name, _)| *name).collect::<Vec<_>>(),
+            specs.iter().map(|(name, _)| *name).collect::<Vec<_>>()
+        );
+
+        let saved = pool
+            .mdv
+            .filesystems()
+            .into_iter()
+            .map(|fssave| fssave.uuid)
+            .collect::<HashSet<_>>();
+        assert_eq!(saved.len(), names.len());
+
+        cmd::udev_settle().unwrap();
+
+        for (name, fs_uuid) in created {
+            assert!(saved.contains(&fs_uuid));
+            assert!(Path::new(&format!("/dev/stratis/{}/{}", pool_name, name)).exists());
+
+            let tmp_dir = tempfile::Builder::new()
+                .prefix("stratis_testing")
+                .tempdir()
+                .unwrap();
+            let (_, fs) = pool.get_filesystem_by_uuid(fs_uuid).unwrap();
+            mount(
+                Some(&fs.devnode()),
+                tmp_dir.path(),
+                Some("xfs"),
+                MsFlags::empty(),
+                None as Option<&str>,
+            )
+            .unwrap();
+            umount(tmp_dir.path()).unwrap();
+        }
+    }
+
+    #[test]
+    fn loop_test_create_filesystems() {
+        loopbacked::test_with_spec(
+            &loopbacked::DeviceLimits::Range(2, 3, None),
+            test_create_filesystems,
+        );
+    }
+
+    #[test]
+    fn real_test_create_filesystems() {
+        real::test_with_spec(
+            &real::DeviceLimits::AtLeast(2, None, None),
+            test_create_filesystems,
+        );
+    }
+
+    /// Verify that several filesystems, one of them mounted, can be
+    /// snapshotted at once, that each snapshot gets its own UUID, and that
+    /// the snapshots are recorded in the MDV. Verify that a request naming
+    /// a nonexistent origin creates no snapshots at all.
+    fn test_filesystem_snapshots(paths: &[&Path]) {
+        let pool_name = "pool";
+        let pool_uuid = PoolUuid::new_v4();
+        let mut backstore = Backstore::initialize(
+            pool_uuid,
+            paths,
+            MDADataSize::default(),
+            &EncryptionInfo::default(),
+        )
+        .unwrap();
+        let mut pool = ThinPool::new(
+            pool_uuid,
+            &ThinPoolSizeParams::default(),
+            DATA_BLOCK_SIZE,
+            &mut backstore,
+        )
+        .unwrap();
+
+        let origins = (0..3)
+            .map(|i| {
+                pool.create_filesystem(pool_name, pool_uuid, &format!("origin{}", i), None)
+                    .unwrap()
+            })
+            .collect::<Vec<_>>();
+
+        pool.extend_thin_data_device(
+            pool_uuid,
+            &mut backstore,
+            datablocks_to_sectors(INITIAL_DATA_SIZE),
+        )
+        .unwrap();
+
+        let tmp_dir = tempfile::Builder::new()
+            .prefix("stratis_testing")
+            .tempdir()
+            .unwrap();
+        mount(
+            Some(&pool.get_filesystem_by_uuid(origins[0]).unwrap().1.devnode()),
+            tmp_dir.path(),
+            Some("xfs"),
+            MsFlags::empty(),
+            None as Option<&str>,
+        )
+        .unwrap();
+
+        assert!(pool
+            .snapshot_filesystems(
+                pool_name,
+                pool_uuid,
+                &[
+                    (origins[1], "bad_snapshot"),
+                    (FilesystemUuid::new_v4(), "x")
+                ],
+            )
+            .is_err());
+        assert!(pool.get_filesystem_by_name("bad_snapshot").is_none());
+
+        let names = ["snapshot0", "snapshot1", "snapshot2"];
+        let specs = origins
+            .iter()
+            .cloned()
+            .zip(names.iter().cloned())
+            .collect::<Vec<_>>();
+        let created = pool
+            .snapshot_filesystems(pool_name, pool_uuid, &specs)
+            .unwrap();
+        assert_eq!(
+            created.iter().map(|(name, _)| *name).collect::<Vec<_>>(),
+            names.to_vec()
+        );
+
+        cmd::udev_settle().unwrap();
+
+        for (name, _) in created.iter() {
+            assert!(Path::new(&format!("/dev/stratis/{}/{}", pool_name, name)).exists());
+        }
+
+        let saved = pool
+            .mdv
+            .filesystems()
+            .into_iter()
+            .map(|fssave| fssave.uuid)
+            .collect::<HashSet<_>>();
+        assert_eq!(saved.len(), origins.len() + names.len());
+        assert!(created.iter().all(|(_, uuid)| saved.contains(uuid)));
+
+        // The mounted origin's snapshot has a UUID of its own, so it can be
+        // mounted alongside the origin without the "nouuid" option.
+        let snapshot_tmp_dir = tempfile::Builder::new()
+            .prefix("stratis_testing")
+            .tempdir()
+            .unwrap();
+        mount(
+            Some(
+                &pool
+                    .get_filesystem_by_uuid(created[0].1)
+                    .unwrap()
+                    .1
+                    .devnode(),
+            ),
+            snapshot_tmp_dir.path(),
+            Some("xfs"),
+            MsFlags::empty(),
+            None as Option<&str>,
+        )
+        .unwrap();
+    }
+
+    #[test]
+    fn loop_test_filesystem_snapshots() {
+        loopbacked::test_with_spec(
+            &loopbacked::DeviceLimits::Range(2, 3, None),
+            test_filesystem_snapshots,
+        );
+    }
+
+    #[test]
+    fn real_test_filesystem_snapshots() {
+        real::test_with_spec(
+            &real::DeviceLimits::AtLeast(2, None, None),
+            test_filesystem_snapshots,
+        );
+    }
+
     /// Verify that a filesystem rename causes the filesystem metadata to be
     /// updated.
     fn test_filesystem_rename(paths: &[&Path]) {
@@ -1578,8 +2314,15 @@ mod tests {
 
         retry_operation!(pool.teardown());
 
-        let pool =
-            ThinPool::setup(pool_name, pool_uuid, &thinpoolsave, &flexdevs, &backstore).unwrap();
+        let pool = ThinPool::setup(
+            pool_name,
+            pool_uuid,
+            &thinpoolsave,
+            &flexdevs,
+            &backstore,
+            ThinCheckPolicy::default(),
+        )
+        .unwrap();
 
         assert_eq!(&*pool.get_filesystem_by_uuid(fs_uuid).unwrap().0, name2);
     }
@@ -1660,6 +2403,7 @@ mod tests {
             &thinpooldevsave,
             &pool.record(),
             &backstore,
+            ThinCheckPolicy::default(),
         )
         .unwrap();
 
@@ -1719,12 +2463,124 @@ mod tests {
             &thinpooldevsave,
             &flexdevs,
             &backstore,
+            ThinCheckPolicy::default(),
         )
         .unwrap();
 
         assert_matches!(pool.get_filesystem_by_uuid(fs_uuid), None);
     }
 
+    /// Verify that the superblock recorded by the full thin_check at setup
+    /// allows a later setup to skip thin_check, even though writing to a
+    /// filesystem in between has committed further metadata transactions.
+    fn test_setup_after_teardown(paths: &[&Path]) {
+        let pool_name = "pool";
+        let pool_uuid = PoolUuid::new_v4();
+        let mut backstore = Backstore::initialize(
+            pool_uuid,
+            paths,
+            MDADataSize::default(),
+            &EncryptionInfo::default(),
+        )
+        .unwrap();
+        let mut pool = ThinPool::new(
+            pool_uuid,
+            &ThinPoolSizeParams::default(),
+            DATA_BLOCK_SIZE,
+            &mut backstore,
+        )
+        .unwrap();
+
+        let fs_uuid = pool
+            .create_filesystem(pool_name, pool_uuid, "fsname", None)
+            .unwrap();
+
+        let flexdevs: FlexDevsSave = pool.record();
+        pool.teardown().unwrap();
+        let thinpooldevsave: ThinPoolDevSave = pool.record();
+        assert_eq!(thinpooldevsave.checked_superblock, None);
+
+        let mut pool = ThinPool::setup(
+            pool_name,
+            pool_uuid,
+            &thinpooldevsave,
+            &flexdevs,
+            &backstore,
+            ThinCheckPolicy::Skip,
+        )
+        .unwrap();
+        let checked_superblock = pool.checked_superblock();
+        assert!(checked_superblock.is_some());
+
+        let tmp_dir = tempfile::Builder::new()
+            .prefix("stratis_testing")
+            .tempdir()
+            .unwrap();
+        {
+            let (_, fs) = pool.get_filesystem_by_uuid(fs_uuid).unwrap();
+            mount(
+                Some(&fs.devnode()),
+                tmp_dir.path(),
+                Some("xfs"),
+                MsFlags::empty(),
+                None as Option<&str>,
+            )
+            .unwrap();
+            writeln!(
+                &OpenOptions::new()
+                    .create(true)
+                    .write(true)
+                    .open(tmp_dir.path().join("stratis_test.txt"))
+                    .unwrap(),
+                "data"
+            )
+            .unwrap();
+            umount(tmp_dir.path()).unwrap();
+        }
+
+        let flexdevs: FlexDevsSave = pool.record();
+        pool.teardown().unwrap();
+        let thinpooldevsave: ThinPoolDevSave = pool.record();
+
+        let thin_check_runs = cmd::child_process_runs("thin_check");
+        let mut pool = ThinPool::setup(
+            pool_name,
+            pool_uuid,
+            &thinpooldevsave,
+            &flexdevs,
+            &backstore,
+            ThinCheckPolicy::Skip,
+        )
+        .unwrap();
+        assert_eq!(cmd::child_process_runs("thin_check"), thin_check_runs);
+        assert_eq!(
+            pool.checked_superblock(),
+            checked_superblock.map(|checked| CheckedSuperblockSave {
+                short_checks: 1,
+                ..checked
+            })
+        );
+        assert!(pool.get_filesystem_by_uuid(fs_uuid).is_some());
+
+        pool.teardown().unwrap();
+    }
+
+    #[test]
+    fn loop_test_setup_after_teardown() {
+        loopbacked::test_with_spec(
+            &loopbacked::DeviceLimits::Range(1, 3, None),
+            test_setup_after_teardown,
+        );
+    }
+
+    #[test]
+    fn real_test_setup_after_teardown() {
+        real::test_with_spec(
+            &real::DeviceLimits::AtLeast(1, None, None),
+            test_setup_after_teardown,
+        );
+    }
+
     #[test]
     fn loop_test_thindev_destroy() {
         // This test requires more than 1 GiB.
@@ -1821,8 +2677,15 @@ mod tests {
         let flexdevs: FlexDevsSave = pool.record();
         let thinpoolsave: ThinPoolDevSave = pool.record();
         pool.teardown().unwrap();
-        let mut pool =
-            ThinPool::setup(pool_name, pool_uuid, &thinpoolsave, &flexdevs, &backstore).unwrap();
+        let mut pool = ThinPool::setup(
+            pool_name,
+            pool_uuid,
+            &thinpoolsave,
+            &flexdevs,
+            &backstore,
+            ThinCheckPolicy::default(),
+        )
+        .unwrap();
         let filesystem = pool.get_mut_filesystem_by_uuid(fs_uuid).unwrap().1;
         let thindev_size = filesystem.thindev_size();
         assert!(thindev_size > start_thindev_size)
@@ -1946,7 +2809,7 @@ mod tests {
                 .write_all(bytestring)
                 .unwrap();
         }
-        let filesystem_saves = pool.mdv.filesystems().unwrap();
+        let filesystem_saves = pool.mdv.filesystems();
         assert_eq!(filesystem_saves.len(), 1);
         assert_eq!(
             filesystem_saves
@@ -1960,7 +2823,9 @@ mod tests {
         let old_device = backstore
             .device()
             .expect("Space already allocated from backstore, backstore must have device");
-        backstore.init_cache(pool_uuid, paths1).unwrap();
+        backstore
+            .init_cache(pool_uuid, paths1, CacheSettings::default())
+            .unwrap();
         let new_device = backstore
             .device()
             .expect("Space already allocated from backstore, backstore must have device");
@@ -1979,7 +2844,7 @@ mod tests {
         }
         assert_eq!(&buf, bytestring);
 
-        let filesystem_saves = pool.mdv.filesystems().unwrap();
+        let filesystem_saves = pool.mdv.filesystems();
         assert_eq!(filesystem_saves.len(), 1);
         assert_eq!(
             filesystem_saves
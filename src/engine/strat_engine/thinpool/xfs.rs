@@ -0,0 +1,117 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+// Operations on mounted XFS filesystems that are performed through ioctls
+// rather than by running the XFS utilities.
+
+use std::{convert::TryFrom, fs::File, os::unix::io::AsRawFd, path::Path};
+
+use devicemapper::Sectors;
+
+use crate::stratis::{StratisError, StratisResult};
+
+/// The version 1 filesystem geometry structure, struct xfs_fsop_geom_v1 in
+/// the XFS headers. It is supported by every XFS filesystem and it contains
+/// all the information required to grow the data section. Only the fields
+/// that are used are named; the others are kept as reserved space so that
+/// the size and layout match the kernel's.
+#[repr(C)]
+#[derive(Debug, Default)]
+struct XfsFsopGeomV1 {
+    blocksize: u32,
+    // rtextsize, agblocks, agcount, logblocks, sectsize, inodesize
+    _reserved0: [u32; 6],
+    imaxpct: u32,
+    datablocks: u64,
+    // rtblocks, rtextents, logstart, uuid, sunit, swidth, version, flags,
+    // logsectsize, rtsectsize, dirblocksize
+    _reserved1: [u32; 17],
+}
+
+/// The argument of the XFS_IOC_FSGROWFSDATA ioctl, struct xfs_growfs_data in
+/// the XFS headers.
+#[repr(C)]
+#[derive(Debug)]
+struct XfsGrowfsData {
+    newblocks: u64,
+    imaxpct: u32,
+}
+
+ioctl_read!(
+    /// # Safety
+    ///
+    /// This function is a wrapper for `libc::ioctl` and therefore is unsafe for the same reasons
+    /// as other libc bindings. It accepts a file descriptor and mutable pointer so the semantics
+    /// of the invoked `ioctl` command should be examined to determine the effect it will have
+    /// on the resources passed to the command.
+    xfs_fsgeometry_v1,
+    b'X',
+    100,
+    XfsFsopGeomV1
+);
+
+ioctl_write_ptr!(
+    /// # Safety
+    ///
+    /// This function is a wrapper for `libc::ioctl` and therefore is unsafe for the same reasons
+    /// as other libc bindings. It accepts a file descriptor and a pointer so the semantics
+    /// of the invoked `ioctl` command should be examined to determine the effect it will have
+    /// on the resources passed to the command.
+    xfs_fsgrowfsdata,
+    b'X',
+    110,
+    XfsGrowfsData
+);
+
+/// Grow the data section of the XFS filesystem mounted at mount_point to
+/// fill device_size, the size of the device that it is on. This is what
+/// "xfs_growfs -d" does, without running a separate process. Returns true
+/// if the filesystem was grown, false if it already filled the device.
+pub fn xfs_grow_data(mount_point: &Path, device_size: Sectors) -> StratisResult<bool> {
+    let dir = File::open(mount_point)?;
+
+    let mut geometry = XfsFsopGeomV1::default();
+    unsafe { xfs_fsgeometry_v1(dir.as_raw_fd(), &mut geometry) }.map_err(StratisError::Nix)?;
+    if geometry.blocksize == 0 {
+        return Err(StratisError::Msg(format!(
+            "XFS filesystem mounted at {} reported a block size of 0",
+            mount_point.display()
+        )));
+    }
+
+    let newblocks = u64::try_from(
+        u128::from(*device_size.bytes()) / u128::from(geometry.blocksize),
+    )
+    .map_err(|_| {
+        StratisError::Msg(format!(
+            "Size {} is too large for XFS filesystem mounted at {}",
+            device_size,
+            mount_point.display()
+        ))
+    })?;
+    if newblocks <= geometry.datablocks {
+        return Ok(false);
+    }
+
+    let growfs_data = XfsGrowfsData {
+        newblocks,
+        imaxpct: geometry.imaxpct,
+    };
+    unsafe { xfs_fsgrowfsdata(dir.as_raw_fd(), &growfs_data) }.map_err(StratisError::Nix)?;
+    Ok(true)
+}
+
+#[cfg(test)]
+mod tests {
+    use std::mem::size_of;
+
+    use super::*;
+
+    #[test]
+    /// Verify that the geometry structure has the size of
+    /// struct xfs_fsop_geom_v1, which is encoded in the ioctl number.
+    fn test_geometry_size() {
+        assert_eq!(size_of::<XfsFsopGeomV1>(), 112);
+    }
+}
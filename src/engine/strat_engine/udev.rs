@@ -3,7 +3,14 @@
 // file, You can obtain one at http://mozilla.org/MPL/2.0/.
 
 //! udev-related methods
-use std::{ffi::OsStr, fmt, path::Path};
+use std::{
+    ffi::OsStr,
+    fmt, io,
+    os::unix::fs::{FileTypeExt, MetadataExt},
+    path::{Path, PathBuf},
+};
+
+use devicemapper::Device;
 
 use crate::{
     engine::types::UdevEngineDevice,
@@ -158,22 +165,34 @@ pub fn decide_ownership(device: &UdevEngineDevice) -> StratisResult<UdevOwnershi
 /// Locate a udev block device with the specified devnode and apply a function
 /// to that device, returning the result.
 /// This approach is necessitated by the libudev lifetimes, which do not allow
-/// returning anything directly obtained from the enumerator value created in
+/// returning anything directly obtained from the udev context created in
 /// the method itself.
-/// Note that this does require iterating through the blockdevs in the udev
-/// database, so it is essentially linear in the number of block devices.
+/// The device is looked up directly by its device number, rather than by
+/// iterating through all the block devices in the udev database. Returns
+/// None if devnode is not a block device or it is not yet initialized by udev.
 pub fn block_device_apply<F, U>(devnode: &Path, f: F) -> StratisResult<Option<U>>
 where
     F: FnOnce(&UdevEngineDevice) -> U,
 {
     let canonical = devnode.canonicalize()?;
+    let metadata = canonical.metadata()?;
+    if !metadata.file_type().is_block_device() {
+        return Ok(None);
+    }
+    let device = Device::from(metadata.rdev());
 
-    let context = libudev::Context::new()?;
-    let mut enumerator = block_enumerator(&context)?;
+    let syspath = PathBuf::from(format!("/sys/dev/block/{}:{}", device.major, device.minor));
+    let syspath = match syspath.canonicalize() {
+        Ok(syspath) => syspath,
+        Err(ref err) if err.kind() == io::ErrorKind::NotFound => return Ok(None),
+        Err(err) => return Err(err.into()),
+    };
 
-    Ok(enumerator
-        .scan_devices()?
-        .filter(|dev| dev.is_initialized())
-        .find(|x| x.devnode().map_or(false, |d| canonical == d))
-        .map(|ref d| f(&UdevEngineDevice::from(d))))
+    let context = libudev::Context::new()?;
+    let dev = context.device_from_syspath(&syspath)?;
+    if dev.is_initialized() && dev.devnode().map_or(false, |d| canonical == d) {
+        Ok(Some(f(&UdevEngineDevice::from(&dev))))
+    } else {
+        Ok(None)
+    }
 }
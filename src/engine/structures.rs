@@ -9,14 +9,16 @@ use std::{
     iter::IntoIterator,
     ops::{Deref, DerefMut},
     sync::Arc,
+    time::Instant,
 };
 
 use futures::executor::block_on;
-use tokio::sync::{Mutex, MutexGuard, RwLock, RwLockReadGuard, RwLockWriteGuard};
+use tokio::sync::{RwLock, RwLockReadGuard, RwLockWriteGuard};
 
 use crate::engine::{
-    engine::Engine,
-    types::{AsUuid, Name},
+    engine::{Engine, Pool},
+    metrics::{AtomicSpan, LockHistograms, ENGINE_LOCK, POOL_LOCK},
+    types::{AsUuid, Name, PoolGuard, PoolMutGuard},
 };
 
 /// Map UUID and name to T items.
@@ -299,7 +301,9 @@ where
     }
 }
 
-pub struct SharedGuard<G>(G);
+/// A shared lock, which records the time for which it is held when it is
+/// dropped.
+pub struct SharedGuard<G>(G, AtomicSpan);
 
 impl<T, G> Deref for SharedGuard<G>
 where
@@ -319,7 +323,9 @@ impl<G> Drop for SharedGuard<G> {
     }
 }
 
-pub struct ExclusiveGuard<G>(G);
+/// An exclusive lock, which records the time for which it is held when it
+/// is dropped.
+pub struct ExclusiveGuard<G>(G, AtomicSpan);
 
 impl<T, G> Deref for ExclusiveGuard<G>
 where
@@ -348,36 +354,51 @@ impl<G> Drop for ExclusiveGuard<G> {
     }
 }
 
-pub struct Lockable<T>(T);
+/// A reader/writer lock shared between the threads of the daemon.
+///
+/// Lock ordering: a thread which needs both the D-Bus tree lock and the
+/// engine lock must acquire the tree lock first, and must not try to acquire
+/// the tree lock while it holds the engine lock. D-Bus method handlers hold
+/// the tree lock only to take a reference to the current tree, and take the
+/// engine lock inside the handler, once the tree lock is released. Changes
+/// to the tree made while the engine lock is held are queued and applied
+/// later by the tree handler, which holds no engine lock.
+///
+/// A shared (read) lock must never be upgraded to an exclusive (write) lock
+/// while it is held; drop the shared guard and acquire the exclusive lock
+/// instead, since two readers waiting to upgrade would deadlock. The locks are
+/// fair, so a held shared lock blocks a waiting writer, and a waiting writer
+/// blocks new readers.
+///
+/// Each pool has a lock of its own, which is acquired only while the engine
+/// lock is held, so that an exclusive engine lock excludes every pool lock.
+/// An operation which changes a single pool may take a shared engine lock
+/// and an exclusive lock on the pool, so that other pools remain available
+/// while it runs; operations which change the set of pools take an
+/// exclusive engine lock. A thread which holds an exclusive pool lock must
+/// not acquire any other pool lock. A thread may hold shared locks on
+/// several pools, acquired in the order in which the engine lists its pools,
+/// but must not lock a pool which it has already locked.
+///
+/// The time spent waiting for and holding the lock is recorded in its
+/// LockHistograms.
+pub struct Lockable<T>(T, &'static LockHistograms);
 
-impl<T> Lockable<Arc<Mutex<T>>>
+impl<T> Lockable<Arc<RwLock<T>>>
 where
     T: 'static + Engine,
 {
-    pub fn new_exclusive(t: T) -> Lockable<Arc<Mutex<dyn Engine>>> {
-        Lockable(Arc::new(Mutex::new(t)) as Arc<Mutex<dyn Engine>>)
+    pub fn new_engine(t: T) -> Lockable<Arc<RwLock<dyn Engine>>> {
+        Lockable(
+            Arc::new(RwLock::new(t)) as Arc<RwLock<dyn Engine>>,
+            &ENGINE_LOCK,
+        )
     }
 }
 
 impl<T> Lockable<Arc<RwLock<T>>> {
-    pub fn new_shared(t: T) -> Self {
-        Lockable(Arc::new(RwLock::new(t)))
-    }
-}
-
-impl<T> Lockable<Arc<Mutex<T>>>
-where
-    T: ?Sized,
-{
-    pub async fn lock(&self) -> ExclusiveGuard<MutexGuard<'_, T>> {
-        trace!("Acquiring exclusive lock on {}", type_name::<Self>());
-        let lock = ExclusiveGuard(self.0.lock().await);
-        trace!("Acquired exclusive lock on {}", type_name::<Self>());
-        lock
-    }
-
-    pub fn blocking_lock(&self) -> ExclusiveGuard<MutexGuard<'_, T>> {
-        block_on(self.lock())
+    pub fn new_shared(histograms: &'static LockHistograms, t: T) -> Self {
+        Lockable(Arc::new(RwLock::new(t)), histograms)
     }
 }
 
@@ -386,10 +407,7 @@ where
     T: ?Sized,
 {
     pub async fn read(&self) -> SharedGuard<RwLockReadGuard<'_, T>> {
-        trace!("Acquiring shared lock on {}", type_name::<Self>());
-        let lock = SharedGuard(self.0.read().await);
-        trace!("Acquired shared lock on {}", type_name::<Self>());
-        lock
+        acquire_shared(&self.0, self.1).await
     }
 
     pub fn blocking_read(&self) -> SharedGuard<RwLockReadGuard<'_, T>> {
@@ -397,10 +415,7 @@ where
     }
 
     pub async fn write(&self) -> ExclusiveGuard<RwLockWriteGuard<'_, T>> {
-        trace!("Acquiring exclusive lock on {}", type_name::<Self>());
-        let lock = ExclusiveGuard(self.0.write().await);
-        trace!("Acquired exclusive lock on {}", type_name::<Self>());
-        lock
+        acquire_exclusive(&self.0, self.1).await
     }
 
     pub fn blocking_write(&self) -> ExclusiveGuard<RwLockWriteGuard<'_, T>> {
@@ -408,19 +423,89 @@ where
     }
 }
 
+impl<'a, T> Lockable<&'a RwLock<T>>
+where
+    T: ?Sized,
+{
+    /// The lock of a pool, which belongs to an engine that is locked.
+    pub fn new_pool(lock: &'a RwLock<T>) -> Self {
+        Lockable(lock, &POOL_LOCK)
+    }
+
+    pub fn blocking_read(self) -> SharedGuard<RwLockReadGuard<'a, T>> {
+        block_on(acquire_shared(self.0, self.1))
+    }
+
+    pub fn blocking_write(self) -> ExclusiveGuard<RwLockWriteGuard<'a, T>> {
+        block_on(acquire_exclusive(self.0, self.1))
+    }
+}
+
+/// Acquire lock shared, recording the time spent waiting for it and holding
+/// it in histograms.
+async fn acquire_shared<'a, T>(
+    lock: &'a RwLock<T>,
+    histograms: &'static LockHistograms,
+) -> SharedGuard<RwLockReadGuard<'a, T>>
+where
+    T: ?Sized,
+{
+    trace!("Acquiring shared lock on {}", type_name::<T>());
+    let start = Instant::now();
+    let guard = lock.read().await;
+    histograms.shared_wait.record(start.elapsed());
+    let lock = SharedGuard(guard, AtomicSpan::new(&histograms.shared_hold));
+    trace!("Acquired shared lock on {}", type_name::<T>());
+    lock
+}
+
+/// Acquire lock exclusively, recording the time spent waiting for it and
+/// holding it in histograms.
+async fn acquire_exclusive<'a, T>(
+    lock: &'a RwLock<T>,
+    histograms: &'static LockHistograms,
+) -> ExclusiveGuard<RwLockWriteGuard<'a, T>>
+where
+    T: ?Sized,
+{
+    trace!("Acquiring exclusive lock on {}", type_name::<T>());
+    let start = Instant::now();
+    let guard = lock.write().await;
+    histograms.exclusive_wait.record(start.elapsed());
+    let lock = ExclusiveGuard(guard, AtomicSpan::new(&histograms.exclusive_hold));
+    trace!("Acquired exclusive lock on {}", type_name::<T>());
+    lock
+}
+
+/// Lock pool, which belongs to an engine that is locked, for reading.
+pub fn read_pool<P>(pool: &RwLock<P>) -> PoolGuard<'_>
+where
+    P: 'static + Pool,
+{
+    Lockable::new_pool(pool as &RwLock<dyn Pool>).blocking_read()
+}
+
+/// Lock pool, which belongs to an engine that is locked, for writing.
+pub fn write_pool<P>(pool: &RwLock<P>) -> PoolMutGuard<'_>
+where
+    P: 'static + Pool,
+{
+    Lockable::new_pool(pool as &RwLock<dyn Pool>).blocking_write()
+}
+
 impl<T> Clone for Lockable<Arc<T>>
 where
     T: ?Sized,
 {
     fn clone(&self) -> Self {
-        Lockable(Arc::clone(&self.0))
+        Lockable(Arc::clone(&self.0), self.1)
     }
 }
 
 #[cfg(test)]
 mod tests {
 
-    use crate::engine::{types::PoolUuid, Name};
+    use crate::engine::{types::PoolUuid, Name, SimEngine};
 
     use super::*;
 
@@ -685,4 +770,18 @@ mod tests {
         assert_eq!(t.get_by_name(name3).unwrap().1.stuff, thing_key3);
         assert_eq!(t.len(), 1);
     }
+
+    #[test]
+    /// Verify that several shared locks on the engine may be held at once,
+    /// and that an exclusive lock is available once they are released.
+    fn lockable_engine_shared() {
+        let engine = Lockable::new_engine(SimEngine::default());
+        {
+            let first = engine.blocking_read();
+            let second = engine.blocking_read();
+            assert!(first.is_sim() && second.is_sim());
+            assert!(engine.0.try_write().is_err());
+        }
+        assert!(engine.blocking_write().pools_mut().is_empty());
+    }
 }
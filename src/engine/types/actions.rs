@@ -10,9 +10,11 @@
 
 use std::fmt::{self, Display};
 
+use devicemapper::Sectors;
+
 use crate::engine::{
     engine::Filesystem,
-    types::{DevUuid, FilesystemUuid, PoolUuid},
+    types::{AllocPolicy, DevUuid, FilesystemUuid, FsGrowthPolicy, PoolUuid},
 };
 
 /// Return value indicating key operation
@@ -610,3 +612,75 @@ impl Display for RegenAction {
         )
     }
 }
+
+#[derive(Debug, PartialEq, Eq)]
+/// An action which may change the value of a single property.
+pub enum PropChangeAction<T> {
+    /// The property already had the given value.
+    Identity,
+    /// The property was set to the given value.
+    NewValue(T),
+}
+
+impl<T> EngineAction for PropChangeAction<T> {
+    type Return = T;
+
+    fn is_changed(&self) -> bool {
+        matches!(*self, PropChangeAction::NewValue(_))
+    }
+
+    fn changed(self) -> Option<T> {
+        match self {
+            PropChangeAction::NewValue(t) => Some(t),
+            _ => None,
+        }
+    }
+}
+
+impl Display for PropChangeAction<FsGrowthPolicy> {
+    fn fmt(&self, f: &mut fmt::Formatter) -> fmt::Result {
+        match self {
+            PropChangeAction::Identity => {
+                write!(
+                    f,
+                    "Filesystem already has the requested growth policy; no action taken"
+                )
+            }
+            PropChangeAction::NewValue(policy) => {
+                write!(f, "Filesystem growth policy was set to {}", policy)
+            }
+        }
+    }
+}
+
+impl Display for PropChangeAction<AllocPolicy> {
+    fn fmt(&self, f: &mut fmt::Formatter) -> fmt::Result {
+        match self {
+            PropChangeAction::Identity => {
+                write!(
+                    f,
+                    "Pool already has the requested allocation policy; no action taken"
+                )
+            }
+            PropChangeAction::NewValue(policy) => {
+                write!(f, "Pool allocation policy was set to {}", policy)
+            }
+        }
+    }
+}
+
+impl Display for PropChangeAction<Sectors> {
+    fn fmt(&self, f: &mut fmt::Formatter) -> fmt::Result {
+        match self {
+            PropChangeAction::Identity => {
+                write!(
+                    f,
+                    "Cache already has the requested migration threshold; no action taken"
+                )
+            }
+            PropChangeAction::NewValue(threshold) => {
+                write!(f, "Cache migration threshold was set to {}", threshold)
+            }
+        }
+    }
+}
@@ -12,11 +12,13 @@ use std::{
     ops::Deref,
     path::{Path, PathBuf},
     sync::Arc,
+    time::Instant,
 };
 
+use devicemapper::{Bytes, Sectors, ThinPoolStatus, ThinStatus};
 use libudev::EventType;
 use serde::{Deserialize, Serialize};
-use tokio::sync::Mutex;
+use tokio::sync::{RwLock, RwLockReadGuard, RwLockWriteGuard};
 use uuid::Uuid;
 
 pub use crate::engine::{
@@ -25,13 +27,19 @@ pub use crate::engine::{
     types::{
         actions::{
             Clevis, CreateAction, DeleteAction, EngineAction, Key, MappingCreateAction,
-            MappingDeleteAction, RegenAction, RenameAction, SetCreateAction, SetDeleteAction,
-            SetUnlockAction,
+            MappingDeleteAction, PropChangeAction, RegenAction, RenameAction, SetCreateAction,
+            SetDeleteAction, SetUnlockAction,
         },
         keys::{EncryptionInfo, KeyDescription, SizedKeyMemory},
     },
 };
-use crate::stratis::{StratisError, StratisResult};
+use crate::{
+    engine::{
+        engine::Pool,
+        structures::{ExclusiveGuard, SharedGuard},
+    },
+    stratis::{StratisError, StratisResult},
+};
 
 mod actions;
 mod keys;
@@ -73,8 +81,19 @@ macro_rules! uuid {
     }
 }
 
-/// An engine that can be locked for synchronization.
-pub type LockableEngine = Lockable<Arc<Mutex<dyn Engine>>>;
+/// An engine that can be locked for synchronization. Operations which only
+/// inspect the engine take a shared lock and may run concurrently; operations
+/// which modify the engine take an exclusive lock. An operation which
+/// modifies a single pool may instead take a shared lock on the engine and
+/// an exclusive lock on the pool. See Lockable for the order in which locks
+/// must be acquired.
+pub type LockableEngine = Lockable<Arc<RwLock<dyn Engine>>>;
+
+/// A pool, locked for reading while the engine that owns it is locked.
+pub type PoolGuard<'a> = SharedGuard<RwLockReadGuard<'a, dyn Pool>>;
+
+/// A pool, locked for writing while the engine that owns it is locked.
+pub type PoolMutGuard<'a> = ExclusiveGuard<RwLockWriteGuard<'a, dyn Pool>>;
 
 pub trait AsUuid:
     Copy
@@ -209,8 +228,17 @@ impl fmt::Display for Name {
 ///
 /// * `ErroredPoolDevices` returns the state of devices that caused an error while
 /// attempting to reconstruct a pool.
+/// * `PoolChecks` returns the depth of the queue of pool checks scheduled in
+/// response to devicemapper events and the latency of the checks run so far.
+/// * `ChildProcesses` returns the number of external commands run for each
+/// operation and the time spent waiting for them.
+/// * `DeviceIdentification` returns the number of block devices whose
+/// identification is cached and the hit and miss counts of the cache.
 pub enum ReportType {
     ErroredPoolDevices,
+    PoolChecks,
+    ChildProcesses,
+    DeviceIdentification,
 }
 
 impl<'a> TryFrom<&'a str> for ReportType {
@@ -219,6 +247,9 @@ impl<'a> TryFrom<&'a str> for ReportType {
     fn try_from(name: &str) -> StratisResult<ReportType> {
         match name {
             "errored_pool_report" => Ok(ReportType::ErroredPoolDevices),
+            "pool_check_report" => Ok(ReportType::PoolChecks),
+            "child_process_report" => Ok(ReportType::ChildProcesses),
+            "device_identification_report" => Ok(ReportType::DeviceIdentification),
             _ => Err(StratisError::Msg(format!(
                 "Report name {} not understood",
                 name
@@ -227,6 +258,290 @@ impl<'a> TryFrom<&'a str> for ReportType {
     }
 }
 
+/// The policy by which the thin device of a filesystem, and the filesystem
+/// on it, are grown when the filesystem runs low on free space.
+///
+/// A policy is written as `double`, `fixed:<bytes>`, `percent:<percent>`, or
+/// `predictive:<seconds>`.
+#[derive(Clone, Copy, Debug, Deserialize, Eq, PartialEq, Serialize)]
+pub enum FsGrowthPolicy {
+    /// Double the size of the thin device.
+    Double,
+    /// Grow the thin device by a fixed amount.
+    Fixed(Sectors),
+    /// Grow the thin device by a percentage of its current size.
+    Percent(u16),
+    /// Grow the thin device by enough to absorb writes for the given number
+    /// of seconds at the rate at which the filesystem has recently been
+    /// filling, and grow it as soon as its free space would be exhausted in
+    /// that time.
+    Predictive(u64),
+}
+
+impl Default for FsGrowthPolicy {
+    fn default() -> FsGrowthPolicy {
+        FsGrowthPolicy::Double
+    }
+}
+
+impl Display for FsGrowthPolicy {
+    fn fmt(&self, f: &mut fmt::Formatter) -> fmt::Result {
+        match self {
+            FsGrowthPolicy::Double => write!(f, "double"),
+            FsGrowthPolicy::Fixed(size) => write!(f, "fixed:{}", *size.bytes()),
+            FsGrowthPolicy::Percent(percent) => write!(f, "percent:{}", percent),
+            FsGrowthPolicy::Predictive(secs) => write!(f, "predictive:{}", secs),
+        }
+    }
+}
+
+impl<'a> TryFrom<&'a str> for FsGrowthPolicy {
+    type Error = StratisError;
+
+    fn try_from(policy: &str) -> StratisResult<FsGrowthPolicy> {
+        let err = || {
+            StratisError::Msg(format!(
+                "Growth policy {} not understood; expected double, fixed:<bytes>, percent:<1-1000> or predictive:<seconds>",
+                policy
+            ))
+        };
+        let mut parts = policy.splitn(2, ':');
+        let kind = parts.next().ok_or_else(err)?;
+        let value = parts.next().map(|v| v.parse::<u64>().map_err(|_| err()));
+        match (kind, value) {
+            ("double", None) => Ok(FsGrowthPolicy::Double),
+            ("fixed", Some(bytes)) => {
+                let size = Bytes::from(bytes?).sectors();
+                if size == Sectors(0) {
+                    return Err(err());
+                }
+                Ok(FsGrowthPolicy::Fixed(size))
+            }
+            ("percent", Some(percent)) => match u16::try_from(percent?) {
+                Ok(percent) if (1..=1000).contains(&percent) => {
+                    Ok(FsGrowthPolicy::Percent(percent))
+                }
+                _ => Err(err()),
+            },
+            ("predictive", Some(secs)) => match secs? {
+                0 => Err(err()),
+                secs => Ok(FsGrowthPolicy::Predictive(secs)),
+            },
+            _ => Err(err()),
+        }
+    }
+}
+
+/// The policy by which space is selected from the block devices of a pool's
+/// data tier when an allocation is requested.
+///
+/// A policy is written as `fill_first`, `spread`, or `largest_free`.
+#[derive(Clone, Copy, Debug, Deserialize, Eq, PartialEq, Serialize)]
+pub enum AllocPolicy {
+    /// Allocate from the block devices in the order in which they were
+    /// added, exhausting each before moving on to the next.
+    FillFirst,
+    /// Divide each request as evenly as possible among all the block devices
+    /// which have some space available.
+    Spread,
+    /// Allocate from the block device with the most space available first.
+    LargestFree,
+}
+
+impl Default for AllocPolicy {
+    fn default() -> AllocPolicy {
+        AllocPolicy::FillFirst
+    }
+}
+
+impl Display for AllocPolicy {
+    fn fmt(&self, f: &mut fmt::Formatter) -> fmt::Result {
+        match self {
+            AllocPolicy::FillFirst => write!(f, "fill_first"),
+            AllocPolicy::Spread => write!(f, "spread"),
+            AllocPolicy::LargestFree => write!(f, "largest_free"),
+        }
+    }
+}
+
+impl<'a> TryFrom<&'a str> for AllocPolicy {
+    type Error = StratisError;
+
+    fn try_from(policy: &str) -> StratisResult<AllocPolicy> {
+        match policy {
+            "fill_first" => Ok(AllocPolicy::FillFirst),
+            "spread" => Ok(AllocPolicy::Spread),
+            "largest_free" => Ok(AllocPolicy::LargestFree),
+            _ => Err(StratisError::Msg(format!(
+                "Allocation policy {} not understood; expected fill_first, spread or largest_free",
+                policy
+            ))),
+        }
+    }
+}
+
+/// The check of a thin pool's metadata that is made when the pool is set up,
+/// if a full thin_check has verified the metadata and the kernel has since
+/// committed further transactions to it without marking it as needing a
+/// check. The kernel does not find every error in the metadata, so anything
+/// other than a full check trades safety for speed, and a full check is
+/// still made periodically. Metadata that has never been verified, or that
+/// has been marked or otherwise changed, always gets a full check.
+#[derive(Clone, Copy, Debug, Eq, PartialEq)]
+pub enum ThinCheckPolicy {
+    /// Run a full thin_check regardless.
+    Full,
+    /// Check only the superblock.
+    Superblock,
+    /// Do not run thin_check.
+    Skip,
+}
+
+impl Default for ThinCheckPolicy {
+    fn default() -> ThinCheckPolicy {
+        ThinCheckPolicy::Full
+    }
+}
+
+impl<'a> TryFrom<&'a str> for ThinCheckPolicy {
+    type Error = StratisError;
+
+    fn try_from(policy: &str) -> StratisResult<ThinCheckPolicy> {
+        match policy {
+            "full" => Ok(ThinCheckPolicy::Full),
+            "superblock" => Ok(ThinCheckPolicy::Superblock),
+            "skip" => Ok(ThinCheckPolicy::Skip),
+            _ => Err(StratisError::Msg(format!(
+                "thin_check policy {} not understood; expected full, superblock or skip",
+                policy
+            ))),
+        }
+    }
+}
+
+/// The default size of a cache block; the kernel docs indicate that this is
+/// the largest typical size.
+pub const DEFAULT_CACHE_BLOCK_SIZE: Sectors = Sectors(2048); // 1024 KiB
+
+// The kernel requires the cache block size to be a multiple of 32 KiB and
+// no larger than 1 GiB.
+const CACHE_BLOCK_SIZE_GRANULARITY: Sectors = Sectors(64);
+const MAX_CACHE_BLOCK_SIZE: Sectors = Sectors(2 * 1024 * 1024);
+
+// devicemapper's CacheDev always builds its table with the default cache
+// policy, which is smq, in writethrough mode, and neither can be changed by
+// a message to the running cache.
+const CACHE_POLICY: &str = "smq";
+const CACHE_MODE: &str = "writethrough";
+
+/// The settings of the dm-cache device which caches the data tier of a pool.
+#[derive(Clone, Copy, Debug, Eq, PartialEq)]
+pub struct CacheSettings {
+    /// The size of a cache block. It is fixed when the cache is initialized.
+    pub block_size: Sectors,
+    /// The maximum amount of data that the cache policy may be migrating
+    /// between the cache and the origin at any one time. If None, the
+    /// kernel default is used. It may be changed while the cache is in use.
+    pub migration_threshold: Option<Sectors>,
+}
+
+impl Default for CacheSettings {
+    fn default() -> CacheSettings {
+        CacheSettings {
+            block_size: DEFAULT_CACHE_BLOCK_SIZE,
+            migration_threshold: None,
+        }
+    }
+}
+
+impl CacheSettings {
+    /// Return an error if the kernel would not accept these settings.
+    pub fn validate(&self) -> StratisResult<()> {
+        if self.block_size == Sectors(0)
+            || self.block_size > MAX_CACHE_BLOCK_SIZE
+            || *self.block_size % *CACHE_BLOCK_SIZE_GRANULARITY != 0
+        {
+            return Err(StratisError::Msg(format!(
+                "Cache block size {} is invalid; it must be a multiple of {} no greater than {}",
+                self.block_size, CACHE_BLOCK_SIZE_GRANULARITY, MAX_CACHE_BLOCK_SIZE
+            )));
+        }
+        if let Some(threshold) = self.migration_threshold {
+            // A threshold smaller than a block would prevent every migration.
+            if threshold < self.block_size {
+                return Err(StratisError::Msg(format!(
+                    "Cache migration threshold {} is less than the cache block size {}",
+                    threshold, self.block_size
+                )));
+            }
+        }
+        Ok(())
+    }
+
+    /// Return an error if a cache policy or write mode is requested other
+    /// than the ones every cache is set up with, which are smq and
+    /// writethrough.
+    pub fn check_policy_and_mode(policy: Option<&str>, mode: Option<&str>) -> StratisResult<()> {
+        if let Some(policy) = policy {
+            if policy != CACHE_POLICY {
+                return Err(StratisError::Msg(format!(
+                    "Cache policy {} is not supported; only {} is",
+                    policy, CACHE_POLICY
+                )));
+            }
+        }
+        if let Some(mode) = mode {
+            if mode != CACHE_MODE {
+                return Err(StratisError::Msg(format!(
+                    "Cache mode {} is not supported; only {} is",
+                    mode, CACHE_MODE
+                )));
+            }
+        }
+        Ok(())
+    }
+}
+
+/// The statistics reported by the dm-cache device of a pool, as counted by
+/// the kernel since the device was set up.
+#[derive(Clone, Debug, Eq, PartialEq)]
+pub struct CacheStats {
+    pub read_hits: u64,
+    pub read_misses: u64,
+    pub write_hits: u64,
+    pub write_misses: u64,
+    pub promotions: u64,
+    pub demotions: u64,
+    /// The number of cache blocks which have not yet been written back to
+    /// the origin.
+    pub dirty: u64,
+    /// The number of cache blocks in use and the total number of them.
+    pub used_blocks: u64,
+    pub total_blocks: u64,
+    /// The name of the cache policy in effect.
+    pub policy: String,
+    /// The write mode in effect: writethrough, writeback or passthrough.
+    pub write_mode: String,
+}
+
+/// The status of the devices of every pool that an engine manages, read by
+/// Engine::read_usage() while the engine is shared with readers, from which
+/// Engine::set_usage() then updates the cached usage.
+#[derive(Debug, Default)]
+pub struct UsageReadings {
+    pub pools: HashMap<PoolUuid, PoolUsageReadings>,
+}
+
+/// The status of the thin pool of a pool and of the thin device of each of
+/// its filesystems.
+#[derive(Debug)]
+pub struct PoolUsageReadings {
+    pub thin_pool: StratisResult<ThinPoolStatus>,
+    pub filesystems: HashMap<FilesystemUuid, StratisResult<ThinStatus>>,
+    // When the status of the thin pool was read
+    pub read_at: Instant,
+}
+
 pub struct LockedPoolDevice {
     pub devnode: PathBuf,
     pub uuid: DevUuid,
@@ -254,6 +569,13 @@ impl UdevEngineEvent {
     }
 }
 
+#[cfg(test)]
+impl UdevEngineEvent {
+    pub fn new(event_type: EventType, device: UdevEngineDevice) -> UdevEngineEvent {
+        UdevEngineEvent { event_type, device }
+    }
+}
+
 impl<'a> From<&'a libudev::Event<'a>> for UdevEngineEvent {
     fn from(e: &'a libudev::Event<'a>) -> UdevEngineEvent {
         UdevEngineEvent {
@@ -295,6 +617,23 @@ impl UdevEngineDevice {
     }
 }
 
+#[cfg(test)]
+impl UdevEngineDevice {
+    pub fn new(
+        is_initialized: bool,
+        devnode: Option<PathBuf>,
+        devnum: Option<libc::dev_t>,
+        properties: HashMap<Box<OsStr>, Box<OsStr>>,
+    ) -> UdevEngineDevice {
+        UdevEngineDevice {
+            is_initialized,
+            devnode,
+            devnum,
+            properties,
+        }
+    }
+}
+
 impl<'a> From<&'a libudev::Device<'a>> for UdevEngineDevice {
     fn from(d: &'a libudev::Device<'a>) -> UdevEngineDevice {
         UdevEngineDevice {
@@ -3,7 +3,7 @@
 // file, You can obtain one at http://mozilla.org/MPL/2.0/.
 
 use std::{
-    io::Read,
+    io::{BufRead, BufReader},
     os::unix::{
         io::{AsRawFd, RawFd},
         net::UnixStream,
@@ -17,10 +17,16 @@ use nix::sys::{
 };
 
 use crate::{
-    jsonrpc::interface::{StratisParams, StratisRet},
-    stratis::StratisResult,
+    jsonrpc::interface::{StratisParamType, StratisParams, StratisRet},
+    stratis::{StratisError, StratisResult},
 };
 
+fn encode_request(type_: &StratisParamType) -> StratisResult<Vec<u8>> {
+    let mut vec = serde_json::to_vec(type_)?;
+    vec.push(b'\n');
+    Ok(vec)
+}
+
 fn send_request(unix_fd: RawFd, vec: Vec<u8>, fd_opt: Option<RawFd>) -> StratisResult<()> {
     let fd_vec: Vec<_> = fd_opt.into_iter().collect();
     let scm = if fd_vec.is_empty() {
@@ -38,25 +44,49 @@ fn send_request(unix_fd: RawFd, vec: Vec<u8>, fd_opt: Option<RawFd>) -> StratisR
     Ok(())
 }
 
-pub struct StratisClient(UnixStream);
+/// A connection to stratisd-min, on which any number of requests may be made.
+pub struct StratisClient(BufReader<UnixStream>);
 
 impl StratisClient {
     pub fn connect<P>(path: P) -> StratisResult<StratisClient>
     where
         P: AsRef<Path>,
     {
-        Ok(StratisClient(UnixStream::connect(path)?))
+        Ok(StratisClient(BufReader::new(UnixStream::connect(path)?)))
+    }
+
+    fn response(&mut self) -> StratisResult<StratisRet> {
+        let mut vec = Vec::new();
+        if self.0.read_until(b'\n', &mut vec)? == 0 {
+            return Err(StratisError::Msg(
+                "stratisd-min closed the connection without responding".to_string(),
+            ));
+        }
+        Ok(serde_json::from_slice(vec.as_slice())?)
     }
 
     pub fn request(&mut self, params: StratisParams) -> StratisResult<StratisRet> {
         send_request(
-            self.0.as_raw_fd(),
-            serde_json::to_vec(&params.type_)?,
+            self.0.get_ref().as_raw_fd(),
+            encode_request(&params.type_)?,
             params.fd_opt,
         )?;
-        let mut vec = vec![0; 65536];
-        let bytes_read = self.0.read(vec.as_mut_slice())?;
-        vec.truncate(bytes_read);
-        Ok(serde_json::from_slice(vec.as_slice())?)
+        self.response()
+    }
+
+    /// Make several requests in a single message. The requests take effect
+    /// in order, and the responses are returned in the same order. None of
+    /// the requests may carry a file descriptor.
+    pub fn batch(&mut self, requests: Vec<StratisParamType>) -> StratisResult<Vec<StratisRet>> {
+        let len = requests.len();
+        match self.request(StratisParams {
+            type_: StratisParamType::Batch(requests),
+            fd_opt: None,
+        })? {
+            StratisRet::Batch(rets) if rets.len() == len => Ok(rets),
+            _ => Err(StratisError::Msg(
+                "Request and response types did not match".to_string(),
+            )),
+        }
     }
 }
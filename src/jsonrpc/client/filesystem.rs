@@ -2,11 +2,50 @@
 // License, v. 2.0. If a copy of the MPL was not distributed with this
 // file, You can obtain one at http://mozilla.org/MPL/2.0/.
 
-use crate::{jsonrpc::client::utils::to_suffix_repr, stratis::StratisResult};
+use crate::{
+    jsonrpc::{
+        client::{utils::to_suffix_repr, StratisClient},
+        consts::RPC_SOCKADDR,
+        interface::{StratisParamType, StratisRet},
+    },
+    stratis::{StratisError, StratisResult},
+};
 
 // stratis-min filesystem create
-pub fn filesystem_create(pool_name: String, filesystem_name: String) -> StratisResult<()> {
-    do_request_standard!(FsCreate, pool_name, filesystem_name)
+//
+// Several filesystems are created with a single batch request.
+pub fn filesystem_create(pool_name: String, filesystem_names: Vec<String>) -> StratisResult<()> {
+    if let [filesystem_name] = filesystem_names.as_slice() {
+        return do_request_standard!(FsCreate, pool_name, filesystem_name.to_owned());
+    }
+
+    let mut client = StratisClient::connect(RPC_SOCKADDR)?;
+    let rets = client.batch(
+        filesystem_names
+            .iter()
+            .map(|fs_name| StratisParamType::FsCreate(pool_name.clone(), fs_name.clone()))
+            .collect(),
+    )?;
+    let errors: Vec<_> = filesystem_names
+        .iter()
+        .zip(rets)
+        .filter_map(|(fs_name, ret)| match ret {
+            StratisRet::FsCreate((true, 0, _)) => None,
+            StratisRet::FsCreate((false, 0, _)) => {
+                Some(format!("{}: The requested action had no effect", fs_name))
+            }
+            StratisRet::FsCreate((_, _, rs)) => Some(format!("{}: {}", fs_name, rs)),
+            _ => Some(format!(
+                "{}: Request and response types did not match",
+                fs_name
+            )),
+        })
+        .collect();
+    if errors.is_empty() {
+        Ok(())
+    } else {
+        Err(StratisError::Msg(errors.join("; ")))
+    }
 }
 
 // stratis-min filesystem [list]
@@ -49,3 +88,11 @@ pub fn filesystem_rename(
 ) -> StratisResult<()> {
     do_request_standard!(FsRename, pool_name, filesystem_name, new_filesystem_name)
 }
+
+// stratis-min filesystem snapshot
+pub fn filesystem_snapshot(
+    pool_name: String,
+    snapshots: Vec<(String, String)>,
+) -> StratisResult<()> {
+    do_request_standard!(FsSnapshot, pool_name, snapshots)
+}
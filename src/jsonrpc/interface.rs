@@ -54,8 +54,11 @@ pub enum StratisParamType {
     FsCreate(String, String),
     FsDestroy(String, String),
     FsRename(String, String, String),
+    FsSnapshot(String, Vec<(String, String)>),
     FsList,
     Report,
+    /// Requests which are processed in order, without a file descriptor.
+    Batch(Vec<StratisParamType>),
 }
 
 pub struct StratisParams {
@@ -96,5 +99,8 @@ pub enum StratisRet {
     FsList(FsListType),
     FsDestroy((bool, u16, String)),
     FsRename((bool, u16, String)),
+    FsSnapshot((bool, u16, String)),
     Report(Value),
+    /// The responses to the requests in a batch, in the same order.
+    Batch(Vec<StratisRet>),
 }
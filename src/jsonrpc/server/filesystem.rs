@@ -7,7 +7,7 @@ use tokio::task::block_in_place;
 
 use crate::{
     engine::{EngineAction, LockableEngine, Name},
-    jsonrpc::{interface::FsListType, server::utils::name_to_uuid_and_pool},
+    jsonrpc::interface::FsListType,
     stratis::{StratisError, StratisResult},
 };
 
@@ -17,10 +17,11 @@ pub async fn filesystem_create(
     pool_name: &str,
     name: &str,
 ) -> StratisResult<bool> {
-    let mut lock = engine.lock().await;
-    let (pool_uuid, pool) = name_to_uuid_and_pool(&mut *lock, pool_name)
-        .ok_or_else(|| StratisError::Msg(format!("No pool named {} found", pool_name)))?;
+    let lock = engine.read().await;
     block_in_place(|| {
+        let (pool_uuid, mut pool) = lock
+            .lock_pool_by_name(pool_name)
+            .ok_or_else(|| StratisError::Msg(format!("No pool named {} found", pool_name)))?;
         Ok(pool
             .create_filesystems(pool_name, pool_uuid, &[(name, None)])?
             .is_changed())
@@ -29,29 +30,31 @@ pub async fn filesystem_create(
 
 // stratis-min filesystem [list]
 pub async fn filesystem_list(engine: LockableEngine) -> FsListType {
-    let lock = engine.lock().await;
-    lock.pools().into_iter().fold(
-        (
-            Vec::new(),
-            Vec::new(),
-            Vec::new(),
-            Vec::new(),
-            Vec::new(),
-            Vec::new(),
-        ),
-        |mut acc, (name, _uuid, pool)| {
-            for (fs_name, uuid, fs) in pool.filesystems() {
-                acc.0.push(name.to_string());
-                acc.1.push(fs_name.to_string());
-                acc.2.push(fs.used().ok().map(|u| *u));
-                acc.3
-                    .push(fs.created().to_rfc3339_opts(SecondsFormat::Secs, true));
-                acc.4.push(fs.devnode());
-                acc.5.push(uuid);
-            }
-            acc
-        },
-    )
+    let lock = engine.read().await;
+    block_in_place(|| {
+        lock.pools().into_iter().fold(
+            (
+                Vec::new(),
+                Vec::new(),
+                Vec::new(),
+                Vec::new(),
+                Vec::new(),
+                Vec::new(),
+            ),
+            |mut acc, (name, _uuid, pool)| {
+                for (fs_name, uuid, fs) in pool.filesystems() {
+                    acc.0.push(name.to_string());
+                    acc.1.push(fs_name.to_string());
+                    acc.2.push(fs.used().ok().map(|u| *u));
+                    acc.3
+                        .push(fs.created().to_rfc3339_opts(SecondsFormat::Secs, true));
+                    acc.4.push(fs.devnode());
+                    acc.5.push(uuid);
+                }
+                acc
+            },
+        )
+    })
 }
 
 // stratis-min filesystem destroy
@@ -60,13 +63,16 @@ pub async fn filesystem_destroy(
     pool_name: &str,
     fs_name: &str,
 ) -> StratisResult<bool> {
-    let mut lock = engine.lock().await;
-    let (_, pool) = name_to_uuid_and_pool(&mut *lock, pool_name)
-        .ok_or_else(|| StratisError::Msg(format!("No pool named {} found", pool_name)))?;
-    let (uuid, _) = pool
-        .get_filesystem_by_name(&Name::new(fs_name.to_string()))
-        .ok_or_else(|| StratisError::Msg(format!("No filesystem named {} found", fs_name)))?;
-    block_in_place(|| Ok(pool.destroy_filesystems(pool_name, &[uuid])?.is_changed()))
+    let lock = engine.read().await;
+    block_in_place(|| {
+        let (_, mut pool) = lock
+            .lock_pool_by_name(pool_name)
+            .ok_or_else(|| StratisError::Msg(format!("No pool named {} found", pool_name)))?;
+        let (uuid, _) = pool
+            .get_filesystem_by_name(&Name::new(fs_name.to_string()))
+            .ok_or_else(|| StratisError::Msg(format!("No filesystem named {} found", fs_name)))?;
+        Ok(pool.destroy_filesystems(pool_name, &[uuid])?.is_changed())
+    })
 }
 
 // stratis-min filesystem rename
@@ -76,15 +82,43 @@ pub async fn filesystem_rename(
     fs_name: &str,
     new_fs_name: &str,
 ) -> StratisResult<bool> {
-    let mut lock = engine.lock().await;
-    let (_, pool) = name_to_uuid_and_pool(&mut *lock, pool_name)
-        .ok_or_else(|| StratisError::Msg(format!("No pool named {} found", pool_name)))?;
-    let (uuid, _) = pool
-        .get_filesystem_by_name(&Name::new(fs_name.to_string()))
-        .ok_or_else(|| StratisError::Msg(format!("No filesystem named {} found", fs_name)))?;
+    let lock = engine.read().await;
     block_in_place(|| {
+        let (_, mut pool) = lock
+            .lock_pool_by_name(pool_name)
+            .ok_or_else(|| StratisError::Msg(format!("No pool named {} found", pool_name)))?;
+        let (uuid, _) = pool
+            .get_filesystem_by_name(&Name::new(fs_name.to_string()))
+            .ok_or_else(|| StratisError::Msg(format!("No filesystem named {} found", fs_name)))?;
         Ok(pool
             .rename_filesystem(pool_name, uuid, new_fs_name)?
             .is_changed())
     })
 }
+
+// stratis-min filesystem snapshot
+pub async fn filesystem_snapshot(
+    engine: LockableEngine,
+    pool_name: &str,
+    snapshots: &[(String, String)],
+) -> StratisResult<bool> {
+    let lock = engine.read().await;
+    block_in_place(|| {
+        let (pool_uuid, mut pool) = lock
+            .lock_pool_by_name(pool_name)
+            .ok_or_else(|| StratisError::Msg(format!("No pool named {} found", pool_name)))?;
+        let specs = snapshots
+            .iter()
+            .map(|(fs_name, snapshot_name)| {
+                pool.get_filesystem_by_name(&Name::new(fs_name.to_string()))
+                    .map(|(uuid, _)| (uuid, snapshot_name.as_str()))
+                    .ok_or_else(|| {
+                        StratisError::Msg(format!("No filesystem named {} found", fs_name))
+                    })
+            })
+            .collect::<StratisResult<Vec<_>>>()?;
+        Ok(pool
+            .snapshot_filesystems(pool_name, pool_uuid, &specs)?
+            .is_changed())
+    })
+}
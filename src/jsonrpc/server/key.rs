@@ -17,7 +17,7 @@ pub async fn key_set(
 ) -> StratisResult<Option<bool>> {
     Ok(
         match engine
-            .lock()
+            .write()
             .await
             .get_key_handler_mut()
             .set(key_desc, key_fd)?
@@ -32,7 +32,7 @@ pub async fn key_set(
 // stratis-min key unset
 pub async fn key_unset(engine: LockableEngine, key_desc: &KeyDescription) -> StratisResult<bool> {
     Ok(
-        match engine.lock().await.get_key_handler_mut().unset(key_desc)? {
+        match engine.write().await.get_key_handler_mut().unset(key_desc)? {
             MappingDeleteAction::Deleted(_) => true,
             MappingDeleteAction::Identity => false,
         },
@@ -42,16 +42,16 @@ pub async fn key_unset(engine: LockableEngine, key_desc: &KeyDescription) -> Str
 // stratis-min key [list]
 pub async fn key_list(engine: LockableEngine) -> StratisResult<Vec<KeyDescription>> {
     Ok(engine
-        .lock()
+        .read()
         .await
-        .get_key_handler_mut()
+        .get_key_handler()
         .list()?
         .into_iter()
         .collect())
 }
 
 pub async fn key_get_desc(engine: LockableEngine, pool_uuid: PoolUuid) -> Option<KeyDescription> {
-    let locked_pools = engine.lock().await.locked_pools();
+    let locked_pools = engine.read().await.locked_pools();
     locked_pools
         .get(&pool_uuid)
         .and_then(|info| info.info.key_description.to_owned())
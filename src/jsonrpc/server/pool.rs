@@ -8,8 +8,8 @@ use tokio::task::block_in_place;
 
 use crate::{
     engine::{
-        BlockDevTier, CreateAction, DeleteAction, EncryptionInfo, EngineAction, LockableEngine,
-        PoolUuid, RenameAction, UnlockMethod,
+        BlockDevTier, CacheSettings, CreateAction, DeleteAction, EncryptionInfo, EngineAction,
+        LockableEngine, PoolUuid, RenameAction, UnlockMethod,
     },
     jsonrpc::{
         interface::PoolListType,
@@ -34,7 +34,7 @@ pub async fn pool_unlock(
         }
     }
 
-    let mut lock = engine.lock().await;
+    let mut lock = engine.write().await;
     match pool_uuid {
         Some(u) => block_in_place(|| Ok(lock.unlock_pool(u, unlock_method)?.changed().is_some())),
         None => {
@@ -61,7 +61,7 @@ pub async fn pool_create(
     blockdev_paths: &[&Path],
     enc_info: EncryptionInfo,
 ) -> StratisResult<bool> {
-    let mut lock = engine.lock().await;
+    let mut lock = engine.write().await;
     Ok(
         match block_in_place(|| lock.create_pool(name, blockdev_paths, None, &enc_info))? {
             CreateAction::Created(_) => true,
@@ -72,7 +72,7 @@ pub async fn pool_create(
 
 // stratis-min pool destroy
 pub async fn pool_destroy(engine: LockableEngine, name: &str) -> StratisResult<bool> {
-    let mut lock = engine.lock().await;
+    let mut lock = engine.write().await;
     let (uuid, _) = name_to_uuid_and_pool(&mut *lock, name)
         .ok_or_else(|| StratisError::Msg(format!("No pool found with name {}", name)))?;
     Ok(match block_in_place(|| lock.destroy_pool(uuid))? {
@@ -87,10 +87,15 @@ pub async fn pool_init_cache(
     name: &str,
     paths: &[&Path],
 ) -> StratisResult<bool> {
-    let mut lock = engine.lock().await;
-    let (uuid, pool) = name_to_uuid_and_pool(&mut *lock, name)
-        .ok_or_else(|| StratisError::Msg(format!("No pool found with name {}", name)))?;
-    block_in_place(|| Ok(pool.init_cache(uuid, name, paths)?.is_changed()))
+    let lock = engine.read().await;
+    block_in_place(|| {
+        let (uuid, mut pool) = lock
+            .lock_pool_by_name(name)
+            .ok_or_else(|| StratisError::Msg(format!("No pool found with name {}", name)))?;
+        Ok(pool
+            .init_cache(uuid, name, paths, CacheSettings::default())?
+            .is_changed())
+    })
 }
 
 // stratis-min pool rename
@@ -99,7 +104,7 @@ pub async fn pool_rename(
     current_name: &str,
     new_name: &str,
 ) -> StratisResult<bool> {
-    let mut lock = engine.lock().await;
+    let mut lock = engine.write().await;
     let (uuid, _) = name_to_uuid_and_pool(&mut *lock, current_name)
         .ok_or_else(|| StratisError::Msg(format!("No pool found with name {}", current_name)))?;
     Ok(match block_in_place(|| lock.rename_pool(uuid, new_name))? {
@@ -133,10 +138,11 @@ async fn add_blockdevs(
     blockdevs: &[&Path],
     tier: BlockDevTier,
 ) -> StratisResult<bool> {
-    let mut lock = engine.lock().await;
-    let (uuid, pool) = name_to_uuid_and_pool(&mut *lock, name)
-        .ok_or_else(|| StratisError::Msg(format!("No pool found with name {}", name)))?;
+    let lock = engine.read().await;
     block_in_place(|| {
+        let (uuid, mut pool) = lock
+            .lock_pool_by_name(name)
+            .ok_or_else(|| StratisError::Msg(format!("No pool found with name {}", name)))?;
         Ok(pool
             .add_blockdevs(uuid, name, blockdevs, tier)?
             .is_changed())
@@ -145,90 +151,104 @@ async fn add_blockdevs(
 
 // stratis-min pool [list]
 pub async fn pool_list(engine: LockableEngine) -> PoolListType {
-    let lock = engine.lock().await;
-    lock.pools()
-        .iter()
-        .map(|(n, u, p)| {
-            (
-                n.to_string(),
+    let lock = engine.read().await;
+    block_in_place(|| {
+        let pools = lock.pools();
+        pools
+            .iter()
+            .map(|(n, u, p)| {
                 (
-                    *p.total_physical_size().bytes(),
-                    p.total_physical_used().ok().map(|u| *u.bytes()),
-                ),
-                (p.has_cache(), p.is_encrypted()),
-                u,
+                    n.to_string(),
+                    (
+                        *p.total_physical_size().bytes(),
+                        p.total_physical_used().ok().map(|u| *u.bytes()),
+                    ),
+                    (p.has_cache(), p.is_encrypted()),
+                    u,
+                )
+            })
+            .fold(
+                (Vec::new(), Vec::new(), Vec::new(), Vec::new()),
+                |(mut name_vec, mut size_vec, mut pool_props_vec, mut uuid_vec), (n, s, p, u)| {
+                    name_vec.push(n);
+                    size_vec.push(s);
+                    pool_props_vec.push(p);
+                    uuid_vec.push(*u);
+                    (name_vec, size_vec, pool_props_vec, uuid_vec)
+                },
             )
-        })
-        .fold(
-            (Vec::new(), Vec::new(), Vec::new(), Vec::new()),
-            |(mut name_vec, mut size_vec, mut pool_props_vec, mut uuid_vec), (n, s, p, u)| {
-                name_vec.push(n);
-                size_vec.push(s);
-                pool_props_vec.push(p);
-                uuid_vec.push(*u);
-                (name_vec, size_vec, pool_props_vec, uuid_vec)
-            },
-        )
+    })
 }
 
 // stratis-min pool is-encrypted
 pub async fn pool_is_encrypted(engine: LockableEngine, uuid: PoolUuid) -> StratisResult<bool> {
-    let lock = engine.lock().await;
-    if let Some((_, pool)) = lock.get_pool(uuid) {
-        Ok(pool.is_encrypted())
-    } else if lock.locked_pools().get(&uuid).is_some() {
-        Ok(true)
-    } else {
-        Err(StratisError::Msg(format!(
-            "Pool with UUID {} not found",
-            uuid.to_simple_ref()
-        )))
-    }
+    let lock = engine.read().await;
+    block_in_place(|| {
+        let pool = lock.get_pool(uuid);
+        if let Some((_, pool)) = pool {
+            Ok(pool.is_encrypted())
+        } else if lock.locked_pools().get(&uuid).is_some() {
+            Ok(true)
+        } else {
+            Err(StratisError::Msg(format!(
+                "Pool with UUID {} not found",
+                uuid.to_simple_ref()
+            )))
+        }
+    })
 }
 
 // stratis-min pool is-locked
 pub async fn pool_is_locked(engine: LockableEngine, uuid: PoolUuid) -> StratisResult<bool> {
-    let lock = engine.lock().await;
-    if lock.get_pool(uuid).is_some() {
-        Ok(false)
-    } else if lock.locked_pools().get(&uuid).is_some() {
-        Ok(true)
-    } else {
-        Err(StratisError::Msg(format!(
-            "Pool with UUID {} not found",
-            uuid.to_simple_ref()
-        )))
-    }
+    let lock = engine.read().await;
+    block_in_place(|| {
+        if lock.get_pool(uuid).is_some() {
+            Ok(false)
+        } else if lock.locked_pools().get(&uuid).is_some() {
+            Ok(true)
+        } else {
+            Err(StratisError::Msg(format!(
+                "Pool with UUID {} not found",
+                uuid.to_simple_ref()
+            )))
+        }
+    })
 }
 
 // stratis-min pool is-bound
 pub async fn pool_is_bound(engine: LockableEngine, uuid: PoolUuid) -> StratisResult<bool> {
-    let lock = engine.lock().await;
-    if let Some((_, pool)) = lock.get_pool(uuid) {
-        Ok(pool.encryption_info().clevis_info.is_some())
-    } else if let Some(info) = lock.locked_pools().get(&uuid) {
-        Ok(info.info.clevis_info.is_some())
-    } else {
-        Err(StratisError::Msg(format!(
-            "Pool with UUID {} not found",
-            uuid.to_simple_ref()
-        )))
-    }
+    let lock = engine.read().await;
+    block_in_place(|| {
+        let pool = lock.get_pool(uuid);
+        if let Some((_, pool)) = pool {
+            Ok(pool.encryption_info().clevis_info.is_some())
+        } else if let Some(info) = lock.locked_pools().get(&uuid) {
+            Ok(info.info.clevis_info.is_some())
+        } else {
+            Err(StratisError::Msg(format!(
+                "Pool with UUID {} not found",
+                uuid.to_simple_ref()
+            )))
+        }
+    })
 }
 
 // stratis-min pool has-passphrase
 pub async fn pool_has_passphrase(engine: LockableEngine, uuid: PoolUuid) -> StratisResult<bool> {
-    let lock = engine.lock().await;
-    if let Some((_, pool)) = lock.get_pool(uuid) {
-        Ok(pool.encryption_info().key_description.is_some())
-    } else if let Some(info) = lock.locked_pools().get(&uuid) {
-        Ok(info.info.key_description.is_some())
-    } else {
-        Err(StratisError::Msg(format!(
-            "Pool with UUID {} not found",
-            uuid.to_simple_ref()
-        )))
-    }
+    let lock = engine.read().await;
+    block_in_place(|| {
+        let pool = lock.get_pool(uuid);
+        if let Some((_, pool)) = pool {
+            Ok(pool.encryption_info().key_description.is_some())
+        } else if let Some(info) = lock.locked_pools().get(&uuid) {
+            Ok(info.info.key_description.is_some())
+        } else {
+            Err(StratisError::Msg(format!(
+                "Pool with UUID {} not found",
+                uuid.to_simple_ref()
+            )))
+        }
+    })
 }
 
 // stratis-min pool clevis-pin
@@ -236,19 +256,22 @@ pub async fn pool_clevis_pin(
     engine: LockableEngine,
     uuid: PoolUuid,
 ) -> StratisResult<Option<String>> {
-    let lock = engine.lock().await;
-    if let Some((_, pool)) = lock.get_pool(uuid) {
-        Ok(pool
-            .encryption_info()
-            .clevis_info
-            .as_ref()
-            .map(|(pin, _)| pin.clone()))
-    } else if let Some(info) = lock.locked_pools().get(&uuid) {
-        Ok(info.info.clevis_info.as_ref().map(|(pin, _)| pin.clone()))
-    } else {
-        Err(StratisError::Msg(format!(
-            "Pool with UUID {} not found",
-            uuid.to_simple_ref()
-        )))
-    }
+    let lock = engine.read().await;
+    block_in_place(|| {
+        let pool = lock.get_pool(uuid);
+        if let Some((_, pool)) = pool {
+            Ok(pool
+                .encryption_info()
+                .clevis_info
+                .as_ref()
+                .map(|(pin, _)| pin.clone()))
+        } else if let Some(info) = lock.locked_pools().get(&uuid) {
+            Ok(info.info.clevis_info.as_ref().map(|(pin, _)| pin.clone()))
+        } else {
+            Err(StratisError::Msg(format!(
+                "Pool with UUID {} not found",
+                uuid.to_simple_ref()
+            )))
+        }
+    })
 }
@@ -4,9 +4,18 @@
 
 use serde_json::Value;
 
-use crate::engine::LockableEngine;
+use crate::{engine::LockableEngine, stratis::StratisResult};
 
+// The engine is locked only while the report is written out, which is much
+// quicker than building it as a Value; it is parsed once the lock has been
+// released.
 #[inline]
 pub async fn report(engine: LockableEngine) -> Value {
-    engine.lock().await.engine_state_report()
+    let report = engine.read().await.engine_state_report_json();
+    report
+        .and_then(|json| -> StratisResult<Value> { Ok(serde_json::from_str(&json)?) })
+        .unwrap_or_else(|e| {
+            warn!("Failed to generate engine state report: {}", e);
+            Value::Null
+        })
 }
@@ -6,23 +6,23 @@
 use std::collections::HashMap;
 use std::{
     fs::{create_dir_all, remove_file},
-    future::Future,
     os::unix::io::{AsRawFd, RawFd},
     path::Path,
     pin::Pin,
-    sync::Arc,
     task::{Context, Poll},
 };
 
 use futures::{
+    future::BoxFuture,
     ready,
     stream::{Stream, StreamExt},
 };
 use nix::{
+    errno::Errno,
     fcntl::{fcntl, FcntlArg, OFlag},
     sys::{
         socket::{
-            accept, bind, listen, recvmsg, sendmsg, socket, AddressFamily, ControlMessageOwned,
+            accept, bind, listen, recvmsg, send, socket, AddressFamily, ControlMessageOwned,
             MsgFlags, SockAddr, SockFlag, SockType,
         },
         uio::IoVec,
@@ -43,6 +43,12 @@ use crate::{
     stratis::{StratisError, StratisResult},
 };
 
+// The number of bytes that are received from a connection at a time
+const RECV_SIZE: usize = 65536;
+// A connection on which this many bytes are received without completing a
+// request is closed.
+const MAX_REQUEST_SIZE: usize = 1 << 24;
+
 impl StratisParams {
     async fn process(self, engine: LockableEngine) -> StratisRet {
         match self.type_ {
@@ -200,6 +206,13 @@ impl StratisParams {
                     false,
                 ))
             }
+            StratisParamType::FsSnapshot(pool_name, snapshots) => {
+                expects_fd!(self.fd_opt, FsSnapshot, false, false);
+                StratisRet::FsSnapshot(stratis_result_to_return(
+                    filesystem::filesystem_snapshot(engine, &pool_name, &snapshots).await,
+                    false,
+                ))
+            }
             StratisParamType::Report => {
                 if let Some(fd) = self.fd_opt {
                     if let Err(e) = close(fd) {
@@ -212,8 +225,41 @@ impl StratisParams {
                 }
                 StratisRet::Report(report::report(engine).await)
             }
+            StratisParamType::Batch(requests) => {
+                if let Some(fd) = self.fd_opt {
+                    if let Err(e) = close(fd) {
+                        warn!(
+                            "Failed to close file descriptor {}: {}; a file \
+                            descriptor may have been leaked",
+                            fd, e,
+                        );
+                    }
+                }
+                StratisRet::Batch(StratisParams::process_batch(requests, engine).await)
+            }
         }
     }
+
+    /// Process the requests in a batch in order, as if each had been sent
+    /// separately. None of them receive a file descriptor.
+    ///
+    /// The future is boxed because a batch is processed by process().
+    fn process_batch(
+        requests: Vec<StratisParamType>,
+        engine: LockableEngine,
+    ) -> BoxFuture<'static, Vec<StratisRet>> {
+        Box::pin(async move {
+            let mut rets = Vec::with_capacity(requests.len());
+            for type_ in requests {
+                let params = StratisParams {
+                    type_,
+                    fd_opt: None,
+                };
+                rets.push(params.process(engine.clone()).await);
+            }
+            rets
+        })
+    }
 }
 
 pub struct StratisServer {
@@ -241,24 +287,30 @@ impl StratisServer {
         Ok(server)
     }
 
-    async fn handle_request(&mut self) -> StratisResult<Option<()>> {
-        let request_handler = match self.listener.next().await {
-            Some(req_res) => req_res?,
+    async fn handle_connection(&mut self) -> StratisResult<Option<()>> {
+        let mut connection = match self.listener.next().await {
+            Some(conn_res) => conn_res?,
             None => return Ok(None),
         };
         let engine = self.engine.clone();
+        // The requests on a connection are processed one at a time, so that
+        // pipelined requests take effect, and are responded to, in the order
+        // in which they were sent.
         tokio::spawn(async move {
-            let fd = Arc::clone(&request_handler.fd);
-            let params = match request_handler.await {
-                Ok(p) => p,
-                Err(e) => {
-                    warn!("Failed to receive request from connection: {}", e);
+            loop {
+                let params = match connection.next_request().await {
+                    Ok(Some(p)) => p,
+                    Ok(None) => return,
+                    Err(e) => {
+                        warn!("Failed to receive request from connection: {}", e);
+                        return;
+                    }
+                };
+                let ret = params.process(engine.clone()).await;
+                if let Err(e) = connection.respond(&ret).await {
+                    warn!("Failed to respond to request: {}", e);
                     return;
                 }
-            };
-            let ret = params.process(engine).await;
-            if let Err(e) = StratisUnixResponse::new(fd, ret).await {
-                warn!("Failed to respond to request: {}", e);
             }
         });
         Ok(Some(()))
@@ -266,7 +318,7 @@ impl StratisServer {
 
     pub async fn run(mut self) {
         loop {
-            match self.handle_request().await {
+            match self.handle_connection().await {
                 Ok(Some(())) => (),
                 Ok(None) => {
                     info!("Unix socket listener can no longer accept connections; exiting...");
@@ -322,77 +374,182 @@ fn handle_cmsgs(mut cmsgs: Vec<ControlMessageOwned>) -> StratisResult<Option<Raw
     })
 }
 
-fn try_recvmsg(fd: RawFd) -> StratisResult<StratisParams> {
+/// Receive bytes from the connection fd, appending them to buf. Returns None
+/// if there is nothing to receive yet, otherwise the number of bytes
+/// received, which is 0 if the client has closed the connection, and the file
+/// descriptor received with them, if any.
+fn try_recvmsg(fd: RawFd, buf: &mut Vec<u8>) -> StratisResult<Option<(usize, Option<RawFd>)>> {
     let mut cmsg_space = cmsg_space!([RawFd; 1]);
-    let mut vec = vec![0; 65536];
-    let rmsg = recvmsg(
+    let start = buf.len();
+    buf.resize(start + RECV_SIZE, 0);
+    let rmsg = match recvmsg(
         fd,
-        &[IoVec::from_mut_slice(vec.as_mut_slice())],
+        &[IoVec::from_mut_slice(&mut buf[start..])],
         Some(&mut cmsg_space),
         MsgFlags::empty(),
-    )?;
+    ) {
+        Ok(rmsg) => rmsg,
+        Err(e) => {
+            buf.truncate(start);
+            return match e {
+                nix::Error::Sys(Errno::EAGAIN) => Ok(None),
+                e => Err(StratisError::from(e)),
+            };
+        }
+    };
 
+    let bytes = rmsg.bytes;
     let cmsgs = rmsg.cmsgs().collect();
-    let fd_opt = handle_cmsgs(cmsgs)?;
-    vec.truncate(rmsg.bytes);
-    Ok(serde_json::from_slice(vec.as_slice())
-        .map(|type_: StratisParamType| StratisParams { type_, fd_opt })?)
+    buf.truncate(start + bytes);
+    Ok(Some((bytes, handle_cmsgs(cmsgs)?)))
 }
 
-fn try_sendmsg(fd: RawFd, ret: &StratisRet) -> StratisResult<()> {
-    let vec = serde_json::to_vec(ret)?;
-    sendmsg(
-        fd,
-        &[IoVec::from_slice(vec.as_slice())],
-        &[],
-        MsgFlags::empty(),
-        None,
-    )?;
-    Ok(())
+/// Send as much of buf as the connection fd will accept. Returns None if it
+/// will not accept anything yet.
+fn try_send(fd: RawFd, buf: &[u8]) -> StratisResult<Option<usize>> {
+    match send(fd, buf, MsgFlags::MSG_NOSIGNAL) {
+        Ok(bytes) => Ok(Some(bytes)),
+        Err(nix::Error::Sys(Errno::EAGAIN)) => Ok(None),
+        Err(e) => Err(StratisError::from(e)),
+    }
 }
 
-pub struct StratisUnixRequest {
-    fd: Arc<AsyncFd<RawFd>>,
-}
+/// The file descriptor of a connection, which is closed when the connection
+/// is dropped.
+struct ConnectionFd(RawFd);
 
-impl Future for StratisUnixRequest {
-    type Output = StratisResult<StratisParams>;
+impl AsRawFd for ConnectionFd {
+    fn as_raw_fd(&self) -> RawFd {
+        self.0
+    }
+}
 
-    fn poll(self: Pin<&mut Self>, ctxt: &mut Context) -> Poll<StratisResult<StratisParams>> {
-        let poll_res = ready!(self.fd.poll_read_ready(ctxt));
-        let mut poll_guard = match poll_res {
-            Ok(poll) => poll,
-            Err(e) => return Poll::Ready(Err(StratisError::from(e))),
-        };
-        let res = try_recvmsg(self.fd.as_raw_fd());
-        poll_guard.clear_ready();
-        Poll::Ready(res)
+impl Drop for ConnectionFd {
+    fn drop(&mut self) {
+        if let Err(e) = close(self.0) {
+            warn!(
+                "Failed to close connection file descriptor {}: {}",
+                self.0, e
+            );
+        }
     }
 }
 
-pub struct StratisUnixResponse {
-    fd: Arc<AsyncFd<RawFd>>,
-    ret: StratisRet,
+/// A connection on which a client may send any number of requests, without
+/// waiting for the response to one request before sending the next. Each
+/// request and each response is a JSON message terminated by a newline.
+///
+/// A file descriptor sent with a request is passed to the first request that
+/// is completed by the bytes with which it is received, so a client must not
+/// pipeline a request that carries a file descriptor behind other requests.
+pub struct StratisUnixConnection {
+    fd: AsyncFd<ConnectionFd>,
+    // Bytes received which do not yet form a complete request
+    buf: Vec<u8>,
+    // The length of the prefix of buf that is known not to contain a newline
+    scanned: usize,
+    // A file descriptor received which has not yet been passed to a request
+    fd_opt: Option<RawFd>,
 }
 
-impl StratisUnixResponse {
-    pub fn new(fd: Arc<AsyncFd<RawFd>>, ret: StratisRet) -> StratisUnixResponse {
-        StratisUnixResponse { fd, ret }
+impl StratisUnixConnection {
+    /// Take ownership of the connected socket fd.
+    fn new(fd: RawFd) -> StratisResult<StratisUnixConnection> {
+        let fd = ConnectionFd(fd);
+        let flags = OFlag::from_bits(fcntl(fd.0, FcntlArg::F_GETFL)?).ok_or_else(|| {
+            StratisError::Msg("Unrecognized flag types returned from fcntl".to_string())
+        })?;
+        fcntl(fd.0, FcntlArg::F_SETFL(flags | OFlag::O_NONBLOCK))?;
+        Ok(StratisUnixConnection {
+            fd: AsyncFd::new(fd)?,
+            buf: Vec::new(),
+            scanned: 0,
+            fd_opt: None,
+        })
     }
-}
 
-impl Future for StratisUnixResponse {
-    type Output = StratisResult<()>;
+    /// Receive the next request. Returns None if the client has closed the
+    /// connection.
+    pub async fn next_request(&mut self) -> StratisResult<Option<StratisParams>> {
+        loop {
+            if let Some(pos) = self.buf[self.scanned..].iter().position(|b| *b == b'\n') {
+                let end = self.scanned + pos;
+                let fd_opt = self.fd_opt.take();
+                let res = serde_json::from_slice(&self.buf[..end]);
+                self.buf.drain(..=end);
+                self.scanned = 0;
+                return match res {
+                    Ok(type_) => Ok(Some(StratisParams { type_, fd_opt })),
+                    Err(e) => {
+                        if let Some(fd) = fd_opt {
+                            if let Err(e) = close(fd) {
+                                warn!("Failed to close file descriptor {}: {}", fd, e);
+                            }
+                        }
+                        Err(StratisError::from(e))
+                    }
+                };
+            }
+            self.scanned = self.buf.len();
+            if self.buf.len() > MAX_REQUEST_SIZE {
+                return Err(StratisError::Msg(format!(
+                    "Request exceeded the maximum size of {} bytes",
+                    MAX_REQUEST_SIZE
+                )));
+            }
 
-    fn poll(self: Pin<&mut Self>, ctxt: &mut Context) -> Poll<StratisResult<()>> {
-        let poll_res = ready!(self.fd.poll_write_ready(ctxt));
-        let mut poll_guard = match poll_res {
-            Ok(poll) => poll,
-            Err(e) => return Poll::Ready(Err(StratisError::from(e))),
-        };
-        let res = try_sendmsg(self.fd.as_raw_fd(), &self.ret);
-        poll_guard.clear_ready();
-        Poll::Ready(res)
+            let mut guard = self.fd.readable().await?;
+            match try_recvmsg(self.fd.as_raw_fd(), &mut self.buf)? {
+                None => guard.clear_ready(),
+                Some((0, _)) => {
+                    return if self.buf.is_empty() {
+                        Ok(None)
+                    } else {
+                        Err(StratisError::Msg(
+                            "Connection was closed in the middle of a request".to_string(),
+                        ))
+                    };
+                }
+                Some((_, Some(fd))) if self.fd_opt.is_some() => {
+                    if let Err(e) = close(fd) {
+                        warn!("Failed to close file descriptor {}: {}", fd, e);
+                    }
+                    return Err(StratisError::Msg(
+                        "Received a file descriptor before the previous one was used".to_string(),
+                    ));
+                }
+                Some((_, fd_opt)) => {
+                    if fd_opt.is_some() {
+                        self.fd_opt = fd_opt;
+                    }
+                }
+            }
+        }
+    }
+
+    /// Send the response to a request.
+    pub async fn respond(&mut self, ret: &StratisRet) -> StratisResult<()> {
+        let mut vec = serde_json::to_vec(ret)?;
+        vec.push(b'\n');
+        let mut sent = 0;
+        while sent < vec.len() {
+            let mut guard = self.fd.writable().await?;
+            match try_send(self.fd.as_raw_fd(), &vec[sent..])? {
+                Some(bytes) => sent += bytes,
+                None => guard.clear_ready(),
+            }
+        }
+        Ok(())
+    }
+}
+
+impl Drop for StratisUnixConnection {
+    fn drop(&mut self) {
+        if let Some(fd) = self.fd_opt.take() {
+            if let Err(e) = close(fd) {
+                warn!("Failed to close file descriptor {}: {}", fd, e);
+            }
+        }
     }
 }
 
@@ -429,24 +586,17 @@ impl StratisUnixListener {
     }
 }
 
-fn try_accept(fd: RawFd) -> StratisResult<StratisUnixRequest> {
-    let fd = accept(fd)?;
-    let flags = OFlag::from_bits(fcntl(fd, FcntlArg::F_GETFL)?).ok_or_else(|| {
-        StratisError::Msg("Unrecognized flag types returned from fcntl".to_string())
-    })?;
-    fcntl(fd, FcntlArg::F_SETFL(flags | OFlag::O_NONBLOCK))?;
-    Ok(StratisUnixRequest {
-        fd: Arc::new(AsyncFd::new(fd)?),
-    })
+fn try_accept(fd: RawFd) -> StratisResult<StratisUnixConnection> {
+    StratisUnixConnection::new(accept(fd)?)
 }
 
 impl Stream for StratisUnixListener {
-    type Item = StratisResult<StratisUnixRequest>;
+    type Item = StratisResult<StratisUnixConnection>;
 
     fn poll_next(
         self: Pin<&mut Self>,
         ctxt: &mut Context,
-    ) -> Poll<Option<StratisResult<StratisUnixRequest>>> {
+    ) -> Poll<Option<StratisResult<StratisUnixConnection>>> {
         let poll_res = ready!(self.fd.poll_read_ready(ctxt));
         let mut poll_guard = match poll_res {
             Ok(poll) => poll,
@@ -469,3 +619,56 @@ pub fn run_server(engine: LockableEngine) -> JoinHandle<()> {
         }
     })
 }
+
+#[cfg(test)]
+mod tests {
+    use std::{
+        io::{BufRead, BufReader, Write},
+        os::unix::{io::IntoRawFd, net::UnixStream},
+    };
+
+    use super::*;
+
+    #[tokio::test]
+    /// Verify that requests pipelined on a connection are received in order,
+    /// even when they arrive together or in pieces, and that each response
+    /// is terminated by a newline.
+    async fn test_pipelined_requests() {
+        let (server, client) = UnixStream::pair().unwrap();
+        let mut connection = StratisUnixConnection::new(server.into_raw_fd()).unwrap();
+        let mut client = BufReader::new(client);
+
+        client
+            .get_mut()
+            .write_all(b"\"PoolList\"\n\"FsList\"\n{\"PoolDestroy\"")
+            .unwrap();
+        assert!(matches!(
+            connection.next_request().await.unwrap().unwrap().type_,
+            StratisParamType::PoolList
+        ));
+        assert!(matches!(
+            connection.next_request().await.unwrap().unwrap().type_,
+            StratisParamType::FsList
+        ));
+
+        client.get_mut().write_all(b":\"pool\"}\n").unwrap();
+        match connection.next_request().await.unwrap().unwrap().type_ {
+            StratisParamType::PoolDestroy(name) => assert_eq!(name, "pool"),
+            _ => panic!("expected a PoolDestroy request"),
+        }
+
+        connection
+            .respond(&StratisRet::PoolDestroy((true, 0, String::new())))
+            .await
+            .unwrap();
+        let mut response = Vec::new();
+        client.read_until(b'\n', &mut response).unwrap();
+        assert!(matches!(
+            serde_json::from_slice::<StratisRet>(&response).unwrap(),
+            StratisRet::PoolDestroy((true, 0, _))
+        ));
+
+        drop(client);
+        assert!(connection.next_request().await.unwrap().is_none());
+    }
+}
@@ -2,10 +2,13 @@
 // License, v. 2.0. If a copy of the MPL was not distributed with this
 // file, You can obtain one at http://mozilla.org/MPL/2.0/.
 
-use std::os::unix::io::{AsRawFd, RawFd};
+use std::{
+    os::unix::io::{AsRawFd, RawFd},
+    time::Duration,
+};
 
 use nix::fcntl::{fcntl, FcntlArg, OFlag};
-use tokio::io::unix::AsyncFd;
+use tokio::{io::unix::AsyncFd, task::block_in_place, time::timeout};
 
 use crate::{
     engine::{get_dm, get_dm_init, LockableEngine},
@@ -16,25 +19,46 @@ const REQUIRED_DM_MINOR_VERSION: u32 = 37;
 
 // Waits for devicemapper event. On devicemapper event, transfers control
 // to engine to handle event and waits until control is returned from engine.
+// Between events, runs the pool checks that the engine has scheduled as they
+// become due.
 // Accepts None as an argument; this indicates that devicemapper events are
 // to be ignored.
 pub async fn dm_event_thread(engine: Option<LockableEngine>) -> StratisResult<()> {
-    async fn process_dm_event(engine: &LockableEngine, fd: &AsyncFd<RawFd>) -> StratisResult<()> {
+    // Wait for a devicemapper event for no longer than wait, if wait is not
+    // None, and hand the event to the engine.
+    async fn process_dm_event(
+        engine: &LockableEngine,
+        fd: &AsyncFd<RawFd>,
+        wait: Option<Duration>,
+    ) -> StratisResult<()> {
         {
-            let mut guard = fd.readable().await?;
+            let mut guard = match wait {
+                Some(wait) => match timeout(wait, fd.readable()).await {
+                    Ok(guard) => guard?,
+                    Err(_) => return Ok(()),
+                },
+                None => fd.readable().await?,
+            };
             guard.clear_ready();
         }
         get_dm().arm_poll()?;
-        let mut lock = engine.lock().await;
-        lock.evented()?;
-        Ok(())
+        let lock = engine.read().await;
+        block_in_place(|| lock.evented())
     }
 
     match engine {
         Some(engine) => {
             let fd = setup_dm()?;
             loop {
-                if let Err(e) = process_dm_event(&engine, &fd).await {
+                let next_due = engine.read().await.next_check_due();
+                let wait = match next_due {
+                    Some(due) if due == Duration::from_secs(0) => {
+                        let lock = engine.read().await;
+                        block_in_place(|| lock.run_scheduled_checks())
+                    }
+                    _ => next_due,
+                };
+                if let Err(e) = process_dm_event(&engine, &fd, wait).await {
                     warn!("Failed to process devicemapper event: {}", e);
                 }
             }
@@ -24,15 +24,15 @@ use crate::{
 /// Set up the cooperating D-Bus threads.
 pub async fn setup(
     engine: LockableEngine,
-    receiver: UnboundedReceiver<UdevEngineEvent>,
+    receiver: UnboundedReceiver<Vec<UdevEngineEvent>>,
     trigger: Sender<()>,
 ) -> StratisResult<()> {
     let (mut conn, mut udev, mut tree) = spawn_blocking(move || {
         create_dbus_handlers(engine.clone(), receiver, trigger)
             .map(|(conn, udev, tree)| {
-                let mutex_lock = engine.blocking_lock();
-                for (pool_name, pool_uuid, pool) in mutex_lock.pools() {
-                    udev.register_pool(&pool_name, pool_uuid, pool)
+                let read_lock = engine.blocking_read();
+                for (pool_name, pool_uuid, pool) in read_lock.pools() {
+                    udev.register_pool(&pool_name, pool_uuid, &*pool)
                 }
                 info!("D-Bus API is available");
                 (conn, udev, tree)
@@ -16,28 +16,28 @@ use crate::{
 
 fn handle_udev(
     engine: LockableEngine,
-    mut recv: UnboundedReceiver<UdevEngineEvent>,
+    mut recv: UnboundedReceiver<Vec<UdevEngineEvent>>,
 ) -> JoinHandle<()> {
     tokio::spawn(async move {
         loop {
-            let udev_event = match recv.recv().await {
+            let udev_events = match recv.recv().await {
                 Some(u) => u,
                 None => {
                     error!("Channel from udev handler to JSON RPC handler was shut");
                     return;
                 }
             };
-            let mut lock = engine.lock().await;
+            let mut lock = engine.write().await;
             // Return value should be ignored as JSON RPC does not keep a record
             // of data structure information in the IPC layer.
-            let _ = lock.handle_event(&udev_event);
+            let _ = lock.handle_events(&udev_events);
         }
     })
 }
 
 pub async fn setup(
     engine: LockableEngine,
-    recv: UnboundedReceiver<UdevEngineEvent>,
+    recv: UnboundedReceiver<Vec<UdevEngineEvent>>,
     _: Sender<()>,
 ) -> StratisResult<()> {
     let mut udev_join = handle_udev(engine.clone(), recv);
@@ -6,6 +6,7 @@ pub use self::{
     errors::{StratisError, StratisResult},
     run::run,
     stratis::VERSION,
+    usage_refresh::DEFAULT_USAGE_REFRESH_INTERVAL,
 };
 
 mod dm;
@@ -15,3 +16,4 @@ mod run;
 #[allow(clippy::module_inception)]
 mod stratis;
 mod udev_monitor;
+mod usage_refresh;
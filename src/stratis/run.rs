@@ -4,7 +4,10 @@
 
 //! Main loop
 
-use std::sync::atomic::{AtomicUsize, Ordering};
+use std::{
+    sync::atomic::{AtomicUsize, Ordering},
+    time::Duration,
+};
 
 use tokio::{
     runtime::Builder,
@@ -14,10 +17,13 @@ use tokio::{
 };
 
 use crate::{
-    engine::{Lockable, LockableEngine, SimEngine, StratEngine, UdevEngineEvent},
+    engine::{
+        Lockable, LockableEngine, PoolMetadataFormat, SimEngine, StratEngine, ThinCheckPolicy,
+        UdevEngineEvent,
+    },
     stratis::{
         dm::dm_event_thread, errors::StratisResult, ipc_support::setup, stratis::VERSION,
-        udev_monitor::udev_thread,
+        udev_monitor::udev_thread, usage_refresh::usage_refresh_thread,
     },
 };
 
@@ -34,7 +40,19 @@ async fn signal_thread() {
 /// or a fatal error is encountered.
 /// If sim is true, start the sim engine rather than the real engine.
 /// Always check for devicemapper context.
-pub fn run(sim: bool) -> StratisResult<()> {
+/// If usage_refresh_interval is not None, refresh the cached pool and
+/// filesystem usage at that interval as well as on devicemapper events.
+/// The thin pool metadata of each pool set up by the real engine is checked
+/// according to thin_check_policy, and the metadata of each pool it creates
+/// is written in metadata_format. The devices of an encrypted pool are
+/// unlocked on no more than unlock_parallelism threads at once.
+pub fn run(
+    sim: bool,
+    usage_refresh_interval: Option<Duration>,
+    thin_check_policy: ThinCheckPolicy,
+    metadata_format: PoolMetadataFormat,
+    unlock_parallelism: usize,
+) -> StratisResult<()> {
     let runtime = Builder::new_multi_thread()
         .enable_all()
         .thread_name_fn(|| {
@@ -58,10 +76,14 @@ pub fn run(sim: bool) -> StratisResult<()> {
             info!("stratis daemon version {} started", VERSION);
             if sim {
                 info!("Using SimEngine");
-                Lockable::new_exclusive(SimEngine::default())
+                Lockable::new_engine(SimEngine::default())
             } else {
                 info!("Using StratEngine");
-                Lockable::new_exclusive(match StratEngine::initialize() {
+                Lockable::new_engine(match StratEngine::initialize(
+                    thin_check_policy,
+                    metadata_format,
+                    unlock_parallelism,
+                ) {
                     Ok(engine) => engine,
                     Err(e) => {
                         error!("Failed to start up stratisd engine: {}; exiting", e);
@@ -72,7 +94,7 @@ pub fn run(sim: bool) -> StratisResult<()> {
         };
 
         let (trigger, should_exit) = channel(1);
-        let (sender, receiver) = unbounded_channel::<UdevEngineEvent>();
+        let (sender, receiver) = unbounded_channel::<Vec<UdevEngineEvent>>();
 
         let join_udev = task::spawn_blocking(move || udev_thread(sender, should_exit));
         let join_ipc = task::spawn(setup(engine.clone(), receiver, trigger.clone()));
@@ -82,6 +104,12 @@ pub fn run(sim: bool) -> StratisResult<()> {
         } else {
             Some(engine.clone())
         }));
+        match usage_refresh_interval {
+            Some(refresh_interval) if !sim => {
+                task::spawn(usage_refresh_thread(engine.clone(), refresh_interval));
+            }
+            _ => info!("Periodic refresh of pool and filesystem usage disabled"),
+        }
 
         select! {
             res = join_udev => {
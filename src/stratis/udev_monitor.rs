@@ -4,9 +4,14 @@
 
 //! Support for monitoring udev events.
 
-use std::os::unix::io::{AsRawFd, RawFd};
+use std::{
+    collections::HashMap,
+    convert::TryFrom,
+    os::unix::io::{AsRawFd, RawFd},
+    time::{Duration, Instant},
+};
 
-use libudev::Event;
+use libudev::{Event, EventType};
 use nix::poll::{poll, PollFd, PollFlags};
 use tokio::sync::{
     broadcast::{error::TryRecvError, Receiver},
@@ -14,14 +19,22 @@ use tokio::sync::{
 };
 
 use crate::{
-    engine::UdevEngineEvent,
+    engine::{increment_counter, Counter, UdevEngineEvent},
     stratis::errors::{StratisError, StratisResult},
 };
 
-// Poll for udev events.
+// Once an event is received, the udev thread waits this long for further
+// events, so that devices which appear together, e.g., all the disks in an
+// enclosure, are handled in a single batch.
+const BATCH_WINDOW: Duration = Duration::from_millis(10);
+
+// The maximum number of events in a single batch.
+const MAX_BATCH_SIZE: usize = 1024;
+
+// Poll for udev events and send them to the engine in batches.
 // Check for exit condition and return if true.
 pub fn udev_thread(
-    sender: UnboundedSender<UdevEngineEvent>,
+    sender: UnboundedSender<Vec<UdevEngineEvent>>,
     mut should_exit: Receiver<()>,
 ) -> StratisResult<()> {
     let context = libudev::Context::new()?;
@@ -45,20 +58,86 @@ pub fn udev_thread(
                 };
             }
             _ => {
-                if let Some(ref e) = udev.poll() {
-                    if let Err(e) = sender.send(UdevEngineEvent::from(e)) {
-                        warn!(
-                            "udev event could not be sent to engine thread: {}; the \
-                            engine was not notified of this udev event",
-                            e,
-                        );
-                    }
+                let batch = receive_batch(&mut udev, &mut pollers)?;
+                if batch.is_empty() {
+                    continue;
+                }
+                if let Err(e) = sender.send(batch) {
+                    warn!(
+                        "udev events could not be sent to engine thread: {}; the \
+                        engine was not notified of these udev events",
+                        e,
+                    );
                 }
             }
         }
     }
 }
 
+// Receive all the events that are ready, and any that become ready within
+// the batch window, up to the maximum batch size. Return the events,
+// coalesced so that there is at most one event for each device.
+fn receive_batch(
+    udev: &mut UdevMonitor,
+    pollers: &mut [PollFd],
+) -> StratisResult<Vec<UdevEngineEvent>> {
+    let deadline = Instant::now() + BATCH_WINDOW;
+    let mut events = Vec::new();
+    'receive: loop {
+        while let Some(ref e) = udev.poll() {
+            events.push(UdevEngineEvent::from(e));
+            if events.len() >= MAX_BATCH_SIZE {
+                break 'receive;
+            }
+        }
+        let remaining = deadline.saturating_duration_since(Instant::now());
+        let timeout = i32::try_from(remaining.as_millis()).unwrap_or(std::i32::MAX);
+        if timeout == 0 || poll(pollers, timeout)? == 0 {
+            break;
+        }
+    }
+    increment_counter(Counter::UdevEventsReceived, events.len());
+    let events = coalesce_events(events);
+    increment_counter(Counter::UdevEventsDelivered, events.len());
+    Ok(events)
+}
+
+// Reduce events to the last event received for each device, keeping the
+// order in which those last events were received. The last event describes
+// the current state of the device, so the earlier ones need not be handled.
+// Remove events are always kept, however, since the device number may have
+// been reused by a different device, whose later events do not describe the
+// departure of the earlier one. An event for a device without a device
+// number is always kept.
+fn coalesce_events(events: Vec<UdevEngineEvent>) -> Vec<UdevEngineEvent> {
+    let last = events
+        .iter()
+        .enumerate()
+        .filter_map(|(index, event)| event.device().devnum().map(|devnum| (devnum, index)))
+        .collect::<HashMap<_, _>>();
+    let num_events = events.len();
+    let coalesced = events
+        .into_iter()
+        .enumerate()
+        .filter(|(index, event)| {
+            event.event_type() == EventType::Remove
+                || event
+                    .device()
+                    .devnum()
+                    .map_or(true, |devnum| last[&devnum] == *index)
+        })
+        .map(|(_, event)| event)
+        .collect::<Vec<_>>();
+    if coalesced.len() < num_events {
+        debug!(
+            "Coalesced {} udev events into {} events",
+            num_events,
+            coalesced.len()
+        );
+    }
+    coalesced
+}
+
 /// A facility for listening for and handling udev events that stratisd
 /// considers interesting.
 struct UdevMonitor<'a> {
@@ -85,3 +164,55 @@ impl<'a> AsRawFd for UdevMonitor<'a> {
         self.socket.as_raw_fd()
     }
 }
+
+#[cfg(test)]
+mod tests {
+    use std::collections::HashMap;
+
+    use crate::engine::UdevEngineDevice;
+
+    use super::*;
+
+    fn udev_event(event_type: EventType, devnum: Option<libc::dev_t>) -> UdevEngineEvent {
+        UdevEngineEvent::new(
+            event_type,
+            UdevEngineDevice::new(true, None, devnum, HashMap::new()),
+        )
+    }
+
+    #[test]
+    /// Verify that only the last event for each device is kept, in the order
+    /// in which the last events were received, except that remove events
+    /// are all kept, and that events for devices without a device number
+    /// are all kept.
+    fn test_coalesce_events() {
+        let events = vec![
+            udev_event(EventType::Add, Some(1)),
+            udev_event(EventType::Add, Some(2)),
+            udev_event(EventType::Change, None),
+            udev_event(EventType::Change, Some(1)),
+            udev_event(EventType::Change, None),
+            udev_event(EventType::Remove, Some(2)),
+            udev_event(EventType::Add, Some(3)),
+            udev_event(EventType::Remove, Some(4)),
+            udev_event(EventType::Add, Some(4)),
+            udev_event(EventType::Change, Some(4)),
+        ];
+        let coalesced = coalesce_events(events)
+            .iter()
+            .map(|event| (event.event_type(), event.device().devnum()))
+            .collect::<Vec<_>>();
+        assert_eq!(
+            coalesced,
+            vec![
+                (EventType::Change, None),
+                (EventType::Change, Some(1)),
+                (EventType::Change, None),
+                (EventType::Remove, Some(2)),
+                (EventType::Add, Some(3)),
+                (EventType::Remove, Some(4)),
+                (EventType::Change, Some(4)),
+            ]
+        );
+    }
+}
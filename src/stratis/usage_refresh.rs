@@ -0,0 +1,33 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+use std::time::Duration;
+
+use tokio::{
+    task::block_in_place,
+    time::{interval_at, Instant},
+};
+
+use crate::engine::LockableEngine;
+
+/// The default interval at which the cached pool and filesystem usage is
+/// refreshed if no devicemapper event has caused it to be refreshed sooner.
+pub const DEFAULT_USAGE_REFRESH_INTERVAL: Duration = Duration::from_secs(60);
+
+// Refreshes the cached usage of all pools and filesystems every
+// refresh_interval, in addition to the refresh which happens whenever a
+// devicemapper event is handled. The status of the devices is read while
+// holding only a read lock, so that other readers are not held up; the
+// write lock is held only to update the cached usage.
+pub async fn usage_refresh_thread(engine: LockableEngine, refresh_interval: Duration) {
+    let mut timer = interval_at(Instant::now() + refresh_interval, refresh_interval);
+    loop {
+        timer.tick().await;
+        let readings = {
+            let read_lock = engine.read().await;
+            block_in_place(|| read_lock.read_usage())
+        };
+        engine.write().await.set_usage(readings);
+    }
+}